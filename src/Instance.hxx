@@ -38,6 +38,7 @@ class UpdateService;
 class EventLoop;
 class Error;
 class ClientList;
+class ClientThreads;
 struct Partition;
 
 struct Instance final
@@ -74,9 +75,16 @@ struct Instance final
 
 	ClientList *client_list;
 
+	/**
+	 * The threads serving client connections, or nullptr if all
+	 * clients run in the main thread.
+	 */
+	ClientThreads *client_threads;
+
 	Partition *partition;
 
-	Instance() {
+	Instance()
+		:client_threads(nullptr) {
 #ifdef ENABLE_DATABASE
 		storage = nullptr;
 		update = nullptr;
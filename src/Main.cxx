@@ -31,6 +31,7 @@
 #include "Listen.hxx"
 #include "client/Client.hxx"
 #include "client/ClientList.hxx"
+#include "client/ClientThreads.hxx"
 #include "command/AllCommands.hxx"
 #include "Partition.hxx"
 #include "tag/TagConfig.hxx"
@@ -47,6 +48,7 @@
 #include "playlist/PlaylistRegistry.hxx"
 #include "zeroconf/ZeroconfGlue.hxx"
 #include "decoder/DecoderList.hxx"
+#include "decoder/SeekIndex.hxx"
 #include "AudioConfig.hxx"
 #include "pcm/PcmConvert.hxx"
 #include "unix/SignalHandlers.hxx"
@@ -259,11 +261,29 @@ glue_sticker_init(void)
 		return;
 	}
 
-	if (!sticker_global_init(std::move(sticker_file), error))
+	if (!sticker_global_init(*instance->event_loop,
+				 std::move(sticker_file), error))
 		FatalError(error);
 #endif
 }
 
+/**
+ * Configure the #SeekIndex cache file.
+ */
+static void
+glue_seek_index_init()
+{
+	Error error;
+	auto path = config_get_path(ConfigOption::SEEK_INDEX_FILE, error);
+	if (path.IsNull()) {
+		if (error.IsDefined())
+			FatalError(error);
+		return;
+	}
+
+	seek_index_cache_init(std::move(path));
+}
+
 static bool
 glue_state_file_init(Error &error)
 {
@@ -336,7 +356,18 @@ initialize_decoder_and_player(void)
 
 	buffer_size *= 1024;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const size_t chunk_size =
+		config_get_positive(ConfigOption::AUDIO_CHUNK_SIZE,
+				    DEFAULT_CHUNK_SIZE);
+	if (chunk_size < MIN_CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE)
+		FormatFatalError("audio chunk size \"%lu\" is out of range",
+				 (unsigned long)chunk_size);
+
+	if (chunk_size > buffer_size)
+		FormatFatalError("audio chunk size \"%lu\" is bigger than the "
+				 "buffer", (unsigned long)chunk_size);
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
 
 	if (buffered_chunks >= 1 << 15)
 		FormatFatalError("buffer size \"%lu\" is too big",
@@ -367,6 +398,7 @@ initialize_decoder_and_player(void)
 	instance->partition = new Partition(*instance,
 					    max_length,
 					    buffered_chunks,
+					    chunk_size,
 					    buffered_before_play);
 }
 
@@ -565,6 +597,7 @@ static int mpd_main_after_fork(struct options options)
 	}
 
 	decoder_plugin_init_all();
+	glue_seek_index_init();
 
 #ifdef ENABLE_DATABASE
 	const bool create_db = InitDatabaseAndStorage();
@@ -598,6 +631,15 @@ static int mpd_main_after_fork(struct options options)
 
 	io_thread_start();
 
+	const unsigned n_client_threads =
+		config_get_unsigned(ConfigOption::CLIENT_THREADS, 0);
+	if (n_client_threads > 0) {
+		instance->client_threads =
+			new ClientThreads(*instance->event_loop,
+					  n_client_threads);
+		instance->client_threads->Start();
+	}
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr &&
 	    !instance->neighbors->Open(error))
@@ -684,6 +726,12 @@ static int mpd_main_after_fork(struct options options)
 	instance->partition->pc.Kill();
 	ZeroconfDeinit();
 	listen_global_finish();
+
+	if (instance->client_threads != nullptr) {
+		instance->client_threads->Stop(*instance->client_list);
+		delete instance->client_threads;
+	}
+
 	delete instance->client_list;
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -721,6 +769,7 @@ static int mpd_main_after_fork(struct options options)
 
 	delete instance->partition;
 	command_finish();
+	seek_index_cache_finish();
 	decoder_plugin_deinit_all();
 #ifdef ENABLE_ARCHIVE
 	archive_plugin_deinit_all();
@@ -21,20 +21,44 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 #include "system/FatalError.hxx"
+#include "util/HugeAllocator.hxx"
 
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
-	if (buffer.IsOOM())
+/**
+ * Align each chunk's data buffer to a cache line.
+ */
+static constexpr size_t
+CalcStride(size_t chunk_size)
+{
+	return (chunk_size + 63) & ~size_t(63);
+}
+
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size)
+	:buffer(num_chunks),
+	 chunk_size(_chunk_size), stride(CalcStride(_chunk_size)),
+	 payload((uint8_t *)HugeAllocate(num_chunks * stride)) {
+	assert(chunk_size > 0);
+
+	if (buffer.IsOOM() || payload == nullptr)
 		FatalError("Failed to allocate buffer");
 }
 
+MusicBuffer::~MusicBuffer()
+{
+	HugeFree(payload, buffer.GetCapacity() * stride);
+}
+
 MusicChunk *
 MusicBuffer::Allocate()
 {
-	const ScopeLock protect(mutex);
-	return buffer.Allocate();
+	MusicChunk *chunk = buffer.Allocate();
+	if (chunk != nullptr) {
+		chunk->data = payload + buffer.IndexOf(chunk) * stride;
+		chunk->capacity = chunk_size;
+	}
+
+	return chunk;
 }
 
 void
@@ -42,8 +66,6 @@ MusicBuffer::Return(MusicChunk *chunk)
 {
 	assert(chunk != nullptr);
 
-	const ScopeLock protect(mutex);
-
 	if (chunk->other != nullptr) {
 		assert(chunk->other->other == nullptr);
 		buffer.Free(chunk->other);
@@ -51,3 +73,13 @@ MusicBuffer::Return(MusicChunk *chunk)
 
 	buffer.Free(chunk);
 }
+
+void
+MusicBuffer::DiscardUnsafe()
+{
+	if (!buffer.IsEmpty())
+		return;
+
+	buffer.DiscardUnsafe();
+	HugeDiscard(payload, buffer.GetCapacity() * stride);
+}
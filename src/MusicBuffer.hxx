@@ -20,19 +20,32 @@
 #ifndef MPD_MUSIC_BUFFER_HXX
 #define MPD_MUSIC_BUFFER_HXX
 
-#include "util/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "util/LockFreeSliceBuffer.hxx"
 
 struct MusicChunk;
 
 /**
- * An allocator for #MusicChunk objects.
+ * An allocator for #MusicChunk objects.  All methods are lock-free
+ * and may be called from any thread.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	Mutex mutex;
+	LockFreeSliceBuffer<MusicChunk> buffer;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * The size of MusicChunk::data.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * The distance between two chunks' data buffers in
+	 * #payload.
+	 */
+	const size_t stride;
+
+	/**
+	 * The data buffers of all chunks.
+	 */
+	uint8_t *const payload;
 
 public:
 	/**
@@ -40,14 +53,18 @@ public:
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the size of MusicChunk::data in bytes
 	 */
-	MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size);
+	~MusicBuffer();
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
 #ifndef NDEBUG
 	/**
-	 * Check whether the buffer is empty.  This call is not
-	 * protected with the mutex, and may only be used while this
-	 * object is inaccessible to other threads.
+	 * Check whether the buffer is empty.  This may only be used
+	 * while this object is inaccessible to other threads.
 	 */
 	bool IsEmptyUnsafe() const {
 		return buffer.IsEmpty();
@@ -64,6 +81,13 @@ public:
 		return buffer.GetCapacity();
 	}
 
+	/**
+	 * Returns the size of MusicChunk::data in bytes.
+	 */
+	size_t GetChunkSize() const {
+		return chunk_size;
+	}
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
@@ -78,6 +102,13 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(MusicChunk *chunk);
+
+	/**
+	 * Give the memory of all chunks back to the kernel.  This
+	 * object must be inaccessible to other threads.  Does nothing
+	 * if there are chunks which have not been returned yet.
+	 */
+	void DiscardUnsafe();
 };
 
 #endif
@@ -28,10 +28,19 @@
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <stdint.h>
 #include <stddef.h>
 
-static constexpr size_t CHUNK_SIZE = 4096;
+/**
+ * The default size of MusicChunk::data, see setting
+ * "audio_chunk_size".
+ */
+static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
+
+static constexpr size_t MIN_CHUNK_SIZE = 256;
+static constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
 
 struct AudioFormat;
 struct Tag;
@@ -41,8 +50,12 @@ struct Tag;
  * MusicPipe::Push() caller.
  */
 struct MusicChunk {
-	/** the next chunk in a linked list */
-	MusicChunk *next;
+	/**
+	 * The next chunk in a linked list.  This is atomic because
+	 * #MusicPipe links new chunks while other threads walk the
+	 * list.
+	 */
+	std::atomic<MusicChunk *> next;
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -57,7 +70,7 @@ struct MusicChunk {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length;
+	uint32_t length;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -86,8 +99,16 @@ struct MusicChunk {
 	 */
 	unsigned replay_gain_serial;
 
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE];
+	/**
+	 * The data (probably PCM).  This buffer is owned by the
+	 * #MusicBuffer and is assigned by MusicBuffer::Allocate().
+	 */
+	uint8_t *data;
+
+	/**
+	 * The size of the #data buffer in bytes.
+	 */
+	size_t capacity;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
@@ -97,7 +118,8 @@ struct MusicChunk {
 		:other(nullptr),
 		 length(0),
 		 tag(nullptr),
-		 replay_gain_serial(0) {}
+		 replay_gain_serial(0),
+		 data(nullptr), capacity(0) {}
 
 	~MusicChunk();
 
@@ -27,8 +27,6 @@
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const
 {
-	const ScopeLock protect(mutex);
-
 	for (const MusicChunk *i = head; i != nullptr; i = i->next)
 		if (i == chunk)
 			return true;
@@ -41,33 +39,47 @@ MusicPipe::Contains(const MusicChunk *chunk) const
 MusicChunk *
 MusicPipe::Shift()
 {
-	const ScopeLock protect(mutex);
-
-	MusicChunk *chunk = head;
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
+	MusicChunk *chunk = head.load(std::memory_order_acquire);
+	if (chunk == nullptr)
+		return nullptr;
 
-		head = chunk->next;
-		--size;
-
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
-		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+	MusicChunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		/* this looks like the last chunk: detach it by
+		   pointing #tail_r back to #head; this must be done
+		   atomically, because Push() may be appending to it
+		   right now */
+		head.store(nullptr, std::memory_order_relaxed);
+
+		auto *expected = &chunk->next;
+		if (!tail_r.compare_exchange_strong(expected, &head)) {
+			/* Push() has already claimed the "next"
+			   attribute of this chunk; wait until it has
+			   stored the new chunk there (this is only a
+			   matter of a few instructions) */
+			while ((next = chunk->next.load(std::memory_order_acquire)) == nullptr) {
+			}
+
+			head.store(next, std::memory_order_release);
 		}
+	} else
+		head.store(next, std::memory_order_release);
+
+	gcc_unused
+	const unsigned old_size =
+		size.fetch_sub(1, std::memory_order_relaxed);
+	assert(old_size > 0);
 
 #ifndef NDEBUG
-		/* poison the "next" reference */
-		chunk->next = (MusicChunk *)(void *)0x01010101;
+	/* poison the "next" reference */
+	chunk->next = (MusicChunk *)(void *)0x01010101;
 
-		if (size == 0)
-			audio_format.Clear();
+	if (old_size == 1)
+		audio_format.store(AudioFormat::Undefined(),
+				   std::memory_order_relaxed);
 #endif
-	}
 
 	return chunk;
 }
@@ -87,20 +99,40 @@ MusicPipe::Push(MusicChunk *chunk)
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
-	const ScopeLock protect(mutex);
+	chunk->next.store(nullptr, std::memory_order_relaxed);
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+	/* increment the counter before the chunk becomes visible, so
+	   a concurrent Shift() cannot make it wrap */
+	gcc_unused
+	const unsigned old_size =
+		size.fetch_add(1, std::memory_order_relaxed);
 
 #ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+	const AudioFormat chunk_format = chunk->length > 0
+		? chunk->audio_format
+		: AudioFormat::Undefined();
+
+	if (old_size == 0) {
+		/* the first chunk of a new sequence: overwrite the
+		   format of the previous one (which Shift() may not
+		   have cleared yet) */
+		audio_format.store(chunk_format, std::memory_order_relaxed);
+	} else {
+		/* Shift() cannot clear the format meanwhile, because
+		   this chunk is already counted; only a late clear
+		   from an earlier sequence may come in */
+		const AudioFormat af =
+			audio_format.load(std::memory_order_relaxed);
+		assert(!af.IsDefined() || chunk->CheckFormat(af));
+
+		if (!af.IsDefined() && chunk_format.IsDefined())
+			audio_format.store(chunk_format,
+					   std::memory_order_relaxed);
+	}
 #endif
 
-	chunk->next = nullptr;
-	*tail_r = chunk;
-	tail_r = &chunk->next;
-
-	++size;
+	/* claim the tail and link the chunk; the "release" makes the
+	   chunk's contents visible to the consumer */
+	auto *prev = tail_r.exchange(&chunk->next, std::memory_order_acq_rel);
+	prev->store(chunk, std::memory_order_release);
 }
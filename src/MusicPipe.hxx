@@ -20,13 +20,14 @@
 #ifndef MPD_PIPE_H
 #define MPD_PIPE_H
 
-#include "thread/Mutex.hxx"
 #include "Compiler.h"
 
 #ifndef NDEBUG
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 
 struct MusicChunk;
@@ -35,22 +36,37 @@ class MusicBuffer;
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * This class is lock-free: there may be one thread calling Push()
+ * and one thread calling Shift() and Clear() at a time, without
+ * further synchronization.  Any thread may walk the chunk list
+ * starting at Peek(), as long as the consumer does not shift those
+ * chunks meanwhile.
  */
 class MusicPipe {
 	/** the first chunk */
-	MusicChunk *head;
+	std::atomic<MusicChunk *> head;
 
-	/** a pointer to the tail of the chunk */
-	MusicChunk **tail_r;
+	/**
+	 * A pointer to the "next" attribute of the last chunk, or to
+	 * #head if the pipe is empty.  Push() swaps it atomically,
+	 * and Shift() resets it when it removes the last chunk.
+	 */
+	std::atomic<std::atomic<MusicChunk *> *> tail_r;
 
 	/** the current number of chunks */
-	unsigned size;
-
-	/** a mutex which protects #head and #tail_r */
-	mutable Mutex mutex;
+	std::atomic_uint size;
 
 #ifndef NDEBUG
-	AudioFormat audio_format;
+	/**
+	 * The audio format of the chunks in this pipe (for
+	 * consistency checks).  Push() sets it when the pipe was
+	 * empty, and Shift() clears it when it removes the last
+	 * chunk.  Without a lock, a clear by Shift() may arrive late
+	 * and erase the format of the next chunks; that only makes
+	 * the check miss a mismatch, but never report a wrong one.
+	 */
+	std::atomic<AudioFormat> audio_format;
 #endif
 
 public:
@@ -60,7 +76,8 @@ public:
 	MusicPipe()
 		:head(nullptr), tail_r(&head), size(0) {
 #ifndef NDEBUG
-		audio_format.Clear();
+		audio_format.store(AudioFormat::Undefined(),
+				   std::memory_order_relaxed);
 #endif
 	}
 
@@ -68,10 +85,13 @@ public:
 	 * Frees the object.  It must be empty now.
 	 */
 	~MusicPipe() {
-		assert(head == nullptr);
-		assert(tail_r == &head);
+		assert(head.load() == nullptr);
+		assert(tail_r.load() == &head);
 	}
 
+	MusicPipe(const MusicPipe &) = delete;
+	MusicPipe &operator=(const MusicPipe &) = delete;
+
 #ifndef NDEBUG
 	/**
 	 * Checks if the audio format if the chunk is equal to the specified
@@ -79,12 +99,14 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const {
-		return !audio_format.IsDefined() ||
-			audio_format == other;
+		const AudioFormat af =
+			audio_format.load(std::memory_order_relaxed);
+		return !af.IsDefined() || af == other;
 	}
 
 	/**
 	 * Checks if the specified chunk is enqueued in the music pipe.
+	 * Must only be called by the consumer thread.
 	 */
 	gcc_pure
 	bool Contains(const MusicChunk *chunk) const;
@@ -96,11 +118,12 @@ public:
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const {
-		return head;
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
 	 * Removes the first chunk from the head, and returns it.
+	 * Must only be called by the consumer thread.
 	 */
 	MusicChunk *Shift();
 
@@ -112,7 +135,8 @@ public:
 	void Clear(MusicBuffer &buffer);
 
 	/**
-	 * Pushes a chunk to the tail of the pipe.
+	 * Pushes a chunk to the tail of the pipe.  Must only be called
+	 * by the producer thread.
 	 */
 	void Push(MusicChunk *chunk);
 
@@ -121,7 +145,7 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return size;
+		return size.load(std::memory_order_relaxed);
 	}
 
 	gcc_pure
@@ -48,10 +48,12 @@ struct Partition final : private PlayerListener, private MixerListener {
 	Partition(Instance &_instance,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
+		  size_t chunk_size,
 		  unsigned buffered_before_play)
 		:instance(_instance), playlist(max_length),
 		 outputs(*this),
-		 pc(*this, outputs, buffer_chunks, buffered_before_play) {}
+		 pc(*this, outputs, buffer_chunks, chunk_size,
+		    buffered_before_play) {}
 
 	void ClearQueue() {
 		playlist.Clear(pc);
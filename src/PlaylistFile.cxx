@@ -40,11 +40,15 @@
 #include "fs/FileSystem.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "fs/NarrowPath.hxx"
 #include "util/Macros.hxx"
 #include "util/StringUtil.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 
+#include <map>
+#include <algorithm>
+
 #include <assert.h>
 #include <sys/stat.h>
 #include <string.h>
@@ -55,6 +59,61 @@ static const char PLAYLIST_COMMENT = '#';
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
+/**
+ * The maximum number of parsed stored playlists kept in memory.
+ */
+static constexpr size_t PLAYLIST_CACHE_SIZE = 8;
+
+/**
+ * A parsed stored playlist.  It is only used while the file's
+ * modification time, size (and inode number) are unchanged; edits
+ * made by MPD update the entry after writing the file.
+ *
+ * Like all stored playlist functions, the cache is only accessed by
+ * the main thread.
+ */
+struct PlaylistCacheEntry {
+	time_t mtime;
+	uint64_t size;
+#ifndef WIN32
+	ino_t inode;
+#endif
+
+	unsigned long last_used;
+
+	/**
+	 * Does the file begin with "#EXTM3U"?  Its "#EXTINF" lines
+	 * are ignored here, so printing such a playlist is left to
+	 * the playlist plugin.
+	 */
+	bool extended;
+
+	PlaylistFileContents contents;
+
+	void SetStamp(const FileInfo &fi) {
+		mtime = fi.GetModificationTime();
+		size = fi.GetSize();
+#ifndef WIN32
+		inode = fi.GetInode();
+#endif
+	}
+
+	gcc_pure
+	bool CheckStamp(const FileInfo &fi) const {
+		return mtime == fi.GetModificationTime() &&
+			size == fi.GetSize()
+#ifndef WIN32
+			&& inode == fi.GetInode()
+#endif
+			;
+	}
+};
+
+typedef std::map<std::string, PlaylistCacheEntry> PlaylistCache;
+
+static PlaylistCache playlist_cache;
+static unsigned long playlist_cache_tick;
+
 void
 spl_global_init(void)
 {
@@ -222,17 +281,19 @@ ListPlaylistFiles(Error &error)
 	return list;
 }
 
+/**
+ * Write the playlist to a temporary file and rename it over the old
+ * one, so a crash leaves either the old or the new version.
+ */
 static bool
-SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
+SavePlaylistFile(const PlaylistFileContents &contents, Path path_fs,
 		 Error &error)
 {
-	assert(utf8path != nullptr);
-
-	const auto path_fs = spl_map_to_fs(utf8path, error);
-	if (path_fs.IsNull())
-		return false;
+	const auto tmp_fs =
+		AllocatedPath::FromFS(PathTraitsFS::string(path_fs.c_str()) +
+				      PATH_LITERAL(".tmp"));
 
-	FileOutputStream fos(path_fs, error);
+	FileOutputStream fos(tmp_fs, error);
 	if (!fos.IsDefined()) {
 		TranslatePlaylistError(error);
 		return false;
@@ -243,98 +304,268 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
 	for (const auto &uri_utf8 : contents)
 		playlist_print_uri(bos, uri_utf8.c_str());
 
-	return bos.Flush(error) && fos.Commit(error);
+	if (!bos.Flush(error) || !fos.Commit(error))
+		return false;
+
+	if (!RenameFileReplace(tmp_fs, path_fs)) {
+#ifdef WIN32
+		error.SetLastError("Failed to replace playlist file");
+#else
+		playlist_errno(error);
+#endif
+		RemoveFile(tmp_fs);
+		return false;
+	}
+
+	return true;
 }
 
-PlaylistFileContents
-LoadPlaylistFile(const char *utf8path, Error &error)
+/**
+ * Convert one line of a playlist file to a song URI.
+ *
+ * @return false if the line shall be ignored
+ */
+static bool
+ParsePlaylistLine(const char *s, std::string &uri_utf8)
 {
-	PlaylistFileContents contents;
+#ifdef _UNICODE
+	wchar_t buffer[MAX_PATH];
+	auto result = MultiByteToWideChar(CP_ACP, 0, s, -1,
+					  buffer, ARRAY_SIZE(buffer));
+	if (result <= 0)
+		return false;
 
-	const auto path_fs = spl_map_to_fs(utf8path, error);
-	if (path_fs.IsNull())
-		return contents;
+	const Path path = Path::FromFS(buffer);
+#else
+	const Path path = Path::FromFS(s);
+#endif
+
+	if (!uri_has_scheme(s)) {
+#ifdef ENABLE_DATABASE
+		uri_utf8 = map_fs_to_utf8(path);
+		if (uri_utf8.empty()) {
+			if (path.IsAbsolute()) {
+				uri_utf8 = path.ToUTF8();
+				if (uri_utf8.empty())
+					return false;
+			} else
+				return false;
+		}
+#else
+		return false;
+#endif
+	} else {
+		uri_utf8 = path.ToUTF8();
+		if (uri_utf8.empty())
+			return false;
+	}
 
+	return true;
+}
+
+static bool
+ParsePlaylistFile(Path path_fs, PlaylistCacheEntry &entry, Error &error)
+{
 	TextFile file(path_fs, error);
 	if (file.HasFailed()) {
 		TranslatePlaylistError(error);
-		return contents;
+		return false;
 	}
 
+	auto &contents = entry.contents;
+	entry.extended = false;
+
+	std::string uri_utf8;
 	char *s;
-	while ((s = file.ReadLine()) != nullptr) {
-		if (*s == 0 || *s == PLAYLIST_COMMENT)
+	for (bool first = true; (s = file.ReadLine()) != nullptr;
+	     first = false) {
+		if (*s == 0 || *s == PLAYLIST_COMMENT) {
+			if (first && strcmp(s, "#EXTM3U") == 0)
+				entry.extended = true;
 			continue;
+		}
 
-#ifdef _UNICODE
-		wchar_t buffer[MAX_PATH];
-		auto result = MultiByteToWideChar(CP_ACP, 0, s, -1,
-						  buffer, ARRAY_SIZE(buffer));
-		if (result <= 0)
+		if (!ParsePlaylistLine(s, uri_utf8))
 			continue;
 
-		const Path path = Path::FromFS(buffer);
-#else
-		const Path path = Path::FromFS(s);
-#endif
+		contents.emplace_back(std::move(uri_utf8));
+	}
 
-		std::string uri_utf8;
+	return true;
+}
 
-		if (!uri_has_scheme(s)) {
-#ifdef ENABLE_DATABASE
-			uri_utf8 = map_fs_to_utf8(path);
-			if (uri_utf8.empty()) {
-				if (path.IsAbsolute()) {
-					uri_utf8 = path.ToUTF8();
-					if (uri_utf8.empty())
-						continue;
-				} else
-					continue;
-			}
-#else
-			continue;
-#endif
-		} else {
-			uri_utf8 = path.ToUTF8();
-			if (uri_utf8.empty())
-				continue;
-		}
+/**
+ * Look up a cache entry, and check whether the file has been
+ * modified since it was loaded.  Stale entries are removed.
+ */
+static PlaylistCacheEntry *
+FindCachedPlaylist(const char *utf8path, const FileInfo &fi)
+{
+	auto i = playlist_cache.find(utf8path);
+	if (i == playlist_cache.end())
+		return nullptr;
 
-		contents.emplace_back(std::move(uri_utf8));
-		if (contents.size() >= playlist_max_length)
-			break;
+	if (!i->second.CheckStamp(fi)) {
+		playlist_cache.erase(i);
+		return nullptr;
+	}
+
+	i->second.last_used = ++playlist_cache_tick;
+	return &i->second;
+}
+
+static PlaylistCacheEntry &
+AddCachedPlaylist(const char *utf8path)
+{
+	if (playlist_cache.size() >= PLAYLIST_CACHE_SIZE) {
+		/* evict the least recently used entry */
+		auto lru = std::min_element(playlist_cache.begin(),
+					    playlist_cache.end(),
+					    [](const PlaylistCache::value_type &a,
+					       const PlaylistCache::value_type &b){
+						    return a.second.last_used <
+							    b.second.last_used;
+					    });
+		playlist_cache.erase(lru);
 	}
 
-	return contents;
+	auto &entry = playlist_cache[utf8path];
+	entry.contents.clear();
+	entry.last_used = ++playlist_cache_tick;
+	return entry;
+}
+
+static void
+InvalidateCachedPlaylist(const char *utf8path)
+{
+	playlist_cache.erase(utf8path);
+}
+
+/**
+ * Obtain the parsed playlist, from the cache if the file is
+ * unmodified.  The pointer is valid until the next call to a
+ * function which modifies the cache.
+ */
+static PlaylistCacheEntry *
+LoadCachedPlaylist(const char *utf8path, Path path_fs, Error &error)
+{
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi, error)) {
+		InvalidateCachedPlaylist(utf8path);
+		TranslatePlaylistError(error);
+		return nullptr;
+	}
+
+	auto *entry = FindCachedPlaylist(utf8path, fi);
+	if (entry != nullptr)
+		return entry;
+
+	/* if the file gets modified while it is being parsed, the
+	   stamp obtained above will not match the next time, and
+	   the playlist will be parsed again */
+	entry = &AddCachedPlaylist(utf8path);
+	entry->SetStamp(fi);
+	if (!ParsePlaylistFile(path_fs, *entry, error)) {
+		InvalidateCachedPlaylist(utf8path);
+		return nullptr;
+	}
+
+	return entry;
+}
+
+static PlaylistCacheEntry *
+LoadCachedPlaylist(const char *utf8path, Error &error)
+{
+	const auto path_fs = spl_map_to_fs(utf8path, error);
+	if (path_fs.IsNull())
+		return nullptr;
+
+	return LoadCachedPlaylist(utf8path, path_fs, error);
+}
+
+/**
+ * Write the (modified) contents of a cache entry to the file, and
+ * update the entry's stamp.  On error, the entry is removed.
+ */
+static bool
+StoreCachedPlaylist(const char *utf8path, PlaylistCacheEntry &entry,
+		    Error &error)
+{
+	const auto path_fs = spl_map_to_fs(utf8path, error);
+
+	FileInfo fi;
+	if (path_fs.IsNull() ||
+	    !SavePlaylistFile(entry.contents, path_fs, error) ||
+	    !GetFileInfo(path_fs, fi, error)) {
+		InvalidateCachedPlaylist(utf8path);
+		return false;
+	}
+
+	entry.SetStamp(fi);
+	entry.extended = false;
+	return true;
+}
+
+PlaylistFileContents
+LoadPlaylistFile(const char *utf8path, Error &error)
+{
+	const auto *entry = LoadCachedPlaylist(utf8path, error);
+	if (entry == nullptr)
+		return PlaylistFileContents();
+
+	return entry->contents;
 }
 
 bool
-spl_move_index(const char *utf8path, unsigned src, unsigned dest,
-	       Error &error)
+VisitPlaylistFile(const char *utf8path, const VisitPlaylistUri &visitor,
+		  Error &error)
+{
+	const auto *entry = LoadCachedPlaylist(utf8path, error);
+	if (entry == nullptr)
+		return false;
+
+	if (entry->extended)
+		return false;
+
+	for (const auto &uri_utf8 : entry->contents)
+		visitor(uri_utf8.c_str());
+
+	return true;
+}
+
+bool
+spl_move_range(const char *utf8path, unsigned start, unsigned end,
+	       unsigned to, Error &error)
 {
-	if (src == dest)
+	if (start == to && start < end)
 		/* this doesn't check whether the playlist exists, but
 		   what the hell.. */
 		return true;
 
-	auto contents = LoadPlaylistFile(utf8path, error);
-	if (contents.empty() && error.IsDefined())
+	auto *entry = LoadCachedPlaylist(utf8path, error);
+	if (entry == nullptr)
 		return false;
 
-	if (src >= contents.size() || dest >= contents.size()) {
+	auto &contents = entry->contents;
+	if (end > contents.size())
+		end = contents.size();
+
+	if (start >= end || to > contents.size() - (end - start)) {
 		error.Set(playlist_domain, int(PlaylistResult::BAD_RANGE),
 			  "Bad range");
 		return false;
 	}
 
-	const auto src_i = std::next(contents.begin(), src);
-	auto value = std::move(*src_i);
-	contents.erase(src_i);
-
-	const auto dest_i = std::next(contents.begin(), dest);
-	contents.insert(dest_i, std::move(value));
+	/* move the block [start,end) so it begins at position "to"
+	   of the new list */
+	const auto begin = contents.begin();
+	if (to < start)
+		std::rotate(begin + to, begin + start, begin + end);
+	else
+		std::rotate(begin + start, begin + end,
+			    begin + to + (end - start));
 
-	bool result = SavePlaylistFile(contents, utf8path, error);
+	bool result = StoreCachedPlaylist(utf8path, *entry, error);
 
 	idle_add(IDLE_STORED_PLAYLIST);
 	return result;
@@ -355,6 +586,8 @@ spl_clear(const char *utf8path, Error &error)
 
 	fclose(file);
 
+	InvalidateCachedPlaylist(utf8path);
+
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -366,6 +599,8 @@ spl_delete(const char *name_utf8, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	InvalidateCachedPlaylist(name_utf8);
+
 	if (!RemoveFile(path_fs)) {
 		playlist_errno(error);
 		return false;
@@ -376,21 +611,27 @@ spl_delete(const char *name_utf8, Error &error)
 }
 
 bool
-spl_remove_index(const char *utf8path, unsigned pos, Error &error)
+spl_remove_range(const char *utf8path, unsigned start, unsigned end,
+		 Error &error)
 {
-	auto contents = LoadPlaylistFile(utf8path, error);
-	if (contents.empty() && error.IsDefined())
+	auto *entry = LoadCachedPlaylist(utf8path, error);
+	if (entry == nullptr)
 		return false;
 
-	if (pos >= contents.size()) {
+	auto &contents = entry->contents;
+	if (end > contents.size())
+		end = contents.size();
+
+	if (start >= end) {
 		error.Set(playlist_domain, int(PlaylistResult::BAD_RANGE),
 			  "Bad range");
 		return false;
 	}
 
-	contents.erase(std::next(contents.begin(), pos));
+	contents.erase(std::next(contents.begin(), start),
+		       std::next(contents.begin(), end));
 
-	bool result = SavePlaylistFile(contents, utf8path, error);
+	bool result = StoreCachedPlaylist(utf8path, *entry, error);
 
 	idle_add(IDLE_STORED_PLAYLIST);
 	return result;
@@ -403,13 +644,22 @@ spl_append_song(const char *utf8path, const DetachedSong &song, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	/* if the playlist is cached and up to date, append to the
+	   cache entry, too, instead of discarding it */
+	PlaylistCacheEntry *entry = nullptr;
+	FileInfo fi;
+	if (GetFileInfo(path_fs, fi))
+		entry = FindCachedPlaylist(utf8path, fi);
+
 	AppendFileOutputStream fos(path_fs, error);
 	if (!fos.IsDefined()) {
 		TranslatePlaylistError(error);
 		return false;
 	}
 
-	if (fos.Tell() / (MPD_PATH_MAX + 1) >= playlist_max_length) {
+	if (entry != nullptr
+	    ? entry->contents.size() >= playlist_max_length
+	    : fos.Tell() / (MPD_PATH_MAX + 1) >= playlist_max_length) {
 		error.Set(playlist_domain, int(PlaylistResult::TOO_LARGE),
 			  "Stored playlist is too large");
 		return false;
@@ -419,8 +669,28 @@ spl_append_song(const char *utf8path, const DetachedSong &song, Error &error)
 
 	playlist_print_song(bos, song);
 
-	if (!bos.Flush(error) || !fos.Commit(error))
+	if (!bos.Flush(error) || !fos.Commit(error)) {
+		InvalidateCachedPlaylist(utf8path);
 		return false;
+	}
+
+	if (entry != nullptr) {
+		/* parse the line we have just written, just like
+		   LoadPlaylistFile() would */
+		const auto uri_fs =
+			AllocatedPath::FromUTF8(playlist_saveAbsolutePaths
+						? song.GetRealURI()
+						: song.GetURI());
+		std::string uri_utf8;
+		if (!uri_fs.IsNull() &&
+		    ParsePlaylistLine(NarrowPath(uri_fs).c_str(), uri_utf8))
+			entry->contents.emplace_back(std::move(uri_utf8));
+
+		if (GetFileInfo(path_fs, fi))
+			entry->SetStamp(fi);
+		else
+			InvalidateCachedPlaylist(utf8path);
+	}
 
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
@@ -476,5 +746,8 @@ spl_rename(const char *utf8from, const char *utf8to, Error &error)
 	if (to_path_fs.IsNull())
 		return false;
 
+	InvalidateCachedPlaylist(utf8from);
+	InvalidateCachedPlaylist(utf8to);
+
 	return spl_rename_internal(from_path_fs, to_path_fs, error);
 }
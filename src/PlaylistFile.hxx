@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 
 class DetachedSong;
 class SongLoader;
@@ -31,6 +32,8 @@ class AllocatedPath;
 
 typedef std::vector<std::string> PlaylistFileContents;
 
+typedef std::function<void(const char *uri_utf8)> VisitPlaylistUri;
+
 extern bool playlist_saveAbsolutePaths;
 
 /**
@@ -59,12 +62,33 @@ TranslatePlaylistError(Error &error);
 PlaylistVector
 ListPlaylistFiles(Error &error);
 
+/**
+ * Load a stored playlist.  Parsed playlists are cached until the
+ * file is modified.
+ */
 PlaylistFileContents
 LoadPlaylistFile(const char *utf8path, Error &error);
 
+/**
+ * Invoke the visitor for each song URI in the stored playlist,
+ * without copying the (cached) list.
+ *
+ * @return true on success; false on error, or (without setting
+ * #error) if the file is an extended M3U playlist, which should be
+ * read by the playlist plugin to obtain its "#EXTINF" metadata
+ */
 bool
-spl_move_index(const char *utf8path, unsigned src, unsigned dest,
-	       Error &error);
+VisitPlaylistFile(const char *utf8path, const VisitPlaylistUri &visitor,
+		  Error &error);
+
+/**
+ * Move the songs in the range [start,end) so that the first one is
+ * at position #to afterwards.  The end of the range is clipped to the
+ * length of the playlist.
+ */
+bool
+spl_move_range(const char *utf8path, unsigned start, unsigned end,
+	       unsigned to, Error &error);
 
 bool
 spl_clear(const char *utf8path, Error &error);
@@ -72,8 +96,13 @@ spl_clear(const char *utf8path, Error &error);
 bool
 spl_delete(const char *name_utf8, Error &error);
 
+/**
+ * Remove the songs in the range [start,end).  The end of the range
+ * is clipped to the length of the playlist.
+ */
 bool
-spl_remove_index(const char *utf8path, unsigned pos, Error &error);
+spl_remove_range(const char *utf8path, unsigned start, unsigned end,
+		 Error &error);
 
 bool
 spl_append_song(const char *utf8path, const DetachedSong &song, Error &error);
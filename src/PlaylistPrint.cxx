@@ -151,17 +151,11 @@ spl_print(Response &r, Partition &partition,
 	(void)detail;
 #endif
 
-	PlaylistFileContents contents = LoadPlaylistFile(name_utf8, error);
-	if (contents.empty() && error.IsDefined())
-		return false;
-
-	for (const auto &uri_utf8 : contents) {
+	return VisitPlaylistFile(name_utf8, [&](const char *uri_utf8){
 #ifdef ENABLE_DATABASE
-		if (!detail || !PrintSongDetails(r, partition,
-						 uri_utf8.c_str()))
+			if (!detail || !PrintSongDetails(r, partition,
+							 uri_utf8))
 #endif
-			r.Format(SONG_FILE "%s\n", uri_utf8.c_str());
-	}
-
-	return true;
+				r.Format(SONG_FILE "%s\n", uri_utf8);
+		}, error);
 }
@@ -98,6 +98,8 @@ playlist_print_changes_position(Response &r,
  * @param name_utf8 the name of the stored playlist in UTF-8 encoding
  * @param detail true if all details should be printed
  * @return true on success, false if the playlist does not exist
+ * (or, without setting #error, if it is an extended M3U file which
+ * should be printed by the playlist plugin)
  */
 bool
 spl_print(Response &r, Partition &partition,
@@ -21,6 +21,7 @@
 #include "StateFile.hxx"
 #include "output/OutputState.hxx"
 #include "queue/PlaylistState.hxx"
+#include "decoder/DecoderPluginCache.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
@@ -43,7 +44,7 @@ StateFile::StateFile(AllocatedPath &&_path, unsigned _interval,
 	 interval(_interval),
 	 partition(_partition),
 	 prev_volume_version(0), prev_output_version(0),
-	 prev_playlist_version(0)
+	 prev_playlist_version(0), prev_decoder_version(0)
 {
 }
 
@@ -54,6 +55,7 @@ StateFile::RememberVersions()
 	prev_output_version = audio_output_state_get_version();
 	prev_playlist_version = playlist_state_get_hash(partition.playlist,
 							partition.pc);
+	prev_decoder_version = decoder_plugin_cache_get_version();
 }
 
 bool
@@ -62,7 +64,8 @@ StateFile::IsModified() const
 	return prev_volume_version != sw_volume_state_get_hash() ||
 		prev_output_version != audio_output_state_get_version() ||
 		prev_playlist_version != playlist_state_get_hash(partition.playlist,
-								 partition.pc);
+								 partition.pc) ||
+		prev_decoder_version != decoder_plugin_cache_get_version();
 }
 
 inline void
@@ -71,6 +74,7 @@ StateFile::Write(BufferedOutputStream &os)
 	save_sw_volume_state(os);
 	audio_output_state_save(os, partition.outputs);
 	playlist_state_save(os, partition.playlist, partition.pc);
+	decoder_plugin_cache_save(os);
 }
 
 inline bool
@@ -124,7 +128,8 @@ StateFile::Read()
 			audio_output_state_read(line, partition.outputs) ||
 			playlist_state_restore(line, file, song_loader,
 					       partition.playlist,
-					       partition.pc);
+					       partition.pc) ||
+			decoder_plugin_cache_read(line);
 		if (!success)
 			FormatError(state_file_domain,
 				    "Unrecognized line in state file: %s",
@@ -43,7 +43,7 @@ class StateFile final : private TimeoutMonitor {
 	 * file.  If nothing has changed, we won't let the hard drive spin up.
 	 */
 	unsigned prev_volume_version, prev_output_version,
-		prev_playlist_version;
+		prev_playlist_version, prev_decoder_version;
 
 public:
 	static constexpr unsigned DEFAULT_INTERVAL = 2 * 60;
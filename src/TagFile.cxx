@@ -24,6 +24,8 @@
 #include "util/Error.hxx"
 #include "decoder/DecoderList.hxx"
 #include "decoder/DecoderPlugin.hxx"
+#include "decoder/DecoderSniff.hxx"
+#include "decoder/DecoderPluginCache.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
 #include "thread/Cond.hxx"
@@ -74,9 +76,17 @@ public:
 		return plugin.ScanStream(*is, handler, handler_ctx);
 	}
 
-	bool Scan(const DecoderPlugin &plugin) {
-		return plugin.SupportsSuffix(suffix) &&
-			(ScanFile(plugin) || ScanStream(plugin));
+	/**
+	 * @param remember remember the plugin in the
+	 * #DecoderPluginCache on success?
+	 */
+	bool Scan(const DecoderPlugin &plugin, bool remember=true) {
+		if (!ScanFile(plugin) && !ScanStream(plugin))
+			return false;
+
+		if (remember)
+			decoder_plugin_cache_store(suffix, plugin);
+		return true;
 	}
 };
 
@@ -94,7 +104,29 @@ tag_file_scan(Path path_fs, const tag_handler &handler, void *handler_ctx)
 	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
 	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler, handler_ctx);
-	return decoder_plugins_try([&](const DecoderPlugin &plugin){
-			return tfs.Scan(plugin);
-		});
+
+	/* first try the plugin determined from the file contents */
+	const char *mime_type = decoder_sniff_file_mime_type(path_fs);
+	const DecoderPlugin *const sniffed = mime_type != nullptr
+		? decoder_plugin_from_mime_type(mime_type)
+		: nullptr;
+
+	if (sniffed != nullptr && tfs.Scan(*sniffed, false))
+		return true;
+
+	const DecoderPlugin *cached =
+		decoder_plugin_cache_lookup(suffix_utf8.c_str());
+	if (cached == sniffed)
+		cached = nullptr;
+
+	const auto check = [&suffix_utf8,
+			    sniffed](const DecoderPlugin &plugin){
+		return &plugin != sniffed &&
+			plugin.SupportsSuffix(suffix_utf8.c_str());
+	};
+
+	return decoder_plugins_try_cached(cached, check,
+					  [&tfs](const DecoderPlugin &plugin){
+						  return tfs.Scan(plugin);
+					  });
 }
@@ -22,13 +22,18 @@
 
 #include "check.h"
 #include "ClientMessage.hxx"
+#include "ResponseProducer.hxx"
 #include "command/CommandListBuilder.hxx"
 #include "event/FullyBufferedSocket.hxx"
 #include "event/TimeoutMonitor.hxx"
+#include "event/DeferredMonitor.hxx"
 #include "Compiler.h"
 
 #include <boost/intrusive/list.hpp>
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <set>
 #include <string>
 #include <list>
@@ -42,9 +47,10 @@ class Path;
 struct Partition;
 class Database;
 class Storage;
+class Response;
 
 class Client final
-	: FullyBufferedSocket, TimeoutMonitor,
+	: FullyBufferedSocket, TimeoutMonitor, DeferredMonitor,
 	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
 public:
 	Partition &partition;
@@ -70,6 +76,12 @@ public:
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/**
+	 * Idle flags submitted by another thread, to be passed to
+	 * IdleAdd() in this client's thread.
+	 */
+	std::atomic<unsigned> pending_idle_flags;
+
 	/**
 	 * A list of channel names this client is subscribed to.
 	 */
@@ -86,6 +98,42 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+private:
+	/**
+	 * Is a command being executed in the main thread on behalf of
+	 * this client?  See CallMain().
+	 */
+	bool in_main_call;
+
+	/**
+	 * Has #main_call_output exceeded the configured limit?
+	 */
+	bool main_call_output_full;
+
+	/**
+	 * Response data written while #in_main_call is set.
+	 */
+	std::string main_call_output;
+
+	/**
+	 * Generates the rest of the current response.  While this is
+	 * set, no input is processed.  See StartProducer().
+	 */
+	std::unique_ptr<ResponseProducer> producer;
+
+	/**
+	 * The name of the command which created #producer.  Used to
+	 * generate error messages.
+	 */
+	const char *producer_command;
+
+	/**
+	 * Was #producer created in the main thread?  Then it must be
+	 * invoked with CallMain().
+	 */
+	bool producer_in_main;
+
+public:
 	Client(EventLoop &loop, Partition &partition,
 	       int fd, int uid, int num);
 
@@ -103,6 +151,8 @@ public:
 		return !FullyBufferedSocket::IsDefined();
 	}
 
+	using TimeoutMonitor::GetEventLoop;
+
 	void Close();
 	void SetExpired();
 
@@ -184,7 +234,47 @@ public:
 	gcc_pure
 	const Storage *GetStorage() const;
 
+	/**
+	 * Invoke a function in the main thread, while this client's
+	 * #ClientThread is blocked.  Response data written by the
+	 * function is collected and submitted afterwards.  Only
+	 * available if #ClientThreads are configured.
+	 *
+	 * @return false if the main loop has quit and the function
+	 * was not invoked
+	 */
+	bool CallMain(const std::function<void()> &f);
+
+	/**
+	 * Is the current thread executing a CallMain() function on
+	 * behalf of this client?
+	 */
+	bool IsInMainCall() const {
+		return in_main_call;
+	}
+
+	/**
+	 * Let the given #ResponseProducer generate the response of
+	 * the current command.  Inside a command list, the whole
+	 * response is generated right away; otherwise, the method
+	 * returns CommandResult::BACKGROUND, and the producer is
+	 * invoked each time the output buffer has been drained.
+	 *
+	 * @param producer a newly allocated object; this method
+	 * takes ownership
+	 */
+	CommandResult StartProducer(ResponseProducer *producer, Response &r);
+
 private:
+	/**
+	 * Invoke #producer until it has written something.  When it
+	 * has finished, it is freed, and the "OK" is written.
+	 */
+	CommandResult ProduceResponse();
+
+	/* virtual methods from class FullyBufferedSocket */
+	virtual bool OnSocketDrained() override;
+
 	/* virtual methods from class BufferedSocket */
 	virtual InputResult OnSocketInput(void *data, size_t length) override;
 	virtual void OnSocketError(Error &&error) override;
@@ -192,11 +282,19 @@ private:
 
 	/* virtual methods from class TimeoutMonitor */
 	virtual void OnTimeout() override;
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
 };
 
 void
 client_manager_init();
 
+/**
+ * Accept a new client connection.  If #ClientThreads are
+ * configured, it is handed over to one of them; otherwise, the
+ * #Client runs in the given #EventLoop.
+ */
 void
 client_new(EventLoop &loop, Partition &partition,
 	   int fd, SocketAddress address, int uid);
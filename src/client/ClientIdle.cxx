@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "Idle.hxx"
+#include "event/Loop.hxx"
 
 #include <assert.h>
 
@@ -48,6 +49,14 @@ Client::IdleNotify()
 void
 Client::IdleAdd(unsigned flags)
 {
+	if (!GetEventLoop().IsInside()) {
+		/* called by the main thread, but this client runs
+		   in a #ClientThread */
+		pending_idle_flags.fetch_or(flags);
+		DeferredMonitor::Schedule();
+		return;
+	}
+
 	if (IsExpired())
 		return;
 
@@ -56,6 +65,14 @@ Client::IdleAdd(unsigned flags)
 		IdleNotify();
 }
 
+void
+Client::RunDeferred()
+{
+	const unsigned flags = pending_idle_flags.exchange(0);
+	if (flags != 0)
+		IdleAdd(flags);
+}
+
 bool
 Client::IdleWait(unsigned flags)
 {
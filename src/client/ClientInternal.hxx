@@ -33,6 +33,14 @@ extern int client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * Create a #Client for an accepted connection in the calling
+ * thread's #EventLoop.
+ */
+void
+client_create(EventLoop &loop, Partition &partition,
+	      int fd, int uid, unsigned num, const char *remote);
+
 CommandResult
 client_process_line(Client &client, char *line);
 
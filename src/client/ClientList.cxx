@@ -24,9 +24,23 @@
 
 #include <assert.h>
 
+bool
+ClientList::Add(Client &client)
+{
+	const ScopeLock protect(mutex);
+
+	if (list.size() >= max_size)
+		return false;
+
+	list.push_front(client);
+	return true;
+}
+
 void
 ClientList::Remove(Client &client)
 {
+	const ScopeLock protect(mutex);
+
 	assert(!list.empty());
 
 	list.erase(list.iterator_to(client));
@@ -35,14 +49,31 @@ ClientList::Remove(Client &client)
 void
 ClientList::CloseAll()
 {
+	const ScopeLock protect(mutex);
+
 	list.clear_and_dispose(DeleteDisposer());
 }
 
+void
+ClientList::CloseAll(EventLoop &loop)
+{
+	const ScopeLock protect(mutex);
+
+	for (auto i = list.begin(); i != list.end();) {
+		if (&i->GetEventLoop() == &loop)
+			i = list.erase_and_dispose(i, DeleteDisposer());
+		else
+			++i;
+	}
+}
+
 void
 ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
+	const ScopeLock protect(mutex);
+
 	for (auto &client : list)
 		client.IdleAdd(flags);
 }
@@ -21,15 +21,24 @@
 #define MPD_CLIENT_LIST_HXX
 
 #include "Client.hxx"
+#include "thread/Mutex.hxx"
 
 class Client;
 
+/**
+ * The list of all connected clients.  All methods are thread-safe,
+ * except for iteration, which requires the caller to lock the
+ * mutex returned by GetMutex(): with #ClientThreads, clients are
+ * added and removed by their own threads.
+ */
 class ClientList {
 	typedef boost::intrusive::list<Client,
 				       boost::intrusive::constant_time_size<true>> List;
 
 	const unsigned max_size;
 
+	mutable Mutex mutex;
+
 	List list;
 
 public:
@@ -39,6 +48,10 @@ public:
 		CloseAll();
 	}
 
+	Mutex &GetMutex() const {
+		return mutex;
+	}
+
 	List::iterator begin() {
 		return list.begin();
 	}
@@ -47,18 +60,21 @@ public:
 		return list.end();
 	}
 
-	bool IsFull() const {
-		return list.size() >= max_size;
-	}
-
-	void Add(Client &client) {
-		list.push_front(client);
-	}
+	/**
+	 * @return false if the list is full
+	 */
+	bool Add(Client &client);
 
 	void Remove(Client &client);
 
 	void CloseAll();
 
+	/**
+	 * Close all clients which run in the given #EventLoop.  Must
+	 * be called from that loop's thread.
+	 */
+	void CloseAll(EventLoop &loop);
+
 	void IdleAdd(unsigned flags);
 };
 
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "ClientList.hxx"
+#include "ClientThreads.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "system/fd_util.h"
@@ -45,14 +46,16 @@ static const char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
 Client::Client(EventLoop &_loop, Partition &_partition,
 	       int _fd, int _uid, int _num)
 	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size),
-	 TimeoutMonitor(_loop),
+	 TimeoutMonitor(_loop), DeferredMonitor(_loop),
 	 partition(_partition),
 	 playlist(partition.playlist), player_control(partition.pc),
 	 permission(getDefaultPermissions()),
 	 uid(_uid),
 	 num(_num),
 	 idle_waiting(false), idle_flags(0),
-	 num_subscriptions(0)
+	 pending_idle_flags(0),
+	 num_subscriptions(0),
+	 in_main_call(false), main_call_output_full(false)
 {
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
 }
@@ -62,7 +65,7 @@ client_new(EventLoop &loop, Partition &partition,
 	   int fd, SocketAddress address, int uid)
 {
 	static unsigned int next_client_num;
-	const auto remote = ToString(address);
+	auto remote = ToString(address);
 
 	assert(fd >= 0);
 
@@ -88,22 +91,32 @@ client_new(EventLoop &loop, Partition &partition,
 	}
 #endif	/* HAVE_WRAP */
 
+	const unsigned num = next_client_num++;
+
+	ClientThreads *threads = partition.instance.client_threads;
+	if (threads != nullptr)
+		threads->Add(partition, fd, uid, num, std::move(remote));
+	else
+		client_create(loop, partition, fd, uid, num, remote.c_str());
+}
+
+void
+client_create(EventLoop &loop, Partition &partition,
+	      int fd, int uid, unsigned num, const char *remote)
+{
+	Client *client = new Client(loop, partition, fd, uid, num);
+
 	ClientList &client_list = *partition.instance.client_list;
-	if (client_list.IsFull()) {
+	if (!client_list.Add(*client)) {
 		LogWarning(client_domain, "Max connections reached");
-		close_socket(fd);
+		delete client;
 		return;
 	}
 
-	Client *client = new Client(loop, partition, fd, uid,
-				    next_client_num++);
-
 	(void)send(fd, GREETING, sizeof(GREETING) - 1, 0);
 
-	client_list.Add(*client);
-
 	FormatInfo(client_domain, "[%u] opened from %s",
-		   client->num, remote.c_str());
+		   num, remote);
 }
 
 void
@@ -24,19 +24,25 @@
 #include "Log.hxx"
 #include "util/StringAPI.hxx"
 
+#include <algorithm>
+
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
 #define CLIENT_LIST_MODE_END "command_list_end"
 
+/**
+ * Execute the command list entries in the range [begin, end) one by
+ * one, stopping at the first failure.
+ */
 static CommandResult
-client_process_command_list(Client &client, bool list_ok,
-			    std::list<std::string> &&list)
+client_process_commands(Client &client, bool list_ok, unsigned &num,
+			std::list<std::string>::iterator begin,
+			std::list<std::string>::iterator end)
 {
 	CommandResult ret = CommandResult::OK;
-	unsigned num = 0;
 
-	for (auto &&i : list) {
-		char *cmd = &*i.begin();
+	for (auto i = begin; i != end; ++i) {
+		char *cmd = &*i->begin();
 
 		FormatDebug(client_domain, "process command \"%s\"", cmd);
 		ret = command_process(client, num++, cmd);
@@ -50,6 +56,49 @@ client_process_command_list(Client &client, bool list_ok,
 	return ret;
 }
 
+static CommandResult
+client_process_command_list(Client &client, bool list_ok,
+			    std::list<std::string> &&list)
+{
+	CommandResult ret = CommandResult::OK;
+	unsigned num = 0;
+
+	for (auto i = list.begin(), end = list.end(); i != end;) {
+		/* a run of commands which append to the queue is
+		   executed as one batch, see command_batch() */
+		const auto batch_end =
+			std::find_if_not(i, end, [](const std::string &s){
+					return command_is_batchable(s.c_str());
+				});
+
+		if (batch_end == i || std::next(i) == batch_end) {
+			const auto next = std::next(i);
+			ret = client_process_commands(client, list_ok, num,
+						      i, next);
+			i = next;
+		} else {
+			FormatDebug(client_domain,
+				    "[%u] process command batch", client.num);
+
+			if (!command_batch(client, [&](){
+						ret = client_process_commands(client,
+									      list_ok,
+									      num,
+									      i,
+									      batch_end);
+					}))
+				return CommandResult::CLOSE;
+
+			i = batch_end;
+		}
+
+		if (ret != CommandResult::OK || client.IsExpired())
+			break;
+	}
+
+	return ret;
+}
+
 CommandResult
 client_process_line(Client &client, char *line)
 {
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientInternal.hxx"
+#include "Response.hxx"
+#include "protocol/Result.hxx"
+
+#include <assert.h>
+
+CommandResult
+Client::StartProducer(ResponseProducer *_producer, Response &r)
+{
+	assert(producer == nullptr);
+
+	std::unique_ptr<ResponseProducer> p(_producer);
+
+	if (cmd_list.IsActive()) {
+		/* the commands of a list are executed in one go, and
+		   the following ones must not be postponed; generate
+		   the whole response now */
+		CommandResult result;
+		do {
+			result = p->Produce(r);
+		} while (result == CommandResult::BACKGROUND && !IsExpired());
+
+		return result == CommandResult::BACKGROUND
+			? CommandResult::CLOSE
+			: result;
+	}
+
+	producer = std::move(p);
+	producer_command = r.GetCommand();
+	producer_in_main = in_main_call;
+	return CommandResult::BACKGROUND;
+}
+
+CommandResult
+Client::ProduceResponse()
+{
+	assert(producer != nullptr);
+
+	const auto step = [this](){
+		Response r(*this, 0);
+		r.SetCommand(producer_command);
+		return producer->Produce(r);
+	};
+
+	CommandResult result;
+	do {
+		if (producer_in_main) {
+			result = CommandResult::CLOSE;
+			CallMain([&result, &step](){
+					result = step();
+				});
+		} else
+			result = step();
+	} while (result == CommandResult::BACKGROUND &&
+		 IsOutputEmpty() && !IsExpired());
+
+	if (result != CommandResult::BACKGROUND) {
+		producer.reset();
+
+		if (result == CommandResult::OK)
+			command_success(*this);
+	}
+
+	return result;
+}
+
+bool
+Client::OnSocketDrained()
+{
+	if (producer == nullptr)
+		return true;
+
+	/* the client is still receiving our response; don't let it
+	   time out */
+	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	const CommandResult result = ProduceResponse();
+	if (result == CommandResult::CLOSE || IsExpired()) {
+		SetExpired();
+		return false;
+	}
+
+	if (result == CommandResult::BACKGROUND)
+		return true;
+
+	/* the response is complete; continue with the commands the
+	   client has sent meanwhile */
+	return ResumeInput();
+}
@@ -29,6 +29,10 @@
 BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length)
 {
+	if (producer != nullptr)
+		/* still busy with the previous response */
+		return InputResult::PAUSE;
+
 	char *p = (char *)data;
 	char *newline = (char *)memchr(p, '\n', length);
 	if (newline == nullptr)
@@ -45,10 +49,14 @@ Client::OnSocketInput(void *data, size_t length)
 	*end = 0;
 
 	CommandResult result = client_process_line(*this, p);
+	if (result == CommandResult::BACKGROUND)
+		result = ProduceResponse();
+
 	switch (result) {
 	case CommandResult::OK:
 	case CommandResult::IDLE:
 	case CommandResult::ERROR:
+	case CommandResult::BACKGROUND:
 		break;
 
 	case CommandResult::KILL:
@@ -71,5 +79,9 @@ Client::OnSocketInput(void *data, size_t length)
 		return InputResult::CLOSED;
 	}
 
+	if (result == CommandResult::BACKGROUND)
+		/* OnSocketDrained() will resume */
+		return InputResult::PAUSE;
+
 	return InputResult::AGAIN;
 }
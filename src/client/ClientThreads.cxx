@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ClientThreads.hxx"
+#include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "event/Call.hxx"
+#include "thread/Name.hxx"
+#include "thread/Slack.hxx"
+#include "system/FatalError.hxx"
+#include "system/fd_util.h"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+ClientThread::PendingQueue::~PendingQueue()
+{
+	/* connections which were never picked up */
+	for (const auto &c : list)
+		close_socket(c.fd);
+}
+
+void
+ClientThread::PendingQueue::Push(Partition &partition, int fd, int uid,
+				 unsigned num, std::string &&remote)
+{
+	mutex.lock();
+	list.emplace_back(partition, fd, uid, num, std::move(remote));
+	mutex.unlock();
+
+	DeferredMonitor::Schedule();
+}
+
+void
+ClientThread::PendingQueue::RunDeferred()
+{
+	std::list<PendingClient> tmp;
+
+	mutex.lock();
+	tmp.swap(list);
+	mutex.unlock();
+
+	for (auto &c : tmp)
+		client_create(GetEventLoop(), c.partition, c.fd, c.uid,
+			      c.num, c.remote.c_str());
+}
+
+void
+ClientThread::Run(void *ctx)
+{
+	ClientThread &thread = *(ClientThread *)ctx;
+
+	SetThreadName("client");
+	SetThreadTimerSlackMS(100);
+
+	thread.loop.Run();
+}
+
+void
+ClientThread::Start()
+{
+	Error error;
+	if (!thread.Start(Run, this, error))
+		FatalError(error);
+}
+
+void
+ClientThread::Stop(ClientList &client_list)
+{
+	/* the clients must be destroyed in the thread which owns
+	   their sockets and timers */
+	BlockingCall(loop, [this, &client_list](){
+			client_list.CloseAll(loop);
+		});
+
+	loop.Break();
+	thread.Join();
+}
+
+ClientThreads::ClientThreads(EventLoop &_main_loop, unsigned _n_threads)
+	:main_loop(_main_loop), n_threads(_n_threads),
+	 threads(new ClientThread[_n_threads]), next_thread(0),
+	 main_quit(false)
+{
+	assert(n_threads > 0);
+}
+
+void
+ClientThreads::Start()
+{
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Start();
+}
+
+void
+ClientThreads::Stop(ClientList &client_list)
+{
+	/* wake up all threads waiting in CallMain() */
+	mutex.lock();
+	main_quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Stop(client_list);
+}
+
+void
+ClientThreads::Add(Partition &partition, int fd, int uid, unsigned num,
+		   std::string &&remote)
+{
+	assert(main_loop.IsInside());
+
+	threads[next_thread].Add(partition, fd, uid, num, std::move(remote));
+	next_thread = (next_thread + 1) % n_threads;
+}
+
+class ClientThreads::MainCall final : DeferredMonitor {
+	ClientThreads &threads;
+
+	const std::function<void()> &f;
+
+public:
+	/**
+	 * Protected with ClientThreads::mutex.
+	 */
+	bool done;
+
+	MainCall(ClientThreads &_threads, const std::function<void()> &_f)
+		:DeferredMonitor(_threads.main_loop),
+		 threads(_threads), f(_f), done(false) {}
+
+	void Schedule() {
+		DeferredMonitor::Schedule();
+	}
+
+private:
+	virtual void RunDeferred() override {
+		f();
+
+		const ScopeLock protect(threads.mutex);
+		done = true;
+		threads.cond.broadcast();
+	}
+};
+
+bool
+ClientThreads::CallMain(const std::function<void()> &f)
+{
+	MainCall call(*this, f);
+	call.Schedule();
+
+	const ScopeLock protect(mutex);
+	while (!call.done && !main_quit)
+		cond.wait(mutex);
+
+	/* if the main loop has quit, it will never run the call;
+	   the MainCall destructor unregisters it */
+	return call.done;
+}
+
+bool
+Client::CallMain(const std::function<void()> &f)
+{
+	ClientThreads &threads = *partition.instance.client_threads;
+
+	assert(!in_main_call);
+	in_main_call = true;
+
+	const bool success = threads.CallMain(f);
+
+	in_main_call = false;
+
+	if (main_call_output_full) {
+		main_call_output_full = false;
+		main_call_output.clear();
+
+		FormatWarning(client_domain,
+			      "[%u] output buffer is full", num);
+		SetExpired();
+	} else if (!main_call_output.empty()) {
+		Write(main_call_output.data(), main_call_output.size());
+		main_call_output.clear();
+	}
+
+	/* don't keep large responses allocated */
+	if (main_call_output.capacity() > 65536)
+		std::string().swap(main_call_output);
+
+	return success;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CLIENT_THREADS_HXX
+#define MPD_CLIENT_THREADS_HXX
+
+#include "check.h"
+#include "event/Loop.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+
+struct Partition;
+class ClientList;
+
+/**
+ * A thread with its own #EventLoop which performs socket I/O,
+ * command parsing and response formatting for a subset of the
+ * #Client connections.
+ */
+class ClientThread final {
+	struct PendingClient {
+		Partition &partition;
+		int fd, uid;
+		unsigned num;
+		std::string remote;
+
+		PendingClient(Partition &_partition, int _fd, int _uid,
+			      unsigned _num, std::string &&_remote)
+			:partition(_partition), fd(_fd), uid(_uid),
+			 num(_num), remote(std::move(_remote)) {}
+	};
+
+	/**
+	 * Hands new connections over from the main thread to this
+	 * thread.
+	 */
+	class PendingQueue final : DeferredMonitor {
+		Mutex mutex;
+		std::list<PendingClient> list;
+
+	public:
+		explicit PendingQueue(EventLoop &_loop)
+			:DeferredMonitor(_loop) {}
+
+		~PendingQueue();
+
+		void Push(Partition &partition, int fd, int uid,
+			  unsigned num, std::string &&remote);
+
+	private:
+		virtual void RunDeferred() override;
+	};
+
+	EventLoop loop;
+
+	PendingQueue pending;
+
+	Thread thread;
+
+public:
+	ClientThread():pending(loop) {}
+
+	void Start();
+
+	/**
+	 * Close all clients served by this thread, and stop it.
+	 */
+	void Stop(ClientList &client_list);
+
+	/**
+	 * Create a new #Client for the given connection in this
+	 * thread.  This method is thread-safe and does not block.
+	 */
+	void Add(Partition &partition, int fd, int uid, unsigned num,
+		 std::string &&remote) {
+		pending.Push(partition, fd, uid, num, std::move(remote));
+	}
+
+private:
+	static void Run(void *ctx);
+};
+
+/**
+ * A pool of #ClientThread instances, configured with the setting
+ * "client_threads".  New connections are accepted by the main
+ * thread and then assigned to the threads round-robin.
+ *
+ * Commands which may modify or inspect state owned by the main
+ * thread (the #Partition, the player, the outputs, other clients)
+ * are marshalled to the main thread with CallMain().
+ */
+class ClientThreads final {
+	EventLoop &main_loop;
+
+	const unsigned n_threads;
+
+	std::unique_ptr<ClientThread[]> threads;
+
+	/**
+	 * The index of the thread which gets the next connection.
+	 * Only accessed by the main thread.
+	 */
+	unsigned next_thread;
+
+	/**
+	 * Protects #main_quit and the "done" flags of pending
+	 * CallMain() invocations.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled when a CallMain() invocation has finished or
+	 * when the main loop has quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Set by Stop(): the main loop does not run anymore, and
+	 * CallMain() fails.
+	 */
+	bool main_quit;
+
+	class MainCall;
+
+public:
+	/**
+	 * @param n_threads the number of threads; must be positive
+	 */
+	ClientThreads(EventLoop &_main_loop, unsigned _n_threads);
+
+	ClientThreads(const ClientThreads &) = delete;
+	ClientThreads &operator=(const ClientThreads &) = delete;
+
+	void Start();
+
+	/**
+	 * Close all clients and stop all threads.  To be called by
+	 * the main thread after its #EventLoop has quit.
+	 */
+	void Stop(ClientList &client_list);
+
+	/**
+	 * Assign a new connection to the next thread.  Must be
+	 * called by the main thread.
+	 */
+	void Add(Partition &partition, int fd, int uid, unsigned num,
+		 std::string &&remote);
+
+	/**
+	 * Invoke a function in the main thread, and block the calling
+	 * thread until it has returned.  Must not be called by the
+	 * main thread.
+	 *
+	 * @return false if the main loop has quit and the function
+	 * was not invoked
+	 */
+	bool CallMain(const std::function<void()> &f);
+};
+
+#endif
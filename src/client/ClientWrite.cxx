@@ -18,7 +18,7 @@
  */
 
 #include "config.h"
-#include "Client.hxx"
+#include "ClientInternal.hxx"
 #include "util/FormatString.hxx"
 
 #include <string.h>
@@ -27,7 +27,25 @@ bool
 Client::Write(const void *data, size_t length)
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	if (IsExpired())
+		return false;
+
+	if (in_main_call) {
+		/* this is the main thread running a command on
+		   behalf of the (blocked) #ClientThread, which must
+		   not touch the socket's EventLoop; CallMain() will
+		   submit the data */
+		if (main_call_output_full ||
+		    main_call_output.size() + length > client_max_output_buffer_size) {
+			main_call_output_full = true;
+			return false;
+		}
+
+		main_call_output.append((const char *)data, length);
+		return true;
+	}
+
+	return FullyBufferedSocket::Write(data, length);
 }
 
 void
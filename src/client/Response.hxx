@@ -53,6 +53,10 @@ public:
 		command = _command;
 	}
 
+	const char *GetCommand() const {
+		return command;
+	}
+
 	bool Write(const void *data, size_t length);
 	bool Write(const char *data);
 	bool FormatV(const char *fmt, va_list args);
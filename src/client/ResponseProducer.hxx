@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RESPONSE_PRODUCER_HXX
+#define MPD_RESPONSE_PRODUCER_HXX
+
+#include "check.h"
+#include "command/CommandResult.hxx"
+
+class Response;
+
+/**
+ * Generates a long response in portions: the next portion is
+ * written only after the client's output buffer has been drained.
+ * This keeps the memory used by one client bounded, no matter how
+ * large the response is, and lets the #EventLoop serve other
+ * clients in between.  See Client::StartProducer().
+ *
+ * Since the object may live longer than the command which created
+ * it, it must make copies of all command arguments it needs.
+ */
+class ResponseProducer {
+public:
+	virtual ~ResponseProducer() {}
+
+	/**
+	 * Write the next portion of the response.
+	 *
+	 * @return CommandResult::BACKGROUND if there is more to be
+	 * written, CommandResult::OK if the response is complete (the
+	 * "OK" line is written by the caller) or
+	 * CommandResult::ERROR after an "ACK" has been written
+	 */
+	virtual CommandResult Produce(Response &r) = 0;
+};
+
+#endif
@@ -34,6 +34,8 @@
 #include "Permission.hxx"
 #include "tag/TagType.h"
 #include "Partition.hxx"
+#include "Instance.hxx"
+#include "BulkEdit.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
 #include "util/Macros.hxx"
@@ -47,6 +49,11 @@
 #include "sticker/StickerDatabase.hxx"
 #endif
 
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#endif
+
 #include <assert.h>
 #include <string.h>
 
@@ -339,6 +346,94 @@ command_check_request(const struct command *cmd, Response &r,
 		return true;
 }
 
+/**
+ * May this command be executed in a #ClientThread?  This is only
+ * allowed for commands which do not touch state owned by the main
+ * thread: read-only database queries (if the database plugin
+ * supports concurrent access) and commands which affect only the
+ * client itself.
+ */
+gcc_pure
+static bool
+command_is_thread_safe(const Partition &partition,
+		       const struct command &cmd)
+{
+	if (cmd.handler == handle_ping || cmd.handler == handle_idle)
+		return true;
+
+#ifdef ENABLE_DATABASE
+	if (cmd.handler == handle_count || cmd.handler == handle_find ||
+	    cmd.handler == handle_list || cmd.handler == handle_listall ||
+	    cmd.handler == handle_listallinfo ||
+	    cmd.handler == handle_lsinfo || cmd.handler == handle_search) {
+		const Database *db = partition.instance.database;
+		return db == nullptr || db->GetPlugin().IsThreadSafe();
+	}
+#else
+	(void)partition;
+#endif
+
+	return false;
+}
+
+static CommandResult
+command_invoke(Client &client, const struct command &cmd,
+	       Request args, Response &r)
+{
+	if (client.partition.instance.client_threads == nullptr ||
+	    client.IsInMainCall() ||
+	    command_is_thread_safe(client.partition, cmd))
+		return cmd.handler(client, args, r);
+
+	/* this client runs in a #ClientThread: marshal the command
+	   to the main thread */
+	CommandResult result = CommandResult::CLOSE;
+	client.CallMain([&client, &cmd, args, &r, &result](){
+			result = cmd.handler(client, args, r);
+		});
+	return result;
+}
+
+bool
+command_is_batchable(const char *line)
+{
+	/* extract the command name (the first word) */
+	char name[32];
+	const size_t length = strcspn(line, " \t");
+	if (length == 0 || length >= sizeof(name))
+		return false;
+
+	memcpy(name, line, length);
+	name[length] = 0;
+
+	const struct command *cmd = command_lookup(name);
+	return cmd != nullptr &&
+		(cmd->handler == handle_add || cmd->handler == handle_addid ||
+#ifdef ENABLE_DATABASE
+		 cmd->handler == handle_findadd ||
+		 cmd->handler == handle_searchadd ||
+#endif
+		 cmd->handler == handle_load);
+}
+
+bool
+command_batch(Client &client, const std::function<void()> &f)
+{
+	auto &partition = client.partition;
+
+	const auto g = [&partition, &f](){
+		const ScopeBulkEdit bulk_edit(partition);
+		f();
+	};
+
+	if (partition.instance.client_threads == nullptr) {
+		g();
+		return true;
+	}
+
+	return client.CallMain(g);
+}
+
 static const struct command *
 command_checked_lookup(Response &r, unsigned permission,
 		       const char *cmd_name, Request args)
@@ -412,7 +507,7 @@ command_process(Client &client, unsigned num, char *line)
 				       cmd_name, args);
 
 	CommandResult ret = cmd
-		? cmd->handler(client, args, r)
+		? command_invoke(client, *cmd, args, r)
 		: CommandResult::ERROR;
 
 	return ret;
@@ -21,6 +21,9 @@
 #define MPD_ALL_COMMANDS_HXX
 
 #include "CommandResult.hxx"
+#include "Compiler.h"
+
+#include <functional>
 
 class Client;
 
@@ -33,4 +36,26 @@ command_finish();
 CommandResult
 command_process(Client &client, unsigned num, char *line);
 
+/**
+ * Does the given (unparsed) command line only append to the queue,
+ * i.e. may it be executed in a batch with command_batch()?
+ */
+gcc_pure
+bool
+command_is_batchable(const char *line);
+
+/**
+ * Invoke a function which executes a run of batchable command list
+ * entries with command_process().  The commands are executed in the
+ * main thread (with one Client::CallMain() call if the client runs in
+ * a #ClientThread) inside one "bulk edit" of the queue, which means
+ * that the queue version is bumped and the idle event is emitted only
+ * once for the whole batch.
+ *
+ * @return false if the main loop has quit and the function was not
+ * invoked
+ */
+bool
+command_batch(Client &client, const std::function<void()> &f);
+
 #endif
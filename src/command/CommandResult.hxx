@@ -41,6 +41,13 @@ enum class CommandResult {
 	 */
 	IDLE,
 
+	/**
+	 * The response is being generated by a #ResponseProducer,
+	 * and the "OK" will be sent when it has finished.  Input from
+	 * the client is not processed until then.
+	 */
+	BACKGROUND,
+
 	/**
 	 * There was an error.  The "ACK" response was sent to the
 	 * client.
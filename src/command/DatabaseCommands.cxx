@@ -26,9 +26,12 @@
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/Interface.hxx"
+#include "db/Cursor.hxx"
 #include "CommandError.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseProducer.hxx"
 #include "tag/Tag.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
@@ -36,8 +39,97 @@
 #include "SongFilter.hxx"
 #include "BulkEdit.hxx"
 
+#include <memory>
+
 #include <string.h>
 
+/**
+ * Prints a (possibly huge) database selection in portions with a
+ * #DatabaseCursor.
+ */
+class DatabasePrintProducer final : public ResponseProducer {
+	/**
+	 * The number of objects visited by each Produce() call.
+	 */
+	static constexpr unsigned PART_SIZE = 1024;
+
+	Partition &partition;
+
+	const std::unique_ptr<SongFilter> filter;
+
+	const DatabaseSelection selection;
+
+	const std::unique_ptr<DatabaseCursor> cursor;
+
+	const bool full;
+
+	/**
+	 * The number of songs visited so far, for the window.
+	 */
+	unsigned position;
+
+	const unsigned window_start, window_end;
+
+public:
+	DatabasePrintProducer(Partition &_partition,
+			      std::unique_ptr<SongFilter> &&_filter,
+			      const DatabaseSelection &_selection,
+			      DatabaseCursor *_cursor, bool _full,
+			      unsigned _window_start, unsigned _window_end)
+		:partition(_partition), filter(std::move(_filter)),
+		 selection(_selection), cursor(_cursor),
+		 full(_full), position(0),
+		 window_start(_window_start), window_end(_window_end) {}
+
+	/* virtual methods from class ResponseProducer */
+	CommandResult Produce(Response &r) override {
+		bool more;
+		Error error;
+		if (!db_cursor_print(r, partition, *cursor, selection,
+				     full, false,
+				     position, window_start, window_end,
+				     PART_SIZE, more, error))
+			return print_error(r, error);
+
+		return more && position < window_end
+			? CommandResult::BACKGROUND
+			: CommandResult::OK;
+	}
+};
+
+/**
+ * Print a recursive database selection, in portions if the database
+ * supports Database::OpenCursor().
+ */
+static CommandResult
+PrintSelection(Client &client, Response &r,
+	       const char *uri, std::unique_ptr<SongFilter> &&filter,
+	       bool full, unsigned window_start, unsigned window_end)
+{
+	Error error;
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return print_error(r, error);
+
+	const DatabaseSelection selection(uri, true, filter.get());
+
+	DatabaseCursor *cursor = db->OpenCursor(selection);
+	if (cursor != nullptr) {
+		auto *producer =
+			new DatabasePrintProducer(client.partition,
+						  std::move(filter),
+						  selection, cursor, full,
+						  window_start, window_end);
+		return client.StartProducer(producer, r);
+	}
+
+	return db_selection_print(r, client.partition,
+				  selection, full, false,
+				  window_start, window_end, error)
+		? CommandResult::OK
+		: print_error(r, error);
+}
+
 CommandResult
 handle_listfiles_db(Client &client, Response &r, const char *uri)
 {
@@ -77,20 +169,14 @@ handle_match(Client &client, Request args, Response &r, bool fold_case)
 	} else
 		window.SetAll();
 
-	SongFilter filter;
-	if (!filter.Parse(args, fold_case)) {
+	std::unique_ptr<SongFilter> filter(new SongFilter());
+	if (!filter->Parse(args, fold_case)) {
 		r.Error(ACK_ERROR_ARG, "incorrect arguments");
 		return CommandResult::ERROR;
 	}
 
-	const DatabaseSelection selection("", true, &filter);
-
-	Error error;
-	return db_selection_print(r, client.partition,
-				  selection, true, false,
-				  window.start, window.end, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	return PrintSelection(client, r, "", std::move(filter), true,
+			      window.start, window.end);
 }
 
 CommandResult
@@ -192,12 +278,9 @@ handle_listall(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	Error error;
-	return db_selection_print(r, client.partition,
-				  DatabaseSelection(uri, true),
-				  false, false, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	const RangeArg all = RangeArg::All();
+	return PrintSelection(client, r, uri, nullptr, false,
+			      all.start, all.end);
 }
 
 CommandResult
@@ -278,10 +361,7 @@ handle_listallinfo(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	Error error;
-	return db_selection_print(r, client.partition,
-				  DatabaseSelection(uri, true),
-				  true, false, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	const RangeArg all = RangeArg::All();
+	return PrintSelection(client, r, uri, nullptr, true,
+			      all.start, all.end);
 }
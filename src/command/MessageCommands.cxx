@@ -79,10 +79,16 @@ handle_channels(Client &client, gcc_unused Request args, Response &r)
 {
 	assert(args.IsEmpty());
 
+	ClientList &client_list = *client.partition.instance.client_list;
+
 	std::set<std::string> channels;
-	for (const auto &c : *client.partition.instance.client_list)
-		channels.insert(c.subscriptions.begin(),
-				c.subscriptions.end());
+
+	{
+		const ScopeLock protect(client_list.GetMutex());
+		for (const auto &c : client_list)
+			channels.insert(c.subscriptions.begin(),
+					c.subscriptions.end());
+	}
 
 	for (const auto &channel : channels)
 		r.Format("channel: %s\n", channel.c_str());
@@ -120,11 +126,17 @@ handle_send_message(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
+	ClientList &client_list = *client.partition.instance.client_list;
+
 	bool sent = false;
 	const ClientMessage msg(channel_name, message_text);
-	for (auto &c : *client.partition.instance.client_list)
-		if (c.PushMessage(msg))
-			sent = true;
+
+	{
+		const ScopeLock protect(client_list.GetMutex());
+		for (auto &c : client_list)
+			if (c.PushMessage(msg))
+				sent = true;
+	}
 
 	if (sent)
 		return CommandResult::OK;
@@ -25,6 +25,7 @@
 #include "PlaylistPrint.hxx"
 #include "PlaylistSave.hxx"
 #include "PlaylistFile.hxx"
+#include "PlaylistError.hxx"
 #include "db/PlaylistVector.hxx"
 #include "SongLoader.hxx"
 #include "BulkEdit.hxx"
@@ -87,34 +88,38 @@ handle_load(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_listplaylist(Client &client, Request args, Response &r)
+/**
+ * Print a playlist.  Stored playlists are tried first, because their
+ * parsed contents are cached; other playlists are read by the
+ * playlist plugins.
+ */
+static CommandResult
+print_playlist(Client &client, const char *name, bool detail, Response &r)
 {
-	const char *const name = args.front();
+	Error error;
+	if (spl_print(r, client.partition, name, detail, error))
+		return CommandResult::OK;
 
 	if (playlist_file_print(r, client.partition, SongLoader(client),
-				name, false))
+				name, detail))
 		return CommandResult::OK;
 
-	Error error;
-	return spl_print(r, client.partition, name, false, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	if (!error.IsDefined())
+		error.Set(playlist_domain, int(PlaylistResult::NO_SUCH_LIST),
+			  "No such playlist");
+	return print_error(r, error);
 }
 
 CommandResult
-handle_listplaylistinfo(Client &client, Request args, Response &r)
+handle_listplaylist(Client &client, Request args, Response &r)
 {
-	const char *const name = args.front();
-
-	if (playlist_file_print(r, client.partition, SongLoader(client),
-				name, true))
-		return CommandResult::OK;
+	return print_playlist(client, args.front(), false, r);
+}
 
-	Error error;
-	return spl_print(r, client.partition, name, true, error)
-		? CommandResult::OK
-		: print_error(r, error);
+CommandResult
+handle_listplaylistinfo(Client &client, Request args, Response &r)
+{
+	return print_playlist(client, args.front(), true, r);
 }
 
 CommandResult
@@ -144,12 +149,12 @@ CommandResult
 handle_playlistdelete(gcc_unused Client &client, Request args, Response &r)
 {
 	const char *const name = args[0];
-	unsigned from;
-	if (!args.Parse(1, from, r))
+	RangeArg range;
+	if (!args.Parse(1, range, r))
 		return CommandResult::ERROR;
 
 	Error error;
-	return spl_remove_index(name, from, error)
+	return spl_remove_range(name, range.start, range.end, error)
 		? CommandResult::OK
 		: print_error(r, error);
 }
@@ -158,12 +163,13 @@ CommandResult
 handle_playlistmove(gcc_unused Client &client, Request args, Response &r)
 {
 	const char *const name = args.front();
-	unsigned from, to;
-	if (!args.Parse(1, from, r) || !args.Parse(2, to, r))
+	RangeArg range;
+	unsigned to;
+	if (!args.Parse(1, range, r) || !args.Parse(2, to, r))
 		return CommandResult::ERROR;
 
 	Error error;
-	return spl_move_index(name, from, to, error)
+	return spl_move_range(name, range.start, range.end, to, error)
 		? CommandResult::OK
 		: print_error(r, error);
 }
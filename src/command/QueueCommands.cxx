@@ -29,8 +29,10 @@
 #include "LocateUri.hxx"
 #include "queue/Playlist.hxx"
 #include "PlaylistPrint.hxx"
+#include "queue/QueuePrint.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseProducer.hxx"
 #include "Partition.hxx"
 #include "BulkEdit.hxx"
 #include "util/ConstBuffer.hxx"
@@ -40,6 +42,7 @@
 #include "fs/AllocatedPath.hxx"
 
 #include <limits>
+#include <algorithm>
 
 #include <string.h>
 
@@ -277,6 +280,52 @@ handle_plchangesposid(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+/**
+ * Prints a large portion of the queue in several steps.  If the
+ * queue is modified meanwhile, the following steps see the new
+ * queue.
+ */
+class QueuePrintProducer final : public ResponseProducer {
+	Partition &partition;
+	const struct playlist &playlist;
+
+	unsigned position;
+
+	const unsigned end;
+
+public:
+	/**
+	 * The number of songs printed by each Produce() call.
+	 */
+	static constexpr unsigned PART_SIZE = 512;
+
+	QueuePrintProducer(Partition &_partition,
+			   const struct playlist &_playlist,
+			   unsigned start, unsigned _end)
+		:partition(_partition), playlist(_playlist),
+		 position(start), end(_end) {}
+
+	/* virtual methods from class ResponseProducer */
+	CommandResult Produce(Response &r) override {
+		const Queue &queue = playlist.queue;
+		const unsigned queue_end = std::min(end, queue.GetLength());
+		if (position >= queue_end)
+			/* the queue has been shortened meanwhile */
+			return CommandResult::OK;
+
+		const unsigned part_end = queue_end - position > PART_SIZE
+			? position + PART_SIZE
+			: queue_end;
+
+		queue_print_info(r, partition, queue, position, part_end);
+
+		position = part_end;
+		return position < queue_end
+			? CommandResult::BACKGROUND
+			: CommandResult::OK;
+	}
+};
+
 CommandResult
 handle_playlistinfo(Client &client, Request args, Response &r)
 {
@@ -284,6 +333,17 @@ handle_playlistinfo(Client &client, Request args, Response &r)
 	if (!args.ParseOptional(0, range, r))
 		return CommandResult::ERROR;
 
+	const unsigned length = client.playlist.queue.GetLength();
+	if (range.start < length &&
+	    std::min(range.end, length) - range.start >
+	    QueuePrintProducer::PART_SIZE) {
+		auto *producer = new QueuePrintProducer(client.partition,
+							client.playlist,
+							range.start,
+							range.end);
+		return client.StartProducer(producer, r);
+	}
+
 	if (!playlist_print_info(r, client.partition, client.playlist,
 				 range.start, range.end))
 		return print_playlist_result(r,
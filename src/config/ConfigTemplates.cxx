@@ -34,6 +34,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "pid_file" },
 	{ "state_file" },
 	{ "state_file_interval" },
+	{ "seek_index_file" },
 	{ "restore_paused" },
 	{ "user" },
 	{ "group" },
@@ -53,6 +54,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "audio_chunk_size" },
 	{ "buffer_before_play" },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -63,6 +65,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
+	{ "client_threads" },
 	{ "filesystem_charset" },
 	{ "id3v1_encoding", false, true },
 	{ "metadata_to_use" },
@@ -70,6 +73,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback" },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "update_threads" },
 	{ "despotify_user", false, true },
 	{ "despotify_password", false, true },
 	{ "despotify_high_bitrate", false, true },
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_CURSOR_HXX
+#define MPD_DATABASE_CURSOR_HXX
+
+#include "Visitor.hxx"
+
+class Error;
+
+/**
+ * Walks a #DatabaseSelection in portions, see
+ * Database::OpenCursor().  Between two portions, the database lock
+ * is released; the cursor remembers where to continue.
+ */
+class DatabaseCursor {
+public:
+	virtual ~DatabaseCursor() {}
+
+	/**
+	 * Visit the next portion of the selection, in the same order
+	 * as Database::Visit().
+	 *
+	 * @param limit stop after (roughly) this number of objects
+	 * @param more_r on success, this is set to true if there are
+	 * more objects after this portion
+	 */
+	virtual bool Visit(unsigned limit,
+			   VisitDirectory visit_directory,
+			   VisitSong visit_song,
+			   VisitPlaylist visit_playlist,
+			   bool &more_r, Error &error) = 0;
+};
+
+#endif
@@ -27,12 +27,18 @@
 #define MPD_DB_LOCK_HXX
 
 #include "check.h"
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 #include "Compiler.h"
 
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  Readers (e.g. client queries) obtain it
+ * in "shared" mode, which allows them to run concurrently; code which
+ * modifies the database (i.e. the update thread) needs "exclusive"
+ * mode.
+ */
+extern SharedMutex db_mutex;
 
 #ifndef NDEBUG
 
@@ -41,11 +47,28 @@ extern Mutex db_mutex;
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold a shared lock?
+ */
+extern thread_local bool db_mutex_shared_holder;
+
+/**
+ * Does the current thread hold the database lock (shared or
+ * exclusive)?  This is enough for reading.
  */
 gcc_pure
 static inline bool
 holding_db_lock(void)
+{
+	return db_mutex_holder.IsInside() || db_mutex_shared_holder;
+}
+
+/**
+ * Does the current thread hold the exclusive database lock?  This is
+ * required for modifying the database.
+ */
+gcc_pure
+static inline bool
+holding_db_exclusive_lock(void)
 {
 	return db_mutex_holder.IsInside();
 }
@@ -53,8 +76,8 @@ holding_db_lock(void)
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock in exclusive mode.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
@@ -70,12 +93,12 @@ db_lock(void)
 }
 
 /**
- * Release the global database lock.
+ * Release the exclusive database lock.
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::Null();
 #endif
@@ -83,6 +106,39 @@ db_unlock(void)
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain the global database lock in shared mode.  This is needed
+ * before dereferencing a #song or #directory.  Other threads may hold
+ * the shared lock at the same time.  It is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	db_mutex.lock_shared();
+
+	assert(db_mutex_holder.IsNull());
+#ifndef NDEBUG
+	db_mutex_shared_holder = true;
+#endif
+}
+
+/**
+ * Release the shared database lock.
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(holding_db_lock());
+	assert(!holding_db_exclusive_lock());
+#ifndef NDEBUG
+	db_mutex_shared_holder = false;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
 class ScopeDatabaseLock {
 public:
 	ScopeDatabaseLock() {
@@ -94,4 +150,15 @@ public:
 	}
 };
 
+class ScopeDatabaseSharedLock {
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		db_unlock_shared();
+	}
+};
+
 #endif
@@ -31,6 +31,7 @@
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
+#include "Cursor.hxx"
 #include "fs/Traits.hxx"
 
 #include <functional>
@@ -149,19 +150,21 @@ PrintPlaylistFull(Response &r, bool base,
 	return true;
 }
 
-bool
-db_selection_print(Response &r, Partition &partition,
-		   const DatabaseSelection &selection,
-		   bool full, bool base,
-		   unsigned window_start, unsigned window_end,
-		   Error &error)
+/**
+ * Create the visitors which print a database selection, and pass
+ * them to the given function.
+ *
+ * @param i the number of songs which have already been visited; it
+ * is incremented for each song
+ */
+template<typename F>
+static bool
+WithPrintVisitors(Response &r, Partition &partition,
+		  const DatabaseSelection &selection,
+		  bool full, bool base,
+		  unsigned &i, unsigned window_start, unsigned window_end,
+		  F &&f)
 {
-	const Database *db = partition.GetDatabase(error);
-	if (db == nullptr)
-		return false;
-
-	unsigned i = 0;
-
 	using namespace std::placeholders;
 	const auto d = selection.filter == nullptr
 		? std::bind(full ? PrintDirectoryFull : PrintDirectoryBrief,
@@ -183,7 +186,48 @@ db_selection_print(Response &r, Partition &partition,
 			return !in_window || s(song, error2);
 		};
 
-	return db->Visit(selection, d, s, p, error);
+	return f(d, s, p);
+}
+
+bool
+db_selection_print(Response &r, Partition &partition,
+		   const DatabaseSelection &selection,
+		   bool full, bool base,
+		   unsigned window_start, unsigned window_end,
+		   Error &error)
+{
+	const Database *db = partition.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	const auto visit = [db, &selection, &error](const VisitDirectory &d,
+						    const VisitSong &s,
+						    const VisitPlaylist &p){
+		return db->Visit(selection, d, s, p, error);
+	};
+
+	unsigned i = 0;
+	return WithPrintVisitors(r, partition, selection, full, base,
+				 i, window_start, window_end, visit);
+}
+
+bool
+db_cursor_print(Response &r, Partition &partition,
+		DatabaseCursor &cursor, const DatabaseSelection &selection,
+		bool full, bool base,
+		unsigned &i, unsigned window_start, unsigned window_end,
+		unsigned limit, bool &more_r,
+		Error &error)
+{
+	const auto visit = [&cursor, limit, &more_r,
+			    &error](const VisitDirectory &d,
+				    const VisitSong &s,
+				    const VisitPlaylist &p){
+		return cursor.Visit(limit, d, s, p, more_r, error);
+	};
+
+	return WithPrintVisitors(r, partition, selection, full, base,
+				 i, window_start, window_end, visit);
 }
 
 bool
@@ -25,6 +25,7 @@
 
 class SongFilter;
 struct DatabaseSelection;
+class DatabaseCursor;
 struct Partition;
 class Client;
 class Response;
@@ -46,6 +47,24 @@ db_selection_print(Response &r, Partition &partition,
 		   unsigned window_start, unsigned window_end,
 		   Error &error);
 
+/**
+ * Print the next portion of a selection with a #DatabaseCursor
+ * obtained from Database::OpenCursor().
+ *
+ * @param i the number of songs printed by the previous portions;
+ * this is used for the window, and it is updated
+ * @param limit the portion size, see DatabaseCursor::Visit()
+ * @param more_r on success, this is set to true if there are more
+ * objects after this portion
+ */
+bool
+db_cursor_print(Response &r, Partition &partition,
+		DatabaseCursor &cursor, const DatabaseSelection &selection,
+		bool full, bool base,
+		unsigned &i, unsigned window_start, unsigned window_end,
+		unsigned limit, bool &more_r,
+		Error &error);
+
 bool
 PrintUniqueTags(Response &r, Partition &partition,
 		unsigned type, tag_mask_t group_mask,
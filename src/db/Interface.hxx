@@ -31,6 +31,7 @@ struct DatabasePlugin;
 struct DatabaseStats;
 struct DatabaseSelection;
 struct LightSong;
+class DatabaseCursor;
 class Error;
 
 class Database {
@@ -103,6 +104,21 @@ public:
 		return Visit(selection, VisitDirectory(), visit_song, error);
 	}
 
+	/**
+	 * Prepare visiting the selection in portions, for responses
+	 * which are too large to be generated at once.  The
+	 * #DatabaseSelection (and its #SongFilter) must remain valid
+	 * while the cursor is used.
+	 *
+	 * @return a new cursor (to be freed by the caller) or
+	 * nullptr if this database (or this selection) does not
+	 * support it; use Visit() then
+	 */
+	virtual DatabaseCursor *
+	OpenCursor(gcc_unused const DatabaseSelection &selection) const {
+		return nullptr;
+	}
+
 	/**
 	 * Visit all unique tag values.
 	 */
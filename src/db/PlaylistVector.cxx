@@ -38,7 +38,7 @@ PlaylistVector::find(const char *name)
 bool
 PlaylistVector::UpdateOrInsert(PlaylistInfo &&pi)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	auto i = find(pi.name.c_str());
 	if (i != end()) {
@@ -55,7 +55,7 @@ PlaylistVector::UpdateOrInsert(PlaylistInfo &&pi)
 bool
 PlaylistVector::erase(const char *name)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	auto i = find(name);
 	if (i == end())
@@ -0,0 +1,648 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BinaryDatabase.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Settings.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain binary_db_domain("binary_db");
+
+static constexpr char BINARY_DB_MAGIC[BINARY_DB_MAGIC_SIZE] = {
+	'M', 'P', 'D', 'B', 'I', 'N', '\r', '\n',
+};
+
+static constexpr uint32_t BINARY_DB_FORMAT = 1;
+
+/**
+ * Written in host byte order; a file from a machine with a
+ * different byte order is rejected.
+ */
+static constexpr uint32_t BINARY_DB_BYTE_ORDER = 0x01020304;
+
+/**
+ * Records are aligned to this many bytes within the file.
+ */
+static constexpr size_t BINARY_DB_ALIGN = 8;
+
+/**
+ * The file header.  All offsets are relative to the beginning of the
+ * file.  All strings are stored as offsets into the string table,
+ * which is a sequence of null-terminated strings at the end of the
+ * file.
+ */
+struct BinaryDbHeader {
+	char magic[8];
+	uint32_t format;
+	uint32_t byte_order;
+
+	/**
+	 * The fs_charset which was used to create this database.
+	 */
+	uint32_t fs_charset;
+
+	/**
+	 * The number of tag names (an array of string offsets).  Tag
+	 * items refer to an index in this array, and not to the
+	 * (version specific) #TagType value.
+	 */
+	uint32_t n_tags;
+
+	uint32_t n_directories, n_songs, n_items, n_playlists;
+
+	uint32_t string_size, reserved;
+
+	uint64_t tags_offset;
+
+	/**
+	 * The directories are stored in breadth-first order, i.e.
+	 * the children of each directory are adjacent, and the root
+	 * directory is the first one.
+	 */
+	uint64_t directories_offset;
+
+	uint64_t songs_offset, items_offset, playlists_offset;
+
+	uint64_t strings_offset;
+};
+
+struct BinaryDbDirectory {
+	uint32_t name;
+	uint32_t device;
+	int64_t mtime;
+	uint32_t first_child, n_children;
+	uint32_t first_song, n_songs;
+	uint32_t first_playlist, n_playlists;
+};
+
+struct BinaryDbSong {
+	uint32_t uri;
+
+	/**
+	 * The number of tag items; they follow the items of the
+	 * previous song.
+	 */
+	uint32_t n_items;
+
+	/**
+	 * The duration in milliseconds; negative if unknown.
+	 */
+	int32_t duration_ms;
+
+	uint32_t start_ms, end_ms;
+
+	uint32_t flags;
+
+	int64_t mtime;
+};
+
+static constexpr uint32_t BINARY_DB_SONG_HAS_PLAYLIST = 0x1;
+
+struct BinaryDbTagItem {
+	uint32_t type;
+	uint32_t value;
+};
+
+struct BinaryDbPlaylist {
+	uint32_t name;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+static_assert(sizeof(BinaryDbHeader) % BINARY_DB_ALIGN == 0,
+	      "Wrong BinaryDbHeader size");
+static_assert(sizeof(BinaryDbDirectory) % BINARY_DB_ALIGN == 0,
+	      "Wrong BinaryDbDirectory size");
+static_assert(sizeof(BinaryDbSong) % BINARY_DB_ALIGN == 0,
+	      "Wrong BinaryDbSong size");
+static_assert(sizeof(BinaryDbTagItem) % BINARY_DB_ALIGN == 0,
+	      "Wrong BinaryDbTagItem size");
+static_assert(sizeof(BinaryDbPlaylist) % BINARY_DB_ALIGN == 0,
+	      "Wrong BinaryDbPlaylist size");
+
+static constexpr size_t
+AlignSize(size_t size)
+{
+	return (size + BINARY_DB_ALIGN - 1) & ~(BINARY_DB_ALIGN - 1);
+}
+
+bool
+db_is_binary(ConstBuffer<void> data)
+{
+	return data.size >= sizeof(BINARY_DB_MAGIC) &&
+		memcmp(data.data, BINARY_DB_MAGIC,
+		       sizeof(BINARY_DB_MAGIC)) == 0;
+}
+
+/**
+ * Collects the whole database into arrays which can then be written
+ * to the file.
+ */
+class BinaryDbWriter {
+	std::vector<uint32_t> tags;
+	std::vector<BinaryDbDirectory> directories;
+	std::vector<BinaryDbSong> songs;
+	std::vector<BinaryDbTagItem> items;
+	std::vector<BinaryDbPlaylist> playlists;
+
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> string_map;
+
+	/**
+	 * Maps #TagType to an index in #tags.
+	 */
+	uint32_t tag_index[TAG_NUM_OF_ITEM_TYPES];
+
+	uint32_t fs_charset;
+
+public:
+	BinaryDbWriter();
+
+	void Collect(const Directory &root);
+
+	bool Write(OutputStream &os, Error &error) const;
+
+private:
+	uint32_t AddString(const std::string &s);
+
+	uint32_t AddString(const char *s) {
+		return AddString(std::string(s));
+	}
+
+	void AddSong(const Song &song);
+	void AddDirectory(const Directory &directory, BinaryDbDirectory &d,
+			  std::vector<const Directory *> &queue);
+};
+
+BinaryDbWriter::BinaryDbWriter()
+{
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		if (IsTagEnabled(i)) {
+			tag_index[i] = tags.size();
+			tags.push_back(AddString(tag_item_names[i]));
+		} else
+			tag_index[i] = UINT32_MAX;
+	}
+
+	fs_charset = AddString(GetFSCharset());
+}
+
+uint32_t
+BinaryDbWriter::AddString(const std::string &s)
+{
+	auto i = string_map.find(s);
+	if (i != string_map.end())
+		return i->second;
+
+	const uint32_t offset = strings.size();
+	strings.append(s.c_str(), s.length() + 1);
+	string_map.emplace(s, offset);
+	return offset;
+}
+
+inline void
+BinaryDbWriter::AddSong(const Song &song)
+{
+	BinaryDbSong s;
+	s.uri = AddString(song.uri);
+	s.n_items = 0;
+	s.duration_ms = song.tag.duration.IsNegative()
+		? -1
+		: int32_t(song.tag.duration.ToMS());
+	s.start_ms = song.start_time.ToMS();
+	s.end_ms = song.end_time.ToMS();
+	s.flags = song.tag.has_playlist ? BINARY_DB_SONG_HAS_PLAYLIST : 0;
+	s.mtime = song.mtime;
+
+	for (const auto &i : song.tag) {
+		const uint32_t type = tag_index[i.type];
+		if (type == UINT32_MAX)
+			continue;
+
+		items.push_back({type, AddString(i.value)});
+		++s.n_items;
+	}
+
+	songs.push_back(s);
+}
+
+inline void
+BinaryDbWriter::AddDirectory(const Directory &directory,
+			     BinaryDbDirectory &d,
+			     std::vector<const Directory *> &queue)
+{
+	d.device = directory.device;
+	d.mtime = directory.mtime;
+
+	d.first_child = queue.size();
+	d.n_children = 0;
+	for (const auto &child : directory.children) {
+		/* the contents of mounted databases are not stored
+		   here */
+		if (child.IsMount())
+			continue;
+
+		queue.push_back(&child);
+		++d.n_children;
+	}
+
+	d.first_song = songs.size();
+	d.n_songs = 0;
+	for (const auto &song : directory.songs) {
+		AddSong(song);
+		++d.n_songs;
+	}
+
+	d.first_playlist = playlists.size();
+	d.n_playlists = 0;
+	for (const auto &pi : directory.playlists) {
+		playlists.push_back({AddString(pi.name), 0, pi.mtime});
+		++d.n_playlists;
+	}
+}
+
+void
+BinaryDbWriter::Collect(const Directory &root)
+{
+	std::vector<const Directory *> queue;
+	queue.push_back(&root);
+
+	for (size_t i = 0; i < queue.size(); ++i) {
+		const Directory &directory = *queue[i];
+
+		BinaryDbDirectory d;
+		d.name = directory.IsRoot()
+			? AddString("")
+			: AddString(directory.GetName());
+		AddDirectory(directory, d, queue);
+		directories.push_back(d);
+	}
+}
+
+static bool
+WritePadded(OutputStream &os, const void *data, size_t size, Error &error)
+{
+	static constexpr char padding[BINARY_DB_ALIGN] = {};
+
+	return os.Write(data, size, error) &&
+		(size == AlignSize(size) ||
+		 os.Write(padding, AlignSize(size) - size, error));
+}
+
+template<typename T>
+static bool
+WriteArray(OutputStream &os, const std::vector<T> &v, Error &error)
+{
+	return v.empty() ||
+		WritePadded(os, &v.front(), v.size() * sizeof(T), error);
+}
+
+bool
+BinaryDbWriter::Write(OutputStream &os, Error &error) const
+{
+	BinaryDbHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.format = BINARY_DB_FORMAT;
+	header.byte_order = BINARY_DB_BYTE_ORDER;
+	header.n_tags = tags.size();
+	header.n_directories = directories.size();
+	header.n_songs = songs.size();
+	header.n_items = items.size();
+	header.n_playlists = playlists.size();
+
+	uint64_t offset = sizeof(header);
+	header.tags_offset = offset;
+	offset += AlignSize(tags.size() * sizeof(tags.front()));
+	header.directories_offset = offset;
+	offset += directories.size() * sizeof(directories.front());
+	header.songs_offset = offset;
+	offset += songs.size() * sizeof(songs.front());
+	header.items_offset = offset;
+	offset += items.size() * sizeof(items.front());
+	header.playlists_offset = offset;
+	offset += playlists.size() * sizeof(playlists.front());
+	header.strings_offset = offset;
+	header.fs_charset = fs_charset;
+	header.string_size = strings.size();
+
+	return os.Write(&header, sizeof(header), error) &&
+		WriteArray(os, tags, error) &&
+		WriteArray(os, directories, error) &&
+		WriteArray(os, songs, error) &&
+		WriteArray(os, items, error) &&
+		WriteArray(os, playlists, error) &&
+		os.Write(strings.data(), strings.size(), error);
+}
+
+bool
+db_save_binary(OutputStream &os, const Directory &root, Error &error)
+{
+	BinaryDbWriter writer;
+	writer.Collect(root);
+	return writer.Write(os, error);
+}
+
+/**
+ * Provides checked access to the arrays of a binary database.
+ */
+class BinaryDbReader {
+	const uint8_t *const data;
+	const size_t size;
+
+	const BinaryDbHeader &header;
+
+	const char *strings;
+
+public:
+	BinaryDbReader(ConstBuffer<void> buffer)
+		:data((const uint8_t *)buffer.data), size(buffer.size),
+		 header(*(const BinaryDbHeader *)buffer.data) {}
+
+	bool Check(Error &error);
+
+	bool Load(Directory &root, Error &error) const;
+
+private:
+	template<typename T>
+	gcc_pure
+	bool CheckArray(uint64_t offset, uint32_t n) const {
+		return offset % BINARY_DB_ALIGN == 0 &&
+			offset <= size &&
+			uint64_t(n) * sizeof(T) <= size - offset;
+	}
+
+	template<typename T>
+	const T *GetArray(uint64_t offset) const {
+		return (const T *)(data + offset);
+	}
+
+	/**
+	 * Returns the string at the given offset, or nullptr if the
+	 * offset is invalid.
+	 */
+	gcc_pure
+	const char *GetString(uint32_t offset) const {
+		return offset < header.string_size
+			? strings + offset
+			: nullptr;
+	}
+
+	bool LoadSong(Directory &directory, const BinaryDbSong &s,
+		      const BinaryDbTagItem *items,
+		      const TagType *tag_types, Error &error) const;
+};
+
+bool
+BinaryDbReader::Check(Error &error)
+{
+	if (size < sizeof(header) ||
+	    memcmp(header.magic, BINARY_DB_MAGIC, sizeof(header.magic)) != 0) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	if (header.format != BINARY_DB_FORMAT ||
+	    header.byte_order != BINARY_DB_BYTE_ORDER) {
+		error.Set(db_domain,
+			  "Database format mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	if (!CheckArray<uint32_t>(header.tags_offset, header.n_tags) ||
+	    !CheckArray<BinaryDbDirectory>(header.directories_offset,
+					   header.n_directories) ||
+	    header.n_directories == 0 ||
+	    !CheckArray<BinaryDbSong>(header.songs_offset,
+				      header.n_songs) ||
+	    !CheckArray<BinaryDbTagItem>(header.items_offset,
+					 header.n_items) ||
+	    !CheckArray<BinaryDbPlaylist>(header.playlists_offset,
+					  header.n_playlists) ||
+	    header.strings_offset > size ||
+	    header.string_size == 0 ||
+	    /* the string table is the end of the file */
+	    header.string_size != size - header.strings_offset ||
+	    data[header.strings_offset + header.string_size - 1] != 0) {
+		error.Set(binary_db_domain, "Database corrupted");
+		return false;
+	}
+
+	strings = (const char *)data + header.strings_offset;
+
+	const char *new_charset = GetString(header.fs_charset);
+	const char *const old_charset = GetFSCharset();
+	if (new_charset == nullptr ||
+	    (*old_charset != 0 && strcmp(new_charset, old_charset) != 0)) {
+		error.Format(db_domain,
+			     "Existing database has charset "
+			     "\"%s\" instead of \"%s\"; "
+			     "discarding database file",
+			     new_charset != nullptr ? new_charset : "",
+			     old_charset);
+		return false;
+	}
+
+	return true;
+}
+
+inline bool
+BinaryDbReader::LoadSong(Directory &directory, const BinaryDbSong &s,
+			 const BinaryDbTagItem *items,
+			 const TagType *tag_types, Error &error) const
+{
+	const char *uri = GetString(s.uri);
+	if (uri == nullptr || *uri == 0 || strchr(uri, '/') != nullptr) {
+		error.Set(binary_db_domain, "Malformed song");
+		return false;
+	}
+
+	TagBuilder tag;
+	tag.Reserve(s.n_items);
+	tag.SetDuration(s.duration_ms >= 0
+			? SignedSongTime::FromMS(s.duration_ms)
+			: SignedSongTime::Negative());
+	tag.SetHasPlaylist((s.flags & BINARY_DB_SONG_HAS_PLAYLIST) != 0);
+
+	for (uint32_t i = 0; i < s.n_items; ++i) {
+		const char *value = GetString(items[i].value);
+		if (items[i].type >= header.n_tags || value == nullptr) {
+			error.Set(binary_db_domain, "Malformed tag item");
+			return false;
+		}
+
+		tag.AddItem(tag_types[items[i].type], value);
+	}
+
+	Song *song = Song::NewFile(uri, directory);
+	tag.Commit(song->tag);
+	song->mtime = s.mtime;
+	song->start_time = SongTime::FromMS(s.start_ms);
+	song->end_time = SongTime::FromMS(s.end_ms);
+	directory.AddSong(song);
+	return true;
+}
+
+bool
+BinaryDbReader::Load(Directory &root, Error &error) const
+{
+	/* map the file's tag names to TagType */
+
+	bool tags[TAG_NUM_OF_ITEM_TYPES];
+	memset(tags, false, sizeof(tags));
+
+	const uint32_t *tag_names = GetArray<uint32_t>(header.tags_offset);
+	std::vector<TagType> tag_types(header.n_tags);
+	for (uint32_t i = 0; i < header.n_tags; ++i) {
+		const char *name = GetString(tag_names[i]);
+		if (name == nullptr) {
+			error.Set(binary_db_domain, "Database corrupted");
+			return false;
+		}
+
+		const TagType type = tag_name_parse(name);
+		if (type == TAG_NUM_OF_ITEM_TYPES) {
+			error.Format(db_domain,
+				     "Unrecognized tag '%s', "
+				     "discarding database file",
+				     name);
+			return false;
+		}
+
+		tag_types[i] = type;
+		tags[type] = true;
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		if (IsTagEnabled(i) && !tags[i]) {
+			error.Set(db_domain,
+				  "Tag list mismatch, "
+				  "discarding database file");
+			return false;
+		}
+	}
+
+	/* walk the directories; since they are stored in
+	   breadth-first order, each directory has been created by its
+	   parent before we get to it, and each array range must
+	   start where the previous one ended */
+
+	const auto *directories =
+		GetArray<BinaryDbDirectory>(header.directories_offset);
+	const auto *songs = GetArray<BinaryDbSong>(header.songs_offset);
+	const auto *items = GetArray<BinaryDbTagItem>(header.items_offset);
+	const auto *playlists =
+		GetArray<BinaryDbPlaylist>(header.playlists_offset);
+
+	std::vector<Directory *> objects(header.n_directories);
+	objects[0] = &root;
+
+	uint32_t next_child = 1, next_song = 0, next_item = 0;
+	uint32_t next_playlist = 0;
+
+	for (uint32_t i = 0; i < header.n_directories; ++i) {
+		const BinaryDbDirectory &d = directories[i];
+
+		if (i >= next_child ||
+		    d.first_child != next_child ||
+		    d.n_children > header.n_directories - next_child ||
+		    d.first_song != next_song ||
+		    d.n_songs > header.n_songs - next_song ||
+		    d.first_playlist != next_playlist ||
+		    d.n_playlists > header.n_playlists - next_playlist) {
+			error.Set(binary_db_domain, "Malformed directory");
+			return false;
+		}
+
+		Directory &directory = *objects[i];
+		if (!directory.IsRoot()) {
+			directory.device = d.device;
+			directory.mtime = d.mtime;
+		}
+
+		for (uint32_t j = 0; j < d.n_children; ++j) {
+			const char *name =
+				GetString(directories[next_child].name);
+			if (name == nullptr || *name == 0 ||
+			    strchr(name, '/') != nullptr) {
+				error.Set(binary_db_domain,
+					  "Malformed directory");
+				return false;
+			}
+
+			objects[next_child++] = directory.CreateChild(name);
+		}
+
+		for (uint32_t j = 0; j < d.n_songs; ++j) {
+			const BinaryDbSong &s = songs[next_song++];
+			if (s.n_items > header.n_items - next_item) {
+				error.Set(binary_db_domain, "Malformed song");
+				return false;
+			}
+
+			if (!LoadSong(directory, s, items + next_item,
+				      tag_types.data(), error))
+				return false;
+
+			next_item += s.n_items;
+		}
+
+		for (uint32_t j = 0; j < d.n_playlists; ++j) {
+			const BinaryDbPlaylist &p = playlists[next_playlist++];
+			const char *name = GetString(p.name);
+			if (name == nullptr || *name == 0) {
+				error.Set(binary_db_domain,
+					  "Malformed playlist");
+				return false;
+			}
+
+			directory.playlists.UpdateOrInsert(PlaylistInfo(name,
+									p.mtime));
+		}
+	}
+
+	return true;
+}
+
+bool
+db_load_binary(ConstBuffer<void> data, Directory &root, Error &error)
+{
+	assert(holding_db_lock());
+
+	BinaryDbReader reader(data);
+	return reader.Check(error) && reader.Load(root, error);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BINARY_DATABASE_HXX
+#define MPD_BINARY_DATABASE_HXX
+
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+struct Directory;
+class OutputStream;
+class Error;
+
+/**
+ * The number of bytes at the beginning of the file which are needed
+ * by db_is_binary().
+ */
+static constexpr size_t BINARY_DB_MAGIC_SIZE = 8;
+
+/**
+ * Does the given file contents look like a binary database (as
+ * opposed to the text format written by db_save_internal())?  Only
+ * the first #BINARY_DB_MAGIC_SIZE bytes are needed.
+ */
+gcc_pure
+bool
+db_is_binary(ConstBuffer<void> data);
+
+/**
+ * Write the database in the binary format.  Unlike the text format,
+ * this one consists of a string table and arrays of fixed-size
+ * records, and can be loaded from a memory mapping without parsing.
+ */
+bool
+db_save_binary(OutputStream &os, const Directory &root, Error &error);
+
+/**
+ * Load a database in the binary format from the given (usually
+ * memory-mapped) file contents.  The buffer is not referenced after
+ * this function returns.
+ *
+ * Caller must lock the #db_mutex.
+ */
+bool
+db_load_binary(ConstBuffer<void> data, Directory &root, Error &error);
+
+#endif
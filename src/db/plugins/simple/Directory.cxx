@@ -33,22 +33,92 @@
 #include "util/Alloc.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/Error.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <unordered_map>
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
+/**
+ * FNV-1a hash of a null-terminated string.
+ */
+struct DirectoryNameHash {
+	gcc_pure
+	size_t operator()(const char *s) const {
+		size_t hash = 2166136261u;
+		for (; *s != 0; ++s)
+			hash = (hash ^ (unsigned char)*s) * 16777619u;
+		return hash;
+	}
+};
+
+struct DirectoryNameEqual {
+	gcc_pure
+	bool operator()(const char *a, const char *b) const {
+		return strcmp(a, b) == 0;
+	}
+};
+
+/**
+ * Maps names to objects in a #Directory.  The keys point into the
+ * objects.  This is a multimap because the lists don't forbid
+ * duplicate names.
+ */
+template<typename T>
+struct DirectoryIndex
+	: std::unordered_multimap<const char *, T *,
+				  DirectoryNameHash, DirectoryNameEqual> {
+	gcc_pure
+	T *Find(const char *name) const {
+		auto i = this->find(name);
+		return i != this->end()
+			? i->second
+			: nullptr;
+	}
+
+	void Erase(const char *name, const T &value) {
+		auto r = this->equal_range(name);
+		for (auto i = r.first; i != r.second; ++i) {
+			if (i->second == &value) {
+				this->erase(i);
+				return;
+			}
+		}
+
+		assert(false);
+	}
+};
+
+struct Directory::ChildIndex : DirectoryIndex<Directory> {};
+struct Directory::SongIndex : DirectoryIndex<Song> {};
+
+unsigned Directory::serial;
+
+/**
+ * Protects the transition of Directory::mount_pins to zero, for
+ * WaitMountUnpinned().
+ */
+static Mutex mount_pin_mutex;
+static Cond mount_pin_cond;
+
 Directory::Directory(std::string &&_path_utf8, Directory *_parent)
 	:parent(_parent),
 	 mtime(0),
 	 inode(0), device(0),
 	 path(std::move(_path_utf8)),
-	 mounted_database(nullptr)
+	 mounted_database(nullptr),
+	 mount_pins(0),
+	 n_children(0), n_songs(0)
 {
 }
 
 Directory::~Directory()
 {
+	assert(mount_pins == 0);
+
 	delete mounted_database;
 
 	songs.clear_and_dispose(Song::Disposer());
@@ -58,11 +128,23 @@ Directory::~Directory()
 void
 Directory::Delete()
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(parent != nullptr);
 
-	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
-					   DeleteDisposer());
+	MarkModified();
+	parent->EraseChild(parent->children.iterator_to(*this));
+}
+
+Directory::List::iterator
+Directory::EraseChild(List::iterator i)
+{
+	assert(n_children > 0);
+	--n_children;
+
+	if (child_index != nullptr)
+		child_index->Erase(i->GetName(), *i);
+
+	return children.erase_and_dispose(i, DeleteDisposer());
 }
 
 const char *
@@ -76,7 +158,7 @@ Directory::GetName() const
 Directory *
 Directory::CreateChild(const char *name_utf8)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
@@ -86,6 +168,17 @@ Directory::CreateChild(const char *name_utf8)
 
 	Directory *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	++n_children;
+
+	if (child_index != nullptr) {
+		child_index->emplace(child->GetName(), child);
+	} else if (n_children > INDEX_THRESHOLD) {
+		child_index.reset(new ChildIndex());
+		for (auto &i : children)
+			child_index->emplace(i.GetName(), &i);
+	}
+
+	MarkModified();
 	return child;
 }
 
@@ -94,6 +187,9 @@ Directory::FindChild(const char *name) const
 {
 	assert(holding_db_lock());
 
+	if (child_index != nullptr)
+		return child_index->Find(name);
+
 	for (const auto &child : children)
 		if (strcmp(child.GetName(), name) == 0)
 			return &child;
@@ -104,16 +200,16 @@ Directory::FindChild(const char *name) const
 void
 Directory::PruneEmpty()
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty())
-			child = children.erase_and_dispose(child,
-							   DeleteDisposer());
-		else
+		if (child->IsEmpty()) {
+			child = EraseChild(child);
+			MarkModified();
+		} else
 			++child;
 	}
 }
@@ -166,21 +262,40 @@ Directory::LookupDirectory(const char *uri)
 void
 Directory::AddSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.push_back(*song);
+	++n_songs;
+
+	if (song_index != nullptr) {
+		song_index->emplace(song->uri, song);
+	} else if (n_songs > INDEX_THRESHOLD) {
+		song_index.reset(new SongIndex());
+		for (auto &i : songs)
+			song_index->emplace(i.uri, &i);
+	}
+
+	MarkModified();
 }
 
 void
 Directory::RemoveSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.erase(songs.iterator_to(*song));
+
+	assert(n_songs > 0);
+	--n_songs;
+
+	if (song_index != nullptr)
+		song_index->Erase(song->uri, *song);
+
+	MarkModified();
 }
 
 const Song *
@@ -189,6 +304,9 @@ Directory::FindSong(const char *name_utf8) const
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index != nullptr)
+		return song_index->Find(name_utf8);
+
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
@@ -209,15 +327,42 @@ directory_cmp(const Directory &a, const Directory &b)
 void
 Directory::Sort()
 {
-	assert(holding_db_lock());
+	assert(holding_db_exclusive_lock());
 
 	children.sort(directory_cmp);
 	song_list_sort(songs);
+	MarkModified();
 
 	for (auto &child : children)
 		child.Sort();
 }
 
+void
+Directory::UnpinMount() const
+{
+	const ScopeLock protect(mount_pin_mutex);
+
+	assert(mount_pins > 0);
+	if (--mount_pins == 0)
+		mount_pin_cond.broadcast();
+}
+
+bool
+Directory::WaitMountUnpinned() const
+{
+	assert(holding_db_exclusive_lock());
+
+	const ScopeLock protect(mount_pin_mutex);
+	if (mount_pins == 0)
+		return true;
+
+	/* no reader can pin it again while we hold the exclusive
+	   lock; release the lock, so the reader can finish */
+	db_unlock();
+	mount_pin_cond.wait(mount_pin_mutex);
+	return false;
+}
+
 bool
 Directory::Walk(bool recursive, const SongFilter *filter,
 		VisitDirectory visit_directory, VisitSong visit_song,
@@ -231,14 +376,20 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
-		   call will lock it again */
-		db_unlock();
+		   call will lock it again; the pin keeps this
+		   object and the mounted database alive
+		   meanwhile, and it must be released only after
+		   locking again, because the caller may be
+		   iterating over our parent's children */
+		PinMount();
+		db_unlock_shared();
 		bool result = WalkMount(GetPath(), *mounted_database,
 					recursive, filter,
 					visit_directory, visit_song,
 					visit_playlist,
 					error);
-		db_lock();
+		db_lock_shared();
+		UnpinMount();
 		return result;
 	}
 
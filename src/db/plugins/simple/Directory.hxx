@@ -29,6 +29,8 @@
 #include <boost/intrusive/list.hpp>
 
 #include <string>
+#include <memory>
+#include <atomic>
 
 /**
  * Virtual directory that is really an archive file or a folder inside
@@ -98,6 +100,49 @@ struct Directory {
 	 */
 	Database *mounted_database;
 
+private:
+	/**
+	 * The number of readers which have released the database
+	 * lock to visit #mounted_database.  As long as it is not
+	 * zero, the mount point must not be removed; see PinMount().
+	 */
+	mutable std::atomic_uint mount_pins;
+
+	/**
+	 * Directories with more entries than this get a hash index
+	 * for FindChild() or FindSong().
+	 */
+	static constexpr unsigned INDEX_THRESHOLD = 32;
+
+	struct ChildIndex;
+	struct SongIndex;
+
+	/**
+	 * Hash indexes of #children and #songs by name.  They are
+	 * created by CreateChild() and AddSong() as soon as the list
+	 * grows beyond #INDEX_THRESHOLD entries, and are then
+	 * maintained alongside the lists; small directories don't
+	 * need them.
+	 *
+	 * These attributes are protected with the global #db_mutex.
+	 */
+	std::unique_ptr<ChildIndex> child_index;
+	std::unique_ptr<SongIndex> song_index;
+
+	/**
+	 * The number of entries in #children and #songs.
+	 */
+	unsigned n_children, n_songs;
+
+	/**
+	 * Incremented each time a #Directory tree (of any
+	 * #SimpleDatabase) is modified.  This allows invalidating
+	 * caches such as #TagIndex.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	static unsigned serial;
+
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent);
 	~Directory();
@@ -114,18 +159,67 @@ public:
 		return mounted_database != nullptr;
 	}
 
+	/**
+	 * Prevent this mount point (and its #mounted_database) from
+	 * being removed, so the caller may release the database lock
+	 * while visiting the mounted database.  Caller must lock the
+	 * #db_mutex.  Call UnpinMount() when done.
+	 */
+	void PinMount() const {
+		assert(IsMount());
+
+		++mount_pins;
+	}
+
+	/**
+	 * Undo PinMount().  The caller does not need to hold the
+	 * #db_mutex.
+	 */
+	void UnpinMount() const;
+
+	/**
+	 * Check if a reader has pinned this mount point, and if yes,
+	 * wait until it unpins it.  Caller must hold the exclusive
+	 * database lock.
+	 *
+	 * @return true if the mount point is not pinned (and the
+	 * lock is still held); false if this function has waited, and
+	 * has released the lock meanwhile (the caller must lock again
+	 * and look up the mount point again)
+	 */
+	bool WaitMountUnpinned() const;
+
+	/**
+	 * Caller must lock the #db_mutex.
+	 */
+	gcc_pure
+	static unsigned GetSerial() {
+		return serial;
+	}
+
+	/**
+	 * Mark the tree as modified.  The methods of this class which
+	 * modify the tree do that automatically; this must only be
+	 * called after modifying a #Song object in place.
+	 *
+	 * Caller must lock the #db_mutex exclusively.
+	 */
+	static void MarkModified() {
+		++serial;
+	}
+
 	/**
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void Delete();
 
 	/**
 	 * Create a new #Directory object as a child of the given one.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 *
 	 * @param name_utf8 the UTF-8 encoded name of the new sub directory
 	 */
@@ -148,7 +242,7 @@ public:
 	 * Look up a sub directory, and create the object if it does not
 	 * exist.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	Directory *MakeChild(const char *name_utf8) {
 		Directory *child = FindChild(name_utf8);
@@ -207,6 +301,18 @@ public:
 		return parent == nullptr;
 	}
 
+	/**
+	 * Is this the given directory or one of its descendants?
+	 */
+	gcc_pure
+	bool IsInside(const Directory &other) const {
+		for (const Directory *i = this; i != nullptr; i = i->parent)
+			if (i == &other)
+				return true;
+
+		return false;
+	}
+
 	template<typename T>
 	void ForEachChildSafe(T &&t) {
 		const auto end = children.end();
@@ -253,14 +359,14 @@ public:
 	void RemoveSong(Song *song);
 
 	/**
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void PruneEmpty();
 
 	/**
 	 * Sort all directory entries recursively.
 	 *
-	 * Caller must lock the #db_mutex.
+	 * Caller must lock the #db_mutex exclusively.
 	 */
 	void Sort();
 
@@ -274,6 +380,13 @@ public:
 
 	gcc_pure
 	LightDirectory Export() const;
+
+private:
+	/**
+	 * Removes a child from #children and #child_index, and frees
+	 * it.
+	 */
+	List::iterator EraseChild(List::iterator i);
 };
 
 #endif
@@ -21,6 +21,7 @@
 #define MPD_DB_SIMPLE_PREFIXED_LIGHT_SONG_HXX
 
 #include "check.h"
+#include "Directory.hxx"
 #include "db/LightSong.hxx"
 #include "fs/Traits.hxx"
 
@@ -29,13 +30,47 @@
 class PrefixedLightSong : public LightSong {
 	std::string buffer;
 
+	/**
+	 * The mount point this song was found in.  It has been
+	 * pinned by the caller, and the destructor unpins it.
+	 */
+	const Directory *const mount;
+
 public:
+	/**
+	 * Copy a #LightSong without adding a prefix.
+	 */
+	explicit PrefixedLightSong(const LightSong &song)
+		:LightSong(song), mount(nullptr) {}
+
 	PrefixedLightSong(const LightSong &song, const char *base)
 		:LightSong(song),
-		 buffer(PathTraitsUTF8::Build(base, GetURI().c_str())) {
+		 buffer(PathTraitsUTF8::Build(base, GetURI().c_str())),
+		 mount(nullptr) {
 		uri = buffer.c_str();
 		directory = nullptr;
 	}
+
+	/**
+	 * Copy a #LightSong from a mounted database, and take over
+	 * its pin.
+	 *
+	 * @param _mount the mount point, pinned with
+	 * Directory::PinMount()
+	 */
+	PrefixedLightSong(const LightSong &song, const char *base,
+			  const Directory &_mount)
+		:LightSong(song),
+		 buffer(PathTraitsUTF8::Build(base, GetURI().c_str())),
+		 mount(&_mount) {
+		uri = buffer.c_str();
+		directory = nullptr;
+	}
+
+	~PrefixedLightSong() {
+		if (mount != nullptr)
+			mount->UnpinMount();
+	}
 };
 
 #endif
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SimpleCursor.hxx"
+#include "SimpleDatabasePlugin.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/LightDirectory.hxx"
+#include "SongFilter.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+SimpleDatabaseCursor::SimpleDatabaseCursor(const SimpleDatabase &_db,
+					   const DatabaseSelection &_selection,
+					   const Directory &_base)
+	:db(_db), selection(_selection), phase(Phase::START),
+	 serial(Directory::GetSerial()),
+	 base(&_base), directory(&_base),
+	 indexed(nullptr), next_indexed(0)
+{
+	assert(holding_db_lock());
+	assert(selection.recursive);
+	assert(!base->IsMount());
+}
+
+inline bool
+SimpleDatabaseCursor::VisitIndexed(unsigned &n, unsigned limit,
+				   const VisitSong &visit_song, Error &error)
+{
+	while (next_indexed < indexed->size()) {
+		if (n >= limit)
+			return true;
+
+		const Song &song = *(*indexed)[next_indexed++];
+		++n;
+
+		if (!song.parent->IsInside(*base))
+			continue;
+
+		last_name = song.uri;
+		directory = song.parent;
+
+		const LightSong song2 = song.Export();
+		if (selection.filter->Match(song2) &&
+		    !visit_song(song2, error))
+			return false;
+	}
+
+	phase = Phase::END;
+	return true;
+}
+
+inline bool
+SimpleDatabaseCursor::VisitSongs(unsigned &n, unsigned limit,
+				 const VisitSong &visit_song, Error &error)
+{
+	while (next_song != directory->songs.end()) {
+		if (n >= limit)
+			return true;
+
+		const Song &song = *next_song++;
+		++n;
+
+		const LightSong song2 = song.Export();
+		if ((selection.filter == nullptr ||
+		     selection.filter->Match(song2)) &&
+		    !visit_song(song2, error))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+SimpleDatabaseCursor::Visit(unsigned limit,
+			    VisitDirectory visit_directory,
+			    VisitSong visit_song,
+			    VisitPlaylist visit_playlist,
+			    bool &more_r, Error &error)
+{
+	assert(limit > 0);
+
+	more_r = false;
+	if (phase == Phase::END)
+		return true;
+
+	ScopeDatabaseSharedLock protect;
+
+	if (Directory::GetSerial() != serial && !Restore(error))
+		return false;
+
+	if (phase == Phase::START) {
+		/* same as SimpleDatabase::Visit() */
+
+		if (visit_directory &&
+		    !visit_directory(base->Export(), error))
+			return false;
+
+		if (selection.filter != nullptr && visit_song &&
+		    !visit_directory && !visit_playlist)
+			indexed = db.FindIndexed(*selection.filter);
+
+		if (indexed != nullptr) {
+			phase = Phase::INDEXED;
+			last_name.clear();
+		} else {
+			phase = Phase::SONGS;
+			next_song = base->songs.begin();
+		}
+	}
+
+	unsigned n = 0;
+	while (true) {
+		switch (phase) {
+		case Phase::START:
+			assert(false);
+			gcc_unreachable();
+
+		case Phase::INDEXED:
+			if (!VisitIndexed(n, limit, visit_song, error))
+				return false;
+
+			break;
+
+		case Phase::SONGS:
+			if (visit_song &&
+			    !VisitSongs(n, limit, visit_song, error))
+				return false;
+
+			if (visit_song && next_song != directory->songs.end())
+				break;
+
+			/* the playlists of one directory are visited
+			   at once */
+			if (visit_playlist) {
+				const LightDirectory d = directory->Export();
+				for (const auto &p : directory->playlists) {
+					++n;
+					if (!visit_playlist(p, d, error))
+						return false;
+				}
+			}
+
+			phase = Phase::CHILDREN;
+			next_child = directory->children.begin();
+			break;
+
+		case Phase::CHILDREN:
+			if (next_child == directory->children.end()) {
+				if (directory == base) {
+					phase = Phase::END;
+					break;
+				}
+
+				/* go up */
+				const Directory &child = *directory;
+				directory = child.parent;
+				next_child =
+					directory->children.iterator_to(child);
+				++next_child;
+				break;
+			}
+
+			if (n >= limit)
+				break;
+
+			{
+				const Directory &child = *next_child++;
+				++n;
+
+				if (visit_directory &&
+				    !visit_directory(child.Export(), error))
+					return false;
+
+				if (child.IsMount()) {
+					/* Directory::Walk() releases
+					   the lock while it visits the
+					   mounted database */
+					Save();
+
+					if (!child.Walk(true, selection.filter,
+							visit_directory,
+							visit_song,
+							visit_playlist,
+							error))
+						return false;
+
+					if (Directory::GetSerial() != serial &&
+					    !Restore(error))
+						return false;
+				} else {
+					directory = &child;
+					phase = Phase::SONGS;
+					next_song = child.songs.begin();
+				}
+			}
+
+			break;
+
+		case Phase::END:
+			return true;
+		}
+
+		if (n >= limit && phase != Phase::END) {
+			Save();
+			more_r = true;
+			return true;
+		}
+	}
+}
+
+void
+SimpleDatabaseCursor::Save()
+{
+	switch (phase) {
+	case Phase::START:
+	case Phase::END:
+		assert(false);
+		gcc_unreachable();
+
+	case Phase::INDEXED:
+		/* VisitIndexed() has already set #last_name and
+		   #directory; continue after that song if the tree
+		   gets modified, because #TagIndex lists are in the
+		   order of the tree walk */
+		directory_uri = last_name.empty()
+			? selection.uri
+			: directory->GetPath();
+		break;
+
+	case Phase::SONGS:
+		directory_uri = directory->GetPath();
+		if (next_song == directory->songs.begin())
+			last_name.clear();
+		else
+			last_name = std::prev(next_song)->uri;
+		break;
+
+	case Phase::CHILDREN:
+		directory_uri = directory->GetPath();
+		if (next_child == directory->children.begin())
+			last_name.clear();
+		else
+			last_name = std::prev(next_child)->GetName();
+		break;
+	}
+}
+
+bool
+SimpleDatabaseCursor::Restore(Error &error)
+{
+	assert(holding_db_lock());
+
+	auto r = db.root->LookupDirectory(selection.uri.c_str());
+	if (r.uri != nullptr || r.directory->IsMount()) {
+		error.Set(db_domain, DB_NOT_FOUND, "No such directory");
+		return false;
+	}
+
+	base = r.directory;
+	serial = Directory::GetSerial();
+
+	if (phase == Phase::START) {
+		directory = base;
+		return true;
+	}
+
+	if (phase == Phase::INDEXED) {
+		/* the #TagIndex has become invalid; continue in the
+		   tree */
+		indexed = nullptr;
+		phase = Phase::SONGS;
+	}
+
+	r = db.root->LookupDirectory(directory_uri.c_str());
+	if (r.uri != nullptr || !r.directory->IsInside(*base)) {
+		error.Set(db_domain, DB_CONFLICT,
+			  "Directory has been removed during the listing");
+		return false;
+	}
+
+	directory = r.directory;
+
+	if (phase == Phase::SONGS) {
+		if (last_name.empty()) {
+			next_song = directory->songs.begin();
+			return true;
+		}
+
+		const Song *song = directory->FindSong(last_name.c_str());
+		if (song == nullptr) {
+			error.Set(db_domain, DB_CONFLICT,
+				  "Song has been removed during the listing");
+			return false;
+		}
+
+		next_song = std::next(directory->songs.iterator_to(*song));
+	} else {
+		assert(phase == Phase::CHILDREN);
+
+		if (last_name.empty()) {
+			next_child = directory->children.begin();
+			return true;
+		}
+
+		const Directory *child =
+			directory->FindChild(last_name.c_str());
+		if (child == nullptr) {
+			error.Set(db_domain, DB_CONFLICT,
+				  "Directory has been removed "
+				  "during the listing");
+			return false;
+		}
+
+		next_child = std::next(directory->children.iterator_to(*child));
+	}
+
+	return true;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SIMPLE_DATABASE_CURSOR_HXX
+#define MPD_SIMPLE_DATABASE_CURSOR_HXX
+
+#include "check.h"
+#include "db/Cursor.hxx"
+#include "db/Selection.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "TagIndex.hxx"
+
+#include <string>
+
+class SimpleDatabase;
+
+/**
+ * The #DatabaseCursor implementation of #SimpleDatabase.  It walks
+ * the #Directory tree in the same order as Directory::Walk(), but
+ * without recursion: the position is the current #Directory and an
+ * iterator into its songs or children, and the way up is
+ * Directory::parent.
+ *
+ * These pointers are only valid as long as the tree is not
+ * modified, i.e. while Directory::GetSerial() is unchanged.  If it
+ * has changed between two portions, the position is looked up again
+ * by the names of the current directory and of the last visited
+ * song or child directory.  If one of them has been deleted
+ * meanwhile, the cursor fails.
+ *
+ * Mount points are visited at once, with Directory::Walk().
+ */
+class SimpleDatabaseCursor final : public DatabaseCursor {
+	const SimpleDatabase &db;
+
+	const DatabaseSelection selection;
+
+	enum class Phase {
+		/**
+		 * Nothing has been visited yet.
+		 */
+		START,
+
+		/**
+		 * Visiting the songs of the #TagIndex list
+		 * #indexed.
+		 */
+		INDEXED,
+
+		SONGS,
+		CHILDREN,
+		END,
+	} phase;
+
+	/**
+	 * The Directory::GetSerial() value which the pointers and
+	 * iterators below are valid for.
+	 */
+	unsigned serial;
+
+	/**
+	 * The directory specified by the #DatabaseSelection.
+	 */
+	const Directory *base;
+
+	const Directory *directory;
+
+	SongList::const_iterator next_song;
+	Directory::List::const_iterator next_child;
+
+	const TagIndex::SongVector *indexed;
+	size_t next_indexed;
+
+	/**
+	 * The URI of #directory and the name of the last visited
+	 * song (#Phase::SONGS) or child directory
+	 * (#Phase::CHILDREN), or an empty string if there is none.
+	 * They are set at the end of each portion by Save(), and
+	 * used by Restore().
+	 */
+	std::string directory_uri, last_name;
+
+public:
+	/**
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @param _base the directory specified by the selection;
+	 * must not be a mount point
+	 */
+	SimpleDatabaseCursor(const SimpleDatabase &_db,
+			     const DatabaseSelection &_selection,
+			     const Directory &_base);
+
+	/* virtual methods from class DatabaseCursor */
+	bool Visit(unsigned limit,
+		   VisitDirectory visit_directory,
+		   VisitSong visit_song,
+		   VisitPlaylist visit_playlist,
+		   bool &more_r, Error &error) override;
+
+private:
+	bool VisitSongs(unsigned &n, unsigned limit,
+			const VisitSong &visit_song, Error &error);
+
+	bool VisitIndexed(unsigned &n, unsigned limit,
+			  const VisitSong &visit_song, Error &error);
+
+	/**
+	 * Remember the position by name, for Restore().
+	 */
+	void Save();
+
+	/**
+	 * Look up the position saved by Save() in the modified tree.
+	 */
+	bool Restore(Error &error);
+};
+
+#endif
@@ -29,11 +29,19 @@
 #include "Song.hxx"
 #include "SongFilter.hxx"
 #include "DatabaseSave.hxx"
+#include "BinaryDatabase.hxx"
+#include "TagIndex.hxx"
+#include "SimpleCursor.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
+#include "tag/Set.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Settings.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
+#include "fs/io/MappedFile.hxx"
+#include "fs/io/FileReader.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
@@ -56,22 +64,24 @@ inline SimpleDatabase::SimpleDatabase()
 #ifdef ENABLE_ZLIB
 	 compress(true),
 #endif
+	 binary(false),
 	 cache_path(AllocatedPath::Null()),
-	 prefixed_light_song(nullptr) {}
+	 tag_index(nullptr), tag_index_serial(0), last_query_serial(0) {}
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef ENABLE_ZLIB
 				      gcc_unused
 #endif
-				      bool _compress)
+				      bool _compress, bool _binary)
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
+	 binary(_binary),
 	 cache_path(AllocatedPath::Null()),
-	 prefixed_light_song(nullptr) {
+	 tag_index(nullptr), tag_index_serial(0), last_query_serial(0) {
 }
 
 Database *
@@ -109,6 +119,15 @@ SimpleDatabase::Configure(const ConfigBlock &block, Error &error)
 	compress = block.GetBlockValue("compress", compress);
 #endif
 
+	const char *format = block.GetBlockValue("format", "text");
+	if (strcmp(format, "binary") == 0)
+		binary = true;
+	else if (strcmp(format, "text") != 0) {
+		error.Format(simple_db_domain,
+			     "Unrecognized database format: %s", format);
+		return false;
+	}
+
 	return true;
 }
 
@@ -176,31 +195,74 @@ SimpleDatabase::Check(Error &error) const
 	return true;
 }
 
+inline bool
+SimpleDatabase::LoadText(Error &error)
+{
+	TextFile file(path, error);
+	if (file.HasFailed())
+		return false;
+
+	return db_load_internal(file, *root, error) && file.Check(error);
+}
+
 bool
 SimpleDatabase::Load(Error &error)
 {
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path, error);
-	if (file.HasFailed())
-		return false;
+	bool is_binary;
+
+	{
+		/* peek at the magic with a plain read(); only a
+		   binary database gets mapped */
+		FileReader file(path, error);
+		if (!file.IsDefined())
+			return false;
 
-	if (!db_load_internal(file, *root, error) || !file.Check(error))
+		char magic[BINARY_DB_MAGIC_SIZE];
+		const size_t nbytes = file.Read(magic, sizeof(magic), error);
+		if (nbytes == 0 && error.IsDefined())
+			return false;
+
+		is_binary = db_is_binary({magic, nbytes});
+	}
+
+	if (is_binary) {
+		LogDebug(simple_db_domain, "reading binary DB");
+
+		const MappedFile file(path, error);
+		if (!file.IsDefined())
+			return false;
+
+		const ScopeDatabaseLock protect;
+		if (!db_load_binary(file.Get(), *root, error))
+			return false;
+	} else if (!LoadText(error))
 		return false;
 
 	FileInfo fi;
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
 
+	if (is_binary != binary) {
+		/* the "format" setting was changed: convert the
+		   database file right now */
+		FormatDefault(simple_db_domain,
+			      "converting database to %s format",
+			      binary ? "binary" : "text");
+
+		Error save_error;
+		if (!Save(save_error))
+			LogError(save_error, "Failed to save database");
+	}
+
 	return true;
 }
 
 bool
 SimpleDatabase::Open(Error &error)
 {
-	assert(prefixed_light_song == nullptr);
-
 	root = Directory::NewRoot();
 	mtime = 0;
 
@@ -227,40 +289,123 @@ void
 SimpleDatabase::Close()
 {
 	assert(root != nullptr);
-	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	DeleteTagIndex();
 	delete root;
 }
 
+void
+SimpleDatabase::DeleteTagIndex() const
+{
+	delete tag_index;
+	tag_index = nullptr;
+}
+
+const TagIndex *
+SimpleDatabase::GetTagIndex() const
+{
+	assert(holding_db_lock());
+
+	/* several readers may get here concurrently, because they
+	   only hold the shared database lock */
+	const ScopeLock protect(tag_index_mutex);
+
+	const unsigned serial = Directory::GetSerial();
+	if (tag_index != nullptr) {
+		if (tag_index_serial == serial)
+			return tag_index;
+
+		DeleteTagIndex();
+	}
+
+	if (serial != last_query_serial) {
+		/* the tree has been modified since the last query;
+		   don't build the index yet, because the update may
+		   still be in progress */
+		last_query_serial = serial;
+		return nullptr;
+	}
+
+	LogDebug(simple_db_domain, "building tag index");
+	tag_index = new TagIndex(*root);
+	tag_index_serial = serial;
+	return tag_index;
+}
+
+const TagIndex::SongVector *
+SimpleDatabase::FindIndexed(const SongFilter &filter) const
+{
+	const TagIndex *index = GetTagIndex();
+	if (index == nullptr || index->HasMounts())
+		return nullptr;
+
+	return index->Find(filter);
+}
+
+gcc_pure
+static bool
+IsInside(const Song &song, const Directory &directory, bool recursive)
+{
+	return recursive
+		? song.parent->IsInside(directory)
+		: song.parent == &directory;
+}
+
+static bool
+VisitSongs(const TagIndex::SongVector &songs,
+	   const Directory &directory, bool recursive,
+	   const SongFilter &filter, VisitSong visit_song, Error &error)
+{
+	for (const Song *song : songs) {
+		if (!IsInside(*song, directory, recursive))
+			continue;
+
+		const LightSong song2 = song->Export();
+		if (filter.Match(song2) && !visit_song(song2, error))
+			return false;
+	}
+
+	return true;
+}
+
 const LightSong *
 SimpleDatabase::GetSong(const char *uri, Error &error) const
 {
 	assert(root != nullptr);
-	assert(prefixed_light_song == nullptr);
-	assert(borrowed_song_count == 0);
 
-	db_lock();
+	db_lock_shared();
 
 	auto r = root->LookupDirectory(uri);
 
 	if (r.directory->IsMount()) {
-		/* pass the request to the mounted database */
-		db_unlock();
-
-		const LightSong *song =
-			r.directory->mounted_database->GetSong(r.uri, error);
-		if (song == nullptr)
+		/* pass the request to the mounted database; the pin
+		   keeps it alive until ReturnSong() */
+		r.directory->PinMount();
+		db_unlock_shared();
+
+		const Database &mounted = *r.directory->mounted_database;
+		const LightSong *song = mounted.GetSong(r.uri, error);
+		if (song == nullptr) {
+			r.directory->UnpinMount();
 			return nullptr;
+		}
+
+		auto *prefixed =
+			new PrefixedLightSong(*song, r.directory->GetPath(),
+					      *r.directory);
+		mounted.ReturnSong(song);
+
+#ifndef NDEBUG
+		++borrowed_song_count;
+#endif
 
-		prefixed_light_song =
-			new PrefixedLightSong(*song, r.directory->GetPath());
-		return prefixed_light_song;
+		return prefixed;
 	}
 
 	if (r.uri == nullptr) {
 		/* it's a directory */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
@@ -268,44 +413,45 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 
 	if (strchr(r.uri, '/') != nullptr) {
 		/* refers to a URI "below" the actual song */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
 	const Song *song = r.directory->FindSong(r.uri);
-	db_unlock();
 	if (song == nullptr) {
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
-	light_song = song->Export();
+	/* each call gets its own copy, because GetSong() may be
+	   called by several threads at a time */
+	auto *light_song = new PrefixedLightSong(song->Export());
+	db_unlock_shared();
 
 #ifndef NDEBUG
 	++borrowed_song_count;
 #endif
 
-	return &light_song;
+	return light_song;
 }
 
 void
-SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const
+SimpleDatabase::ReturnSong(const LightSong *song) const
 {
 	assert(song != nullptr);
-	assert(song == &light_song || song == prefixed_light_song);
-
-	delete prefixed_light_song;
-	prefixed_light_song = nullptr;
 
 #ifndef NDEBUG
-	if (song == &light_song) {
-		assert(borrowed_song_count > 0);
-		--borrowed_song_count;
-	}
+	assert(borrowed_song_count > 0);
+	--borrowed_song_count;
 #endif
+
+	/* all songs returned by GetSong() are PrefixedLightSong
+	   instances */
+	delete static_cast<const PrefixedLightSong *>(song);
 }
 
 bool
@@ -315,7 +461,7 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitPlaylist visit_playlist,
 		      Error &error) const
 {
-	ScopeDatabaseLock protect;
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 	if (r.uri == nullptr) {
@@ -325,6 +471,16 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		    !visit_directory(r.directory->Export(), error))
 			return false;
 
+		if (selection.filter != nullptr && visit_song &&
+		    !visit_directory && !visit_playlist) {
+			const auto *songs = FindIndexed(*selection.filter);
+			if (songs != nullptr)
+				return VisitSongs(*songs, *r.directory,
+						  selection.recursive,
+						  *selection.filter,
+						  visit_song, error);
+		}
+
 		return r.directory->Walk(selection.recursive, selection.filter,
 					 visit_directory, visit_song,
 					 visit_playlist,
@@ -346,15 +502,71 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	return false;
 }
 
+DatabaseCursor *
+SimpleDatabase::OpenCursor(const DatabaseSelection &selection) const
+{
+	if (!selection.recursive)
+		/* not worth it */
+		return nullptr;
+
+	ScopeDatabaseSharedLock protect;
+
+	auto r = root->LookupDirectory(selection.uri.c_str());
+	if (r.uri != nullptr || r.directory->IsMount())
+		/* a song, a mount point or something inside a
+		   mounted database: use Visit() */
+		return nullptr;
+
+	return new SimpleDatabaseCursor(*this, selection, *r.directory);
+}
+
+bool
+SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
+				  TagType tag_type, tag_mask_t group_mask,
+				  TagSet &set) const
+{
+	if (!selection.IsEmpty() || group_mask != 0 ||
+	    (tag_type == TAG_ALBUM_ARTIST && !IsTagEnabled(TAG_ALBUM_ARTIST)))
+		return false;
+
+	ScopeDatabaseSharedLock protect;
+
+	const TagIndex *index = GetTagIndex();
+	if (index == nullptr || index->HasMounts())
+		return false;
+
+	index->ForEachValue(tag_type, [&set, tag_type](const char *value){
+			TagBuilder builder;
+			builder.AddItem(tag_type, value);
+			set.insert(builder.Commit());
+		});
+
+	if (index->HasMissing(tag_type)) {
+		TagBuilder builder;
+		builder.AddEmptyItem(tag_type);
+		set.insert(builder.Commit());
+	}
+
+	return true;
+}
+
 bool
 SimpleDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 				TagType tag_type, tag_mask_t group_mask,
 				VisitTag visit_tag,
 				Error &error) const
 {
-	return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
-				 visit_tag,
-				 error);
+	TagSet set;
+	if (!CollectUniqueTags(selection, tag_type, group_mask, set))
+		return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
+					 visit_tag,
+					 error);
+
+	for (const auto &value : set)
+		if (!visit_tag(value, error))
+			return false;
+
+	return true;
 }
 
 bool
@@ -383,6 +595,25 @@ SimpleDatabase::Save(Error &error)
 	if (!fos.IsDefined())
 		return false;
 
+	if (binary) {
+		if (!db_save_binary(fos, *root, error))
+			return false;
+	} else if (!SaveText(fos, error))
+		return false;
+
+	if (!fos.Commit(error))
+		return false;
+
+	FileInfo fi;
+	if (GetFileInfo(path, fi))
+		mtime = fi.GetModificationTime();
+
+	return true;
+}
+
+inline bool
+SimpleDatabase::SaveText(OutputStream &fos, Error &error)
+{
 	OutputStream *os = &fos;
 
 #ifdef ENABLE_ZLIB
@@ -418,13 +649,6 @@ SimpleDatabase::Save(Error &error)
 	}
 #endif
 
-	if (!fos.Commit(error))
-		return false;
-
-	FileInfo fi;
-	if (GetFileInfo(path, fi))
-		mtime = fi.GetModificationTime();
-
 	return true;
 }
 
@@ -492,7 +716,7 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri,
 #endif
 	auto db = new SimpleDatabase(AllocatedPath::Build(cache_path,
 							  name_fs.c_str()),
-				     compress);
+				     compress, binary);
 	if (!db->Open(error)) {
 		delete db;
 		return false;
@@ -512,16 +736,26 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri,
 Database *
 SimpleDatabase::LockUmountSteal(const char *uri)
 {
-	ScopeDatabaseLock protect;
+	Directory::LookupResult r;
 
-	auto r = root->LookupDirectory(uri);
-	if (r.uri != nullptr || !r.directory->IsMount())
-		return nullptr;
+	do {
+		db_lock();
+
+		r = root->LookupDirectory(uri);
+		if (r.uri != nullptr || !r.directory->IsMount()) {
+			db_unlock();
+			return nullptr;
+		}
+
+		/* a client thread may be visiting the mounted
+		   database without holding the lock */
+	} while (!r.directory->WaitMountUnpinned());
 
 	Database *db = r.directory->mounted_database;
 	r.directory->mounted_database = nullptr;
 	r.directory->Delete();
 
+	db_unlock();
 	return db;
 }
 
@@ -539,6 +773,6 @@ SimpleDatabase::Unmount(const char *uri)
 
 const DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_THREAD_SAFE,
 	SimpleDatabase::Create,
 };
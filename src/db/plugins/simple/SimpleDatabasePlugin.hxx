@@ -24,8 +24,12 @@
 #include "db/Interface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "db/LightSong.hxx"
+#include "thread/Mutex.hxx"
 #include "Compiler.h"
 
+#include <atomic>
+#include <vector>
+
 #include <cassert>
 
 struct ConfigBlock;
@@ -33,9 +37,15 @@ struct Directory;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
-class PrefixedLightSong;
+class OutputStream;
+class SongFilter;
+struct Song;
+class TagSet;
+class TagIndex;
 
 class SimpleDatabase : public Database {
+	friend class SimpleDatabaseCursor;
+
 	AllocatedPath path;
 	std::string path_utf8;
 
@@ -43,6 +53,13 @@ class SimpleDatabase : public Database {
 	bool compress;
 #endif
 
+	/**
+	 * Write the database in the binary format (see
+	 * db_save_binary()) instead of the text format?  Both
+	 * formats can always be loaded.
+	 */
+	bool binary;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
@@ -53,23 +70,38 @@ class SimpleDatabase : public Database {
 	time_t mtime;
 
 	/**
-	 * A buffer for GetSong() when prefixing the #LightSong
-	 * instance from a mounted #Database.
+	 * Protects #tag_index and the serials.
 	 */
-	mutable PrefixedLightSong *prefixed_light_song;
+	mutable Mutex tag_index_mutex;
 
 	/**
-	 * A buffer for GetSong().
+	 * An inverted index of #root, built on demand by
+	 * GetTagIndex().  It is only valid as long as
+	 * Directory::GetSerial() equals #tag_index_serial.
 	 */
-	mutable LightSong light_song;
+	mutable TagIndex *tag_index;
+
+	mutable unsigned tag_index_serial;
+
+	/**
+	 * The Directory::GetSerial() value seen by the previous
+	 * GetTagIndex() call.  The index is only built if the tree
+	 * has not been modified since then; this avoids rebuilding
+	 * it for each query during a database update.
+	 */
+	mutable unsigned last_query_serial;
 
 #ifndef NDEBUG
-	mutable unsigned borrowed_song_count;
+	/**
+	 * The number of #LightSong instances returned by GetSong()
+	 * which have not yet been passed to ReturnSong().
+	 */
+	mutable std::atomic_uint borrowed_song_count;
 #endif
 
 	SimpleDatabase();
 
-	SimpleDatabase(AllocatedPath &&_path, bool _compress);
+	SimpleDatabase(AllocatedPath &&_path, bool _compress, bool _binary);
 
 public:
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
@@ -120,6 +152,9 @@ public:
 			   VisitPlaylist visit_playlist,
 			   Error &error) const override;
 
+	DatabaseCursor *OpenCursor(const DatabaseSelection &selection)
+		const override;
+
 	virtual bool VisitUniqueTags(const DatabaseSelection &selection,
 				     TagType tag_type, tag_mask_t group_mask,
 				     VisitTag visit_tag,
@@ -141,6 +176,41 @@ private:
 
 	bool Load(Error &error);
 
+	/**
+	 * Returns the #TagIndex, building it if necessary.  Returns
+	 * nullptr if the tree is currently being modified.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	const TagIndex *GetTagIndex() const;
+
+	void DeleteTagIndex() const;
+
+	/**
+	 * Use the #TagIndex to determine which songs need to be
+	 * checked against the given filter.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @return nullptr if the index cannot be used
+	 */
+	gcc_pure
+	const std::vector<const Song *> *FindIndexed(const SongFilter &filter) const;
+
+	/**
+	 * Attempt to answer a VisitUniqueTags() call with the
+	 * #TagIndex.
+	 *
+	 * @return false if the index cannot be used
+	 */
+	bool CollectUniqueTags(const DatabaseSelection &selection,
+			       TagType tag_type, tag_mask_t group_mask,
+			       TagSet &set) const;
+
+	bool LoadText(Error &error);
+
+	bool SaveText(OutputStream &os, Error &error);
+
 	Database *LockUmountSteal(const char *uri);
 };
 
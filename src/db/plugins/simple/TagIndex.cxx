@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongFilter.hxx"
+#include "db/DatabaseLock.hxx"
+#include "tag/Tag.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+TagIndex::TagIndex(const Directory &root)
+	:n_songs(0), has_mounts(false)
+{
+	assert(holding_db_lock());
+
+	std::fill_n(n_with_type, size_t(TAG_NUM_OF_ITEM_TYPES), 0u);
+
+	Add(root);
+}
+
+inline void
+TagIndex::Add(const Song &song, TagType type, const char *value)
+{
+	auto &v = maps[type][value];
+
+	/* a tag may contain the same value twice; list the song only
+	   once */
+	if (v.empty() || v.back() != &song)
+		v.push_back(&song);
+}
+
+inline void
+TagIndex::Add(const Song &song)
+{
+	bool present[TAG_NUM_OF_ITEM_TYPES];
+	std::fill_n(present, size_t(TAG_NUM_OF_ITEM_TYPES), false);
+
+	for (const auto &i : song.tag) {
+		Add(song, i.type, i.value);
+		present[i.type] = true;
+	}
+
+	if (!present[TAG_ALBUM_ARTIST] && present[TAG_ARTIST]) {
+		/* same fallback as in SongFilter::Item::Match():
+		   songs without "AlbumArtist" are found by their
+		   "Artist" */
+		for (const auto &i : song.tag)
+			if (i.type == TAG_ARTIST)
+				Add(song, TAG_ALBUM_ARTIST, i.value);
+
+		present[TAG_ALBUM_ARTIST] = true;
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (present[i])
+			++n_with_type[i];
+
+	++n_songs;
+}
+
+void
+TagIndex::Add(const Directory &directory)
+{
+	if (directory.IsMount()) {
+		has_mounts = true;
+		return;
+	}
+
+	/* same order as Directory::Walk() */
+
+	for (const auto &song : directory.songs)
+		Add(song);
+
+	for (const auto &child : directory.children)
+		Add(child);
+}
+
+const TagIndex::SongVector *
+TagIndex::Find(const SongFilter &filter) const
+{
+	const SongVector *result = nullptr;
+
+	for (const auto &item : filter.GetItems()) {
+		const unsigned tag = item.GetTag();
+		const char *value = item.GetValue();
+
+		/* only exact matches on one tag type can be looked
+		   up; an empty value matches songs which don't have
+		   this tag at all */
+		if (tag >= TAG_NUM_OF_ITEM_TYPES || item.GetFoldCase() ||
+		    *value == 0)
+			continue;
+
+		const auto i = maps[tag].find(value);
+		if (i == maps[tag].end())
+			return &empty;
+
+		if (result == nullptr || i->second.size() < result->size())
+			result = &i->second;
+	}
+
+	return result;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "check.h"
+#include "tag/TagType.h"
+#include "Compiler.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <string.h>
+
+struct Directory;
+struct Song;
+class SongFilter;
+
+/**
+ * An inverted index of all songs in a #Directory tree: for each tag
+ * type, it maps each value to the list of songs which have it.  The
+ * lists are in the order of Directory::Walk(), so using them does not
+ * change the order of search results.
+ *
+ * The index is not updated incrementally; it is a snapshot which
+ * must be discarded as soon as the tree is modified (see
+ * Directory::GetSerial()).
+ */
+class TagIndex {
+public:
+	typedef std::vector<const Song *> SongVector;
+
+private:
+	struct StringHash {
+		gcc_pure
+		size_t operator()(const char *p) const {
+			size_t hash = 5381;
+			while (*p != 0)
+				hash = (hash << 5) + hash + (unsigned char)*p++;
+			return hash;
+		}
+	};
+
+	struct StringEqual {
+		gcc_pure
+		bool operator()(const char *a, const char *b) const {
+			return strcmp(a, b) == 0;
+		}
+	};
+
+	/**
+	 * The keys point into the #TagItem objects owned by the
+	 * indexed songs.
+	 */
+	typedef std::unordered_map<const char *, SongVector,
+				   StringHash, StringEqual> Map;
+
+	Map maps[TAG_NUM_OF_ITEM_TYPES];
+
+	/**
+	 * The number of songs which have at least one value of the
+	 * given type.
+	 */
+	unsigned n_with_type[TAG_NUM_OF_ITEM_TYPES];
+
+	unsigned n_songs;
+
+	/**
+	 * Does the tree contain mount points?  Their songs are not
+	 * indexed.
+	 */
+	bool has_mounts;
+
+	/**
+	 * Returned by Find() if there are no matches.
+	 */
+	const SongVector empty;
+
+public:
+	/**
+	 * Build the index.  Caller must lock the #db_mutex.
+	 */
+	explicit TagIndex(const Directory &root);
+
+	TagIndex(const TagIndex &) = delete;
+	TagIndex &operator=(const TagIndex &) = delete;
+
+	bool HasMounts() const {
+		return has_mounts;
+	}
+
+	/**
+	 * Are there songs without a value of the given type?
+	 */
+	bool HasMissing(TagType type) const {
+		return n_with_type[type] < n_songs;
+	}
+
+	/**
+	 * Determine the shortest list of songs which is a superset
+	 * of the songs matched by the given filter.
+	 *
+	 * @return nullptr if none of the filter items can be
+	 * answered by the index
+	 */
+	gcc_pure
+	const SongVector *Find(const SongFilter &filter) const;
+
+	template<typename F>
+	void ForEachValue(TagType type, F &&f) const {
+		for (const auto &i : maps[type])
+			if (!i.second.empty())
+				f(i.first);
+	}
+
+private:
+	void Add(const Song &song, TagType type, const char *value);
+	void Add(const Song &song);
+	void Add(const Directory &directory);
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "ScanPool.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+UpdateScanPool::UpdateScanPool(Storage &_storage, unsigned _n_threads)
+	:storage(_storage),
+	 n_threads(_n_threads), max_in_flight(_n_threads * 4),
+	 threads(new Thread[_n_threads]), n_started(0),
+	 n_running(0), quit(false)
+{
+	assert(n_threads > 0);
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		Error error;
+		if (!threads[i].Start(Run, this, error)) {
+			LogError(error, "Failed to start update worker");
+			break;
+		}
+
+		++n_started;
+	}
+}
+
+UpdateScanPool::~UpdateScanPool()
+{
+	mutex.lock();
+	quit = true;
+	work_cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_started; ++i)
+		threads[i].Join();
+
+	/* the walker is supposed to collect all jobs before
+	   destroying the pool */
+	assert(pending.empty());
+	assert(finished.empty());
+}
+
+inline void
+UpdateScanPool::Scan(UpdateScanJob &job)
+{
+	job.new_song = Song::LoadFile(storage, job.name.c_str(),
+				      job.directory);
+}
+
+void
+UpdateScanPool::Submit(Directory &directory, const char *name,
+		       Song *old_song)
+{
+	if (n_started == 0) {
+		/* no worker thread could be started: scan in the
+		   calling thread */
+		UpdateScanJobList tmp;
+		tmp.emplace_back(directory, name, old_song);
+		Scan(tmp.front());
+
+		const ScopeLock protect(mutex);
+		finished.splice(finished.end(), tmp);
+		return;
+	}
+
+	const ScopeLock protect(mutex);
+
+	while (pending.size() + n_running >= max_in_flight)
+		done_cond.wait(mutex);
+
+	pending.emplace_back(directory, name, old_song);
+	work_cond.signal();
+}
+
+void
+UpdateScanPool::TakeFinished(UpdateScanJobList &dest, size_t min)
+{
+	const ScopeLock protect(mutex);
+
+	if (finished.size() >= min)
+		dest.splice(dest.end(), finished);
+}
+
+void
+UpdateScanPool::WaitAll(UpdateScanJobList &dest)
+{
+	const ScopeLock protect(mutex);
+
+	while (!pending.empty() || n_running > 0)
+		done_cond.wait(mutex);
+
+	dest.splice(dest.end(), finished);
+}
+
+void
+UpdateScanPool::Cancel(UpdateScanJobList &dest)
+{
+	const ScopeLock protect(mutex);
+
+	pending.clear();
+
+	while (n_running > 0)
+		done_cond.wait(mutex);
+
+	dest.splice(dest.end(), finished);
+}
+
+inline void
+UpdateScanPool::Run()
+{
+	SetThreadName("update");
+	SetThreadIdlePriority();
+
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		if (pending.empty()) {
+			if (quit)
+				break;
+
+			work_cond.wait(mutex);
+			continue;
+		}
+
+		/* move the job out of the "pending" list, so Cancel()
+		   cannot discard it while we're working on it */
+		UpdateScanJobList tmp;
+		tmp.splice(tmp.end(), pending, pending.begin());
+		++n_running;
+
+		mutex.unlock();
+		Scan(tmp.front());
+		mutex.lock();
+
+		--n_running;
+		finished.splice(finished.end(), tmp);
+		done_cond.broadcast();
+	}
+}
+
+void
+UpdateScanPool::Run(void *ctx)
+{
+	UpdateScanPool &pool = *(UpdateScanPool *)ctx;
+	pool.Run();
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_SCAN_POOL_HXX
+#define MPD_UPDATE_SCAN_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <list>
+#include <memory>
+
+struct Directory;
+struct Song;
+class Storage;
+
+/**
+ * A request to read the tags of one song file, submitted by
+ * #UpdateWalk to the #UpdateScanPool.
+ */
+struct UpdateScanJob {
+	Directory &directory;
+
+	/**
+	 * The file name relative to #directory.
+	 */
+	std::string name;
+
+	/**
+	 * The existing #Song object which shall be refreshed, or
+	 * nullptr if this is a new song.  The worker does not touch
+	 * it; it is only passed back to the walker.
+	 */
+	Song *old_song;
+
+	/**
+	 * The result: a new #Song object which has not yet been
+	 * added to #directory, or nullptr if no decoder plugin
+	 * recognized the file.
+	 */
+	Song *new_song;
+
+	UpdateScanJob(Directory &_directory, const char *_name,
+		      Song *_old_song)
+		:directory(_directory), name(_name),
+		 old_song(_old_song), new_song(nullptr) {}
+};
+
+typedef std::list<UpdateScanJob> UpdateScanJobList;
+
+/**
+ * A pool of worker threads which load song tags on behalf of the
+ * update thread.  Tag scanning is the most expensive part of a
+ * database update, because every file must be opened and parsed;
+ * on high-latency storage, running several scans at a time hides
+ * most of that latency.
+ *
+ * The workers never touch the #Directory tree.  Finished jobs are
+ * collected by the update thread with TakeFinished(), which then
+ * commits them in one batch while holding the #db_mutex.
+ */
+class UpdateScanPool final {
+	Storage &storage;
+
+	const unsigned n_threads;
+
+	/**
+	 * The maximum number of jobs which may be queued or running
+	 * at a time.  Submit() blocks while this is exceeded.
+	 */
+	const unsigned max_in_flight;
+
+	std::unique_ptr<Thread[]> threads;
+
+	/**
+	 * The number of threads which were started successfully.
+	 */
+	unsigned n_started;
+
+	/**
+	 * Protects all attributes below.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled when a new job has been queued or when the
+	 * workers shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Signalled when a job has been finished.
+	 */
+	Cond done_cond;
+
+	UpdateScanJobList pending, finished;
+
+	unsigned n_running;
+
+	bool quit;
+
+public:
+	/**
+	 * @param n_threads the number of worker threads; must be
+	 * positive
+	 */
+	UpdateScanPool(Storage &_storage, unsigned _n_threads);
+	~UpdateScanPool();
+
+	UpdateScanPool(const UpdateScanPool &) = delete;
+	UpdateScanPool &operator=(const UpdateScanPool &) = delete;
+
+	/**
+	 * Queue a new job.  Blocks while too many jobs are in flight.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void Submit(Directory &directory, const char *name, Song *old_song);
+
+	/**
+	 * Move finished jobs to the given list.
+	 *
+	 * @param min the minimum number of finished jobs; if fewer
+	 * are available, nothing is returned
+	 */
+	void TakeFinished(UpdateScanJobList &dest, size_t min);
+
+	/**
+	 * Wait until all queued jobs have been finished, and move
+	 * them to the given list.
+	 */
+	void WaitAll(UpdateScanJobList &dest);
+
+	/**
+	 * Discard all jobs which have not been started yet, wait for
+	 * the running ones and move them to the given list.
+	 */
+	void Cancel(UpdateScanJobList &dest);
+
+private:
+	void Scan(UpdateScanJob &job);
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
@@ -80,9 +80,9 @@ UpdateService::CancelMount(const char *uri)
 	/* determine which (mounted) database will be updated and what
 	   storage will be scanned */
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(uri);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!lr.directory->IsMount())
 		return;
@@ -188,9 +188,9 @@ UpdateService::Enqueue(const char *path, bool discard)
 	SimpleDatabase *db2;
 	Storage *storage2;
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(path);
-	db_unlock();
+	db_unlock_shared();
 	if (lr.directory->IsMount()) {
 		/* follow the mountpoint, update the mounted
 		   database */
@@ -35,9 +35,9 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 			    const char *name, const char *suffix,
 			    const StorageFileInfo &info)
 {
-	db_lock();
+	db_lock_shared();
 	Song *song = directory.FindSong(name);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!directory_child_access(storage, directory, name, R_OK)) {
 		FormatError(update_domain,
@@ -61,6 +61,13 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
 			    directory.GetPath(), name);
+
+		if (scan_pool) {
+			scan_pool->Submit(directory, name, nullptr);
+			CommitFinishedScans(SCAN_COMMIT_BATCH);
+			return;
+		}
+
 		song = Song::LoadFile(storage, name, directory);
 		if (song == nullptr) {
 			FormatDebug(update_domain,
@@ -79,15 +86,87 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FormatDefault(update_domain, "updating %s/%s",
 			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
+
+		if (scan_pool) {
+			scan_pool->Submit(directory, name, song);
+			CommitFinishedScans(SCAN_COMMIT_BATCH);
+			return;
+		}
+
+		/* scan into a new Song object without holding the
+		   lock; CommitScanJobs() moves its tag into the
+		   existing one and invalidates the tag index in the
+		   same critical section, so readers never see freed
+		   tag items */
+		UpdateScanJobList jobs;
+		jobs.emplace_back(directory, name, song);
+		jobs.front().new_song = Song::LoadFile(storage, name,
+						       directory);
+		CommitScanJobs(jobs);
+	}
+}
+
+void
+UpdateWalk::CommitScanJobs(UpdateScanJobList &jobs)
+{
+	if (jobs.empty())
+		return;
+
+	db_lock();
+
+	for (auto &job : jobs) {
+		Directory &directory = job.directory;
+		const char *name = job.name.c_str();
+
+		if (job.old_song == nullptr) {
+			if (job.new_song == nullptr) {
+				FormatDebug(update_domain,
+					    "ignoring unrecognized file %s/%s",
+					    directory.GetPath(), name);
+				continue;
+			}
+
+			directory.AddSong(job.new_song);
+			FormatDefault(update_domain, "added %s/%s",
+				      directory.GetPath(), name);
+		} else if (job.new_song == nullptr) {
 			FormatDebug(update_domain,
 				    "deleting unrecognized file %s/%s",
 				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
+			editor.DeleteSong(directory, job.old_song);
+		} else {
+			Song &song = *job.old_song;
+			song.tag = std::move(job.new_song->tag);
+			song.mtime = job.new_song->mtime;
+			job.new_song->Free();
+			Directory::MarkModified();
 		}
 
 		modified = true;
 	}
+
+	db_unlock();
+
+	jobs.clear();
+}
+
+void
+UpdateWalk::CommitFinishedScans(size_t min)
+{
+	UpdateScanJobList jobs;
+	scan_pool->TakeFinished(jobs, min);
+	CommitScanJobs(jobs);
+}
+
+void
+UpdateWalk::FlushScanPool()
+{
+	UpdateScanJobList jobs;
+	if (cancel)
+		scan_pool->Cancel(jobs);
+	else
+		scan_pool->WaitAll(jobs);
+	CommitScanJobs(jobs);
 }
 
 bool
@@ -64,6 +64,11 @@ UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
 		config_get_bool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 				DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
 #endif
+
+	const unsigned n_threads =
+		config_get_unsigned(ConfigOption::UPDATE_THREADS, 0);
+	if (n_threads > 0)
+		scan_pool.reset(new UpdateScanPool(storage, n_threads));
 }
 
 static void
@@ -384,6 +389,11 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 
 	directory.mtime = info.mtime;
 
+	if (scan_pool)
+		/* make the songs of this directory visible without
+		   waiting for the next full batch */
+		CommitFinishedScans(1);
+
 	return true;
 }
 
@@ -392,9 +402,9 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 				      const char *uri_utf8,
 				      const char *name_utf8)
 {
-	db_lock();
+	db_lock_shared();
 	Directory *directory = parent.FindChild(name_utf8);
-	db_unlock();
+	db_unlock_shared();
 
 	if (directory != nullptr) {
 		if (directory->IsMount())
@@ -494,5 +504,8 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 		UpdateDirectory(root, exclude_list, info);
 	}
 
+	if (scan_pool)
+		FlushScanPool();
+
 	return modified;
 }
@@ -22,8 +22,11 @@
 
 #include "check.h"
 #include "Editor.hxx"
+#include "ScanPool.hxx"
 #include "Compiler.h"
 
+#include <memory>
+
 #include <sys/stat.h>
 
 struct stat;
@@ -38,6 +41,12 @@ class UpdateWalk final {
 	friend class UpdateArchiveVisitor;
 #endif
 
+	/**
+	 * Finished #UpdateScanPool jobs are committed to the
+	 * database as soon as this many are available.
+	 */
+	static constexpr size_t SCAN_COMMIT_BATCH = 64;
+
 #ifndef WIN32
 	static constexpr bool DEFAULT_FOLLOW_INSIDE_SYMLINKS = true;
 	static constexpr bool DEFAULT_FOLLOW_OUTSIDE_SYMLINKS = true;
@@ -60,6 +69,13 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	/**
+	 * The worker threads which load song tags.  This is nullptr
+	 * if the "update_threads" setting is 0, and tags are loaded
+	 * in the update thread.
+	 */
+	std::unique_ptr<UpdateScanPool> scan_pool;
+
 public:
 	UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
 		   Storage &_storage);
@@ -87,6 +103,25 @@ private:
 
 	void PurgeDeletedFromDirectory(Directory &directory);
 
+	/**
+	 * Add or refresh the songs loaded by the #UpdateScanPool
+	 * and clear the list.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void CommitScanJobs(UpdateScanJobList &jobs);
+
+	/**
+	 * Commit finished #UpdateScanPool jobs, but only if there
+	 * are at least the given number of them.
+	 */
+	void CommitFinishedScans(size_t min);
+
+	/**
+	 * Wait for all #UpdateScanPool jobs and commit them.
+	 */
+	void FlushScanPool();
+
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
 			     const StorageFileInfo &info);
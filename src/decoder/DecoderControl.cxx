@@ -21,11 +21,13 @@
 #include "DecoderControl.hxx"
 #include "MusicPipe.hxx"
 #include "DetachedSong.hxx"
+#include "util/UriUtil.hxx"
 
 #include <assert.h>
 
 DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond)
 	:mutex(_mutex), client_cond(_client_cond),
+	 prefetch(_mutex, cond),
 	 state(DecoderState::STOP),
 	 command(DecoderCommand::NONE),
 	 client_is_waiting(false),
@@ -129,6 +131,18 @@ DecoderControl::Quit()
 	LockAsynchronousCommand(DecoderCommand::STOP);
 
 	thread.Join();
+
+	prefetch.Quit();
+}
+
+void
+DecoderControl::Prefetch(const DetachedSong &next_song)
+{
+	const char *uri = next_song.GetRealURI();
+	if (uri_has_scheme(uri))
+		prefetch.Request(uri);
+	else
+		prefetch.Cancel();
 }
 
 void
@@ -21,6 +21,7 @@
 #define MPD_DECODER_CONTROL_HXX
 
 #include "DecoderCommand.hxx"
+#include "DecoderPrefetch.hxx"
 #include "AudioFormat.hxx"
 #include "MixRampInfo.hxx"
 #include "thread/Mutex.hxx"
@@ -86,6 +87,12 @@ struct DecoderControl {
 	 */
 	Cond &client_cond;
 
+	/**
+	 * Opens the stream of the next song in advance.  See
+	 * Prefetch().
+	 */
+	DecoderPrefetch prefetch;
+
 	DecoderState state;
 	DecoderCommand command;
 
@@ -369,6 +376,25 @@ public:
 
 	void Quit();
 
+	/**
+	 * Announce the song which will probably be decoded after the
+	 * current one.  Its remote input stream will be opened in
+	 * advance, see #DecoderPrefetch.  Local files are not
+	 * prefetched, because opening them is cheap.
+	 *
+	 * Caller must lock the object.
+	 */
+	void Prefetch(const DetachedSong &next_song);
+
+	/**
+	 * Discard the stream opened by Prefetch().
+	 *
+	 * Caller must lock the object.
+	 */
+	void CancelPrefetch() {
+		prefetch.Cancel();
+	}
+
 	const char *GetMixRampStart() const {
 		return mix_ramp.GetStart();
 	}
@@ -125,6 +125,14 @@ decoder_plugin_from_name(const char *name)
 		});
 }
 
+const struct DecoderPlugin *
+decoder_plugin_from_mime_type(const char *mime_type)
+{
+	return decoder_plugins_find([=](const DecoderPlugin &plugin){
+			return plugin.SupportsMimeType(mime_type);
+		});
+}
+
 void decoder_plugin_init_all(void)
 {
 	ConfigBlock empty;
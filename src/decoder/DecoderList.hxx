@@ -33,6 +33,14 @@ gcc_pure
 const struct DecoderPlugin *
 decoder_plugin_from_name(const char *name);
 
+/**
+ * Find the first enabled plugin which supports the specified MIME
+ * type.
+ */
+gcc_pure
+const struct DecoderPlugin *
+decoder_plugin_from_mime_type(const char *mime_type);
+
 /* this is where we "load" all the "plugins" ;-) */
 void
 decoder_plugin_init_all();
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderPluginCache.hxx"
+#include "DecoderList.hxx"
+#include "DecoderPlugin.hxx"
+#include "DecoderError.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/StringUtil.hxx"
+#include "Log.hxx"
+
+#include <map>
+#include <string>
+
+#include <string.h>
+
+#define DECODER_PLUGIN_STATE "decoder_plugin:"
+
+/**
+ * Don't remember more keys than this; stream URIs without a suffix
+ * would otherwise let the cache grow without bounds.
+ */
+static constexpr size_t MAX_KEYS = 1024;
+
+static Mutex decoder_plugin_cache_mutex;
+static std::map<std::string, const DecoderPlugin *> decoder_plugin_cache;
+static unsigned decoder_plugin_cache_version;
+
+const DecoderPlugin *
+decoder_plugin_cache_lookup(const char *key)
+{
+	const ScopeLock protect(decoder_plugin_cache_mutex);
+
+	auto i = decoder_plugin_cache.find(key);
+	return i != decoder_plugin_cache.end()
+		? i->second
+		: nullptr;
+}
+
+void
+decoder_plugin_cache_store(const char *key, const DecoderPlugin &plugin)
+{
+	if (strchr(key, '\n') != nullptr)
+		/* can't be stored in the state file */
+		return;
+
+	const ScopeLock protect(decoder_plugin_cache_mutex);
+
+	auto i = decoder_plugin_cache.find(key);
+	if (i != decoder_plugin_cache.end()) {
+		if (i->second == &plugin)
+			return;
+
+		i->second = &plugin;
+	} else {
+		if (decoder_plugin_cache.size() >= MAX_KEYS)
+			decoder_plugin_cache.clear();
+
+		decoder_plugin_cache.emplace(key, &plugin);
+	}
+
+	++decoder_plugin_cache_version;
+}
+
+bool
+decoder_plugin_cache_read(const char *line)
+{
+	if (!StringStartsWith(line, DECODER_PLUGIN_STATE))
+		return false;
+
+	line += sizeof(DECODER_PLUGIN_STATE) - 1;
+
+	const char *colon = strchr(line, ':');
+	if (colon == nullptr || colon == line || colon[1] == 0)
+		return false;
+
+	const std::string name(line, colon);
+	const DecoderPlugin *plugin = decoder_plugin_from_name(name.c_str());
+	if (plugin == nullptr) {
+		/* unknown or disabled */
+		FormatDebug(decoder_domain,
+			    "Ignoring cached decoder plugin '%s'",
+			    name.c_str());
+		return true;
+	}
+
+	const ScopeLock protect(decoder_plugin_cache_mutex);
+	if (decoder_plugin_cache.size() < MAX_KEYS)
+		decoder_plugin_cache[colon + 1] = plugin;
+	return true;
+}
+
+void
+decoder_plugin_cache_save(BufferedOutputStream &os)
+{
+	const ScopeLock protect(decoder_plugin_cache_mutex);
+
+	for (const auto &i : decoder_plugin_cache)
+		os.Format(DECODER_PLUGIN_STATE "%s:%s\n",
+			  i.second->name, i.first.c_str());
+}
+
+unsigned
+decoder_plugin_cache_get_version()
+{
+	const ScopeLock protect(decoder_plugin_cache_mutex);
+	return decoder_plugin_cache_version;
+}
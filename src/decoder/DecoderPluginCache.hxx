@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Remembers which decoder plugin has succeeded for a file type, so
+ * the next file of that type does not need to probe the plugins
+ * which failed.  The first plugin of the configured order is always
+ * tried first; the cache only decides which one comes next.  The
+ * cache is persisted in the state file.
+ *
+ */
+
+#ifndef MPD_DECODER_PLUGIN_CACHE_HXX
+#define MPD_DECODER_PLUGIN_CACHE_HXX
+
+#include "DecoderList.hxx"
+#include "Compiler.h"
+
+struct DecoderPlugin;
+class BufferedOutputStream;
+
+/**
+ * Determine the cache key for a file: its name suffix, or (for
+ * streams without a suffix) the URI itself.
+ */
+gcc_pure
+static inline const char *
+decoder_plugin_cache_key(const char *uri, const char *suffix)
+{
+	return suffix != nullptr ? suffix : uri;
+}
+
+/**
+ * Which (enabled) plugin has succeeded last for the given key?
+ *
+ * This function is thread-safe.
+ *
+ * @return the plugin or nullptr if the key is unknown
+ */
+gcc_pure
+const DecoderPlugin *
+decoder_plugin_cache_lookup(const char *key);
+
+/**
+ * Remember that the given plugin has succeeded for this key.
+ *
+ * This function is thread-safe.
+ */
+void
+decoder_plugin_cache_store(const char *key, const DecoderPlugin &plugin);
+
+/**
+ * Invoke #f for each enabled plugin accepted by #check, in the
+ * configured order, until it succeeds.  The #cached plugin (see
+ * decoder_plugin_cache_lookup()) is invoked right after the first
+ * one, instead of at its own position.
+ */
+template<typename C, typename F>
+static inline bool
+decoder_plugins_try_cached(const DecoderPlugin *cached, C check, F f)
+{
+	bool cached_tried = false;
+
+	return decoder_plugins_try([&](const DecoderPlugin &plugin){
+			if (!check(plugin))
+				return false;
+
+			if (&plugin == cached) {
+				if (cached_tried)
+					return false;
+
+				cached_tried = true;
+			}
+
+			if (f(plugin))
+				return true;
+
+			if (cached == nullptr || cached_tried)
+				return false;
+
+			cached_tried = true;
+			return f(*cached);
+		});
+}
+
+bool
+decoder_plugin_cache_read(const char *line);
+
+void
+decoder_plugin_cache_save(BufferedOutputStream &os);
+
+/**
+ * Generates a version number for the current state of the cache.
+ * This is used by the #StateFile to determine whether the state has
+ * changed and the state file should be saved.
+ */
+gcc_pure
+unsigned
+decoder_plugin_cache_get_version();
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderPrefetch.hxx"
+#include "DecoderError.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Name.hxx"
+#include "system/FatalError.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+DecoderPrefetch::DecoderPrefetch(Mutex &_mutex, Cond &_stream_cond)
+	:mutex(_mutex), stream_cond(_stream_cond),
+	 is(nullptr), quit(false) {}
+
+DecoderPrefetch::~DecoderPrefetch()
+{
+	assert(!thread.IsDefined());
+	assert(is == nullptr);
+}
+
+void
+DecoderPrefetch::Start()
+{
+	assert(!thread.IsDefined());
+
+	quit = false;
+
+	Error error;
+	if (!thread.Start(Run, this, error))
+		FatalError(error);
+}
+
+void
+DecoderPrefetch::Quit()
+{
+	assert(thread.IsDefined());
+
+	mutex.lock();
+	quit = true;
+	cond.signal();
+	mutex.unlock();
+
+	thread.Join();
+}
+
+void
+DecoderPrefetch::Request(const char *_uri)
+{
+	if (wanted_uri == _uri)
+		return;
+
+	wanted_uri = _uri;
+	cond.signal();
+}
+
+InputStream *
+DecoderPrefetch::Take(const char *_uri)
+{
+	if (wanted_uri == _uri)
+		/* the caller takes care of this URI now; don't
+		   prefetch it (again) */
+		wanted_uri.clear();
+
+	if (is == nullptr || uri != _uri)
+		return nullptr;
+
+	FormatDebug(decoder_domain, "using prefetched stream %s", _uri);
+
+	InputStream *result = is;
+	is = nullptr;
+	uri.clear();
+	return result;
+}
+
+inline void
+DecoderPrefetch::Run()
+{
+	mutex.lock();
+
+	while (!quit) {
+		if (is != nullptr && uri != wanted_uri) {
+			/* the prefetched stream is not wanted anymore;
+			   close it (without holding the mutex, because
+			   the stream may need it while shutting down) */
+			InputStream *old = is;
+			is = nullptr;
+			uri.clear();
+
+			mutex.unlock();
+			delete old;
+			mutex.lock();
+			continue;
+		}
+
+		if (is == nullptr && !wanted_uri.empty()) {
+			opening_uri = wanted_uri;
+			const std::string open_uri = opening_uri;
+
+			mutex.unlock();
+
+			Error error;
+			InputStream *new_is =
+				InputStream::Open(open_uri.c_str(),
+						  mutex, stream_cond, error);
+			if (new_is == nullptr && error.IsDefined())
+				FormatDebug(decoder_domain,
+					    "failed to prefetch %s: %s",
+					    open_uri.c_str(),
+					    error.GetMessage());
+
+			mutex.lock();
+
+			opening_uri.clear();
+
+			if (new_is != nullptr) {
+				is = new_is;
+				uri = open_uri;
+			} else if (wanted_uri == open_uri)
+				/* don't retry; the decoder thread will
+				   report the error */
+				wanted_uri.clear();
+
+			/* wake up the decoder thread if it waits for
+			   this stream */
+			stream_cond.broadcast();
+			continue;
+		}
+
+		cond.wait(mutex);
+	}
+
+	InputStream *old = is;
+	is = nullptr;
+	uri.clear();
+	wanted_uri.clear();
+
+	mutex.unlock();
+
+	delete old;
+}
+
+void
+DecoderPrefetch::Run(void *ctx)
+{
+	SetThreadName("prefetch");
+
+	DecoderPrefetch &prefetch = *(DecoderPrefetch *)ctx;
+	prefetch.Run();
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_PREFETCH_HXX
+#define MPD_DECODER_PREFETCH_HXX
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "Compiler.h"
+
+#include <string>
+
+class InputStream;
+
+/**
+ * Opens the #InputStream of the song which will be decoded next in a
+ * separate thread, while the decoder thread is still busy with the
+ * current song.  Remote streams (HTTP, NFS, SMB, ...) are then
+ * already connected and have begun buffering when the decoder
+ * switches to the next song.
+ *
+ * All methods except Start() and Quit() must be called while
+ * #mutex is locked.
+ */
+class DecoderPrefetch {
+	Thread thread;
+
+	/**
+	 * The #DecoderControl mutex; it protects all attributes of
+	 * this object, and it is passed to InputStream::Open().
+	 */
+	Mutex &mutex;
+
+	/**
+	 * The #DecoderControl cond; it is passed to
+	 * InputStream::Open(), and it is broadcast after a stream
+	 * has been opened.
+	 */
+	Cond &stream_cond;
+
+	/**
+	 * Wakes up the prefetch thread.
+	 */
+	Cond cond;
+
+	/**
+	 * The URI which shall be opened.  Empty if nothing is
+	 * wanted.
+	 */
+	std::string wanted_uri;
+
+	/**
+	 * The URI being opened by the prefetch thread right now.
+	 * Empty if the thread is idle.
+	 */
+	std::string opening_uri;
+
+	/**
+	 * The URI of #is.
+	 */
+	std::string uri;
+
+	/**
+	 * The prefetched stream (maybe not yet ready), or nullptr.
+	 */
+	InputStream *is;
+
+	bool quit;
+
+public:
+	DecoderPrefetch(Mutex &_mutex, Cond &_stream_cond);
+	~DecoderPrefetch();
+
+	DecoderPrefetch(const DecoderPrefetch &) = delete;
+	DecoderPrefetch &operator=(const DecoderPrefetch &) = delete;
+
+	/**
+	 * Start the prefetch thread.  Caller must not lock the
+	 * mutex.
+	 */
+	void Start();
+
+	/**
+	 * Stop the prefetch thread and close the prefetched stream.
+	 * Caller must not lock the mutex.
+	 */
+	void Quit();
+
+	/**
+	 * Ask the prefetch thread to open the given URI.  A stream
+	 * prefetched for another URI is closed.
+	 */
+	void Request(const char *_uri);
+
+	/**
+	 * Discard the prefetched stream (if any).
+	 */
+	void Cancel() {
+		Request("");
+	}
+
+	/**
+	 * Is the prefetch thread opening the given URI right now?
+	 * Then it is better to wait on the #DecoderControl cond
+	 * until it is done than to open it again.
+	 */
+	gcc_pure
+	bool IsOpening(const char *_uri) const {
+		return !opening_uri.empty() && opening_uri == _uri;
+	}
+
+	/**
+	 * Obtain the prefetched stream for the given URI, and cancel
+	 * a pending request for it.
+	 *
+	 * @return the stream (which may not be ready yet; the caller
+	 * becomes its owner) or nullptr if the URI was not
+	 * prefetched
+	 */
+	InputStream *Take(const char *_uri);
+
+private:
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
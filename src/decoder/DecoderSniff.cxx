@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderSniff.hxx"
+#include "fs/io/FileReader.hxx"
+#include "util/Error.hxx"
+
+#include <stdint.h>
+#include <string.h>
+
+gcc_pure
+static bool
+StartsWith(const uint8_t *data, size_t size, const char *magic,
+	   size_t offset=0)
+{
+	const size_t length = strlen(magic);
+	return size >= offset + length &&
+		memcmp(data + offset, magic, length) == 0;
+}
+
+/**
+ * Identify the codec in the first page of an Ogg stream.
+ */
+gcc_pure
+static const char *
+SniffOgg(const uint8_t *data, size_t size)
+{
+	/* the first page contains exactly one segment (the codec
+	   identification header) which starts at offset 28 */
+	if (size < 28 || data[26] != 1)
+		return nullptr;
+
+	if (StartsWith(data, size, "\x01vorbis", 28))
+		return "audio/x-vorbis+ogg";
+
+	if (StartsWith(data, size, "OpusHead", 28))
+		return "audio/opus";
+
+	if (StartsWith(data, size, "\x7f" "FLAC", 28))
+		return "audio/x-flac+ogg";
+
+	return nullptr;
+}
+
+/**
+ * Identify an MPEG audio or AAC/ADTS frame header.
+ */
+gcc_pure
+static const char *
+SniffFrameSync(const uint8_t *data, size_t size)
+{
+	if (size < 4 || data[0] != 0xff || (data[1] & 0xe0) != 0xe0)
+		return nullptr;
+
+	const unsigned layer = (data[1] >> 1) & 0x3;
+	if (layer == 0)
+		/* ADTS uses MPEG-2/4 sync with layer 0 */
+		return (data[1] & 0xf0) == 0xf0
+			? "audio/aac"
+			: nullptr;
+
+	const unsigned bitrate_index = data[2] >> 4;
+	const unsigned samplerate_index = (data[2] >> 2) & 0x3;
+	if (bitrate_index == 0xf || samplerate_index == 0x3 ||
+	    (data[1] & 0x18) == 0x08)
+		/* invalid header, probably random data */
+		return nullptr;
+
+	return "audio/mpeg";
+}
+
+const char *
+decoder_sniff_mime_type(const void *_data, size_t size)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+	if (size > DECODER_SNIFF_SIZE)
+		size = DECODER_SNIFF_SIZE;
+
+	if (StartsWith(data, size, "fLaC"))
+		return "audio/flac";
+
+	if (StartsWith(data, size, "OggS"))
+		return SniffOgg(data, size);
+
+	if (StartsWith(data, size, "RIFF") &&
+	    StartsWith(data, size, "WAVE", 8))
+		return "audio/x-wav";
+
+	if (StartsWith(data, size, "FORM") &&
+	    (StartsWith(data, size, "AIFF", 8) ||
+	     StartsWith(data, size, "AIFC", 8)))
+		return "audio/x-aiff";
+
+	if (StartsWith(data, size, "DSD "))
+		return "application/x-dsf";
+
+	if (StartsWith(data, size, "FRM8") &&
+	    StartsWith(data, size, "DSD ", 12))
+		return "application/x-dff";
+
+	if (StartsWith(data, size, "wvpk"))
+		return "audio/x-wavpack";
+
+	if (StartsWith(data, size, "ftyp", 4))
+		return "audio/mp4";
+
+	/* an ID3v2 tag may precede any format (MP3, AAC, FLAC, ...);
+	   it is too large to look behind it */
+	return SniffFrameSync(data, size);
+}
+
+const char *
+decoder_sniff_file_mime_type(Path path)
+{
+	FileReader reader(path, IgnoreError());
+	if (!reader.IsDefined())
+		return nullptr;
+
+	uint8_t buffer[DECODER_SNIFF_SIZE];
+	const size_t nbytes = reader.Read(buffer, sizeof(buffer),
+					  IgnoreError());
+	return decoder_sniff_mime_type(buffer, nbytes);
+}
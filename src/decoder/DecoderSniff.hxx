@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_SNIFF_HXX
+#define MPD_DECODER_SNIFF_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+
+class Path;
+
+/**
+ * How many bytes from the beginning of a file should be passed to
+ * decoder_sniff_mime_type()?
+ */
+static constexpr size_t DECODER_SNIFF_SIZE = 64;
+
+/**
+ * Determine the MIME type of a file from its first bytes ("magic
+ * numbers").  Only formats which can be identified reliably are
+ * recognized.
+ *
+ * @param data the beginning of the file
+ * @param size the number of bytes in #data; at most
+ * #DECODER_SNIFF_SIZE are evaluated
+ * @return a MIME type or nullptr if the format is unknown
+ */
+gcc_pure
+const char *
+decoder_sniff_mime_type(const void *data, size_t size);
+
+/**
+ * Read the beginning of the specified local file, and pass it to
+ * decoder_sniff_mime_type().
+ *
+ * @return a MIME type or nullptr if the format is unknown or the
+ * file could not be read
+ */
+gcc_pure
+const char *
+decoder_sniff_file_mime_type(Path path);
+
+#endif
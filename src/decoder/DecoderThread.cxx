@@ -32,6 +32,8 @@
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
 #include "DecoderList.hxx"
+#include "DecoderSniff.hxx"
+#include "DecoderPluginCache.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -60,10 +62,31 @@ decoder_command_finished_locked(DecoderControl &dc)
 }
 
 /**
- * Opens the input stream with InputStream::Open(), and waits until
- * the stream gets ready.  If a decoder STOP command is received
- * during that, it cancels the operation (but does not close the
- * stream).
+ * Obtains the stream which was opened in advance by
+ * #DecoderPrefetch.  If the prefetch thread is still opening it, wait
+ * for it to finish.
+ *
+ * Unlock the decoder before calling this function.
+ *
+ * @return the stream or nullptr if this URI was not prefetched
+ */
+static InputStream *
+decoder_take_prefetched(DecoderControl &dc, const char *uri)
+{
+	const ScopeLock protect(dc.mutex);
+
+	while (dc.prefetch.IsOpening(uri) &&
+	       dc.command != DecoderCommand::STOP)
+		dc.Wait();
+
+	return dc.prefetch.Take(uri);
+}
+
+/**
+ * Opens the input stream with InputStream::Open() (unless it has
+ * been prefetched), and waits until the stream gets ready.  If a
+ * decoder STOP command is received during that, it cancels the
+ * operation (but does not close the stream).
  *
  * Unlock the decoder before calling this function.
  *
@@ -75,7 +98,9 @@ decoder_input_stream_open(DecoderControl &dc, const char *uri)
 {
 	Error error;
 
-	InputStream *is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+	InputStream *is = decoder_take_prefetched(dc, uri);
+	if (is == nullptr)
+		is = InputStream::Open(uri, dc.mutex, dc.cond, error);
 	if (is == nullptr) {
 		if (error.IsDefined())
 			LogError(error);
@@ -220,31 +245,95 @@ decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
 		 decoder_check_plugin_suffix(plugin, suffix));
 }
 
-static bool
-decoder_run_stream_plugin(Decoder &decoder, InputStream &is,
-			  const char *suffix,
-			  const DecoderPlugin &plugin,
-			  bool &tried_r)
+/**
+ * Remember the plugin which has decoded the song, see
+ * decoder_plugin_cache_store().  Caller must lock the
+ * #DecoderControl object.
+ *
+ * @param key the cache key; nullptr if the plugin was determined by
+ * decoder_sniff_mime_type(), which works without the cache
+ */
+static void
+decoder_remember_plugin(const Decoder &decoder, const char *key,
+			const DecoderPlugin &plugin)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
-		return false;
+	if (key != nullptr && decoder.dc.state != DecoderState::START)
+		/* the plugin has really decoded something (and
+		   has not been skipped due to a STOP command) */
+		decoder_plugin_cache_store(key, plugin);
+}
+
+/**
+ * Determine the plugin from the first bytes of the stream, see
+ * decoder_sniff_mime_type().  The stream is not rewound; that is
+ * done before each plugin is invoked.
+ *
+ * Unlock the decoder before calling this function.
+ */
+static const DecoderPlugin *
+decoder_sniff_stream(Decoder &decoder, InputStream &is)
+{
+	uint8_t buffer[DECODER_SNIFF_SIZE];
+	size_t length = 0;
+
+	while (length < sizeof(buffer)) {
+		size_t nbytes = decoder_read(decoder, is, buffer + length,
+					     sizeof(buffer) - length);
+		if (nbytes == 0)
+			break;
 
-	tried_r = true;
-	return decoder_stream_decode(plugin, decoder, is);
+		length += nbytes;
+	}
+
+	const char *mime_type = decoder_sniff_mime_type(buffer, length);
+	return mime_type != nullptr
+		? decoder_plugin_from_mime_type(mime_type)
+		: nullptr;
 }
 
 static bool
 decoder_run_stream_locked(Decoder &decoder, InputStream &is,
-			  const char *uri, bool &tried_r)
+			  const char *uri, const DecoderPlugin *sniffed,
+			  bool &tried_r)
 {
 	UriSuffixBuffer suffix_buffer;
 	const char *const suffix = uri_get_suffix(uri, suffix_buffer);
+	const char *const key = decoder_plugin_cache_key(uri, suffix);
+
+	const auto run = [&decoder, &is,
+			  &tried_r](const DecoderPlugin &plugin,
+				    const char *remember_key){
+		tried_r = true;
+		if (!decoder_stream_decode(plugin, decoder, is))
+			return false;
+
+		decoder_remember_plugin(decoder, remember_key, plugin);
+		return true;
+	};
 
-	using namespace std::placeholders;
-	const auto f = std::bind(decoder_run_stream_plugin,
-				 std::ref(decoder), std::ref(is), suffix,
-				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+	/* first try the plugin determined from the stream contents;
+	   this skips MIME type and suffix checks, which may be
+	   missing or wrong */
+	if (sniffed != nullptr && sniffed->stream_decode != nullptr &&
+	    run(*sniffed, nullptr))
+		return true;
+
+	const DecoderPlugin *cached = decoder_plugin_cache_lookup(key);
+	if (cached == sniffed ||
+	    (cached != nullptr && cached->stream_decode == nullptr))
+		cached = nullptr;
+
+	const auto check = [&is, sniffed,
+			    suffix](const DecoderPlugin &plugin){
+		return &plugin != sniffed &&
+			decoder_check_plugin(plugin, is, suffix);
+	};
+
+	const auto run_key = [&run, key](const DecoderPlugin &plugin){
+		return run(plugin, key);
+	};
+
+	return decoder_plugins_try_cached(cached, check, run_key);
 }
 
 /**
@@ -276,12 +365,15 @@ decoder_run_stream(Decoder &decoder, const char *uri)
 		return false;
 	}
 
+	const DecoderPlugin *const sniffed =
+		decoder_sniff_stream(decoder, *input_stream);
+
 	dc.Lock();
 
 	bool tried = false;
 	const bool success = dc.command == DecoderCommand::STOP ||
 		decoder_run_stream_locked(decoder, *input_stream, uri,
-					  tried) ||
+					  sniffed, tried) ||
 		/* fallback to mp3: this is needed for bastard streams
 		   that don't have a suffix or set the mimeType */
 		(!tried &&
@@ -306,20 +398,28 @@ decoder_load_replay_gain(Decoder &decoder, Path path_fs)
 		decoder_replay_gain(decoder, &info);
 }
 
+/**
+ * Decode a file with the given plugin, and remember it on success.
+ *
+ * Unlock the decoder before calling this function.
+ *
+ * @param key see decoder_remember_plugin()
+ * @return true with the decoder locked on success, false with the
+ * decoder unlocked on failure
+ */
 static bool
-TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
+TryDecoderFile(Decoder &decoder, Path path_fs, const char *key,
 	       const DecoderPlugin &plugin)
 {
-	if (!plugin.SupportsSuffix(suffix))
-		return false;
-
 	DecoderControl &dc = decoder.dc;
 
 	if (plugin.file_decode != nullptr) {
 		dc.Lock();
 
-		if (decoder_file_decode(plugin, decoder, path_fs))
+		if (decoder_file_decode(plugin, decoder, path_fs)) {
+			decoder_remember_plugin(decoder, key, plugin);
 			return true;
+		}
 
 		dc.Unlock();
 	} else if (plugin.stream_decode != nullptr) {
@@ -332,6 +432,8 @@ TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
 
 		bool success = decoder_stream_decode(plugin, decoder,
 						     *input_stream);
+		if (success)
+			decoder_remember_plugin(decoder, key, plugin);
 
 		dc.Unlock();
 
@@ -361,12 +463,30 @@ decoder_run_file(Decoder &decoder, const char *uri_utf8, Path path_fs)
 
 	decoder_load_replay_gain(decoder, path_fs);
 
-	if (decoder_plugins_try([&decoder, path_fs,
-				 suffix](const DecoderPlugin &plugin){
-				return TryDecoderFile(decoder,
-						      path_fs, suffix,
-						      plugin);
-			}))
+	/* first try the plugin determined from the file contents */
+	const char *mime_type = decoder_sniff_file_mime_type(path_fs);
+	const DecoderPlugin *const sniffed = mime_type != nullptr
+		? decoder_plugin_from_mime_type(mime_type)
+		: nullptr;
+
+	if (sniffed != nullptr &&
+	    TryDecoderFile(decoder, path_fs, nullptr, *sniffed))
+		return true;
+
+	const DecoderPlugin *cached = decoder_plugin_cache_lookup(suffix);
+	if (cached == sniffed)
+		cached = nullptr;
+
+	const auto check = [sniffed, suffix](const DecoderPlugin &plugin){
+		return &plugin != sniffed && plugin.SupportsSuffix(suffix);
+	};
+
+	const auto run = [&decoder, path_fs,
+			  suffix](const DecoderPlugin &plugin){
+		return TryDecoderFile(decoder, path_fs, suffix, plugin);
+	};
+
+	if (decoder_plugins_try_cached(cached, check, run))
 		return true;
 
 	dc.Lock();
@@ -507,4 +627,6 @@ decoder_thread_start(DecoderControl &dc)
 	Error error;
 	if (!dc.thread.Start(decoder_task, &dc, error))
 		FatalError(error);
+
+	dc.prefetch.Start();
 }
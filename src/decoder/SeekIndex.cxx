@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SeekIndex.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/StringUtil.hxx"
+#include "util/Domain.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr Domain seek_index_domain("seek_index");
+
+#define SEEK_INDEX_BEGIN "index: "
+#define SEEK_INDEX_END "end"
+
+/**
+ * Don't remember more files than this; when the cache is full, the
+ * least recently used index is discarded.
+ */
+static constexpr size_t MAX_FILES = 1024;
+
+const SeekIndex::Point *
+SeekIndex::Find(uint64_t position) const
+{
+	auto i = std::upper_bound(points.begin(), points.end(), position,
+				  [](uint64_t p, const Point &point){
+					  return p < point.position;
+				  });
+	if (i == points.begin())
+		return nullptr;
+
+	return &*std::prev(i);
+}
+
+struct SeekIndexEntry {
+	std::string plugin;
+	offset_type size;
+	time_t mtime;
+	SeekIndex index;
+
+	/**
+	 * The value of #seek_index_clock when this entry was used
+	 * last.
+	 */
+	unsigned last_used;
+};
+
+static Mutex seek_index_mutex;
+static std::map<std::string, SeekIndexEntry> seek_index_cache;
+static unsigned seek_index_clock;
+static AllocatedPath seek_index_path = AllocatedPath::Null();
+static bool seek_index_modified;
+
+bool
+seek_index_cache_lookup(const char *plugin, const char *uri,
+			offset_type size, time_t mtime, SeekIndex &index)
+{
+	const ScopeLock protect(seek_index_mutex);
+
+	auto i = seek_index_cache.find(uri);
+	if (i == seek_index_cache.end() || i->second.size != size ||
+	    i->second.mtime != mtime || i->second.plugin != plugin)
+		return false;
+
+	i->second.last_used = ++seek_index_clock;
+	index = i->second.index;
+	return true;
+}
+
+/**
+ * Discard the least recently used entry.  Caller must lock the
+ * mutex.
+ */
+static void
+seek_index_cache_evict()
+{
+	typedef decltype(seek_index_cache)::const_reference Item;
+
+	auto lru = std::min_element(seek_index_cache.begin(),
+				    seek_index_cache.end(),
+				    [](Item a, Item b){
+					    return a.second.last_used <
+						    b.second.last_used;
+				    });
+	if (lru != seek_index_cache.end())
+		seek_index_cache.erase(lru);
+}
+
+/**
+ * Caller must lock the mutex.
+ */
+static void
+seek_index_cache_put(const char *plugin, const char *uri,
+		     offset_type size, time_t mtime, const SeekIndex &index)
+{
+	auto i = seek_index_cache.find(uri);
+	if (i == seek_index_cache.end()) {
+		if (seek_index_cache.size() >= MAX_FILES)
+			seek_index_cache_evict();
+
+		i = seek_index_cache.emplace(uri, SeekIndexEntry()).first;
+	} else if (i->second.size == size && i->second.mtime == mtime &&
+		   i->second.plugin == plugin &&
+		   i->second.index.GetEnd() >= index.GetEnd())
+		/* the cached index is just as good */
+		return;
+
+	auto &entry = i->second;
+	entry.plugin = plugin;
+	entry.size = size;
+	entry.mtime = mtime;
+	entry.index = index;
+	entry.last_used = ++seek_index_clock;
+}
+
+void
+seek_index_cache_store(const char *plugin, const char *uri,
+		       offset_type size, time_t mtime,
+		       const SeekIndex &index)
+{
+	if (index.IsEmpty() || strchr(uri, '\n') != nullptr)
+		/* can't be stored in the file */
+		return;
+
+	const ScopeLock protect(seek_index_mutex);
+	seek_index_cache_put(plugin, uri, size, mtime, index);
+	seek_index_modified = true;
+}
+
+/**
+ * Parse an "index:" line.
+ *
+ * @return the URI or nullptr on error
+ */
+static const char *
+seek_index_parse_begin(char *line, const char *&plugin, offset_type &size,
+		       time_t &mtime)
+{
+	plugin = line;
+	char *p = strchr(line, ' ');
+	if (p == nullptr)
+		return nullptr;
+
+	*p++ = 0;
+
+	char *endptr;
+	size = strtoull(p, &endptr, 10);
+	if (endptr == p || *endptr != ' ')
+		return nullptr;
+
+	p = endptr + 1;
+	mtime = strtoll(p, &endptr, 10);
+	if (endptr == p || *endptr != ' ')
+		return nullptr;
+
+	return endptr + 1;
+}
+
+static bool
+seek_index_parse_point(const char *line, SeekIndex &index)
+{
+	char *endptr;
+	const uint64_t position = strtoull(line, &endptr, 10);
+	if (endptr == line || *endptr != ' ')
+		return false;
+
+	line = endptr + 1;
+	const offset_type offset = strtoull(line, &endptr, 10);
+	if (endptr == line || *endptr != 0)
+		return false;
+
+	index.Add(position, offset, 1);
+	return true;
+}
+
+static void
+seek_index_cache_load(Path path)
+{
+	Error error;
+	TextFile file(path, error);
+	if (file.HasFailed()) {
+		LogError(error);
+		return;
+	}
+
+	const ScopeLock protect(seek_index_mutex);
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		char *rest = const_cast<char *>(StringAfterPrefix(line,
+								  SEEK_INDEX_BEGIN));
+		const char *plugin;
+		offset_type size;
+		time_t mtime;
+		const char *uri = rest != nullptr
+			? seek_index_parse_begin(rest, plugin, size, mtime)
+			: nullptr;
+		if (uri == nullptr) {
+			FormatError(seek_index_domain,
+				    "Malformed line in seek index file: %s",
+				    line);
+			return;
+		}
+
+		const std::string plugin_s(plugin), uri_s(uri);
+
+		SeekIndex index;
+		while (true) {
+			line = file.ReadLine();
+			if (line == nullptr) {
+				LogError(seek_index_domain,
+					 "Unexpected end of seek index file");
+				return;
+			}
+
+			if (strcmp(line, SEEK_INDEX_END) == 0)
+				break;
+
+			if (!seek_index_parse_point(line, index)) {
+				FormatError(seek_index_domain,
+					    "Malformed line in seek index file: %s",
+					    line);
+				return;
+			}
+		}
+
+		seek_index_cache_put(plugin_s.c_str(), uri_s.c_str(),
+				     size, mtime, index);
+	}
+}
+
+static bool
+seek_index_cache_save(Path path, Error &error)
+{
+	FileOutputStream fos(path, error);
+	if (!fos.IsDefined())
+		return false;
+
+	BufferedOutputStream bos(fos);
+
+	{
+		const ScopeLock protect(seek_index_mutex);
+
+		for (const auto &i : seek_index_cache) {
+			const auto &entry = i.second;
+			bos.Format(SEEK_INDEX_BEGIN "%s %llu %lld %s\n",
+				   entry.plugin.c_str(),
+				   (unsigned long long)entry.size,
+				   (long long)entry.mtime,
+				   i.first.c_str());
+
+			for (const auto &point : entry.index)
+				bos.Format("%llu %llu\n",
+					   (unsigned long long)point.position,
+					   (unsigned long long)point.offset);
+
+			bos.Write(SEEK_INDEX_END "\n");
+		}
+
+		seek_index_modified = false;
+	}
+
+	return bos.Flush(error) && fos.Commit(error);
+}
+
+void
+seek_index_cache_init(AllocatedPath &&path)
+{
+	assert(seek_index_path.IsNull());
+	assert(!path.IsNull());
+
+	seek_index_path = std::move(path);
+
+	if (FileExists(seek_index_path))
+		seek_index_cache_load(seek_index_path);
+}
+
+void
+seek_index_cache_finish()
+{
+	if (seek_index_path.IsNull())
+		return;
+
+	Error error;
+	if (seek_index_modified &&
+	    !seek_index_cache_save(seek_index_path, error))
+		LogError(error);
+
+	seek_index_path.SetNull();
+
+	const ScopeLock protect(seek_index_mutex);
+	seek_index_cache.clear();
+}
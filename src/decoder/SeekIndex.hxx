@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A sparse table of file offsets which lets decoders seek in
+ * formats without a usable seek table (e.g. MP3 without Xing TOC)
+ * using one InputStream seek instead of scanning the file.  Decoders
+ * build it while decoding linearly, and the cache keeps it for the
+ * next time the song is played.  The cache is persisted in the file
+ * configured with "seek_index_file".
+ *
+ */
+
+#ifndef MPD_SEEK_INDEX_HXX
+#define MPD_SEEK_INDEX_HXX
+
+#include "check.h"
+#include "input/Offset.hxx"
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stdint.h>
+#include <time.h>
+
+class AllocatedPath;
+
+/**
+ * The distance between two points in a #SeekIndex [seconds].
+ */
+static constexpr unsigned SEEK_INDEX_INTERVAL = 5;
+
+class SeekIndex {
+public:
+	struct Point {
+		/**
+		 * A decoder specific position, e.g. the MP3 frame
+		 * number or the Ogg granule position.
+		 */
+		uint64_t position;
+
+		/**
+		 * The file offset where decoding of this position
+		 * starts.
+		 */
+		offset_type offset;
+	};
+
+private:
+	/**
+	 * Sorted by position.
+	 */
+	std::vector<Point> points;
+
+public:
+	bool IsEmpty() const {
+		return points.empty();
+	}
+
+	/**
+	 * Returns the position of the last point (or 0 if the index
+	 * is empty).
+	 */
+	uint64_t GetEnd() const {
+		return points.empty() ? 0 : points.back().position;
+	}
+
+	std::vector<Point>::const_iterator begin() const {
+		return points.begin();
+	}
+
+	std::vector<Point>::const_iterator end() const {
+		return points.end();
+	}
+
+	/**
+	 * Append a point if it is at least #interval after the last
+	 * one.
+	 *
+	 * @return true if the point was added
+	 */
+	bool Add(uint64_t position, offset_type offset, uint64_t interval) {
+		if (!points.empty() &&
+		    position < points.back().position + interval)
+			return false;
+
+		points.push_back({position, offset});
+		return true;
+	}
+
+	/**
+	 * Find the last point at or before the given position.
+	 *
+	 * @return the point or nullptr if there is none
+	 */
+	gcc_pure
+	const Point *Find(uint64_t position) const;
+};
+
+/**
+ * Copy the cached index of the given file.
+ *
+ * This function is thread-safe.
+ *
+ * @param plugin the name of the decoder plugin which has built the
+ * index; positions are specific to the plugin
+ * @param size the size of the file
+ * @param mtime the modification time of the file (0 if unknown); an
+ * index for a different size or modification time is stale
+ * @return false if there is no (valid) index
+ */
+bool
+seek_index_cache_lookup(const char *plugin, const char *uri,
+			offset_type size, time_t mtime, SeekIndex &index);
+
+/**
+ * Remember the index of the given file, unless the cache has one
+ * which reaches at least as far.
+ *
+ * This function is thread-safe.
+ */
+void
+seek_index_cache_store(const char *plugin, const char *uri,
+		       offset_type size, time_t mtime,
+		       const SeekIndex &index);
+
+/**
+ * Load the cache from the given file (if it exists), and save it
+ * there in seek_index_cache_finish().
+ */
+void
+seek_index_cache_init(AllocatedPath &&path);
+
+/**
+ * Save the cache (if it was modified) and free it.
+ */
+void
+seek_index_cache_finish();
+
+#endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndex.hxx"
 #include "input/InputStream.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "tag/TagId3.hxx"
@@ -133,6 +134,25 @@ struct MadDecoder {
 	unsigned long highest_frame;
 	unsigned long max_frames;
 	unsigned long current_frame;
+
+	/**
+	 * Frame offsets of this file which were recorded while
+	 * decoding, possibly during an earlier playback.  Positions
+	 * are frame numbers.
+	 */
+	SeekIndex seek_index;
+
+	/**
+	 * The number of frames between two #seek_index points; 0 if
+	 * the stream cannot be indexed.
+	 */
+	unsigned long seek_index_interval;
+
+	/**
+	 * Have points been added to #seek_index?
+	 */
+	bool seek_index_modified;
+
 	unsigned int drop_start_frames;
 	unsigned int drop_end_frames;
 	unsigned int drop_start_samples;
@@ -179,6 +199,34 @@ struct MadDecoder {
 	gcc_pure
 	long TimeToFrame(SongTime t) const;
 
+	/**
+	 * Load #seek_index from the cache.  Call this after
+	 * AllocateBuffers().
+	 */
+	void LoadSeekIndex();
+
+	/**
+	 * Submit #seek_index to the cache if it has grown.
+	 */
+	void SaveSeekIndex();
+
+	/**
+	 * Find the #seek_index point to be used for seeking to the
+	 * given time.
+	 *
+	 * @return nullptr if the index doesn't help, i.e. decoding
+	 * from the current position is just as fast
+	 */
+	gcc_pure
+	const SeekIndex::Point *FindSeekIndexPoint(SongTime t) const;
+
+	/**
+	 * Seek to the given #seek_index point.  Frames between the
+	 * highest decoded frame and the point get calculated times
+	 * and unknown (negative) offsets.
+	 */
+	bool SeekToIndexPoint(const SeekIndex::Point &point);
+
 	void UpdateTimerNextFrame();
 
 	/**
@@ -201,6 +249,7 @@ MadDecoder::MadDecoder(Decoder *_decoder,
 	 frame_offsets(nullptr),
 	 times(nullptr),
 	 highest_frame(0), max_frames(0), current_frame(0),
+	 seek_index_interval(0), seek_index_modified(false),
 	 drop_start_frames(0), drop_end_frames(0),
 	 drop_start_samples(0), drop_end_samples(0),
 	 found_replay_gain(false),
@@ -865,6 +914,86 @@ MadDecoder::TimeToFrame(SongTime t) const
 	return i;
 }
 
+inline void
+MadDecoder::LoadSeekIndex()
+{
+	if (!input_stream.IsSeekable() || !input_stream.KnownSize())
+		return;
+
+	const unsigned frame_samples = 32 * MAD_NSBSAMPLES(&frame.header);
+	seek_index_interval = SEEK_INDEX_INTERVAL *
+		frame.header.samplerate / frame_samples;
+	if (seek_index_interval == 0)
+		return;
+
+	seek_index_cache_lookup(mad_decoder_plugin.name,
+				input_stream.GetURI(), input_stream.GetSize(),
+				input_stream.GetModificationTime(),
+				seek_index);
+}
+
+inline void
+MadDecoder::SaveSeekIndex()
+{
+	if (seek_index_modified)
+		seek_index_cache_store(mad_decoder_plugin.name,
+				       input_stream.GetURI(),
+				       input_stream.GetSize(),
+				       input_stream.GetModificationTime(),
+				       seek_index);
+}
+
+const SeekIndex::Point *
+MadDecoder::FindSeekIndexPoint(SongTime t) const
+{
+	if (seek_index_interval == 0)
+		return nullptr;
+
+	const unsigned frame_samples = 32 * MAD_NSBSAMPLES(&frame.header);
+	const uint64_t target = uint64_t(t.ToMS()) *
+		frame.header.samplerate / (1000 * frame_samples);
+
+	const auto *point = seek_index.Find(target);
+	if (point == nullptr || point->position >= max_frames ||
+	    (current_frame >= point->position && current_frame <= target))
+		return nullptr;
+
+	return point;
+}
+
+bool
+MadDecoder::SeekToIndexPoint(const SeekIndex::Point &point)
+{
+	const unsigned long j = point.position;
+	assert(j < max_frames);
+
+	if (!Seek(point.offset))
+		return false;
+
+	if (j >= highest_frame) {
+		/* all MP3 frames of a file have the same duration,
+		   which allows calculating the time of the frames we
+		   skip; their offsets will be recorded if they get
+		   decoded later */
+		mad_timer_t t = highest_frame > 0
+			? times[highest_frame - 1]
+			: mad_timer_zero;
+
+		for (unsigned long i = highest_frame; i < j; ++i) {
+			mad_timer_add(&t, frame.header.duration);
+			times[i] = t;
+			frame_offsets[i] = -1;
+		}
+
+		highest_frame = j;
+		timer = t;
+	} else
+		frame_offsets[j] = point.offset;
+
+	current_frame = j;
+	return true;
+}
+
 void
 MadDecoder::UpdateTimerNextFrame()
 {
@@ -873,7 +1002,8 @@ MadDecoder::UpdateTimerNextFrame()
 		   (for seeking) and times */
 		bit_rate = frame.header.bitrate;
 
-		if (current_frame >= max_frames)
+		const bool capped = current_frame >= max_frames;
+		if (capped)
 			/* cap current_frame */
 			current_frame = max_frames - 1;
 		else
@@ -881,12 +1011,23 @@ MadDecoder::UpdateTimerNextFrame()
 
 		frame_offsets[current_frame] = ThisFrameOffset();
 
+		if (seek_index_interval > 0 && !capped &&
+		    seek_index.Add(current_frame, frame_offsets[current_frame],
+				   seek_index_interval))
+			seek_index_modified = true;
+
 		mad_timer_add(&timer, frame.header.duration);
 		times[current_frame] = timer;
-	} else
+	} else {
 		/* get the new timer value from "times" */
 		timer = times[current_frame];
 
+		if (frame_offsets[current_frame] < 0)
+			/* this frame was skipped by
+			   SeekToIndexPoint() */
+			frame_offsets[current_frame] = ThisFrameOffset();
+	}
+
 	current_frame++;
 	elapsed_time = ToSongTime(timer);
 }
@@ -992,16 +1133,26 @@ MadDecoder::Read()
 		if (cmd == DecoderCommand::SEEK) {
 			assert(input_stream.IsSeekable());
 
-			unsigned long j =
-				TimeToFrame(decoder_seek_time(*decoder));
-			if (j < highest_frame) {
+			const SongTime t = decoder_seek_time(*decoder);
+			unsigned long j = TimeToFrame(t);
+			const SeekIndex::Point *point;
+			if (j < highest_frame && frame_offsets[j] >= 0) {
 				if (Seek(frame_offsets[j])) {
 					current_frame = j;
 					decoder_command_finished(*decoder);
 				} else
 					decoder_seek_error(*decoder);
+			} else if ((point = FindSeekIndexPoint(t)) != nullptr) {
+				/* jump to the closest known frame and
+				   skip from there */
+				if (SeekToIndexPoint(*point)) {
+					seek_time = t;
+					mute_frame = MUTEFRAME_SEEK;
+					decoder_command_finished(*decoder);
+				} else
+					decoder_seek_error(*decoder);
 			} else {
-				seek_time = decoder_seek_time(*decoder);
+				seek_time = t;
 				mute_frame = MUTEFRAME_SEEK;
 				decoder_command_finished(*decoder);
 			}
@@ -1056,6 +1207,7 @@ mp3_decode(Decoder &decoder, InputStream &input_stream)
 	}
 
 	data.AllocateBuffers();
+	data.LoadSeekIndex();
 
 	Error error;
 	AudioFormat audio_format;
@@ -1079,6 +1231,8 @@ mp3_decode(Decoder &decoder, InputStream &input_stream)
 	}
 
 	while (data.Read()) {}
+
+	data.SaveSeekIndex();
 }
 
 static bool
@@ -22,6 +22,7 @@
 
 #include "check.h"
 #include "OggUtil.hxx"
+#include "input/InputStream.hxx"
 
 #include <ogg/ogg.h>
 
@@ -73,6 +74,16 @@ public:
 	bool ExpectPageSeekIn(ogg_stream_state &os) {
 		return OggExpectPageSeekIn(oy, os, decoder, is);
 	}
+
+	/**
+	 * Determine the file offset of the page which was just
+	 * returned by ExpectPage().
+	 */
+	gcc_pure
+	offset_type GetPageOffset(const ogg_page &page) const {
+		return is.GetOffset() - (oy.fill - oy.returned)
+			- page.header_len - page.body_len;
+	}
 };
 
 #endif
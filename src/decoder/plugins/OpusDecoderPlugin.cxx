@@ -25,6 +25,7 @@
 #include "OggFind.hxx"
 #include "OggSyncState.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndex.hxx"
 #include "OggCodec.hxx"
 #include "tag/TagHandler.hxx"
 #include "tag/TagBuilder.hxx"
@@ -35,6 +36,8 @@
 #include <opus.h>
 #include <ogg/ogg.h>
 
+#include <algorithm>
+
 #include <string.h>
 #include <stdio.h>
 
@@ -91,6 +94,37 @@ class MPDOpusDecoder {
 
 	ogg_int64_t eos_granulepos;
 
+	/**
+	 * The granule position of the last page of the current
+	 * stream; -1 if unknown (e.g. after seeking).  Audio packets
+	 * which complete on the next page start there.
+	 */
+	ogg_int64_t page_granulepos;
+
+	/**
+	 * The granule position of the next decoded frame; -1 if
+	 * unknown.
+	 */
+	ogg_int64_t granulepos;
+
+	/**
+	 * After seeking via #seek_index: discard decoded frames
+	 * before this granule position.
+	 */
+	ogg_int64_t skip_granulepos;
+
+	/**
+	 * Page offsets of this file which were recorded while
+	 * decoding, possibly during an earlier playback.  Positions
+	 * are granule positions.
+	 */
+	SeekIndex seek_index;
+
+	/**
+	 * Have points been added to #seek_index?
+	 */
+	bool seek_index_modified;
+
 	size_t frame_size;
 
 public:
@@ -100,7 +134,10 @@ public:
 		 opus_decoder(nullptr),
 		 output_buffer(nullptr),
 		 previous_channels(0),
-		 os_initialized(false) {}
+		 os_initialized(false),
+		 eos_granulepos(-1),
+		 page_granulepos(0), granulepos(0), skip_granulepos(0),
+		 seek_index_modified(false) {}
 	~MPDOpusDecoder();
 
 	bool ReadFirstPage(OggSyncState &oy);
@@ -114,6 +151,28 @@ public:
 	DecoderCommand HandleAudio(const ogg_packet &packet);
 
 	bool Seek(OggSyncState &oy, uint64_t where_frame);
+
+	/**
+	 * Submit #seek_index to the cache if it has grown.
+	 */
+	void SaveSeekIndex();
+
+private:
+	/**
+	 * Can this stream be indexed?  Only single-stream seekable
+	 * files can.
+	 */
+	bool IsIndexable() const {
+		return eos_granulepos > 0;
+	}
+
+	/**
+	 * Add the given page (just read) to #seek_index.  Pages
+	 * which continue a packet from the previous page are not
+	 * added: seeking there would drop that packet, and the
+	 * position of the first decoded frame would be wrong.
+	 */
+	void IndexPage(const OggSyncState &oy, const ogg_page &page);
 };
 
 MPDOpusDecoder::~MPDOpusDecoder()
@@ -152,10 +211,37 @@ MPDOpusDecoder::ReadNextPage(OggSyncState &oy)
 	if (page_serialno != os.serialno)
 		ogg_stream_reset_serialno(&os, page_serialno);
 
+	if (IsIndexable() && page_serialno == opus_serialno)
+		IndexPage(oy, page);
+
 	ogg_stream_pagein(&os, &page);
 	return true;
 }
 
+inline void
+MPDOpusDecoder::IndexPage(const OggSyncState &oy, const ogg_page &page)
+{
+	if (page_granulepos >= 0 && !ogg_page_continued(&page) &&
+	    seek_index.Add(page_granulepos, oy.GetPageOffset(page),
+			   SEEK_INDEX_INTERVAL * opus_sample_rate))
+		seek_index_modified = true;
+
+	const auto g = ogg_page_granulepos(&page);
+	if (g >= 0)
+		page_granulepos = g;
+}
+
+inline void
+MPDOpusDecoder::SaveSeekIndex()
+{
+	if (seek_index_modified)
+		seek_index_cache_store(opus_decoder_plugin.name,
+				       input_stream.GetURI(),
+				       input_stream.GetSize(),
+				       input_stream.GetModificationTime(),
+				       seek_index);
+}
+
 inline DecoderCommand
 MPDOpusDecoder::HandlePackets()
 {
@@ -298,6 +384,13 @@ MPDOpusDecoder::HandleBOS(const ogg_packet &packet)
 			    eos_granulepos > 0, duration);
 	frame_size = audio_format.GetFrameSize();
 
+	if (IsIndexable())
+		seek_index_cache_lookup(opus_decoder_plugin.name,
+					input_stream.GetURI(),
+					input_stream.GetSize(),
+					input_stream.GetModificationTime(),
+					seek_index);
+
 	output_buffer = new opus_int16[opus_output_buffer_frames
 				       * audio_format.channels];
 
@@ -360,10 +453,25 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 		return DecoderCommand::STOP;
 	}
 
+	const opus_int16 *data = output_buffer;
+	if (granulepos >= 0 && granulepos < skip_granulepos) {
+		/* seeking: discard frames before the seek position */
+		const auto skip = std::min<ogg_int64_t>(skip_granulepos
+							- granulepos,
+							nframes);
+		granulepos += skip;
+		data += skip * (frame_size / sizeof(*data));
+		nframes -= skip;
+	} else if (granulepos >= 0)
+		granulepos += nframes;
+
+	if (packet.granulepos >= 0)
+		granulepos = packet.granulepos;
+
 	if (nframes > 0) {
 		const size_t nbytes = nframes * frame_size;
 		auto cmd = decoder_data(decoder, input_stream,
-					output_buffer, nbytes,
+					data, nbytes,
 					0);
 		if (cmd != DecoderCommand::NONE)
 			return cmd;
@@ -386,12 +494,34 @@ MPDOpusDecoder::Seek(OggSyncState &oy, uint64_t where_frame)
 
 	const ogg_int64_t where_granulepos(where_frame);
 
+	const auto *point = seek_index.Find(where_granulepos);
+	if (point != nullptr &&
+	    where_granulepos - ogg_int64_t(point->position) <
+	    2 * SEEK_INDEX_INTERVAL * opus_sample_rate) {
+		/* the index knows a page shortly before the seek
+		   position: start decoding there and discard the
+		   frames before the seek position */
+		if (!OggSeekPageAtOffset(oy, os, input_stream,
+					 point->offset))
+			return false;
+
+		/* the page at the point has been consumed by
+		   OggSeekPageAtOffset() already, and its granule
+		   position is unknown */
+		page_granulepos = -1;
+		granulepos = point->position;
+		skip_granulepos = where_granulepos;
+		return true;
+	}
+
 	/* interpolate the file offset where we expect to find the
 	   given granule position */
 	/* TODO: implement binary search */
 	offset_type offset(where_granulepos * input_stream.GetSize()
 			   / eos_granulepos);
 
+	page_granulepos = granulepos = -1;
+	skip_granulepos = 0;
 	return OggSeekPageAtOffset(oy, os, input_stream, offset);
 }
 
@@ -429,6 +559,8 @@ mpd_opus_stream_decode(Decoder &decoder,
 		if (!d.ReadNextPage(oy))
 			break;
 	}
+
+	d.SaveSeekIndex();
 }
 
 static bool
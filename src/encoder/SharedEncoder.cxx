@@ -0,0 +1,1020 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SharedEncoder.hxx"
+#include "EncoderAPI.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "thread/Mutex.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain shared_encoder_domain("shared_encoder");
+
+/**
+ * A client which lags behind the others by more than this number of
+ * bytes skips to the end of the log.  This happens to outputs which
+ * stop reading, e.g. a "httpd" output without listeners.
+ */
+static constexpr size_t MAX_BACKLOG = 1024 * 1024;
+
+struct SharedEncoder;
+
+/**
+ * One real #Encoder shared by several #SharedEncoder objects.
+ *
+ * All clients write the same input, but each at its own pace.
+ * Whichever client is ahead feeds the real encoder with the part of
+ * its input which has not been encoded yet.  All encoder output is
+ * appended to a log, and each client reads only what has been
+ * generated from the input it has written itself, just like with a
+ * private encoder.
+ */
+struct SharedEncoderGroup {
+	const std::string name;
+
+	/**
+	 * The settings which determine the input of the encoder,
+	 * see MakeFilterSignature().  They must be equal in all
+	 * outputs of the group.
+	 */
+	const std::string filter_signature;
+
+	/**
+	 * The method table of all #SharedEncoder objects in this
+	 * group.  The "tag" method exists only if the real encoder
+	 * plugin implements it, because outputs check it to choose
+	 * between encoder tags and other metadata.
+	 */
+	EncoderPlugin plugin;
+
+	Encoder *const encoder;
+
+	/**
+	 * The number of #SharedEncoder objects.  Protected by
+	 * #shared_encoder_mutex.
+	 */
+	unsigned n_clients;
+
+	/**
+	 * Protects all attributes below.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Is #encoder open?
+	 */
+	bool open;
+
+	/**
+	 * Has the stream ended for good?  Then the remaining clients
+	 * can only be closed.
+	 */
+	bool ended;
+
+	/**
+	 * Has encoder_end() been called while other clients still
+	 * need the encoder?  Then it is opened again before it gets
+	 * more input, see Restart().
+	 */
+	bool restart;
+
+	/**
+	 * The input audio format of the first client, and the one
+	 * chosen by the encoder.
+	 */
+	AudioFormat in_format, out_format;
+
+	/**
+	 * All open clients.
+	 */
+	std::list<SharedEncoder *> clients;
+
+	/**
+	 * The stream header, which is sent to clients when they are
+	 * opened.
+	 */
+	std::vector<uint8_t> header;
+
+	/**
+	 * Encoder output which has not yet been read by all clients.
+	 */
+	DynamicFifoBuffer<uint8_t> log;
+
+	/**
+	 * The stream position of the first byte in #log.
+	 */
+	uint64_t log_start;
+
+	/**
+	 * The number of input bytes which have been fed into
+	 * #encoder since it was opened.
+	 */
+	uint64_t input_position;
+
+	/**
+	 * Describes how much of the log has been generated from the
+	 * input up to a certain position.
+	 */
+	struct InputMark {
+		uint64_t input, log_end;
+	};
+
+	/**
+	 * The input marks within #log, in ascending order.
+	 */
+	std::deque<InputMark> input_marks;
+
+	/**
+	 * Describes the new stream header generated by a tag.
+	 */
+	struct TagMark {
+		/**
+		 * The sequence number of this tag since the encoder
+		 * was opened, starting at 1.
+		 */
+		unsigned n;
+
+		uint64_t start, end;
+	};
+
+	/**
+	 * The tags within #log.
+	 */
+	std::deque<TagMark> tags;
+
+	/**
+	 * The number of tags since the encoder was opened.
+	 */
+	unsigned n_tags;
+
+	/**
+	 * Describes silence which was written by a paused client,
+	 * see encoder_write_silence().  Clients pause at different
+	 * input positions and for different durations, so the
+	 * silence is encoded only once, at the position of the
+	 * client which is ahead; the others skip it when they
+	 * continue writing audio.
+	 */
+	struct Gap {
+		uint64_t start, end;
+	};
+
+	/**
+	 * The gaps which have not yet been passed by all clients, in
+	 * ascending order.
+	 */
+	std::deque<Gap> gaps;
+
+	SharedEncoderGroup(const char *_name, const char *_filter_signature,
+			   const EncoderPlugin &_plugin, Encoder *_encoder);
+
+	~SharedEncoderGroup() {
+		assert(n_clients == 0);
+		assert(!open);
+
+		encoder->Dispose();
+	}
+
+	uint64_t GetLogEnd() const {
+		return log_start + log.GetAvailable();
+	}
+
+	/**
+	 * Determine the end of the log data which has been generated
+	 * from the specified amount of input.
+	 */
+	gcc_pure
+	uint64_t GetInputEnd(uint64_t input) const {
+		if (input >= input_position)
+			return GetLogEnd();
+
+		uint64_t end = log_start;
+		for (const auto &i : input_marks) {
+			if (i.input > input)
+				break;
+
+			end = i.log_end;
+		}
+
+		return end;
+	}
+
+	/**
+	 * Are there clients which have not called encoder_end()?
+	 */
+	gcc_pure
+	bool HasActiveClients() const;
+
+	/**
+	 * Find the gap which contains the specified input position.
+	 */
+	gcc_pure
+	const Gap *FindGap(uint64_t input) const {
+		for (const auto &i : gaps)
+			if (input >= i.start && input < i.end)
+				return &i;
+
+		return nullptr;
+	}
+
+	/**
+	 * Find the first gap after the specified input position.
+	 */
+	gcc_pure
+	const Gap *FindNextGap(uint64_t input) const {
+		for (const auto &i : gaps)
+			if (i.start > input)
+				return &i;
+
+		return nullptr;
+	}
+
+	gcc_pure
+	const TagMark *FindTag(unsigned n) const {
+		for (const auto &i : tags)
+			if (i.n == n)
+				return &i;
+
+		return nullptr;
+	}
+
+	/**
+	 * Moves all available output of the real encoder to #log,
+	 * and attributes it to the input fed so far.
+	 */
+	void Drain();
+
+	/**
+	 * Removes data from #log which has been read by all clients.
+	 */
+	void Trim();
+
+	/**
+	 * Opens the real encoder again after encoder_end(), so the
+	 * remaining clients can continue with a new stream.
+	 */
+	bool Restart(Error &error);
+
+	/**
+	 * Fail if the stream has ended for good.  This happens after
+	 * the last client has called encoder_end(), or if the
+	 * encoder could not be restarted.
+	 */
+	bool CheckEnded(Error &error) const;
+
+	/**
+	 * Prepare the real encoder for more input: fail if the
+	 * stream has ended for good, and restart it if necessary.
+	 */
+	bool Prepare(Error &error);
+};
+
+struct SharedEncoder {
+	Encoder base;
+
+	SharedEncoderGroup &group;
+
+	/**
+	 * The stream position of the next byte to be read from the
+	 * group's log.
+	 */
+	uint64_t position;
+
+	/**
+	 * The stream header which was current when this client was
+	 * opened, to be read before the log.
+	 */
+	std::vector<uint8_t> header;
+	size_t header_position;
+
+	/**
+	 * The input position after the data written by this client,
+	 * see SharedEncoderGroup::input_position.
+	 */
+	uint64_t input;
+
+	/**
+	 * The number of tags this client has sent.  A client does
+	 * not read past the header of the next tag until it has sent
+	 * this tag itself, so it gets the header right after calling
+	 * encoder_tag(), just like a private encoder.
+	 */
+	unsigned n_tags;
+
+	enum class Limit : uint8_t {
+		NONE,
+
+		/**
+		 * Reading the header generated by a tag; after that,
+		 * reading is unlimited.
+		 */
+		HEADER,
+
+		/**
+		 * encoder_end() has been called.
+		 */
+		END,
+	} limit_mode;
+
+	uint64_t limit;
+
+	/**
+	 * Did pre_tag() pass the tag on to the real encoder?
+	 */
+	bool tag_sender;
+
+	explicit SharedEncoder(SharedEncoderGroup &_group)
+		:base(_group.plugin), group(_group) {}
+
+	/**
+	 * Skips to the end of the log.
+	 */
+	void Skip() {
+		position = group.GetLogEnd();
+		n_tags = group.n_tags;
+		if (limit_mode == Limit::HEADER)
+			limit_mode = Limit::NONE;
+		else if (limit_mode == Limit::END)
+			limit = position;
+	}
+};
+
+static Mutex shared_encoder_mutex;
+static std::map<std::string, SharedEncoderGroup *> shared_encoder_groups;
+
+void
+SharedEncoderGroup::Drain()
+{
+	while (true) {
+		static constexpr size_t CHUNK = 4096;
+		uint8_t *dest = log.Write(CHUNK);
+		const size_t nbytes = encoder_read(encoder, dest, CHUNK);
+		if (nbytes == 0)
+			break;
+
+		log.Append(nbytes);
+	}
+
+	const uint64_t log_end = GetLogEnd();
+	if (!input_marks.empty() &&
+	    input_marks.back().input == input_position)
+		input_marks.back().log_end = log_end;
+	else
+		input_marks.push_back({input_position, log_end});
+}
+
+bool
+SharedEncoderGroup::HasActiveClients() const
+{
+	for (const auto *client : clients)
+		if (client->limit_mode != SharedEncoder::Limit::END)
+			return true;
+
+	return false;
+}
+
+void
+SharedEncoderGroup::Trim()
+{
+	const uint64_t end = GetLogEnd();
+	uint64_t min_position = end;
+	uint64_t min_input = input_position;
+
+	for (auto *client : clients) {
+		if (end - client->position > MAX_BACKLOG)
+			client->Skip();
+
+		min_position = std::min(min_position, client->position);
+		min_input = std::min(min_input, client->input);
+	}
+
+	while (!gaps.empty() && gaps.front().end <= min_input)
+		gaps.pop_front();
+
+	assert(min_position >= log_start);
+	log.Consume(min_position - log_start);
+	log_start = min_position;
+
+	while (!tags.empty() && tags.front().start < log_start)
+		tags.pop_front();
+
+	while (!input_marks.empty() && input_marks.front().log_end < log_start)
+		input_marks.pop_front();
+}
+
+bool
+SharedEncoderGroup::Restart(Error &error)
+{
+	assert(restart);
+
+	restart = false;
+	encoder->Close();
+
+	AudioFormat audio_format = in_format;
+	if (!encoder->Open(audio_format, error)) {
+		open = false;
+		ended = true;
+		return false;
+	}
+
+	if (audio_format != out_format) {
+		encoder->Close();
+		open = false;
+		ended = true;
+		error.Format(shared_encoder_domain,
+			     "Audio format of encoder group \"%s\" has changed",
+			     name.c_str());
+		return false;
+	}
+
+	/* the remaining clients read the new stream header from the
+	   log, right after the end of the old stream; clients
+	   opened after this get it as their header */
+	const uint64_t header_start = GetLogEnd();
+	Drain();
+
+	const auto r = log.Read();
+	header.assign(r.data + (header_start - log_start), r.data + r.size);
+	return true;
+}
+
+bool
+SharedEncoderGroup::CheckEnded(Error &error) const
+{
+	if (ended) {
+		error.Format(shared_encoder_domain,
+			     "Encoder group \"%s\" has ended",
+			     name.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool
+SharedEncoderGroup::Prepare(Error &error)
+{
+	return CheckEnded(error) && (!restart || Restart(error));
+}
+
+/**
+ * Does the configuration block select the software mixer?  Its
+ * volume is not shared by the outputs of an encoder group.
+ */
+gcc_pure
+static bool
+HasSoftwareMixer(const ConfigBlock &block)
+{
+	const char *p = block.GetBlockValue("mixer_type");
+	if (p == nullptr && block.GetBlockValue("mixer_enabled", true))
+		/* the deprecated global setting */
+		p = config_get_string(ConfigOption::MIXER_TYPE, "hardware");
+
+	return p != nullptr && strcmp(p, "software") == 0;
+}
+
+/**
+ * Collects the output settings which affect the audio data and tags
+ * passed to the encoder.  All outputs in an encoder group must have
+ * the same settings, or else they would not write the same input.
+ */
+static std::string
+MakeFilterSignature(const ConfigBlock &block)
+{
+	std::string result = block.GetBlockValue("format", "");
+	result.push_back('\n');
+	result += block.GetBlockValue("filters", "");
+	result.push_back('\n');
+	result += block.GetBlockValue("replay_gain_handler", "software");
+	result.push_back('\n');
+	result.push_back(block.GetBlockValue("tags", true) ? '1' : '0');
+	return result;
+}
+
+static void
+shared_encoder_finish(Encoder *_encoder)
+{
+	SharedEncoder *encoder = (SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder->group;
+	delete encoder;
+
+	const ScopeLock protect(shared_encoder_mutex);
+
+	assert(group.n_clients > 0);
+	if (--group.n_clients == 0) {
+		shared_encoder_groups.erase(group.name);
+		delete &group;
+	}
+}
+
+static bool
+shared_encoder_open(Encoder *_encoder, AudioFormat &audio_format,
+		    Error &error)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	if (group.clients.empty()) {
+		assert(!group.open);
+
+		const AudioFormat in_format = audio_format;
+		if (!group.encoder->Open(audio_format, error))
+			return false;
+
+		group.open = true;
+		group.ended = false;
+		group.restart = false;
+		group.in_format = in_format;
+		group.out_format = audio_format;
+		group.input_position = 0;
+		group.n_tags = 0;
+
+		/* the first output of the encoder is the stream
+		   header */
+		group.log.Clear();
+		group.Drain();
+
+		const auto r = group.log.Read();
+		group.header.assign(r.data, r.data + r.size);
+		group.log.Clear();
+		group.input_marks.clear();
+		group.gaps.clear();
+	} else if (group.ended) {
+		error.Format(shared_encoder_domain,
+			     "Encoder group \"%s\" is being closed",
+			     group.name.c_str());
+		return false;
+	} else if (audio_format != group.in_format) {
+		error.Format(shared_encoder_domain,
+			     "Audio format mismatch in encoder group \"%s\"",
+			     group.name.c_str());
+		return false;
+	} else {
+		/* start the new stream now, so this client gets its
+		   header */
+		if (group.restart && !group.Restart(error))
+			return false;
+
+		audio_format = group.out_format;
+	}
+
+	encoder.position = group.GetLogEnd();
+	encoder.header = group.header;
+	encoder.header_position = 0;
+	encoder.input = group.input_position;
+	encoder.n_tags = group.n_tags;
+	encoder.limit_mode = SharedEncoder::Limit::NONE;
+	encoder.tag_sender = false;
+
+	group.clients.push_back(&encoder);
+	return true;
+}
+
+static void
+shared_encoder_close(Encoder *_encoder)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	group.clients.remove(&encoder);
+
+	if (group.clients.empty()) {
+		if (group.open)
+			group.encoder->Close();
+
+		group.open = false;
+		group.log.Clear();
+		group.input_marks.clear();
+		group.tags.clear();
+		group.gaps.clear();
+		group.header.clear();
+	} else
+		group.Trim();
+}
+
+static bool
+shared_encoder_end(Encoder *_encoder, Error &error)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	if (!group.CheckEnded(error))
+		return false;
+
+	if (!group.restart) {
+		/* the stream may have been ended by another client
+		   already */
+		if (!encoder_end(group.encoder, error))
+			return false;
+
+		group.Drain();
+	}
+
+	/* this client reads everything up to the end of the
+	   stream */
+	encoder.limit_mode = SharedEncoder::Limit::END;
+	encoder.limit = group.GetLogEnd();
+
+	if (group.HasActiveClients())
+		/* the others continue with a new stream as soon as
+		   they write more input; they read the end of the
+		   old one and the new header from the log, as if a
+		   tag had been sent */
+		group.restart = true;
+	else
+		/* the last client: nobody needs the encoder anymore */
+		group.ended = true;
+
+	return true;
+}
+
+static bool
+shared_encoder_flush(Encoder *_encoder, Error &error)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	if (encoder.input < group.input_position || group.restart)
+		/* the encoder has already consumed more input than
+		   this client has written, or the stream has ended;
+		   flushing now would not make this client's output
+		   available any sooner */
+		return true;
+
+	if (!group.CheckEnded(error) ||
+	    !encoder_flush(group.encoder, error))
+		return false;
+
+	group.Drain();
+	return true;
+}
+
+static bool
+shared_encoder_pre_tag(Encoder *_encoder, Error &error)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	/* the first client to arrive at a tag passes it on to the
+	   real encoder */
+	const unsigned n = encoder.n_tags + 1;
+	encoder.tag_sender = n > group.n_tags;
+
+	if (group.encoder->plugin.tag == nullptr) {
+		/* tag() will not be called; count the pre_tag()
+		   calls instead */
+		encoder.n_tags = n;
+		if (encoder.tag_sender)
+			group.n_tags = n;
+	}
+
+	if (!encoder.tag_sender || group.restart)
+		/* nothing to be flushed if the stream has ended */
+		return true;
+
+	if (!group.Prepare(error) ||
+	    !encoder_pre_tag(group.encoder, error))
+		return false;
+
+	group.Drain();
+	return true;
+}
+
+static bool
+shared_encoder_tag(Encoder *_encoder, const Tag &tag, Error &error)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	if (encoder.tag_sender) {
+		if (!group.Prepare(error) ||
+		    !encoder_tag(group.encoder, tag, error))
+			return false;
+
+		/* the output of the encoder right after the tag is
+		   the new stream header */
+		SharedEncoderGroup::TagMark mark;
+		mark.n = ++group.n_tags;
+		mark.start = group.GetLogEnd();
+		group.Drain();
+		mark.end = group.GetLogEnd();
+
+		const auto r = group.log.Read();
+		group.header.assign(r.data + (mark.start - group.log_start),
+				    r.data + (mark.end - group.log_start));
+
+		group.tags.push_back(mark);
+		encoder.n_tags = group.n_tags;
+		return true;
+	}
+
+	const unsigned n = ++encoder.n_tags;
+	const auto *mark = group.FindTag(n);
+	if (mark != nullptr && mark->start >= encoder.position &&
+	    encoder.limit_mode == SharedEncoder::Limit::NONE) {
+		/* skip the rest of the old stream (there should be
+		   none, because the output has read everything after
+		   pre_tag()), and let the next read return exactly
+		   the new header */
+		encoder.position = mark->start;
+		encoder.limit_mode = SharedEncoder::Limit::HEADER;
+		encoder.limit = mark->end;
+	}
+
+	return true;
+}
+
+/**
+ * Write input which does not cross a gap.  Caller must lock the
+ * group's mutex.
+ */
+static bool
+WriteInput(SharedEncoder &encoder, const uint8_t *data, size_t length,
+	   Error &error)
+{
+	SharedEncoderGroup &group = encoder.group;
+
+	assert(encoder.input <= group.input_position);
+
+	const uint64_t end = encoder.input + length;
+	if (end > group.input_position) {
+		/* this client is ahead of all others: encode the part
+		   of its input which has not been encoded yet */
+		const size_t skip = group.input_position - encoder.input;
+		if (!group.Prepare(error) ||
+		    !encoder_write(group.encoder, data + skip,
+				   length - skip, error))
+			return false;
+
+		group.input_position = end;
+		group.Drain();
+	}
+
+	encoder.input = end;
+	return true;
+}
+
+static bool
+shared_encoder_write(Encoder *_encoder, const void *data, size_t length,
+		     Error &error)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	const uint8_t *p = (const uint8_t *)data;
+	while (true) {
+		/* the silence of a paused client is not part of this
+		   client's input: skip it */
+		const auto *gap = group.FindGap(encoder.input);
+		if (gap != nullptr)
+			encoder.input = gap->end;
+
+		size_t nbytes = length;
+		gap = group.FindNextGap(encoder.input);
+		if (gap != nullptr && gap->start - encoder.input < nbytes)
+			nbytes = gap->start - encoder.input;
+
+		if (!WriteInput(encoder, p, nbytes, error))
+			return false;
+
+		p += nbytes;
+		length -= nbytes;
+		if (length == 0)
+			break;
+	}
+
+	group.Trim();
+	return true;
+}
+
+static bool
+shared_encoder_write_silence(SharedEncoder &encoder,
+			     const void *data, size_t length, Error &error)
+{
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	if (encoder.input == group.input_position) {
+		/* this client is ahead of all others: encode the
+		   silence, and remember it as a gap */
+		if (!group.Prepare(error) ||
+		    !encoder_write(group.encoder, data, length, error))
+			return false;
+
+		const uint64_t start = group.input_position;
+		group.input_position += length;
+
+		if (!group.gaps.empty() && group.gaps.back().end == start)
+			group.gaps.back().end = group.input_position;
+		else
+			group.gaps.push_back({start, group.input_position});
+
+		encoder.input = group.input_position;
+		group.Drain();
+	} else {
+		/* read the silence which has been encoded for
+		   another client, but not the audio after it; if
+		   this client has not yet arrived at a gap, it gets
+		   nothing until it continues */
+		const auto *gap = group.FindGap(encoder.input);
+		if (gap != nullptr)
+			encoder.input = std::min(encoder.input + length,
+						 gap->end);
+	}
+
+	group.Trim();
+	return true;
+}
+
+static size_t
+shared_encoder_read(Encoder *_encoder, void *dest, size_t length)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+	SharedEncoderGroup &group = encoder.group;
+	const ScopeLock protect(group.mutex);
+
+	if (encoder.header_position < encoder.header.size()) {
+		const size_t nbytes =
+			std::min(length,
+				 encoder.header.size() - encoder.header_position);
+		memcpy(dest, &encoder.header[encoder.header_position],
+		       nbytes);
+		encoder.header_position += nbytes;
+		return nbytes;
+	}
+
+	assert(encoder.position >= group.log_start);
+
+	uint64_t end = group.GetLogEnd();
+	if (encoder.limit_mode != SharedEncoder::Limit::NONE) {
+		end = std::min(end, encoder.limit);
+	} else {
+		/* only what has been generated from this client's
+		   input */
+		end = std::min(end, group.GetInputEnd(encoder.input));
+
+		/* don't read past the next tag before this client
+		   has sent it */
+		const auto *mark = group.FindTag(encoder.n_tags + 1);
+		if (mark != nullptr && mark->start >= encoder.position)
+			end = std::min(end, mark->start);
+	}
+
+	if (encoder.position >= end) {
+		if (encoder.limit_mode == SharedEncoder::Limit::HEADER)
+			encoder.limit_mode = SharedEncoder::Limit::NONE;
+
+		return 0;
+	}
+
+	const size_t nbytes = std::min<uint64_t>(length,
+						 end - encoder.position);
+	const auto r = group.log.Read();
+	memcpy(dest, r.data + (encoder.position - group.log_start), nbytes);
+	encoder.position += nbytes;
+	return nbytes;
+}
+
+static const char *
+shared_encoder_get_mime_type(Encoder *_encoder)
+{
+	SharedEncoder &encoder = *(SharedEncoder *)_encoder;
+
+	return encoder_get_mime_type(encoder.group.encoder);
+}
+
+SharedEncoderGroup::SharedEncoderGroup(const char *_name,
+				       const char *_filter_signature,
+				       const EncoderPlugin &_plugin,
+				       Encoder *_encoder)
+	:name(_name), filter_signature(_filter_signature),
+	 encoder(_encoder), n_clients(0),
+	 open(false), ended(false), restart(false),
+	 log(16384), log_start(0), input_position(0), n_tags(0)
+{
+	plugin.name = _plugin.name;
+	plugin.init = nullptr;
+	plugin.finish = shared_encoder_finish;
+	plugin.open = shared_encoder_open;
+	plugin.close = shared_encoder_close;
+	plugin.end = shared_encoder_end;
+	plugin.flush = shared_encoder_flush;
+	plugin.pre_tag = shared_encoder_pre_tag;
+	plugin.tag = _plugin.tag != nullptr
+		? shared_encoder_tag
+		: nullptr;
+	plugin.write = shared_encoder_write;
+	plugin.read = shared_encoder_read;
+	plugin.get_mime_type = shared_encoder_get_mime_type;
+}
+
+Encoder *
+encoder_init_output(const EncoderPlugin &plugin, const ConfigBlock &block,
+		    Error &error)
+{
+	const char *name = block.GetBlockValue("encoder_group");
+	if (name == nullptr)
+		return encoder_init(plugin, block, error);
+
+	if (HasSoftwareMixer(block)) {
+		error.Format(shared_encoder_domain,
+			     "The software mixer cannot be used in encoder group \"%s\"",
+			     name);
+		return nullptr;
+	}
+
+	const std::string filter_signature = MakeFilterSignature(block);
+
+	const ScopeLock protect(shared_encoder_mutex);
+
+	SharedEncoderGroup *group;
+	auto i = shared_encoder_groups.find(name);
+	if (i == shared_encoder_groups.end()) {
+		Encoder *encoder = encoder_init(plugin, block, error);
+		if (encoder == nullptr)
+			return nullptr;
+
+		group = new SharedEncoderGroup(name, filter_signature.c_str(),
+					       plugin, encoder);
+		shared_encoder_groups.emplace(name, group);
+	} else {
+		group = i->second;
+
+		if (&group->encoder->plugin != &plugin) {
+			error.Format(shared_encoder_domain,
+				     "Encoder group \"%s\" uses the encoder \"%s\"",
+				     name, group->encoder->plugin.name);
+			return nullptr;
+		}
+
+		if (filter_signature != group->filter_signature) {
+			error.Format(shared_encoder_domain,
+				     "Outputs in encoder group \"%s\" must have the same \"format\", \"filters\", \"replay_gain_handler\" and \"tags\" settings",
+				     name);
+			return nullptr;
+		}
+	}
+
+	++group->n_clients;
+	return &(new SharedEncoder(*group))->base;
+}
+
+bool
+encoder_is_shared(const Encoder &encoder)
+{
+	return encoder.plugin.finish == shared_encoder_finish;
+}
+
+bool
+encoder_write_silence(Encoder *encoder, const void *data, size_t length,
+		      Error &error)
+{
+	if (!encoder_is_shared(*encoder))
+		return encoder_write(encoder, data, length, error);
+
+	assert(encoder->open);
+	assert(!encoder->pre_tag);
+	assert(!encoder->tag);
+	assert(!encoder->end);
+
+	return shared_encoder_write_silence(*(SharedEncoder *)encoder,
+					    data, length, error);
+}
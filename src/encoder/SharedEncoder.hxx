@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SHARED_ENCODER_HXX
+#define MPD_SHARED_ENCODER_HXX
+
+#include "Compiler.h"
+
+struct Encoder;
+struct EncoderPlugin;
+struct ConfigBlock;
+class Error;
+
+/**
+ * Creates the encoder of an audio output.  If the configuration
+ * block has an "encoder_group" setting, all outputs with the same
+ * group name share one encoder instance: the audio is encoded only
+ * once, and each output receives a copy of the encoder output
+ * generated from the input it has written.  The encoder settings of
+ * the first output in a group apply to the whole group.
+ *
+ * Outputs in a group must be fed with the same audio data, so this
+ * fails if their filter settings differ or if one of them has a
+ * software mixer.  When one output ends its stream, the encoder
+ * starts a new stream for the others.
+ *
+ * @param plugin the encoder plugin
+ * @return an encoder object on success, nullptr on failure
+ */
+Encoder *
+encoder_init_output(const EncoderPlugin &plugin, const ConfigBlock &block,
+		    Error &error);
+
+/**
+ * Was this encoder created by encoder_init_output() for an encoder
+ * group?  Outputs which skip encoding while nobody listens must feed
+ * a shared encoder anyway, because other outputs depend on it.
+ */
+gcc_pure
+bool
+encoder_is_shared(const Encoder &encoder);
+
+/**
+ * Writes silence while the output is paused.  With a private
+ * encoder, this is the same as encoder_write().  The outputs of an
+ * encoder group pause at different positions and for different
+ * durations; the silence is therefore not treated as input which
+ * all of them write: it is encoded only for the output which is
+ * ahead, and the others skip it when they continue.
+ */
+bool
+encoder_write_silence(Encoder *encoder, const void *data, size_t length,
+		      Error &error);
+
+#endif
@@ -22,6 +22,8 @@
 
 #include "check.h"
 
+#include <boost/intrusive/list.hpp>
+
 class EventLoop;
 
 /**
@@ -33,6 +35,15 @@ class DeferredMonitor {
 	EventLoop &loop;
 
 	friend class EventLoop;
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> ListHook;
+
+	/**
+	 * Siblings in EventLoop::deferred.  Only valid if #pending.
+	 * Protected with EventLoop::mutex.
+	 */
+	ListHook list_hook;
+
 	bool pending;
 
 public:
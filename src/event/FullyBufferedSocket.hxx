@@ -61,6 +61,20 @@ protected:
 	 */
 	bool Write(const void *data, size_t length);
 
+	bool IsOutputEmpty() const {
+		return output.IsEmpty();
+	}
+
+	/**
+	 * The output buffer has been sent completely.  The method may
+	 * submit more data with Write().
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool OnSocketDrained() {
+		return true;
+	}
+
 	virtual bool OnSocketReady(unsigned flags) override;
 	virtual void OnIdle() override;
 };
@@ -22,6 +22,8 @@
 
 #include "check.h"
 
+#include <boost/intrusive/list.hpp>
+
 class EventLoop;
 
 /**
@@ -35,6 +37,13 @@ class EventLoop;
 class IdleMonitor {
 	friend class EventLoop;
 
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> ListHook;
+
+	/**
+	 * Siblings in EventLoop::idle.  Only valid if #active.
+	 */
+	ListHook list_hook;
+
 	EventLoop &loop;
 
 	bool active;
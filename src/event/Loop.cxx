@@ -28,9 +28,17 @@
 
 #include <algorithm>
 
+#include <limits.h>
+
+inline uint64_t
+EventLoop::GetMonotonicTime()
+{
+	return ::MonotonicClockUS() / 1000;
+}
+
 EventLoop::EventLoop()
 	:SocketMonitor(*this),
-	 now_ms(::MonotonicClockMS()),
+	 now_ms(GetMonotonicTime()), timers(now_ms),
 	 quit(false), busy(true),
 #ifndef NDEBUG
 	 virgin(true),
@@ -44,7 +52,7 @@ EventLoop::EventLoop()
 EventLoop::~EventLoop()
 {
 	assert(idle.empty());
-	assert(timers.empty());
+	assert(timers.IsEmpty());
 
 	/* this is necessary to get a well-defined destruction
 	   order */
@@ -80,9 +88,8 @@ void
 EventLoop::AddIdle(IdleMonitor &i)
 {
 	assert(IsInsideOrVirgin());
-	assert(std::find(idle.begin(), idle.end(), &i) == idle.end());
 
-	idle.push_back(&i);
+	idle.push_back(i);
 	again = true;
 }
 
@@ -91,10 +98,7 @@ EventLoop::RemoveIdle(IdleMonitor &i)
 {
 	assert(IsInsideOrVirgin());
 
-	auto it = std::find(idle.begin(), idle.end(), &i);
-	assert(it != idle.end());
-
-	idle.erase(it);
+	idle.erase(idle.iterator_to(i));
 }
 
 void
@@ -104,7 +108,7 @@ EventLoop::AddTimer(TimeoutMonitor &t, unsigned ms)
 	   modifies the timeout during avahi_client_free() */
 	assert(IsInsideOrNull());
 
-	timers.insert(TimerRecord(t, now_ms + ms));
+	timers.Insert(t, now_ms + ms);
 	again = true;
 }
 
@@ -113,12 +117,7 @@ EventLoop::CancelTimer(TimeoutMonitor &t)
 {
 	assert(IsInsideOrNull());
 
-	for (auto i = timers.begin(), end = timers.end(); i != end; ++i) {
-		if (&i->timer == &t) {
-			timers.erase(i);
-			return;
-		}
-	}
+	timers.Remove(t);
 }
 
 void
@@ -137,36 +136,30 @@ EventLoop::Run()
 	assert(busy);
 
 	do {
-		now_ms = ::MonotonicClockMS();
+		now_ms = GetMonotonicTime();
 		again = false;
 
 		/* invoke timers */
 
-		int timeout_ms;
-		while (true) {
-			auto i = timers.begin();
-			if (i == timers.end()) {
-				timeout_ms = -1;
-				break;
-			}
-
-			timeout_ms = i->due_ms - now_ms;
-			if (timeout_ms > 0)
-				break;
-
-			TimeoutMonitor &m = i->timer;
-			timers.erase(i);
-
+		TimerWheel::Item *item;
+		while ((item = timers.Pop(now_ms)) != nullptr) {
+			TimeoutMonitor &m = static_cast<TimeoutMonitor &>(*item);
 			m.Run();
 
 			if (quit)
 				return;
 		}
 
+		int timeout_ms = -1;
+		const uint64_t next_timer = timers.GetNextEvent();
+		if (next_timer != UINT64_MAX)
+			timeout_ms = std::min<uint64_t>(next_timer - now_ms,
+							INT_MAX);
+
 		/* invoke idle */
 
 		while (!idle.empty()) {
-			IdleMonitor &m = *idle.front();
+			IdleMonitor &m = idle.front();
 			idle.pop_front();
 			m.Run();
 
@@ -192,7 +185,7 @@ EventLoop::Run()
 
 		poll_group.ReadEvents(poll_result, timeout_ms);
 
-		now_ms = ::MonotonicClockMS();
+		now_ms = GetMonotonicTime();
 
 		mutex.lock();
 		busy = true;
@@ -230,15 +223,12 @@ EventLoop::AddDeferred(DeferredMonitor &d)
 		return;
 	}
 
-	assert(std::find(deferred.begin(),
-			 deferred.end(), &d) == deferred.end());
-
 	/* we don't need to wake up the EventLoop if another
 	   DeferredMonitor has already done it */
 	const bool must_wake = !busy && deferred.empty();
 
 	d.pending = true;
-	deferred.push_back(&d);
+	deferred.push_back(d);
 	again = true;
 	mutex.unlock();
 
@@ -251,25 +241,18 @@ EventLoop::RemoveDeferred(DeferredMonitor &d)
 {
 	const ScopeLock protect(mutex);
 
-	if (!d.pending) {
-		assert(std::find(deferred.begin(),
-				 deferred.end(), &d) == deferred.end());
+	if (!d.pending)
 		return;
-	}
 
 	d.pending = false;
-
-	auto i = std::find(deferred.begin(), deferred.end(), &d);
-	assert(i != deferred.end());
-
-	deferred.erase(i);
+	deferred.erase(deferred.iterator_to(d));
 }
 
 void
 EventLoop::HandleDeferred()
 {
 	while (!deferred.empty() && !quit) {
-		DeferredMonitor &m = *deferred.front();
+		DeferredMonitor &m = deferred.front();
 		assert(m.pending);
 
 		deferred.pop_front();
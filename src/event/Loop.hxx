@@ -28,13 +28,15 @@
 #include "thread/Mutex.hxx"
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
+#include "TimerWheel.hxx"
+#include "IdleMonitor.hxx"
+#include "DeferredMonitor.hxx"
 
-#include <list>
-#include <set>
+#include <boost/intrusive/list.hpp>
+
+#include <stdint.h>
 
 class TimeoutMonitor;
-class IdleMonitor;
-class DeferredMonitor;
 class SocketMonitor;
 
 #include <assert.h>
@@ -50,37 +52,30 @@ class SocketMonitor;
  */
 class EventLoop final : SocketMonitor
 {
-	struct TimerRecord {
-		/**
-		 * Projected monotonic_clock_ms() value when this
-		 * timer is due.
-		 */
-		const unsigned due_ms;
-
-		TimeoutMonitor &timer;
-
-		constexpr TimerRecord(TimeoutMonitor &_timer,
-				      unsigned _due_ms)
-			:due_ms(_due_ms), timer(_timer) {}
-
-		bool operator<(const TimerRecord &other) const {
-			return due_ms < other.due_ms;
-		}
-
-		bool IsDue(unsigned _now_ms) const {
-			return _now_ms >= due_ms;
-		}
-	};
+	typedef boost::intrusive::list<IdleMonitor,
+				       boost::intrusive::member_hook<IdleMonitor,
+								     IdleMonitor::ListHook,
+								     &IdleMonitor::list_hook>,
+				       boost::intrusive::constant_time_size<false>> IdleList;
+
+	typedef boost::intrusive::list<DeferredMonitor,
+				       boost::intrusive::member_hook<DeferredMonitor,
+								     DeferredMonitor::ListHook,
+								     &DeferredMonitor::list_hook>,
+				       boost::intrusive::constant_time_size<false>> DeferredList;
 
 	WakeFD wake_fd;
 
-	std::multiset<TimerRecord> timers;
-	std::list<IdleMonitor *> idle;
+	/**
+	 * The current time in milliseconds; see GetMonotonicTime().
+	 */
+	uint64_t now_ms;
 
-	Mutex mutex;
-	std::list<DeferredMonitor *> deferred;
+	TimerWheel timers;
+	IdleList idle;
 
-	unsigned now_ms;
+	Mutex mutex;
+	DeferredList deferred;
 
 	bool quit;
 
@@ -124,7 +119,7 @@ public:
 	unsigned GetTimeMS() const {
 		assert(IsInside());
 
-		return now_ms;
+		return unsigned(now_ms);
 	}
 
 	/**
@@ -183,6 +178,13 @@ public:
 	void Run();
 
 private:
+	/**
+	 * A 64 bit monotonic clock in milliseconds, which (unlike
+	 * MonotonicClockMS()) never wraps around.
+	 */
+	gcc_pure
+	static uint64_t GetMonotonicTime();
+
 	/**
 	 * Invoke all pending DeferredMonitors.
 	 *
@@ -191,7 +191,7 @@ OneServerSocket::Open(Error &error)
 
 	int _fd = socket_bind_listen(address.GetFamily(),
 				     SOCK_STREAM, 0,
-				     address, 5,
+				     address, 64,
 				     error);
 	if (_fd < 0)
 		return false;
@@ -24,6 +24,7 @@
 #include "Compiler.h"
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <winsock2.h>
@@ -130,3 +131,42 @@ SocketMonitor::Write(const void *data, size_t length)
 
 	return send(Get(), (const char *)data, length, flags);
 }
+
+SocketMonitor::ssize_t
+SocketMonitor::Write(const struct iovec *iov, size_t n)
+{
+	assert(IsDefined());
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+#ifdef WIN32
+	/* no sendmsg(): send the buffers one by one until the socket
+	   buffer is full */
+	ssize_t total = 0;
+	for (size_t i = 0; i < n; ++i) {
+		ssize_t nbytes = send(Get(), (const char *)iov[i].iov_base,
+				      iov[i].iov_len, flags);
+		if (nbytes < 0)
+			return total > 0 ? total : nbytes;
+
+		total += nbytes;
+		if (size_t(nbytes) < iov[i].iov_len)
+			break;
+	}
+
+	return total;
+#else
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec *>(iov);
+	msg.msg_iovlen = n;
+
+	return sendmsg(Get(), &msg, flags);
+#endif
+}
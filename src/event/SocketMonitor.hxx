@@ -28,6 +28,15 @@
 #include <assert.h>
 #include <stddef.h>
 
+#ifdef WIN32
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
 #ifdef WIN32
 /* ERROR is a WIN32 macro that poisons our namespace; this is a kludge
    to allow us to use it anyway */
@@ -136,6 +145,12 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+	/**
+	 * Sends several buffers with one system call ("gather
+	 * write").
+	 */
+	ssize_t Write(const struct iovec *iov, size_t n);
+
 protected:
 	/**
 	 * @return false if the socket has been closed
@@ -21,6 +21,7 @@
 #define MPD_SOCKET_TIMEOUT_MONITOR_HXX
 
 #include "check.h"
+#include "TimerWheel.hxx"
 
 class EventLoop;
 
@@ -32,7 +33,7 @@ class EventLoop;
  * thread that runs the #EventLoop, except where explicitly documented
  * as thread-safe.
  */
-class TimeoutMonitor {
+class TimeoutMonitor : TimerWheel::Item {
 	friend class EventLoop;
 
 	EventLoop &loop;
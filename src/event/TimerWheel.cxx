@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "TimerWheel.hxx"
+
+#include <assert.h>
+
+gcc_const
+static inline unsigned
+FindFirstBit(uint64_t mask)
+{
+	assert(mask != 0);
+
+	return __builtin_ctzll(mask);
+}
+
+unsigned
+TimerWheel::CalcIndex(uint64_t due) const
+{
+	if (due < current)
+		due = current;
+
+	/* find the lowest level where the due time and the current
+	   time share the same slot in the level above */
+	for (unsigned level = 0; level < LEVELS; ++level) {
+		const unsigned shift = (level + 1) * BITS;
+		if ((due >> shift) == (current >> shift))
+			return level * SLOTS + ((due >> (level * BITS)) & MASK);
+	}
+
+	return OVERFLOW_INDEX;
+}
+
+inline void
+TimerWheel::Link(Item &item)
+{
+	const unsigned index = CalcIndex(item.due);
+	item.index = index;
+	slots[index].push_back(item);
+
+	if (index < OVERFLOW_INDEX)
+		occupied[index / SLOTS] |= uint64_t(1) << (index % SLOTS);
+
+	++size;
+}
+
+inline void
+TimerWheel::Unlink(Item &item)
+{
+	assert(size > 0);
+
+	const unsigned index = item.index;
+	List &list = slots[index];
+	list.erase(list.iterator_to(item));
+
+	if (index < OVERFLOW_INDEX && list.empty())
+		occupied[index / SLOTS] &= ~(uint64_t(1) << (index % SLOTS));
+
+	--size;
+}
+
+void
+TimerWheel::Insert(Item &item, uint64_t due)
+{
+	item.due = due;
+	Link(item);
+}
+
+void
+TimerWheel::Remove(Item &item)
+{
+	Unlink(item);
+}
+
+uint64_t
+TimerWheel::GetNextEvent() const
+{
+	if (size == 0)
+		return UINT64_MAX;
+
+	/* the lowest non-empty slot is the next event: on level 0,
+	   its timers are due; on the upper levels, it needs to be
+	   cascaded at the beginning of its time range */
+	for (unsigned level = 0; level < LEVELS; ++level) {
+		const unsigned shift = level * BITS;
+		const unsigned i = (current >> shift) & MASK;
+
+		/* on the upper levels, the current slot has already
+		   been cascaded */
+		uint64_t mask = occupied[level] & (~uint64_t(0) << i);
+		if (level > 0)
+			mask &= ~(uint64_t(1) << i);
+
+		if (mask != 0) {
+			const unsigned parent_shift = shift + BITS;
+			const uint64_t base = current >> parent_shift
+				<< parent_shift;
+			return base + (uint64_t(FindFirstBit(mask)) << shift);
+		}
+	}
+
+	/* only the overflow list is left; it gets cascaded when the
+	   top level wraps around */
+	constexpr unsigned shift = LEVELS * BITS;
+	return ((current >> shift) + 1) << shift;
+}
+
+void
+TimerWheel::Cascade(unsigned index)
+{
+	List tmp;
+	tmp.swap(slots[index]);
+
+	if (index < OVERFLOW_INDEX)
+		occupied[index / SLOTS] &= ~(uint64_t(1) << (index % SLOTS));
+
+	while (!tmp.empty()) {
+		Item &item = tmp.front();
+		tmp.pop_front();
+		--size;
+
+		Link(item);
+	}
+}
+
+void
+TimerWheel::Advance(uint64_t now)
+{
+	assert(now > current);
+
+	current = now;
+
+	if ((now & ((uint64_t(1) << (LEVELS * BITS)) - 1)) == 0)
+		Cascade(OVERFLOW_INDEX);
+
+	/* cascade from the top down, because the upper levels may
+	   refill the slots below */
+	for (unsigned level = LEVELS - 1; level > 0; --level) {
+		const unsigned shift = level * BITS;
+		if ((now & ((uint64_t(1) << shift) - 1)) == 0)
+			Cascade(level * SLOTS + ((now >> shift) & MASK));
+	}
+}
+
+TimerWheel::Item *
+TimerWheel::Pop(uint64_t now)
+{
+	assert(now >= current);
+
+	while (size > 0) {
+		List &list = slots[current & MASK];
+		if (!list.empty()) {
+			Item &item = list.front();
+			Unlink(item);
+			return &item;
+		}
+
+		const uint64_t next = GetNextEvent();
+		if (next > now)
+			break;
+
+		Advance(next);
+	}
+
+	/* nothing is due; skip the empty range to keep the upper
+	   levels short for new timers */
+	if (now > current)
+		Advance(now);
+
+	return nullptr;
+}
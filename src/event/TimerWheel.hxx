@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EVENT_TIMER_WHEEL_HXX
+#define MPD_EVENT_TIMER_WHEEL_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <stdint.h>
+
+/**
+ * A hierarchical timer wheel.  It stores timers in #LEVELS levels
+ * of #SLOTS buckets each; level 0 has a resolution of one
+ * millisecond, and each level above is #SLOTS times coarser.  Adding
+ * and removing a timer is O(1) and never allocates memory, because
+ * the list hook is embedded in the #TimerWheel::Item.  Timers in the
+ * upper levels are moved ("cascaded") to lower levels as the wheel
+ * approaches their due time.
+ *
+ * All times are 64 bit milliseconds, therefore the wheel does not
+ * need to care about wraparound.
+ *
+ * This class is not thread-safe.
+ */
+class TimerWheel {
+	static constexpr unsigned BITS = 6;
+	static constexpr unsigned SLOTS = 1u << BITS;
+	static constexpr unsigned MASK = SLOTS - 1;
+	static constexpr unsigned LEVELS = 6;
+
+	/**
+	 * The index used for timers which are too far in the future
+	 * for the top level.
+	 */
+	static constexpr unsigned OVERFLOW_INDEX = LEVELS * SLOTS;
+
+public:
+	class Item {
+		friend class TimerWheel;
+
+		typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> Hook;
+
+		Hook hook;
+
+		/**
+		 * The time when this item is due.
+		 */
+		uint64_t due;
+
+		/**
+		 * The index of the bucket in TimerWheel::slots this
+		 * item is linked into.
+		 */
+		unsigned index;
+
+	public:
+		uint64_t GetDue() const {
+			return due;
+		}
+	};
+
+private:
+	typedef boost::intrusive::list<Item,
+				       boost::intrusive::member_hook<Item,
+								     Item::Hook,
+								     &Item::hook>,
+				       boost::intrusive::constant_time_size<false>> List;
+
+	/**
+	 * All timers due before this time have been returned by
+	 * Pop().  The wheel's slots are relative to this time.
+	 */
+	uint64_t current;
+
+	/**
+	 * The number of linked items.
+	 */
+	unsigned size;
+
+	/**
+	 * One bit for each non-empty slot per level.
+	 */
+	uint64_t occupied[LEVELS];
+
+	List slots[LEVELS * SLOTS + 1];
+
+public:
+	explicit TimerWheel(uint64_t now)
+		:current(now), size(0), occupied() {}
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	bool IsEmpty() const {
+		return size == 0;
+	}
+
+	/**
+	 * Schedule the given item, which must not be scheduled
+	 * already.  A due time in the past is treated as "now".
+	 */
+	void Insert(Item &item, uint64_t due);
+
+	/**
+	 * Unschedule the given item, which must be scheduled.
+	 */
+	void Remove(Item &item);
+
+	/**
+	 * Return the next item which is due at the given time and
+	 * remove it from the wheel, or nullptr if there is none.
+	 * The time must not be smaller than in the previous call.
+	 */
+	Item *Pop(uint64_t now);
+
+	/**
+	 * Returns a time until which nothing is going to happen: it
+	 * is not later than the earliest due time, and may be
+	 * earlier when timers need to be cascaded first.  Returns
+	 * UINT64_MAX if the wheel is empty.
+	 */
+	gcc_pure
+	uint64_t GetNextEvent() const;
+
+private:
+	/**
+	 * Determine the bucket index for the given due time, relative
+	 * to #current.
+	 */
+	gcc_pure
+	unsigned CalcIndex(uint64_t due) const;
+
+	void Link(Item &item);
+	void Unlink(Item &item);
+
+	/**
+	 * Advance #current to the given time, and cascade the slots
+	 * which begin at that time.
+	 */
+	void Advance(uint64_t now);
+
+	void Cascade(unsigned index);
+};
+
+#endif
@@ -28,6 +28,7 @@
 
 #ifdef WIN32
 #include <fileapi.h>
+#include <winbase.h>
 #endif
 
 #include <sys/stat.h>
@@ -88,6 +89,24 @@ RenameFile(Path oldpath, Path newpath)
 #endif
 }
 
+/**
+ * Rename a file, replacing #newpath if it exists already.  This is
+ * what rename() does on POSIX, but _trename() fails on WIN32 if the
+ * target exists.
+ *
+ * On WIN32, errors are reported with GetLastError() instead of errno.
+ */
+static inline bool
+RenameFileReplace(Path oldpath, Path newpath)
+{
+#ifdef WIN32
+	return MoveFileEx(oldpath.c_str(), newpath.c_str(),
+			  MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return RenameFile(oldpath, newpath);
+#endif
+}
+
 #ifndef WIN32
 
 /**
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MappedFile.hxx"
+#include "FileReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#ifdef WIN32
+#include <stdlib.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static constexpr Domain mapped_file_domain("mapped_file");
+
+/**
+ * A dummy pointer for empty files, which cannot be mapped.
+ */
+static char empty_file;
+
+MappedFile::MappedFile(Path path, Error &error)
+	:data(nullptr), size(0)
+{
+	FileReader reader(path, error);
+	if (!reader.IsDefined())
+		return;
+
+	FileInfo info;
+	if (!reader.GetFileInfo(info, error))
+		return;
+
+	const uint64_t file_size = info.GetSize();
+	if (file_size != size_t(file_size)) {
+		error.Set(mapped_file_domain, "File is too large");
+		return;
+	}
+
+	if (file_size == 0) {
+		data = &empty_file;
+		return;
+	}
+
+#ifdef WIN32
+	data = malloc(file_size);
+	if (data == nullptr) {
+		error.Set(mapped_file_domain, "Out of memory");
+		return;
+	}
+
+	while (size < file_size) {
+		size_t nbytes = reader.Read((char *)data + size,
+					    file_size - size, error);
+		if (nbytes == 0) {
+			if (!error.IsDefined())
+				error.Set(mapped_file_domain,
+					  "Unexpected end of file");
+			free(data);
+			data = nullptr;
+			size = 0;
+			return;
+		}
+
+		size += nbytes;
+	}
+#else
+	void *p = mmap(nullptr, file_size, PROT_READ, MAP_SHARED,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED) {
+		error.SetErrno("Failed to map file");
+		return;
+	}
+
+	data = p;
+	size = file_size;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	if (data == nullptr || data == &empty_file)
+		return;
+
+#ifdef WIN32
+	free(data);
+#else
+	munmap(data, size);
+#endif
+}
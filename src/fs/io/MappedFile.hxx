@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MAPPED_FILE_HXX
+#define MPD_MAPPED_FILE_HXX
+
+#include "check.h"
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+class Path;
+class Error;
+
+/**
+ * Map a whole file into memory (read-only).  On systems without
+ * mmap(), the file contents are read into a heap buffer instead.
+ */
+class MappedFile {
+	void *data;
+	size_t size;
+
+public:
+	/**
+	 * Check IsDefined() to see whether the file was mapped
+	 * successfully.
+	 */
+	MappedFile(Path path, Error &error);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool IsDefined() const {
+		return data != nullptr;
+	}
+
+	ConstBuffer<void> Get() const {
+		return { data, size };
+	}
+};
+
+#endif
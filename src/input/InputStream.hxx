@@ -29,6 +29,7 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <time.h>
 
 class Cond;
 class Error;
@@ -84,6 +85,12 @@ protected:
 	 */
 	offset_type size;
 
+	/**
+	 * the time of the last modification of the resource, or 0 if
+	 * unknown
+	 */
+	time_t mtime;
+
 	/**
 	 * the current offset within the stream
 	 */
@@ -100,7 +107,7 @@ public:
 		:uri(_uri),
 		 mutex(_mutex), cond(_cond),
 		 ready(false), seekable(false),
-		 size(UNKNOWN_SIZE), offset(0) {
+		 size(UNKNOWN_SIZE), mtime(0), offset(0) {
 		assert(_uri != nullptr);
 	}
 
@@ -232,6 +239,17 @@ public:
 		return size;
 	}
 
+	/**
+	 * Returns the time of the last modification of the resource,
+	 * or 0 if that is not known.
+	 */
+	gcc_pure
+	time_t GetModificationTime() const {
+		assert(ready);
+
+		return mtime;
+	}
+
 	void AddOffset(offset_type delta) {
 		assert(ready);
 
@@ -43,6 +43,7 @@ ProxyInputStream::CopyAttributes()
 			size = input.KnownSize()
 				? input.GetSize()
 				: UNKNOWN_SIZE;
+			mtime = input.GetModificationTime();
 
 			seekable = input.IsSeekable();
 			SetReady();
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "RangeCache.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+RangeCache::Block *
+RangeCache::Add(offset_type number)
+{
+	assert(blocks.find(number) == blocks.end());
+
+	std::unique_ptr<uint8_t[]> data;
+
+	if (blocks.size() >= max_blocks) {
+		auto lru = blocks.end();
+		for (auto i = blocks.begin(); i != blocks.end(); ++i)
+			if (!i->second.pinned &&
+			    (lru == blocks.end() ||
+			     i->second.last_used < lru->second.last_used))
+				lru = i;
+
+		if (lru == blocks.end())
+			return nullptr;
+
+		/* recycle the buffer of the discarded block */
+		data = std::move(lru->second.data);
+		blocks.erase(lru);
+	} else
+		data.reset(new uint8_t[BLOCK_SIZE]);
+
+	Block &block = blocks[number];
+	block.data = std::move(data);
+	block.fill = 0;
+	block.last_used = ++clock;
+	block.pinned = false;
+	return &block;
+}
+
+void
+RangeCache::Write(offset_type offset, const void *_data, size_t size,
+		  bool pin)
+{
+	if (max_blocks == 0)
+		return;
+
+	const uint8_t *data = (const uint8_t *)_data;
+
+	while (size > 0) {
+		const offset_type number = offset / BLOCK_SIZE;
+		const size_t position = offset % BLOCK_SIZE;
+		const size_t chunk = std::min(size, BLOCK_SIZE - position);
+
+		auto i = blocks.find(number);
+		Block *block;
+		if (i != blocks.end())
+			block = &i->second;
+		else if (position == 0)
+			block = Add(number);
+		else
+			block = nullptr;
+
+		if (block != nullptr && pin)
+			block->pinned = true;
+
+		if (block != nullptr && position <= block->fill &&
+		    position + chunk > block->fill) {
+			/* this chunk continues the filled part of the
+			   block; skip the part which is already
+			   there */
+			const size_t skip = block->fill - position;
+			memcpy(block->data.get() + block->fill,
+			       data + skip, chunk - skip);
+			block->fill += chunk - skip;
+		}
+
+		offset += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+size_t
+RangeCache::Read(offset_type offset, void *_dest, size_t size)
+{
+	uint8_t *dest = (uint8_t *)_dest;
+	size_t result = 0;
+
+	while (size > 0) {
+		const offset_type number = offset / BLOCK_SIZE;
+		const size_t position = offset % BLOCK_SIZE;
+
+		auto i = blocks.find(number);
+		if (i == blocks.end() || position >= i->second.fill)
+			break;
+
+		Block &block = i->second;
+		block.last_used = ++clock;
+
+		const size_t chunk = std::min(size, block.fill - position);
+		memcpy(dest, block.data.get() + position, chunk);
+
+		offset += chunk;
+		dest += chunk;
+		size -= chunk;
+		result += chunk;
+
+		if (position + chunk < BLOCK_SIZE)
+			/* the rest of this block is missing (or the
+			   caller's buffer is full) */
+			break;
+	}
+
+	return result;
+}
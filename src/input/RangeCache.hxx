@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RANGE_CACHE_HXX
+#define MPD_RANGE_CACHE_HXX
+
+#include "check.h"
+#include "Offset.hxx"
+#include "Compiler.h"
+
+#include <map>
+#include <memory>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A small cache for portions of a remote file which have been
+ * received already.  It allows an #InputStream implementation to
+ * serve a seek without sending a new request.
+ *
+ * The file is divided into blocks of #BLOCK_SIZE bytes.  A block is
+ * filled from its beginning; data which doesn't continue the filled
+ * part of a block is not cached.  When the cache is full, the least
+ * recently used block which is not "pinned" is discarded.
+ *
+ * This class is not thread-safe.
+ */
+class RangeCache {
+public:
+	static constexpr size_t BLOCK_SIZE = 32 * 1024;
+
+private:
+	struct Block {
+		std::unique_ptr<uint8_t[]> data;
+
+		/**
+		 * The number of valid bytes at the beginning of
+		 * #data.
+		 */
+		size_t fill;
+
+		unsigned last_used;
+
+		/**
+		 * Never discard this block?
+		 */
+		bool pinned;
+	};
+
+	/**
+	 * Key is the block number (the file offset divided by
+	 * #BLOCK_SIZE).
+	 */
+	std::map<offset_type, Block> blocks;
+
+	const size_t max_blocks;
+
+	/**
+	 * Incremented for each access; used to find the least
+	 * recently used block.
+	 */
+	unsigned clock;
+
+public:
+	explicit RangeCache(size_t max_size)
+		:max_blocks(max_size / BLOCK_SIZE), clock(0) {}
+
+	RangeCache(const RangeCache &) = delete;
+	RangeCache &operator=(const RangeCache &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const {
+		return blocks.empty();
+	}
+
+	void Clear() {
+		blocks.clear();
+	}
+
+	/**
+	 * Store data which has been received at the given file
+	 * offset.
+	 *
+	 * @param pin never discard the blocks containing this data;
+	 * this is meant for small ranges which will likely be
+	 * accessed again, such as the end of the file
+	 */
+	void Write(offset_type offset, const void *data, size_t size,
+		   bool pin=false);
+
+	/**
+	 * Copy contiguous cached data starting at the given file
+	 * offset.
+	 *
+	 * @return the number of bytes copied; 0 if there is no cached
+	 * data at this offset
+	 */
+	size_t Read(offset_type offset, void *dest, size_t size);
+
+private:
+	/**
+	 * Create a new (empty) block, discarding the least recently
+	 * used one if the cache is full.
+	 *
+	 * @return the new block or nullptr if all blocks are pinned
+	 */
+	Block *Add(offset_type number);
+};
+
+#endif
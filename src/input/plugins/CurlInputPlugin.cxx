@@ -20,6 +20,7 @@
 #include "config.h"
 #include "CurlInputPlugin.hxx"
 #include "../AsyncInputStream.hxx"
+#include "../RangeCache.hxx"
 #include "../IcyInputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "config/ConfigGlobal.hxx"
@@ -28,8 +29,10 @@
 #include "tag/TagBuilder.hxx"
 #include "event/SocketMonitor.hxx"
 #include "event/TimeoutMonitor.hxx"
+#include "event/DeferredMonitor.hxx"
 #include "event/Call.hxx"
 #include "IOThread.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringUtil.hxx"
 #include "util/NumberParser.hxx"
@@ -60,7 +63,43 @@ static const size_t CURL_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t CURL_RESUME_AT = 384 * 1024;
 
-struct CurlInputStream final : public AsyncInputStream {
+/**
+ * Remember this number of bytes which have been received from a
+ * seekable stream.  Seeking to data which is still there does not
+ * need a new request.
+ */
+static const size_t CURL_RANGE_CACHE_SIZE = 1024 * 1024;
+
+/**
+ * Fetch this number of bytes from the end of a seekable file in a
+ * parallel request.  Many decoders and tag parsers look there
+ * (ID3v1, APE, the MP4 "moov" atom) before playing from the
+ * beginning.
+ */
+static const size_t CURL_PREFETCH_TAIL = 64 * 1024;
+
+/**
+ * Don't prefetch the end of files smaller than this.
+ */
+static const offset_type CURL_PREFETCH_MIN_SIZE = 1024 * 1024;
+
+/**
+ * An object which owns a CURL "easy" handle registered in the
+ * #CurlMulti.  A pointer to it is stored in CURLOPT_PRIVATE.
+ */
+class CurlRequestHandler {
+public:
+	/**
+	 * A HTTP request is finished.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	virtual void RequestDone(CURLcode result, long status) = 0;
+};
+
+class CurlPrefetch;
+
+struct CurlInputStream final : public AsyncInputStream, CurlRequestHandler {
 	/* some buffers which were passed to libcurl, which we have
 	   too free */
 	char range[32];
@@ -75,13 +114,41 @@ struct CurlInputStream final : public AsyncInputStream {
 	/** parser for icy-metadata */
 	IcyInputStream *icy;
 
+	/**
+	 * Data which has been received from a seekable stream.
+	 * Only accessed in the I/O thread.
+	 */
+	RangeCache range_cache;
+
+	/**
+	 * The file offset where the current request started.  It is
+	 * 0 for the initial request.
+	 */
+	offset_type request_offset;
+
+	/**
+	 * The file offset of the next byte to be received by the
+	 * current request.
+	 */
+	offset_type fetch_offset;
+
+	/**
+	 * The parallel request fetching the end of the file, or
+	 * nullptr if none was started.  Only accessed in the I/O
+	 * thread.
+	 */
+	CurlPrefetch *prefetch;
+
 	CurlInputStream(const char *_url, Mutex &_mutex, Cond &_cond,
 			void *_buffer)
 		:AsyncInputStream(_url, _mutex, _cond,
 				  _buffer, CURL_MAX_BUFFERED,
 				  CURL_RESUME_AT),
 		 request_headers(nullptr),
-		 icy(new IcyInputStream(this)) {}
+		 icy(new IcyInputStream(this)),
+		 range_cache(CURL_RANGE_CACHE_SIZE),
+		 request_offset(0), fetch_offset(0),
+		 prefetch(nullptr) {}
 
 	~CurlInputStream();
 
@@ -109,6 +176,16 @@ struct CurlInputStream final : public AsyncInputStream {
 	 */
 	void FreeEasyIndirect();
 
+	/**
+	 * Shall the headers of the current response update the
+	 * stream's metadata?  Only the initial request may do that;
+	 * the response to a "Range" request describes only a portion
+	 * of the file.
+	 */
+	bool IsInitialRequest() const {
+		return request_offset == 0 && !IsSeekPending();
+	}
+
 	/**
 	 * Called when a new response begins.  This is used to discard
 	 * headers from previous responses (for example authentication
@@ -121,17 +198,86 @@ struct CurlInputStream final : public AsyncInputStream {
 	size_t DataReceived(const void *ptr, size_t size);
 
 	/**
-	 * A HTTP request is finished.
+	 * Start fetching the end of the file in a parallel request,
+	 * if that is worth it.
 	 *
-	 * Runs in the I/O thread.  The caller must not hold locks.
+	 * Runs in the I/O thread.  Caller must hold the mutex.
 	 */
-	void RequestDone(CURLcode result, long status);
+	void StartPrefetch();
+
+	/**
+	 * Copy data at the given offset from the #RangeCache to the
+	 * (empty) buffer.
+	 *
+	 * Runs in the I/O thread.  Caller must hold the mutex.
+	 *
+	 * @return the number of bytes copied
+	 */
+	size_t FillBufferFromCache(offset_type start);
+
+	/* virtual methods from CurlRequestHandler */
+	void RequestDone(CURLcode result, long status) override;
 
 	/* virtual methods from AsyncInputStream */
 	virtual void DoResume() override;
 	virtual void DoSeek(offset_type new_offset) override;
 };
 
+/**
+ * A "Range" request which runs in parallel to the main transfer of a
+ * #CurlInputStream and stores the end of the file in its
+ * #RangeCache.  A decoder which looks there can then seek back and
+ * forth without interrupting the main transfer.
+ *
+ * All methods run in the I/O thread.
+ */
+class CurlPrefetch final : public CurlRequestHandler, DeferredMonitor {
+	const std::string url;
+
+	RangeCache &cache;
+
+	/**
+	 * The file offset of the next byte to be received.
+	 */
+	offset_type offset;
+
+	char range[32];
+
+	CURL *easy;
+
+	/** error message provided by libcurl */
+	char error_buffer[CURL_ERROR_SIZE];
+
+public:
+	CurlPrefetch(EventLoop &_loop, const char *_url,
+		     RangeCache &_cache, offset_type _offset)
+		:DeferredMonitor(_loop), url(_url),
+		 cache(_cache), offset(_offset), easy(nullptr) {}
+
+	~CurlPrefetch() {
+		Free();
+	}
+
+	/**
+	 * Submit the request.  This is deferred, because libcurl
+	 * doesn't allow adding a handle from within its callbacks.
+	 */
+	void Start() {
+		DeferredMonitor::Schedule();
+	}
+
+	size_t DataReceived(const void *ptr, size_t size);
+
+	/* virtual methods from CurlRequestHandler */
+	void RequestDone(CURLcode result, long status) override;
+
+private:
+	void Free();
+
+	/* virtual methods from DeferredMonitor */
+	void RunDeferred() override;
+};
+
 class CurlMulti;
 
 /**
@@ -204,8 +350,8 @@ public:
 		curl_multi_cleanup(multi);
 	}
 
-	bool Add(CurlInputStream *c, Error &error);
-	void Remove(CurlInputStream *c);
+	bool Add(CURL *easy, Error &error);
+	void Remove(CURL *easy);
 
 	/**
 	 * Check for finished HTTP responses.
@@ -256,6 +402,19 @@ static bool verify_peer, verify_host;
 
 static CurlMulti *curl_multi;
 
+/**
+ * Shares the DNS cache and the TLS sessions between all requests, so
+ * a new connection to a known host (for example after seeking) skips
+ * the name lookup and resumes the TLS session.
+ */
+static CURLSH *curl_share;
+
+/**
+ * Protects the data shared by #curl_share.  Easy handles are
+ * configured outside of the I/O thread.
+ */
+static Mutex curl_share_mutex[CURL_LOCK_DATA_LAST];
+
 static constexpr Domain http_domain("http");
 static constexpr Domain curl_domain("curl");
 static constexpr Domain curlm_domain("curlm");
@@ -269,6 +428,12 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
 
 	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, TimerFunction);
 	curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* run concurrent requests to the same server (the prefetch,
+	   the next song) as HTTP/2 streams on one connection */
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
 }
 
 /**
@@ -277,7 +442,7 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
  * Runs in the I/O thread.  No lock needed.
  */
 gcc_pure
-static CurlInputStream *
+static CurlRequestHandler *
 input_curl_find_request(CURL *easy)
 {
 	assert(io_thread_inside());
@@ -287,7 +452,7 @@ input_curl_find_request(CURL *easy)
 	if (code != CURLE_OK)
 		return nullptr;
 
-	return (CurlInputStream *)p;
+	return (CurlRequestHandler *)p;
 }
 
 void
@@ -360,13 +525,12 @@ CurlSocket::OnSocketReady(unsigned flags)
  * Runs in the I/O thread.  No lock needed.
  */
 inline bool
-CurlMulti::Add(CurlInputStream *c, Error &error)
+CurlMulti::Add(CURL *easy, Error &error)
 {
 	assert(io_thread_inside());
-	assert(c != nullptr);
-	assert(c->easy != nullptr);
+	assert(easy != nullptr);
 
-	CURLMcode mcode = curl_multi_add_handle(multi, c->easy);
+	CURLMcode mcode = curl_multi_add_handle(multi, easy);
 	if (mcode != CURLM_OK) {
 		error.Format(curlm_domain, mcode,
 			     "curl_multi_add_handle() failed: %s",
@@ -383,22 +547,21 @@ CurlMulti::Add(CurlInputStream *c, Error &error)
  * any thread.  Caller must not hold a mutex.
  */
 static bool
-input_curl_easy_add_indirect(CurlInputStream *c, Error &error)
+input_curl_easy_add_indirect(CURL *easy, Error &error)
 {
-	assert(c != nullptr);
-	assert(c->easy != nullptr);
+	assert(easy != nullptr);
 
 	bool result;
-	BlockingCall(io_thread_get(), [c, &error, &result](){
-			result = curl_multi->Add(c, error);
+	BlockingCall(io_thread_get(), [easy, &error, &result](){
+			result = curl_multi->Add(easy, error);
 		});
 	return result;
 }
 
 inline void
-CurlMulti::Remove(CurlInputStream *c)
+CurlMulti::Remove(CURL *easy)
 {
-	curl_multi_remove_handle(multi, c->easy);
+	curl_multi_remove_handle(multi, easy);
 }
 
 void
@@ -409,7 +572,7 @@ CurlInputStream::FreeEasy()
 	if (easy == nullptr)
 		return;
 
-	curl_multi->Remove(this);
+	curl_multi->Remove(easy);
 
 	curl_easy_cleanup(easy);
 	easy = nullptr;
@@ -429,7 +592,7 @@ CurlInputStream::FreeEasyIndirect()
 	assert(easy == nullptr);
 }
 
-inline void
+void
 CurlInputStream::RequestDone(CURLcode result, long status)
 {
 	assert(io_thread_inside());
@@ -460,7 +623,7 @@ CurlInputStream::RequestDone(CURLcode result, long status)
 static void
 input_curl_handle_done(CURL *easy_handle, CURLcode result)
 {
-	CurlInputStream *c = input_curl_find_request(easy_handle);
+	CurlRequestHandler *c = input_curl_find_request(easy_handle);
 	assert(c != nullptr);
 
 	long status = 0;
@@ -531,6 +694,21 @@ CurlMulti::OnTimeout()
 	SocketAction(CURL_SOCKET_TIMEOUT, 0);
 }
 
+static void
+input_curl_share_lock(gcc_unused CURL *handle, curl_lock_data data,
+		      gcc_unused curl_lock_access access,
+		      gcc_unused void *userptr)
+{
+	curl_share_mutex[data].lock();
+}
+
+static void
+input_curl_share_unlock(gcc_unused CURL *handle, curl_lock_data data,
+			gcc_unused void *userptr)
+{
+	curl_share_mutex[data].unlock();
+}
+
 /*
  * InputPlugin methods
  *
@@ -585,6 +763,21 @@ input_curl_init(const ConfigBlock &block, Error &error)
 	}
 
 	curl_multi = new CurlMulti(io_thread_get(), multi);
+
+	/* without the share, each request would have its own DNS
+	   and TLS session cache; that is not fatal */
+	curl_share = curl_share_init();
+	if (curl_share != nullptr) {
+		curl_share_setopt(curl_share, CURLSHOPT_LOCKFUNC,
+				  input_curl_share_lock);
+		curl_share_setopt(curl_share, CURLSHOPT_UNLOCKFUNC,
+				  input_curl_share_unlock);
+		curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+				  CURL_LOCK_DATA_DNS);
+		curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+				  CURL_LOCK_DATA_SSL_SESSION);
+	}
+
 	return InputPlugin::InitResult::SUCCESS;
 }
 
@@ -595,6 +788,11 @@ input_curl_finish(void)
 			delete curl_multi;
 		});
 
+	if (curl_share != nullptr) {
+		curl_share_cleanup(curl_share);
+		curl_share = nullptr;
+	}
+
 	curl_slist_free_all(http_200_aliases);
 	http_200_aliases = nullptr;
 
@@ -603,7 +801,11 @@ input_curl_finish(void)
 
 CurlInputStream::~CurlInputStream()
 {
-	FreeEasyIndirect();
+	BlockingCall(io_thread_get(), [this](){
+			delete prefetch;
+			FreeEasy();
+			curl_multi->InvalidateSockets();
+		});
 }
 
 inline void
@@ -612,7 +814,7 @@ CurlInputStream::ResponseBoundary()
 	/* undo all effects of HeaderReceived() because the previous
 	   response was not applicable for this stream */
 
-	if (IsSeekPending())
+	if (!IsInitialRequest())
 		/* don't update metadata while seeking */
 		return;
 
@@ -627,7 +829,7 @@ CurlInputStream::ResponseBoundary()
 inline void
 CurlInputStream::HeaderReceived(const char *name, std::string &&value)
 {
-	if (IsSeekPending())
+	if (!IsInitialRequest())
 		/* don't update metadata while seeking */
 		return;
 
@@ -720,9 +922,57 @@ CurlInputStream::DataReceived(const void *ptr, size_t received_size)
 	}
 
 	AppendToBuffer(ptr, received_size);
+
+	if (IsSeekable()) {
+		if (fetch_offset == 0)
+			StartPrefetch();
+
+		range_cache.Write(fetch_offset, ptr, received_size);
+	}
+
+	fetch_offset += received_size;
 	return received_size;
 }
 
+inline void
+CurlInputStream::StartPrefetch()
+{
+	assert(io_thread_inside());
+
+	if (prefetch != nullptr || !KnownSize() ||
+	    size < CURL_PREFETCH_MIN_SIZE)
+		return;
+
+	/* start at a block boundary, or the first block would not be
+	   cached */
+	const offset_type start = (size - CURL_PREFETCH_TAIL)
+		/ RangeCache::BLOCK_SIZE * RangeCache::BLOCK_SIZE;
+
+	prefetch = new CurlPrefetch(io_thread_get(), GetURI(), range_cache,
+				    start);
+	prefetch->Start();
+}
+
+inline size_t
+CurlInputStream::FillBufferFromCache(offset_type start)
+{
+	assert(io_thread_inside());
+
+	size_t result = 0;
+
+	uint8_t chunk[8192];
+	size_t nbytes;
+	while (GetBufferSpace() > 0 &&
+	       (nbytes = range_cache.Read(start + result, chunk,
+					  std::min(sizeof(chunk),
+						   GetBufferSpace()))) > 0) {
+		AppendToBuffer(chunk, nbytes);
+		result += nbytes;
+	}
+
+	return result;
+}
+
 /** called by curl when new data is available */
 static size_t
 input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
@@ -736,25 +986,23 @@ input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
 	return c.DataReceived(ptr, size);
 }
 
-bool
-CurlInputStream::InitEasy(Error &error)
+/**
+ * Create a CURL "easy" handle with the options common to all
+ * requests.
+ */
+static CURL *
+input_curl_new_easy(const char *url, CurlRequestHandler &handler,
+		    char *error_buffer, Error &error)
 {
-	easy = curl_easy_init();
+	CURL *easy = curl_easy_init();
 	if (easy == nullptr) {
 		error.Set(curl_domain, "curl_easy_init() failed");
-		return false;
+		return nullptr;
 	}
 
-	curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)this);
+	curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)&handler);
 	curl_easy_setopt(easy, CURLOPT_USERAGENT,
 			 "Music Player Daemon " VERSION);
-	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
-			 input_curl_headerfunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
-	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
-			 input_curl_writefunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
-	curl_easy_setopt(easy, CURLOPT_HTTP200ALIASES, http_200_aliases);
 	curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1l);
 	curl_easy_setopt(easy, CURLOPT_NETRC, 1l);
 	curl_easy_setopt(easy, CURLOPT_MAXREDIRS, 5l);
@@ -764,6 +1012,28 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1l);
 	curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10l);
 
+	if (curl_share != nullptr)
+		curl_easy_setopt(easy, CURLOPT_SHARE, curl_share);
+
+#if LIBCURL_VERSION_NUM >= 0x071900
+	/* keep idle connections in the pool alive for the next
+	   song */
+	curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1l);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	/* negotiate HTTP/2 on https:// connections; all requests to
+	   one server can then share a single connection */
+	curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+			 (long)CURL_HTTP_VERSION_2TLS);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* rather wait for a connection which may be multiplexed than
+	   open a new one */
+	curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1l);
+#endif
+
 	if (proxy != nullptr)
 		curl_easy_setopt(easy, CURLOPT_PROXY, proxy);
 
@@ -781,14 +1051,33 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
 
-	CURLcode code = curl_easy_setopt(easy, CURLOPT_URL, GetURI());
+	CURLcode code = curl_easy_setopt(easy, CURLOPT_URL, url);
 	if (code != CURLE_OK) {
+		curl_easy_cleanup(easy);
 		error.Format(curl_domain, code,
 			     "curl_easy_setopt() failed: %s",
 			     curl_easy_strerror(code));
-		return false;
+		return nullptr;
 	}
 
+	return easy;
+}
+
+bool
+CurlInputStream::InitEasy(Error &error)
+{
+	easy = input_curl_new_easy(GetURI(), *this, error_buffer, error);
+	if (easy == nullptr)
+		return false;
+
+	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
+			 input_curl_headerfunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_writefunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+	curl_easy_setopt(easy, CURLOPT_HTTP200ALIASES, http_200_aliases);
+
 	request_headers = nullptr;
 	request_headers = curl_slist_append(request_headers,
 					       "Icy-Metadata: 1");
@@ -802,24 +1091,38 @@ CurlInputStream::DoSeek(offset_type new_offset)
 {
 	assert(IsReady());
 
-	/* close the old connection and open a new one */
+	/* close the old connection */
 
 	mutex.unlock();
-
 	FreeEasyIndirect();
+	mutex.lock();
 
 	offset = new_offset;
-	if (offset == size) {
+
+	/* serve the beginning from the cache; the new request only
+	   needs to fetch what follows, and the caller doesn't have
+	   to wait for it */
+	request_offset = new_offset + FillBufferFromCache(new_offset);
+	if (request_offset > new_offset)
+		SeekDone();
+
+	if (request_offset == size) {
 		/* seek to EOF: simulate empty result; avoid
 		   triggering a "416 Requested Range Not Satisfiable"
 		   response */
-		mutex.lock();
-		SeekDone();
+		if (IsSeekPending())
+			SeekDone();
 		return;
 	}
 
+	/* open a new connection; after SeekDone(), the client may
+	   access the stream, so only I/O thread fields are touched
+	   without the mutex */
+
+	mutex.unlock();
+
 	Error error;
-	if (!InitEasy(postponed_error)) {
+	if (!InitEasy(error)) {
 		mutex.lock();
 		PostponeError(std::move(error));
 		return;
@@ -827,19 +1130,99 @@ CurlInputStream::DoSeek(offset_type new_offset)
 
 	/* send the "Range" header */
 
-	if (offset > 0) {
-		sprintf(range, "%lld-", (long long)offset);
+	if (request_offset > 0) {
+		sprintf(range, "%lld-", (long long)request_offset);
 		curl_easy_setopt(easy, CURLOPT_RANGE, range);
 	}
 
-	if (!input_curl_easy_add_indirect(this, error)) {
+	fetch_offset = request_offset;
+
+	if (!input_curl_easy_add_indirect(easy, error)) {
 		mutex.lock();
 		PostponeError(std::move(error));
 		return;
 	}
 
 	mutex.lock();
-	offset = new_offset;
+}
+
+size_t
+CurlPrefetch::DataReceived(const void *ptr, size_t size)
+{
+	long status = 0;
+	curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+	if (status != 206)
+		/* the server has ignored the "Range" header; don't
+		   download the whole file again */
+		return 0;
+
+	cache.Write(offset, ptr, size, true);
+	offset += size;
+	return size;
+}
+
+/** called by curl when new data is available */
+static size_t
+input_curl_prefetch_writefunction(void *ptr, size_t size, size_t nmemb,
+				  void *stream)
+{
+	CurlPrefetch &p = *(CurlPrefetch *)stream;
+
+	size *= nmemb;
+	if (size == 0)
+		return 0;
+
+	return p.DataReceived(ptr, size);
+}
+
+void
+CurlPrefetch::RunDeferred()
+{
+	assert(easy == nullptr);
+
+	Error error;
+	easy = input_curl_new_easy(url.c_str(), *this, error_buffer, error);
+	if (easy == nullptr) {
+		LogError(error);
+		return;
+	}
+
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_prefetch_writefunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+
+	sprintf(range, "%lld-", (long long)offset);
+	curl_easy_setopt(easy, CURLOPT_RANGE, range);
+
+	if (!curl_multi->Add(easy, error)) {
+		LogError(error);
+		Free();
+	}
+}
+
+void
+CurlPrefetch::RequestDone(CURLcode result, gcc_unused long status)
+{
+	if (result != CURLE_OK)
+		FormatDebug(curl_domain, "prefetch of %s failed: %s",
+			    url.c_str(), error_buffer);
+
+	Free();
+}
+
+void
+CurlPrefetch::Free()
+{
+	assert(io_thread_inside());
+
+	DeferredMonitor::Cancel();
+
+	if (easy == nullptr)
+		return;
+
+	curl_multi->Remove(easy);
+	curl_easy_cleanup(easy);
+	easy = nullptr;
 }
 
 inline InputStream *
@@ -854,7 +1237,8 @@ CurlInputStream::Open(const char *url, Mutex &mutex, Cond &cond,
 
 	CurlInputStream *c = new CurlInputStream(url, mutex, cond, buffer);
 
-	if (!c->InitEasy(error) || !input_curl_easy_add_indirect(c, error)) {
+	if (!c->InitEasy(error) ||
+	    !input_curl_easy_add_indirect(c->easy, error)) {
 		delete c;
 		return nullptr;
 	}
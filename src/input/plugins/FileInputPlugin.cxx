@@ -21,42 +21,187 @@
 #include "FileInputPlugin.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Name.hxx"
+#include "util/CircularBuffer.hxx"
+#include "util/HugeAllocator.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "fs/Path.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/io/FileReader.hxx"
 #include "system/FileDescriptor.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
 
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <string.h>
 
 static constexpr Domain file_domain("file");
 
+/**
+ * The read-ahead thread is started after this number of bytes has
+ * been read sequentially.  Short reads (e.g. while scanning tags)
+ * don't pay for a thread and a buffer.
+ */
+static constexpr size_t READ_AHEAD_THRESHOLD = 64 * 1024;
+
+/**
+ * The maximum size of one read() call in the read-ahead thread.  This
+ * bounds the amount of data which is discarded after a seek.
+ */
+static constexpr size_t READ_AHEAD_CHUNK = 128 * 1024;
+
+/**
+ * The read-ahead thread sleeps until the buffer has at least this
+ * much free space, to avoid waking up for each small Read() call.
+ */
+static constexpr size_t READ_AHEAD_MIN_SPACE = READ_AHEAD_CHUNK / 2;
+
+/**
+ * The size of the read-ahead buffer; 0 disables read-ahead.  See
+ * setting "read_ahead_size".
+ */
+static size_t read_ahead_size = 1024 * 1024;
+
 class FileInputStream final : public InputStream {
 	FileReader reader;
 
+	/**
+	 * The read-ahead thread.  It is started by Read() after
+	 * #READ_AHEAD_THRESHOLD bytes have been consumed.  From then
+	 * on, only this thread accesses #reader.
+	 */
+	Thread thread;
+
+	/**
+	 * Signalled when the thread shall be woken up: when data from
+	 * the buffer has been consumed, after a seek and when the
+	 * stream shall be closed.
+	 */
+	Cond wake_cond;
+
+	/**
+	 * An I/O error from the thread which will be reported by the
+	 * next Read() call.
+	 */
+	Error postponed_error;
+
+	/**
+	 * Data read ahead by the thread; it starts at the current
+	 * #offset.  nullptr if the thread has not been started.
+	 */
+	CircularBuffer<uint8_t> *buffer;
+
+	const size_t buffer_size;
+
+	/**
+	 * The file position of the end of #buffer, i.e. where the
+	 * thread will continue reading.
+	 */
+	offset_type read_offset;
+
+	/**
+	 * The position of the file descriptor.  Only accessed by the
+	 * thread.
+	 */
+	offset_type reader_offset;
+
+	/**
+	 * Incremented by each Seek() which discards the buffer.  The
+	 * thread compares it to detect that a read which was in
+	 * progress during the seek is obsolete.
+	 */
+	unsigned seek_serial;
+
+	/**
+	 * The number of bytes read sequentially since the stream was
+	 * opened or last seeked, before the thread was started.
+	 */
+	size_t sequential;
+
+	/**
+	 * Shall the thread exit?
+	 */
+	bool close;
+
+	/**
+	 * Has the thread hit the end of the file?  This is also set
+	 * after a read error.
+	 */
+	bool eof;
+
 public:
-	FileInputStream(const char *path, FileReader &&_reader, off_t _size,
+	FileInputStream(const char *path, FileReader &&_reader,
+			const FileInfo &info,
 			Mutex &_mutex, Cond &_cond)
 		:InputStream(path, _mutex, _cond),
-		 reader(std::move(_reader)) {
-		size = _size;
+		 reader(std::move(_reader)),
+		 buffer(nullptr), buffer_size(read_ahead_size),
+		 seek_serial(0), sequential(0),
+		 close(false), eof(false) {
+		size = info.GetSize();
+		mtime = info.GetModificationTime();
 		seekable = true;
 		SetReady();
 	}
 
+	~FileInputStream();
+
 	/* virtual methods from InputStream */
 
+	bool Check(Error &error) override;
+
 	bool IsEOF() override {
-		return GetOffset() >= GetSize();
+		return GetOffset() >= GetSize() ||
+			(buffer != nullptr && buffer->IsEmpty() && eof);
+	}
+
+	bool IsAvailable() override {
+		return buffer == nullptr || !buffer->IsEmpty() ||
+			eof || postponed_error.IsDefined();
 	}
 
 	size_t Read(void *ptr, size_t size, Error &error) override;
 	bool Seek(offset_type offset, Error &error) override;
+
+private:
+	/**
+	 * Allocate the buffer and start the read-ahead thread.
+	 * Failures are logged and leave the stream in synchronous
+	 * mode.
+	 */
+	void StartReadAhead();
+
+	size_t ReadBuffered(void *ptr, size_t size, Error &error);
+	bool SeekBuffered(offset_type offset);
+
+	void ThreadFunc();
+	static void ThreadFunc(void *ctx);
 };
 
+FileInputStream::~FileInputStream()
+{
+	if (buffer == nullptr)
+		return;
+
+	Lock();
+	close = true;
+	wake_cond.signal();
+	Unlock();
+
+	thread.Join();
+
+	buffer->Clear();
+	HugeFree(buffer->Write().data, buffer_size);
+	delete buffer;
+}
+
 InputStream *
 OpenFileInputStream(Path path,
 		    Mutex &mutex, Cond &cond,
@@ -82,10 +227,21 @@ OpenFileInputStream(Path path,
 #endif
 
 	return new FileInputStream(path.ToUTF8().c_str(),
-				   std::move(reader), info.GetSize(),
+				   std::move(reader), info,
 				   mutex, cond);
 }
 
+static InputPlugin::InitResult
+input_file_init(const ConfigBlock &block, gcc_unused Error &error)
+{
+	read_ahead_size = block.GetBlockValue("read_ahead_size",
+					      (unsigned)read_ahead_size);
+	if (read_ahead_size > 0 && read_ahead_size < READ_AHEAD_CHUNK)
+		read_ahead_size = READ_AHEAD_CHUNK;
+
+	return InputPlugin::InitResult::SUCCESS;
+}
+
 static InputStream *
 input_file_open(gcc_unused const char *filename,
 		gcc_unused Mutex &mutex, gcc_unused Cond &cond,
@@ -96,30 +252,198 @@ input_file_open(gcc_unused const char *filename,
 	return nullptr;
 }
 
+void
+FileInputStream::StartReadAhead()
+{
+	assert(buffer == nullptr);
+	assert(buffer_size > 0);
+
+	void *p = HugeAllocate(buffer_size);
+	if (p == nullptr) {
+		/* not fatal; continue reading synchronously */
+		sequential = 0;
+		return;
+	}
+
+	buffer = new CircularBuffer<uint8_t>((uint8_t *)p, buffer_size);
+	read_offset = reader_offset = offset;
+
+	Error error;
+	if (!thread.Start(ThreadFunc, this, error)) {
+		LogError(error);
+		HugeFree(p, buffer_size);
+		delete buffer;
+		buffer = nullptr;
+		sequential = 0;
+	}
+}
+
+inline void
+FileInputStream::ThreadFunc()
+{
+	SetThreadName("input:file");
+
+	Lock();
+
+	while (!close) {
+		if (buffer->GetSpace() < READ_AHEAD_MIN_SPACE ||
+		    eof || postponed_error.IsDefined()) {
+			wake_cond.wait(mutex);
+			continue;
+		}
+
+		auto w = buffer->Write();
+
+		const offset_type position = read_offset;
+		const unsigned serial = seek_serial;
+		const size_t chunk = std::min(w.size, READ_AHEAD_CHUNK);
+
+		Unlock();
+
+		Error error;
+		size_t nbytes = 0;
+		if (position == reader_offset ||
+		    reader.Seek((off_t)position, error)) {
+			reader_offset = position;
+			nbytes = reader.Read(w.data, chunk, error);
+			reader_offset += nbytes;
+		}
+
+		Lock();
+
+		if (serial != seek_serial)
+			/* Seek() was called meanwhile; discard the data
+			   and start over at the new position */
+			continue;
+
+		cond.broadcast();
+
+		if (nbytes == 0) {
+			/* after an error, the stream ends here (like
+			   in ThreadInputStream), or else the next
+			   Read() would wait forever; Seek() starts
+			   over */
+			if (error.IsDefined())
+				postponed_error = std::move(error);
+			eof = true;
+			continue;
+		}
+
+		buffer->Append(nbytes);
+		read_offset += nbytes;
+	}
+
+	Unlock();
+}
+
+void
+FileInputStream::ThreadFunc(void *ctx)
+{
+	FileInputStream &fis = *(FileInputStream *)ctx;
+	fis.ThreadFunc();
+}
+
+bool
+FileInputStream::Check(Error &error)
+{
+	if (postponed_error.IsDefined()) {
+		error = std::move(postponed_error);
+		postponed_error.Clear();
+		return false;
+	}
+
+	return true;
+}
+
+inline bool
+FileInputStream::SeekBuffered(offset_type new_offset)
+{
+	if (new_offset >= offset && new_offset <= read_offset) {
+		/* the new position is inside the buffer: skip the
+		   data before it, without touching the file */
+		size_t skip = new_offset - offset;
+		while (skip > 0) {
+			auto r = buffer->Read();
+			const size_t nbytes = std::min(skip, r.size);
+			buffer->Consume(nbytes);
+			skip -= nbytes;
+		}
+	} else {
+		/* discard the buffer and let the thread start over */
+		buffer->Clear();
+		read_offset = new_offset;
+		++seek_serial;
+		eof = false;
+		postponed_error.Clear();
+	}
+
+	offset = new_offset;
+	wake_cond.signal();
+	return true;
+}
+
 bool
 FileInputStream::Seek(offset_type new_offset, Error &error)
 {
+	if (buffer != nullptr)
+		return SeekBuffered(new_offset);
+
 	if (!reader.Seek((off_t)new_offset, error))
 		return false;
 
 	offset = new_offset;
+	sequential = 0;
 	return true;
 }
 
+inline size_t
+FileInputStream::ReadBuffered(void *ptr, size_t read_size, Error &error)
+{
+	while (true) {
+		if (postponed_error.IsDefined()) {
+			error = std::move(postponed_error);
+			postponed_error.Clear();
+			return 0;
+		}
+
+		auto r = buffer->Read();
+		if (!r.IsEmpty()) {
+			size_t nbytes = std::min(read_size, r.size);
+			memcpy(ptr, r.data, nbytes);
+			buffer->Consume(nbytes);
+			if (buffer->GetSpace() >= READ_AHEAD_MIN_SPACE)
+				wake_cond.signal();
+			offset += nbytes;
+			return nbytes;
+		}
+
+		if (eof)
+			return 0;
+
+		cond.wait(mutex);
+	}
+}
+
 size_t
 FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
-	ssize_t nbytes = reader.Read(ptr, read_size, error);
-	if (nbytes < 0)
-		return 0;
+	if (buffer != nullptr)
+		return ReadBuffered(ptr, read_size, error);
 
+	size_t nbytes = reader.Read(ptr, read_size, error);
 	offset += nbytes;
-	return (size_t)nbytes;
+	sequential += nbytes;
+
+	if (sequential >= READ_AHEAD_THRESHOLD && buffer_size > 0 &&
+	    offset < size)
+		StartReadAhead();
+
+	return nbytes;
 }
 
 const InputPlugin input_plugin_file = {
 	"file",
-	nullptr,
+	input_file_init,
 	nullptr,
 	input_file_open,
 };
@@ -515,7 +515,7 @@ AudioOutput::GetNextChunk() const
 {
 	return current_chunk != nullptr
 		/* continue the previous play() call */
-		? current_chunk->next
+		? current_chunk->next.load(std::memory_order_acquire)
 		/* get the first chunk from the pipe */
 		: pipe->Peek();
 }
@@ -546,7 +546,7 @@ AudioOutput::Play()
 		}
 
 		assert(current_chunk == chunk);
-		chunk = chunk->next;
+		chunk = chunk->next.load(std::memory_order_acquire);
 	}
 
 	assert(in_playback_loop);
@@ -26,6 +26,7 @@
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
 #include "config/ConfigError.hxx"
 #include "config/ConfigPath.hxx"
 #include "Log.hxx"
@@ -150,7 +151,7 @@ RecorderOutput::Configure(const ConfigBlock &block, Error &error)
 
 	/* initialize encoder */
 
-	encoder = encoder_init(*encoder_plugin, block, error);
+	encoder = encoder_init_output(*encoder_plugin, block, error);
 	if (encoder == nullptr)
 		return false;
 
@@ -23,6 +23,7 @@
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -174,7 +175,7 @@ ShoutOutput::Configure(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
-	encoder = encoder_init(*encoder_plugin, block, error);
+	encoder = encoder_init_output(*encoder_plugin, block, error);
 	if (encoder == nullptr)
 		return false;
 
@@ -457,9 +458,12 @@ my_shout_play(AudioOutput *ao, const void *chunk, size_t size,
 static bool
 my_shout_pause(AudioOutput *ao)
 {
+	ShoutOutput *sd = (ShoutOutput *)ao;
 	static char silence[1020];
 
-	return my_shout_play(ao, silence, sizeof(silence), IgnoreError());
+	return encoder_write_silence(sd->encoder, silence, sizeof(silence),
+				     IgnoreError()) &&
+		write_page(sd, IgnoreError());
 }
 
 static void
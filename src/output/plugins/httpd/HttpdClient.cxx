@@ -21,23 +21,21 @@
 #include "HttpdClient.hxx"
 #include "HttpdInternal.hxx"
 #include "util/ASCII.hxx"
+#include "util/Macros.hxx"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "net/SocketError.hxx"
 #include "Log.hxx"
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 
 HttpdClient::~HttpdClient()
 {
-	if (state == RESPONSE) {
-		if (current_page != nullptr)
-			current_page->Unref();
-
-		ClearQueue();
-	}
+	if (state == RESPONSE && current_page != nullptr)
+		current_page->Unref();
 
 	if (metadata)
 		metadata->Unref();
@@ -65,6 +63,7 @@ HttpdClient::BeginResponse()
 	assert(state != RESPONSE);
 
 	state = RESPONSE;
+	position = httpd.GetRingEnd();
 	current_page = nullptr;
 
 	if (!head_method)
@@ -198,7 +197,6 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
 	:BufferedSocket(_fd, _loop),
 	 httpd(_httpd),
 	 state(REQUEST),
-	 queue_size(0),
 	 head_method(false),
 	 dlna_streaming_requested(false),
 	 metadata_supported(_metadata_supported),
@@ -210,23 +208,22 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
 }
 
 void
-HttpdClient::ClearQueue()
+HttpdClient::SkipToEnd()
 {
 	assert(state == RESPONSE);
 
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
-
-#ifndef NDEBUG
-		assert(queue_size >= page->size);
-		queue_size -= page->size;
-#endif
-
-		page->Unref();
+	const uint64_t end = httpd.GetRingEnd();
+	if (position < end && current_page == nullptr) {
+		size_t offset;
+		Page &page = httpd.GetRingPage(position, offset);
+		if (offset > 0) {
+			page.Ref();
+			current_page = &page;
+			current_position = offset;
+		}
 	}
 
-	assert(queue_size == 0);
+	position = end;
 }
 
 void
@@ -235,33 +232,87 @@ HttpdClient::CancelQueue()
 	if (state != RESPONSE)
 		return;
 
-	ClearQueue();
+	SkipToEnd();
 
 	if (current_page == nullptr)
 		CancelWrite();
 }
 
+void
+HttpdClient::OnRingUpdated()
+{
+	assert(state == RESPONSE);
+
+	if (httpd.GetRingEnd() - position > 256 * 1024) {
+		FormatDebug(httpd_output_domain,
+			    "client is too slow, flushing its queue");
+		SkipToEnd();
+	}
+
+	if (current_page != nullptr || position < httpd.GetRingEnd())
+		ScheduleWrite();
+}
+
 ssize_t
-HttpdClient::TryWritePage(const Page &page, size_t position)
+HttpdClient::TryWritePage(const Page &page, size_t page_position)
 {
-	assert(position < page.size);
+	assert(page_position < page.size);
 
-	return Write(page.data + position, page.size - position);
+	return Write(page.data + page_position, page.size - page_position);
 }
 
 ssize_t
-HttpdClient::TryWritePageN(const Page &page, size_t position, ssize_t n)
+HttpdClient::TryWriteStream(size_t max_bytes)
+{
+	/* the private page first, followed by as much ring data as
+	   fits into the iovec array */
+	struct iovec iov[16];
+	size_t n = 0;
+
+	if (current_page != nullptr) {
+		assert(current_position < current_page->size);
+
+		size_t length = current_page->size - current_position;
+		if (length > max_bytes)
+			length = max_bytes;
+
+		iov[0].iov_base = current_page->data + current_position;
+		iov[0].iov_len = length;
+		n = 1;
+
+		max_bytes -= length;
+	}
+
+	n += httpd.GetRingData(position, iov + n, ARRAY_SIZE(iov) - n,
+			       max_bytes);
+	assert(n > 0);
+
+	return Write(iov, n);
+}
+
+void
+HttpdClient::Consume(size_t nbytes)
 {
-	return n >= 0
-		? Write(page.data + position, n)
-		: TryWritePage(page, position);
+	if (current_page != nullptr) {
+		const size_t remaining = current_page->size - current_position;
+		if (nbytes < remaining) {
+			current_position += nbytes;
+			return;
+		}
+
+		current_page->Unref();
+		current_page = nullptr;
+		nbytes -= remaining;
+	}
+
+	position += nbytes;
+	assert(position <= httpd.GetRingEnd());
 }
 
 ssize_t
 HttpdClient::GetBytesTillMetaData() const
 {
-	if (metadata_requested &&
-	    current_page->size - current_position > metaint - metadata_fill)
+	if (metadata_requested)
 		return metaint - metadata_fill;
 
 	return -1;
@@ -274,21 +325,12 @@ HttpdClient::TryWrite()
 
 	assert(state == RESPONSE);
 
-	if (current_page == nullptr) {
-		if (pages.empty()) {
-			/* another thread has removed the event source
-			   while this thread was waiting for
-			   httpd.mutex */
-			CancelWrite();
-			return true;
-		}
-
-		current_page = pages.front();
-		pages.pop();
-		current_position = 0;
-
-		assert(queue_size >= current_page->size);
-		queue_size -= current_page->size;
+	if (current_page == nullptr && position == httpd.GetRingEnd()) {
+		/* another thread has removed the event source
+		   while this thread was waiting for
+		   httpd.mutex */
+		CancelWrite();
+		return true;
 	}
 
 	const ssize_t bytes_to_write = GetBytesTillMetaData();
@@ -343,9 +385,9 @@ HttpdClient::TryWrite()
 			metadata_current_position = 0;
 		}
 	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
+		ssize_t nbytes = TryWriteStream(bytes_to_write >= 0
+						? size_t(bytes_to_write)
+						: SIZE_MAX);
 		if (nbytes < 0) {
 			auto e = GetSocketError();
 			if (IsSocketErrorAgain(e))
@@ -362,21 +404,16 @@ HttpdClient::TryWrite()
 			return false;
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size);
+		Consume(nbytes);
 
 		if (metadata_requested)
 			metadata_fill += nbytes;
 
-		if (current_position >= current_page->size) {
-			current_page->Unref();
-			current_page = nullptr;
-
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (current_page == nullptr &&
+		    position == httpd.GetRingEnd())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 	}
 
 	return true;
@@ -389,15 +426,11 @@ HttpdClient::PushPage(Page *page)
 		/* the client is still writing the HTTP request */
 		return;
 
-	if (queue_size > 256 * 1024) {
-		FormatDebug(httpd_output_domain,
-			    "client is too slow, flushing its queue");
-		ClearQueue();
-	}
+	assert(current_page == nullptr);
 
 	page->Ref();
-	pages.push(page);
-	queue_size += page->size;
+	current_page = page;
+	current_position = 0;
 
 	ScheduleWrite();
 }
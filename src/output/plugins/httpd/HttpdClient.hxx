@@ -25,10 +25,9 @@
 
 #include <boost/intrusive/list.hpp>
 
-#include <queue>
-#include <list>
-
+#include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 
 class HttpdOutput;
 class Page;
@@ -56,17 +55,17 @@ class HttpdClient final
 	} state;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
-	 */
-	std::queue<Page *, std::list<Page *>> pages;
-
-	/**
-	 * The sum of all page sizes in #pages.
+	 * The stream position of the next byte to be sent from the
+	 * page ring shared by all clients (see
+	 * HttpdOutput::GetRingData()).  Only valid in the "RESPONSE"
+	 * state.
 	 */
-	size_t queue_size;
+	uint64_t position;
 
 	/**
-	 * The #page which is currently being sent to the client.
+	 * A private #Page which is sent before the ring data: the
+	 * encoder header, or the rest of the page which was being
+	 * sent when this client skipped ahead.
 	 */
 	Page *current_page;
 
@@ -147,10 +146,33 @@ public:
 	void LockClose();
 
 	/**
-	 * Clears the page queue.
+	 * Skips all pending data in the page ring.
 	 */
 	void CancelQueue();
 
+	/**
+	 * Is this client consuming the page ring?
+	 */
+	bool IsStreaming() const {
+		return state == RESPONSE;
+	}
+
+	/**
+	 * Returns the stream position of the next byte to be sent
+	 * from the page ring.
+	 */
+	uint64_t GetPosition() const {
+		assert(IsStreaming());
+
+		return position;
+	}
+
+	/**
+	 * Called by #HttpdOutput after pages have been appended to
+	 * the ring.  Too slow clients skip to the end of the ring.
+	 */
+	void OnRingUpdated();
+
 	/**
 	 * Handle a line of the HTTP request.
 	 */
@@ -169,13 +191,20 @@ public:
 	gcc_pure
 	ssize_t GetBytesTillMetaData() const;
 
-	ssize_t TryWritePage(const Page &page, size_t position);
-	ssize_t TryWritePageN(const Page &page, size_t position, ssize_t n);
+	ssize_t TryWritePage(const Page &page, size_t page_position);
+
+	/**
+	 * Sends the private page and the ring data with one vectored
+	 * write.
+	 *
+	 * @param max_bytes the maximum number of bytes to be sent
+	 */
+	ssize_t TryWriteStream(size_t max_bytes);
 
 	bool TryWrite();
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Sends this page before any data from the page ring.
 	 */
 	void PushPage(Page *page);
 
@@ -185,7 +214,17 @@ public:
 	void PushMetaData(Page *page);
 
 private:
-	void ClearQueue();
+	/**
+	 * Marks the given amount of bytes as sent.
+	 */
+	void Consume(size_t nbytes);
+
+	/**
+	 * Moves #position to the end of the page ring.  A partially
+	 * sent page is kept, to avoid corrupting the stream in the
+	 * middle of an encoder frame.
+	 */
+	void SkipToEnd();
 
 protected:
 	virtual bool OnSocketReady(unsigned flags) override;
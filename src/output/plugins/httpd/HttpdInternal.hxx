@@ -35,8 +35,11 @@
 #include "Compiler.h"
 
 #include <queue>
+#include <deque>
 #include <list>
 
+#include <stdint.h>
+
 struct ConfigBlock;
 class Error;
 class EventLoop;
@@ -111,6 +114,34 @@ private:
 	 */
 	std::queue<Page *, std::list<Page *>> pages;
 
+	struct RingPage {
+		Page *page;
+
+		/**
+		 * The stream position of the end of this page.
+		 */
+		uint64_t end;
+	};
+
+	/**
+	 * The pages which have been broadcasted, shared by all
+	 * clients; each client sends them at its own position.  A
+	 * page is removed as soon as all clients have sent it.  This
+	 * container is only accessed in the IOThread.
+	 */
+	std::deque<RingPage> ring;
+
+	/**
+	 * The stream position of the first byte of the first page
+	 * in #ring.
+	 */
+	uint64_t ring_start;
+
+	/**
+	 * The stream position of the end of the last page in #ring.
+	 */
+	uint64_t ring_end;
+
  public:
 	/**
 	 * The configured name.
@@ -223,6 +254,36 @@ public:
 	 */
 	void SendHeader(HttpdClient &client) const;
 
+	/**
+	 * Returns the stream position at the end of the page ring.
+	 * Only to be used in the IOThread.
+	 */
+	uint64_t GetRingEnd() const {
+		return ring_end;
+	}
+
+	/**
+	 * Describes the ring data starting at the given stream
+	 * position in an iovec array.  Only to be used in the
+	 * IOThread.
+	 *
+	 * @param max_iov the size of the iovec array
+	 * @param max_bytes the maximum number of bytes to be
+	 * described
+	 * @return the number of iovec elements used
+	 */
+	size_t GetRingData(uint64_t position, struct iovec *iov,
+			   size_t max_iov, size_t max_bytes) const;
+
+	/**
+	 * Returns the ring page containing the given stream
+	 * position.  Only to be used in the IOThread.
+	 *
+	 * @param offset_r the offset of the position within the
+	 * page is returned here
+	 */
+	Page &GetRingPage(uint64_t position, size_t &offset_r) const;
+
 	gcc_pure
 	unsigned Delay() const;
 
@@ -244,15 +305,38 @@ public:
 	 */
 	void BroadcastFromEncoder();
 
-	bool EncodeAndPlay(const void *chunk, size_t size, Error &error);
+	/**
+	 * @param silence is this the silence written while paused?
+	 * See encoder_write_silence().
+	 */
+	bool EncodeAndPlay(const void *chunk, size_t size, bool silence,
+			   Error &error);
 
 	void SendTag(const Tag &tag);
 
-	size_t Play(const void *chunk, size_t size, Error &error);
+	size_t Play(const void *chunk, size_t size, bool silence,
+		    Error &error);
 
 	void CancelAllClients();
 
 private:
+	typedef std::deque<RingPage>::const_iterator RingIterator;
+
+	/**
+	 * Finds the ring page containing the given stream position.
+	 *
+	 * @param start_r the stream position of the page start is
+	 * returned here
+	 */
+	RingIterator FindRingPage(uint64_t position,
+				  uint64_t &start_r) const;
+
+	/**
+	 * Removes all pages from the ring which end before the given
+	 * stream position.
+	 */
+	void TrimRing(uint64_t position);
+
 	virtual void RunDeferred() override;
 
 	void OnAccept(int fd, SocketAddress address, int uid) override;
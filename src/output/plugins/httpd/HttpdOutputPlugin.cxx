@@ -25,6 +25,7 @@
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
 #include "net/SocketAddress.hxx"
 #include "net/ToString.hxx"
 #include "Page.hxx"
@@ -37,6 +38,8 @@
 #include "util/DeleteDisposer.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 
 #include <sys/types.h>
@@ -56,12 +59,15 @@ HttpdOutput::HttpdOutput(EventLoop &_loop)
 	:ServerSocket(_loop), DeferredMonitor(_loop),
 	 base(httpd_output_plugin),
 	 encoder(nullptr), unflushed_input(0),
-	 metadata(nullptr)
+	 metadata(nullptr),
+	 ring_start(0), ring_end(0)
 {
 }
 
 HttpdOutput::~HttpdOutput()
 {
+	TrimRing(ring_end);
+
 	if (metadata != nullptr)
 		metadata->Unref();
 
@@ -125,7 +131,7 @@ HttpdOutput::Configure(const ConfigBlock &block, Error &error)
 
 	/* initialize encoder */
 
-	encoder = encoder_init(*encoder_plugin, block, error);
+	encoder = encoder_init_output(*encoder_plugin, block, error);
 	if (encoder == nullptr)
 		return false;
 
@@ -187,21 +193,95 @@ HttpdOutput::RunDeferred()
 
 	const ScopeLock protect(mutex);
 
+	/* move the pages to the ring; it takes over the reference */
 	while (!pages.empty()) {
 		Page *page = pages.front();
 		pages.pop();
 
-		for (auto &client : clients)
-			client.PushPage(page);
+		ring_end += page->size;
+		ring.push_back({page, ring_end});
+	}
 
-		page->Unref();
+	/* release the pages which have been sent to all clients */
+	uint64_t min_position = ring_end;
+	for (auto &client : clients) {
+		if (!client.IsStreaming())
+			continue;
+
+		client.OnRingUpdated();
+		min_position = std::min(min_position, client.GetPosition());
 	}
 
+	TrimRing(min_position);
+
 	/* wake up the client that may be waiting for the queue to be
 	   flushed */
 	cond.broadcast();
 }
 
+HttpdOutput::RingIterator
+HttpdOutput::FindRingPage(uint64_t position, uint64_t &start_r) const
+{
+	assert(position >= ring_start);
+	assert(position <= ring_end);
+
+	const auto i = std::upper_bound(ring.begin(), ring.end(), position,
+					[](uint64_t p, const RingPage &page){
+						return p < page.end;
+					});
+	start_r = i == ring.begin()
+		? ring_start
+		: std::prev(i)->end;
+	return i;
+}
+
+size_t
+HttpdOutput::GetRingData(uint64_t position, struct iovec *iov,
+			 size_t max_iov, size_t max_bytes) const
+{
+	uint64_t start;
+	auto i = FindRingPage(position, start);
+
+	size_t n = 0;
+	for (; i != ring.end() && n < max_iov && max_bytes > 0; ++i) {
+		const Page &page = *i->page;
+		const size_t offset = position - start;
+		const size_t length = std::min(page.size - offset, max_bytes);
+
+		iov[n].iov_base = const_cast<unsigned char *>(page.data) + offset;
+		iov[n].iov_len = length;
+		++n;
+
+		max_bytes -= length;
+		position = start = i->end;
+	}
+
+	return n;
+}
+
+Page &
+HttpdOutput::GetRingPage(uint64_t position, size_t &offset_r) const
+{
+	assert(position < ring_end);
+
+	uint64_t start;
+	const auto i = FindRingPage(position, start);
+	assert(i != ring.end());
+
+	offset_r = position - start;
+	return *i->page;
+}
+
+void
+HttpdOutput::TrimRing(uint64_t position)
+{
+	while (!ring.empty() && ring.front().end <= position) {
+		ring_start = ring.front().end;
+		ring.front().page->Unref();
+		ring.pop_front();
+	}
+}
+
 void
 HttpdOutput::OnAccept(int fd, SocketAddress address, gcc_unused int uid)
 {
@@ -348,6 +428,7 @@ HttpdOutput::Close()
 
 	BlockingCall(GetEventLoop(), [this](){
 			clients.clear_and_dispose(DeleteDisposer());
+			TrimRing(ring_end);
 		});
 
 	if (header != nullptr)
@@ -441,9 +522,12 @@ HttpdOutput::BroadcastFromEncoder()
 }
 
 inline bool
-HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
+HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, bool silence,
+			   Error &error)
 {
-	if (!encoder_write(encoder, chunk, size, error))
+	if (silence
+	    ? !encoder_write_silence(encoder, chunk, size, error)
+	    : !encoder_write(encoder, chunk, size, error))
 		return false;
 
 	unflushed_input += size;
@@ -453,10 +537,13 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 }
 
 inline size_t
-HttpdOutput::Play(const void *chunk, size_t size, Error &error)
+HttpdOutput::Play(const void *chunk, size_t size, bool silence,
+		  Error &error)
 {
-	if (LockHasClients()) {
-		if (!EncodeAndPlay(chunk, size, error))
+	/* a shared encoder must be fed even without clients, because
+	   other outputs may depend on it */
+	if (LockHasClients() || encoder_is_shared(*encoder)) {
+		if (!EncodeAndPlay(chunk, size, silence, error))
 			return 0;
 	}
 
@@ -473,7 +560,7 @@ httpd_output_play(AudioOutput *ao, const void *chunk, size_t size,
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	return httpd->Play(chunk, size, error);
+	return httpd->Play(chunk, size, false, error);
 }
 
 static bool
@@ -483,8 +570,8 @@ httpd_output_pause(AudioOutput *ao)
 
 	if (httpd->LockHasClients()) {
 		static const char silence[1020] = { 0 };
-		return httpd_output_play(ao, silence, sizeof(silence),
-					 IgnoreError()) > 0;
+		return httpd->Play(silence, sizeof(silence), true,
+				   IgnoreError()) > 0;
 	} else {
 		return true;
 	}
@@ -559,6 +646,8 @@ HttpdOutput::CancelAllClients()
 	for (auto &client : clients)
 		client.CancelQueue();
 
+	TrimRing(ring_end);
+
 	cond.broadcast();
 }
 
@@ -60,9 +60,27 @@ PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format,
 	assert(_dest_format.IsValid());
 
 	AudioFormat format = _src_format;
-	if (format.format == SampleFormat::DSD)
+	if (format.format == SampleFormat::DSD) {
 		format.format = SampleFormat::FLOAT;
 
+#ifdef ENABLE_DSD
+		if (format.sample_rate == _dest_format.sample_rate) {
+			switch (_dest_format.format) {
+			case SampleFormat::S16:
+			case SampleFormat::S24_P32:
+			case SampleFormat::S32:
+				format.format = _dest_format.format;
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		dsd_format = format.format;
+#endif
+	}
+
 	enable_resampler = format.sample_rate != _dest_format.sample_rate;
 	if (enable_resampler) {
 		if (!resampler.Open(format, _dest_format.sample_rate, error))
@@ -126,14 +144,23 @@ PcmConvert::Convert(ConstBuffer<void> buffer, Error &error)
 #ifdef ENABLE_DSD
 	if (src_format.format == SampleFormat::DSD) {
 		auto s = ConstBuffer<uint8_t>::FromVoid(buffer);
-		auto d = dsd.ToFloat(src_format.channels, s);
-		if (d.IsNull()) {
-			error.Set(pcm_domain,
-				  "DSD to PCM conversion failed");
-			return nullptr;
+		switch (dsd_format) {
+		case SampleFormat::S16:
+			buffer = dsd.ToS16(src_format.channels, s).ToVoid();
+			break;
+
+		case SampleFormat::S24_P32:
+			buffer = dsd.ToS24(src_format.channels, s).ToVoid();
+			break;
+
+		case SampleFormat::S32:
+			buffer = dsd.ToS32(src_format.channels, s).ToVoid();
+			break;
+
+		default:
+			buffer = dsd.ToFloat(src_format.channels, s).ToVoid();
+			break;
 		}
-
-		buffer = d.ToVoid();
 	}
 #endif
 
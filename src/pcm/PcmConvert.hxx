@@ -45,6 +45,13 @@ class Domain;
 class PcmConvert {
 #ifdef ENABLE_DSD
 	PcmDsd dsd;
+
+	/**
+	 * The sample format generated by #dsd.  This is the
+	 * destination format if no resampling is needed, which saves
+	 * one conversion pass.
+	 */
+	SampleFormat dsd_format;
 #endif
 
 	GluePcmResampler resampler;
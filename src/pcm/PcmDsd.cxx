@@ -19,32 +19,170 @@
 
 #include "config.h"
 #include "PcmDsd.hxx"
-#include "dsd2pcm/dsd2pcm.h"
-#include "util/Macros.hxx"
+#include "PcmUtils.hxx"
+#include "FloatConvert.hxx"
+#include "X86Simd.hxx"
+#include "util/bit_reverse.h"
 #include "util/ConstBuffer.hxx"
+#include "util/Macros.hxx"
 
 #include <algorithm>
 
 #include <assert.h>
+#include <string.h>
 
-PcmDsd::PcmDsd()
+/*
+ * The filter coefficients and the table layout were taken from the
+ * dsd2pcm library by Sebastian Gesemann.
+ *
+ */
+
+static constexpr size_t HTAPS = 48;
+static constexpr size_t CTABLES = (HTAPS + 7) / 8;
+
+static constexpr double htaps[HTAPS] = {
+	0.09950731974056658,
+	0.09562845727714668,
+	0.08819647126516944,
+	0.07782552527068175,
+	0.06534876523171299,
+	0.05172629311427257,
+	0.0379429484910187,
+	0.02490921351762261,
+	0.0133774746265897,
+	0.003883043418804416,
+	-0.003284703416210726,
+	-0.008080250212687497,
+	-0.01067241812471033,
+	-0.01139427235000863,
+	-0.0106813877974587,
+	-0.009007905078766049,
+	-0.006828859761015335,
+	-0.004535184322001496,
+	-0.002425035959059578,
+	-0.0006922187080790708,
+	0.0005700762133516592,
+	0.001353838005269448,
+	0.001713709169690937,
+	0.001742046839472948,
+	0.001545601648013235,
+	0.001226696225277855,
+	0.0008704322683580222,
+	0.0005381636200535649,
+	0.000266446345425276,
+	7.002968738383528e-05,
+	-5.279407053811266e-05,
+	-0.0001140625650874684,
+	-0.0001304796361231895,
+	-0.0001189970287491285,
+	-9.396247155265073e-05,
+	-6.577634378272832e-05,
+	-4.07492895872535e-05,
+	-2.17407957554587e-05,
+	-9.163058931391722e-06,
+	-2.017460145032201e-06,
+	1.249721855219005e-06,
+	2.166655190537392e-06,
+	1.930520892991082e-06,
+	1.319400334374195e-06,
+	7.410039764949091e-07,
+	3.423230509967409e-07,
+	1.244182214744588e-07,
+	3.130441005359396e-08
+};
+
+/**
+ * The lookup tables for the FIR filter.  The first #CTABLES tables
+ * map the most recent DSD bytes to the sum of 8 filter taps; the
+ * other #CTABLES tables are for the older (mirrored) half of the
+ * filter, and have the bit reversal of the index built in.
+ */
+struct DsdTables {
+	gcc_aligned(32) float t[CTABLES * 2][256];
+
+	DsdTables() {
+		for (size_t i = 0; i < CTABLES; ++i) {
+			size_t k = std::min<size_t>(HTAPS - i * 8, 8);
+			for (unsigned e = 0; e < 256; ++e) {
+				double acc = 0.0;
+				for (size_t m = 0; m < k; ++m)
+					acc += (int((e >> (7 - m)) & 1) * 2 - 1)
+						* htaps[i * 8 + m];
+
+				t[CTABLES - 1 - i][e] = float(acc);
+			}
+		}
+
+		for (size_t i = 0; i < CTABLES; ++i)
+			for (unsigned e = 0; e < 256; ++e)
+				t[CTABLES + i][e] = t[i][bit_reverse(e)];
+	}
+};
+
+static const DsdTables dsd_tables;
+
+/**
+ * Calculate one PCM sample.
+ *
+ * @param src the oldest DSD byte of the filter window
+ * @param stride the distance between two bytes of the same channel
+ */
+gcc_pure
+static inline float
+DsdToFloatSample(const uint8_t *src, size_t stride)
+{
+	double acc = 0;
+	for (size_t i = 0; i < CTABLES; ++i)
+		acc += dsd_tables.t[i][src[(CTABLES * 2 - 1 - i) * stride]] +
+			dsd_tables.t[CTABLES + i][src[i * stride]];
+	return float(acc);
+}
+
+static void
+DsdToFloat(float *dest, const uint8_t *src, size_t n, size_t stride)
 {
-	std::fill_n(dsd2pcm, ARRAY_SIZE(dsd2pcm), nullptr);
+#ifdef HAVE_X86_SIMD
+	const X86PcmKernels *k = x86_pcm_kernels;
+	if (k != nullptr && k->dsd_to_float != nullptr) {
+		const size_t done = k->dsd_to_float(dest, src, n, stride,
+						    dsd_tables.t);
+		dest += done;
+		src += done;
+		n -= done;
+	}
+#endif
+
+	for (size_t i = 0; i < n; ++i)
+		dest[i] = DsdToFloatSample(src + i, stride);
 }
 
-PcmDsd::~PcmDsd()
+PcmDsd::PcmDsd()
+	:history_channels(0)
 {
-	for (unsigned i = 0; i < ARRAY_SIZE(dsd2pcm); ++i)
-		if (dsd2pcm[i] != nullptr)
-			dsd2pcm_destroy(dsd2pcm[i]);
+	static_assert(CTABLES == PcmDsd::CTABLES, "Wrong table size");
 }
 
-void
-PcmDsd::Reset()
+inline const uint8_t *
+PcmDsd::Feed(unsigned channels, ConstBuffer<uint8_t> src)
 {
-	for (unsigned i = 0; i < ARRAY_SIZE(dsd2pcm); ++i)
-		if (dsd2pcm[i] != nullptr)
-			dsd2pcm_reset(dsd2pcm[i]);
+	const size_t history_size = HISTORY * channels;
+
+	if (channels != history_channels) {
+		/* dsd2pcm's initial state: its favorite silence
+		   pattern; the older half of its FIFO contains it
+		   in bit-reversed form */
+		static constexpr size_t n_reversed = HISTORY - CTABLES;
+		memset(history, 0x96, n_reversed * channels);
+		memset(history + n_reversed * channels, 0x69,
+		       (HISTORY - n_reversed) * channels);
+		history_channels = channels;
+	}
+
+	uint8_t *p = input_buffer.GetT<uint8_t>(history_size + src.size);
+	memcpy(p, history, history_size);
+	memcpy(p + history_size, src.data, src.size);
+	memcpy(history, p + src.size, history_size);
+	return p;
 }
 
 ConstBuffer<float>
@@ -53,26 +191,60 @@ PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src)
 	assert(!src.IsNull());
 	assert(!src.IsEmpty());
 	assert(src.size % channels == 0);
-	assert(channels <= ARRAY_SIZE(dsd2pcm));
+	assert(channels <= MAX_CHANNELS);
 
-	const unsigned num_samples = src.size;
-	const unsigned num_frames = src.size / channels;
+	const uint8_t *input = Feed(channels, src);
 
-	float *dest;
-	const size_t dest_size = num_samples * sizeof(*dest);
-	dest = (float *)buffer.Get(dest_size);
+	float *dest = buffer.GetT<float>(src.size);
+	DsdToFloat(dest, input, src.size, channels);
+	return { dest, src.size };
+}
 
-	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
-		}
+template<SampleFormat F>
+ConstBuffer<typename SampleTraits<F>::value_type>
+PcmDsd::ToInteger(unsigned channels, ConstBuffer<uint8_t> src)
+{
+	typedef FloatToIntegerSampleConvert<F> C;
+	typedef typename C::DV DV;
+
+	assert(!src.IsNull());
+	assert(!src.IsEmpty());
+	assert(src.size % channels == 0);
+	assert(channels <= MAX_CHANNELS);
+
+	const uint8_t *input = Feed(channels, src);
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
+	DV *const dest = buffer.GetT<DV>(src.size);
+
+	/* convert in small blocks which stay in the L1 cache */
+	float tmp[256];
+	for (size_t i = 0; i < src.size;) {
+		const size_t n = std::min(src.size - i, ARRAY_SIZE(tmp));
+		DsdToFloat(tmp, input + i, n, channels);
+
+		for (size_t j = 0; j < n; ++j)
+			dest[i + j] = C::Convert(tmp[j]);
+
+		i += n;
 	}
 
-	return { dest, num_samples };
+	return { dest, src.size };
+}
+
+ConstBuffer<int16_t>
+PcmDsd::ToS16(unsigned channels, ConstBuffer<uint8_t> src)
+{
+	return ToInteger<SampleFormat::S16>(channels, src);
+}
+
+ConstBuffer<int32_t>
+PcmDsd::ToS24(unsigned channels, ConstBuffer<uint8_t> src)
+{
+	return ToInteger<SampleFormat::S24_P32>(channels, src);
+}
+
+ConstBuffer<int32_t>
+PcmDsd::ToS32(unsigned channels, ConstBuffer<uint8_t> src)
+{
+	return ToInteger<SampleFormat::S32>(channels, src);
 }
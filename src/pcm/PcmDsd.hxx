@@ -22,27 +22,85 @@
 
 #include "check.h"
 #include "PcmBuffer.hxx"
+#include "Traits.hxx"
 
 #include <stdint.h>
+#include <stddef.h>
 
 template<typename T> struct ConstBuffer;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * Convert DSD to PCM, using the FIR filter from the dsd2pcm library.
+ * One PCM sample is generated for each DSD byte, i.e. the PCM sample
+ * rate is 1/8 of the DSD bit rate.
+ *
+ * Unlike dsd2pcm, this class works on the interleaved stream: all
+ * channels are converted in one pass, and consecutive output samples
+ * do not depend on each other, which allows calculating several of
+ * them with one vector operation.  The output is identical to
+ * dsd2pcm's.
  */
 class PcmDsd {
+	/**
+	 * The number of "8 MACs" lookup tables, i.e. the number of
+	 * DSD bytes covered by one half of the symmetric FIR filter.
+	 */
+	static constexpr size_t CTABLES = 6;
+
+	/**
+	 * The number of previous DSD bytes (per channel) which are
+	 * needed to calculate the next PCM sample.
+	 */
+	static constexpr size_t HISTORY = CTABLES * 2 - 1;
+
 	PcmBuffer buffer;
 
-	struct dsd2pcm_ctx_s *dsd2pcm[32];
+	/**
+	 * Contains #history followed by the new input, so the filter
+	 * can run over one contiguous buffer.
+	 */
+	PcmBuffer input_buffer;
+
+	/**
+	 * The number of channels in #history; 0 means it needs to be
+	 * initialized.
+	 */
+	unsigned history_channels;
+
+	/**
+	 * The last #HISTORY interleaved DSD frames.
+	 */
+	uint8_t history[HISTORY * MAX_CHANNELS];
 
 public:
 	PcmDsd();
-	~PcmDsd();
 
-	void Reset();
+	void Reset() {
+		history_channels = 0;
+	}
 
 	ConstBuffer<float> ToFloat(unsigned channels,
 				   ConstBuffer<uint8_t> src);
+
+	ConstBuffer<int16_t> ToS16(unsigned channels,
+				   ConstBuffer<uint8_t> src);
+
+	ConstBuffer<int32_t> ToS24(unsigned channels,
+				   ConstBuffer<uint8_t> src);
+
+	ConstBuffer<int32_t> ToS32(unsigned channels,
+				   ConstBuffer<uint8_t> src);
+
+private:
+	/**
+	 * Append the new input to the history and return the
+	 * combined buffer.
+	 */
+	const uint8_t *Feed(unsigned channels, ConstBuffer<uint8_t> src);
+
+	template<SampleFormat F>
+	ConstBuffer<typename SampleTraits<F>::value_type>
+	ToInteger(unsigned channels, ConstBuffer<uint8_t> src);
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "Traits.hxx"
 #include "FloatConvert.hxx"
 #include "ShiftConvert.hxx"
+#include "X86Simd.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
@@ -82,6 +83,17 @@ struct PortableFloatToInteger
 template<SampleFormat F, class Traits=SampleTraits<F>>
 struct FloatToInteger : PortableFloatToInteger<F, Traits> {};
 
+#ifdef HAVE_X86_SIMD
+/**
+ * Let the x86 kernel with the given #X86PcmKernels attribute name do
+ * the bulk of the work, and the "portable" class the rest.
+ */
+#define X86_OPTIMIZED_CONVERT(kernel, ...) \
+	X86OptimizedConvert<__VA_ARGS__, &X86PcmKernels::kernel>
+#else
+#define X86_OPTIMIZED_CONVERT(kernel, ...) __VA_ARGS__
+#endif
+
 /**
  * A template class that attempts to use the "optimized" algorithm for
  * large portions of the buffer, and calls the "portable" algorithm"
@@ -116,6 +128,25 @@ struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 
 #endif
 
+#ifdef HAVE_X86_SIMD
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: X86_OPTIMIZED_CONVERT(float_to_16,
+				PortableFloatToInteger<SampleFormat::S16>) {};
+
+template<>
+struct FloatToInteger<SampleFormat::S24_P32, SampleTraits<SampleFormat::S24_P32>>
+	: X86_OPTIMIZED_CONVERT(float_to_24,
+				PortableFloatToInteger<SampleFormat::S24_P32>) {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: X86_OPTIMIZED_CONVERT(float_to_32,
+				PortableFloatToInteger<SampleFormat::S32>) {};
+
+#endif
+
 template<class C>
 static ConstBuffer<typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
@@ -196,8 +227,9 @@ struct Convert8To24
 						  SampleFormat::S24_P32>> {};
 
 struct Convert16To24
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S24_P32>> {};
+	: X86_OPTIMIZED_CONVERT(s16_to_24,
+				PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
+									SampleFormat::S24_P32>>) {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -212,8 +244,9 @@ pcm_allocate_16_to_24(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 }
 
 struct Convert32To24
-	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
-						   SampleFormat::S24_P32>> {};
+	: X86_OPTIMIZED_CONVERT(s32_to_24,
+				PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
+									 SampleFormat::S24_P32>>) {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, ConstBuffer<int32_t> src)
@@ -264,12 +297,14 @@ struct Convert8To32
 						  SampleFormat::S32>> {};
 
 struct Convert16To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S32>> {};
+	: X86_OPTIMIZED_CONVERT(s16_to_32,
+				PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
+									SampleFormat::S32>>) {};
 
 struct Convert24To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
-						  SampleFormat::S32>> {};
+	: X86_OPTIMIZED_CONVERT(s24_to_32,
+				PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
+									SampleFormat::S32>>) {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -331,13 +366,16 @@ struct Convert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
 struct Convert16ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
+	: X86_OPTIMIZED_CONVERT(s16_to_float,
+				PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>>) {};
 
 struct Convert24ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
+	: X86_OPTIMIZED_CONVERT(s24_to_float,
+				PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>) {};
 
 struct Convert32ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
+	: X86_OPTIMIZED_CONVERT(s32_to_float,
+				PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>>) {};
 
 static ConstBuffer<float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -23,6 +23,7 @@
 #include "PcmUtils.hxx"
 #include "AudioFormat.hxx"
 #include "Traits.hxx"
+#include "X86Simd.hxx"
 #include "util/Clamp.hxx"
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
@@ -75,6 +76,18 @@ static void
 pcm_add_vol_float(float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2)
 {
+#ifdef HAVE_X86_SIMD
+	if (x86_pcm_kernels != nullptr) {
+		const size_t done =
+			x86_pcm_kernels->add_vol_float(buffer1, buffer2,
+						       num_samples,
+						       volume1, volume2);
+		buffer1 += done;
+		buffer2 += done;
+		num_samples -= done;
+	}
+#endif
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -151,6 +164,27 @@ PcmAdd(typename Traits::pointer_type a,
 		a[i] = PcmAdd<F, Traits>(a[i], b[i]);
 }
 
+#ifdef HAVE_X86_SIMD
+
+/**
+ * Let the x86 kernel add the bulk of the buffer, and the portable
+ * implementation the rest.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+PcmAddX86(size_t (*kernel)(typename Traits::pointer_type,
+			   typename Traits::const_pointer_type,
+			   size_t),
+	  typename Traits::pointer_type a,
+	  typename Traits::const_pointer_type b,
+	  size_t n)
+{
+	const size_t done = kernel(a, b, n);
+	PcmAdd<F, Traits>(a + done, b + done, n - done);
+}
+
+#endif
+
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
 PcmAddVoid(void *a, const void *b, size_t size)
@@ -166,6 +200,17 @@ PcmAddVoid(void *a, const void *b, size_t size)
 static void
 pcm_add_float(float *buffer1, const float *buffer2, unsigned num_samples)
 {
+#ifdef HAVE_X86_SIMD
+	if (x86_pcm_kernels != nullptr) {
+		const size_t done =
+			x86_pcm_kernels->add_float(buffer1, buffer2,
+						   num_samples);
+		buffer1 += done;
+		buffer2 += done;
+		num_samples -= done;
+	}
+#endif
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -189,10 +234,30 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
+#ifdef HAVE_X86_SIMD
+		if (x86_pcm_kernels != nullptr) {
+			PcmAddX86<SampleFormat::S16>(x86_pcm_kernels->add_16,
+						     (int16_t *)buffer1,
+						     (const int16_t *)buffer2,
+						     size / sizeof(int16_t));
+			return true;
+		}
+#endif
+
 		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::S24_P32:
+#ifdef HAVE_X86_SIMD
+		if (x86_pcm_kernels != nullptr) {
+			PcmAddX86<SampleFormat::S24_P32>(x86_pcm_kernels->add_24,
+							 (int32_t *)buffer1,
+							 (const int32_t *)buffer2,
+							 size / sizeof(int32_t));
+			return true;
+		}
+#endif
+
 		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
 		return true;
 
@@ -22,6 +22,7 @@
 #include "Domain.hxx"
 #include "PcmUtils.hxx"
 #include "Traits.hxx"
+#include "X86Simd.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 
@@ -92,6 +93,16 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume)
 {
+#ifdef HAVE_X86_SIMD
+	if (x86_pcm_kernels != nullptr) {
+		const size_t done = x86_pcm_kernels->volume_float(dest, src, n,
+								  volume);
+		dest += done;
+		src += done;
+		n -= done;
+	}
+#endif
+
 	for (size_t i = 0; i != n; ++i)
 		dest[i] = src[i] * volume;
 }
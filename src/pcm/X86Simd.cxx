@@ -0,0 +1,660 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "X86Simd.hxx"
+
+#ifdef HAVE_X86_SIMD
+
+#include <immintrin.h>
+
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/* the scale factors used by FloatConvert.hxx */
+static constexpr float FACTOR_16 = 1 << 15;
+static constexpr float FACTOR_24 = 1 << 23;
+static constexpr float FACTOR_32 = 1u << 31;
+
+/* the clamping range for S24_P32 */
+static constexpr int32_t MIN_24 = -(1 << 23);
+static constexpr int32_t MAX_24 = (1 << 23) - 1;
+
+/**
+ * The left shift which converts 16 bit samples to samples with the
+ * given number of bits.  This is the template parameter of
+ * Sse2S16ToShifted() and Avx2S16ToShifted().
+ */
+static constexpr int
+S16ShiftTo(int bits)
+{
+	return bits - 16;
+}
+
+/*
+ * SSE2
+ *
+ */
+
+static size_t SSE2_TARGET
+Sse2VolumeFloat(float *dest, const float *src, size_t n, float volume)
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dest + i,
+			      _mm_mul_ps(_mm_loadu_ps(src + i), v));
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2AddVolFloat(float *a, const float *b, size_t n,
+		float volume1, float volume2)
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(a + i), v1);
+		__m128 y = _mm_mul_ps(_mm_loadu_ps(b + i), v2);
+		_mm_storeu_ps(a + i, _mm_add_ps(x, y));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2AddFloat(float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(a + i, _mm_add_ps(_mm_loadu_ps(a + i),
+						_mm_loadu_ps(b + i)));
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2Add16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(a + i), _mm_adds_epi16(x, y));
+	}
+
+	return i;
+}
+
+/**
+ * Clamp signed 32 bit integers; SSE2 lacks pminsd/pmaxsd, so this
+ * uses comparison masks instead.
+ */
+static inline __m128i SSE2_TARGET
+Sse2Clamp32(__m128i x, __m128i min, __m128i max)
+{
+	__m128i m = _mm_cmplt_epi32(x, min);
+	x = _mm_or_si128(_mm_and_si128(m, min), _mm_andnot_si128(m, x));
+	m = _mm_cmpgt_epi32(x, max);
+	return _mm_or_si128(_mm_and_si128(m, max), _mm_andnot_si128(m, x));
+}
+
+static size_t SSE2_TARGET
+Sse2Add24(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m128i min = _mm_set1_epi32(MIN_24);
+	const __m128i max = _mm_set1_epi32(MAX_24);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(a + i),
+				 Sse2Clamp32(_mm_add_epi32(x, y), min, max));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2FloatTo16(int16_t *dest, const float *src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FACTOR_16);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		/* truncate to 32 bit, then clamp while packing to 16
+		   bit */
+		__m128i x = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i),
+							 factor));
+		__m128i y = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4),
+							 factor));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(x, y));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2FloatTo24(int32_t *dest, const float *src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FACTOR_24);
+	const __m128 min = _mm_set1_ps(MIN_24), max = _mm_set1_ps(MAX_24);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		/* clamping before truncating gives the same result
+		   as the portable code, which truncates to 64 bit
+		   first */
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), factor);
+		x = _mm_min_ps(_mm_max_ps(x, min), max);
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_cvttps_epi32(x));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2FloatTo32(int32_t *dest, const float *src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FACTOR_32);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), factor);
+
+		/* cvttps2dq returns INT32_MIN on overflow, which is
+		   already correct for negative values; flip it to
+		   INT32_MAX for positive ones */
+		__m128i overflow = _mm_castps_si128(_mm_cmpge_ps(x, factor));
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_xor_si128(_mm_cvttps_epi32(x), overflow));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2S16ToFloat(float *dest, const int16_t *src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(1.f / FACTOR_16);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+		/* sign-extend to 32 bit */
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+		_mm_storeu_ps(dest + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(lo), factor));
+		_mm_storeu_ps(dest + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), factor));
+	}
+
+	return i;
+}
+
+static inline size_t SSE2_TARGET
+Sse2IntegerToFloat(float *dest, const int32_t *src, size_t n, float _factor)
+{
+	const __m128 factor = _mm_set1_ps(_factor);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_ps(dest + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(x), factor));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2S24ToFloat(float *dest, const int32_t *src, size_t n)
+{
+	return Sse2IntegerToFloat(dest, src, n, 1.f / FACTOR_24);
+}
+
+static size_t SSE2_TARGET
+Sse2S32ToFloat(float *dest, const int32_t *src, size_t n)
+{
+	return Sse2IntegerToFloat(dest, src, n, 1.f / FACTOR_32);
+}
+
+/**
+ * Convert 16 bit samples to 32 bit samples with the given left
+ * shift applied.
+ */
+template<int left_shift>
+static inline size_t SSE2_TARGET
+Sse2S16ToShifted(int32_t *dest, const int16_t *src, size_t n)
+{
+	static_assert(left_shift >= 0 && left_shift <= 16,
+		      "Shift out of range");
+
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+
+		/* interleaving with zero shifts each sample into the
+		   upper half (left by 16 bits); an arithmetic right
+		   shift then leaves the requested left shift with the
+		   sign extended */
+		__m128i lo = _mm_unpacklo_epi16(zero, x);
+		__m128i hi = _mm_unpackhi_epi16(zero, x);
+
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_srai_epi32(lo, 16 - left_shift));
+		_mm_storeu_si128((__m128i *)(dest + i + 4),
+				 _mm_srai_epi32(hi, 16 - left_shift));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2S16To24(int32_t *dest, const int16_t *src, size_t n)
+{
+	return Sse2S16ToShifted<S16ShiftTo(24)>(dest, src, n);
+}
+
+static size_t SSE2_TARGET
+Sse2S16To32(int32_t *dest, const int16_t *src, size_t n)
+{
+	return Sse2S16ToShifted<S16ShiftTo(32)>(dest, src, n);
+}
+
+static size_t SSE2_TARGET
+Sse2S24To32(int32_t *dest, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_slli_epi32(x, 8));
+	}
+
+	return i;
+}
+
+static size_t SSE2_TARGET
+Sse2S32To24(int32_t *dest, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_srai_epi32(x, 8));
+	}
+
+	return i;
+}
+
+static constexpr X86PcmKernels sse2_kernels = {
+	"SSE2",
+	Sse2VolumeFloat,
+	Sse2AddVolFloat,
+	Sse2AddFloat,
+	Sse2Add16,
+	Sse2Add24,
+	Sse2FloatTo16,
+	Sse2FloatTo24,
+	Sse2FloatTo32,
+	Sse2S16ToFloat,
+	Sse2S24ToFloat,
+	Sse2S32ToFloat,
+	Sse2S16To24,
+	Sse2S16To32,
+	Sse2S24To32,
+	Sse2S32To24,
+	nullptr,
+};
+
+/*
+ * AVX2
+ *
+ */
+
+static size_t AVX2_TARGET
+Avx2VolumeFloat(float *dest, const float *src, size_t n, float volume)
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_loadu_ps(src + i), v));
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2AddVolFloat(float *a, const float *b, size_t n,
+		float volume1, float volume2)
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	/* no FMA here: fused rounding would differ from the
+	   portable code */
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(a + i), v1);
+		__m256 y = _mm256_mul_ps(_mm256_loadu_ps(b + i), v2);
+		_mm256_storeu_ps(a + i, _mm256_add_ps(x, y));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2AddFloat(float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i,
+				 _mm256_add_ps(_mm256_loadu_ps(a + i),
+					       _mm256_loadu_ps(b + i)));
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2Add16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		_mm256_storeu_si256((__m256i *)(a + i),
+				    _mm256_adds_epi16(x, y));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2Add24(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m256i min = _mm256_set1_epi32(MIN_24);
+	const __m256i max = _mm256_set1_epi32(MAX_24);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		x = _mm256_add_epi32(x, y);
+		x = _mm256_min_epi32(_mm256_max_epi32(x, min), max);
+		_mm256_storeu_si256((__m256i *)(a + i), x);
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2FloatTo16(int16_t *dest, const float *src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FACTOR_16);
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i x = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i),
+							       factor));
+		__m256i y = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8),
+							       factor));
+
+		/* vpackssdw works on each 128 bit lane separately;
+		   restore the sample order afterwards */
+		__m256i z = _mm256_packs_epi32(x, y);
+		z = _mm256_permute4x64_epi64(z, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)(dest + i), z);
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2FloatTo24(int32_t *dest, const float *src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FACTOR_24);
+	const __m256 min = _mm256_set1_ps(MIN_24);
+	const __m256 max = _mm256_set1_ps(MAX_24);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), factor);
+		x = _mm256_min_ps(_mm256_max_ps(x, min), max);
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_cvttps_epi32(x));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2FloatTo32(int32_t *dest, const float *src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FACTOR_32);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), factor);
+		__m256i overflow =
+			_mm256_castps_si256(_mm256_cmp_ps(x, factor,
+							  _CMP_GE_OQ));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_xor_si256(_mm256_cvttps_epi32(x),
+						     overflow));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2S16ToFloat(float *dest, const int16_t *src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(1.f / FACTOR_16);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	return i;
+}
+
+static inline size_t AVX2_TARGET
+Avx2IntegerToFloat(float *dest, const int32_t *src, size_t n, float _factor)
+{
+	const __m256 factor = _mm256_set1_ps(_factor);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2S24ToFloat(float *dest, const int32_t *src, size_t n)
+{
+	return Avx2IntegerToFloat(dest, src, n, 1.f / FACTOR_24);
+}
+
+static size_t AVX2_TARGET
+Avx2S32ToFloat(float *dest, const int32_t *src, size_t n)
+{
+	return Avx2IntegerToFloat(dest, src, n, 1.f / FACTOR_32);
+}
+
+/**
+ * Convert 16 bit samples to 32 bit samples with the given left
+ * shift applied.
+ */
+template<int left_shift>
+static inline size_t AVX2_TARGET
+Avx2S16ToShifted(int32_t *dest, const int16_t *src, size_t n)
+{
+	static_assert(left_shift >= 0 && left_shift <= 16,
+		      "Shift out of range");
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_slli_epi32(x, left_shift));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2S16To24(int32_t *dest, const int16_t *src, size_t n)
+{
+	return Avx2S16ToShifted<S16ShiftTo(24)>(dest, src, n);
+}
+
+static size_t AVX2_TARGET
+Avx2S16To32(int32_t *dest, const int16_t *src, size_t n)
+{
+	return Avx2S16ToShifted<S16ShiftTo(32)>(dest, src, n);
+}
+
+static size_t AVX2_TARGET
+Avx2S24To32(int32_t *dest, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_slli_epi32(x, 8));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2S32To24(int32_t *dest, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_srai_epi32(x, 8));
+	}
+
+	return i;
+}
+
+static size_t AVX2_TARGET
+Avx2DsdToFloat(float *dest, const uint8_t *src, size_t n, size_t stride,
+	       const float (*tables)[256])
+{
+	constexpr size_t CTABLES = 6;
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		/* two double accumulators for 8 samples, to get the
+		   same rounding as the portable code */
+		__m256d acc_lo = _mm256_setzero_pd();
+		__m256d acc_hi = _mm256_setzero_pd();
+
+		for (size_t t = 0; t < CTABLES; ++t) {
+			const uint8_t *a = src + i + (CTABLES * 2 - 1 - t) * stride;
+			const uint8_t *b = src + i + t * stride;
+
+			__m256i ia = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)a));
+			__m256i ib = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)b));
+
+			__m256 x = _mm256_add_ps(_mm256_i32gather_ps(tables[t], ia, 4),
+						 _mm256_i32gather_ps(tables[CTABLES + t], ib, 4));
+
+			acc_lo = _mm256_add_pd(acc_lo,
+					       _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+			acc_hi = _mm256_add_pd(acc_hi,
+					       _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+		}
+
+		_mm_storeu_ps(dest + i, _mm256_cvtpd_ps(acc_lo));
+		_mm_storeu_ps(dest + i + 4, _mm256_cvtpd_ps(acc_hi));
+	}
+
+	return i;
+}
+
+static constexpr X86PcmKernels avx2_kernels = {
+	"AVX2",
+	Avx2VolumeFloat,
+	Avx2AddVolFloat,
+	Avx2AddFloat,
+	Avx2Add16,
+	Avx2Add24,
+	Avx2FloatTo16,
+	Avx2FloatTo24,
+	Avx2FloatTo32,
+	Avx2S16ToFloat,
+	Avx2S24ToFloat,
+	Avx2S32ToFloat,
+	Avx2S16To24,
+	Avx2S16To32,
+	Avx2S24To32,
+	Avx2S32To24,
+	Avx2DsdToFloat,
+};
+
+const X86PcmKernels *
+GetX86PcmKernels(X86SimdLevel level)
+{
+	/* this may be called by a global initializer before
+	   libgcc's own constructor has run */
+	__builtin_cpu_init();
+
+	switch (level) {
+	case X86SimdLevel::SSE2:
+		return __builtin_cpu_supports("sse2")
+			? &sse2_kernels
+			: nullptr;
+
+	case X86SimdLevel::AVX2:
+		return __builtin_cpu_supports("avx2")
+			? &avx2_kernels
+			: nullptr;
+	}
+
+	return nullptr;
+}
+
+static const X86PcmKernels *
+DetectX86PcmKernels()
+{
+	const X86PcmKernels *k = GetX86PcmKernels(X86SimdLevel::AVX2);
+	if (k == nullptr)
+		k = GetX86PcmKernels(X86SimdLevel::SSE2);
+	return k;
+}
+
+const X86PcmKernels *const x86_pcm_kernels = DetectX86PcmKernels();
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_X86_SIMD_HXX
+#define MPD_PCM_X86_SIMD_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if (defined(__i386__) || defined(__x86_64__)) && CLANG_OR_GCC_VERSION(4,9)
+#define HAVE_X86_SIMD
+#endif
+
+#ifdef HAVE_X86_SIMD
+
+enum class X86SimdLevel {
+	SSE2,
+	AVX2,
+};
+
+template<typename D, typename S>
+using X86ConvertFunction = size_t (*)(D *dest, const S *src, size_t n);
+
+/**
+ * A table of SSE2 or AVX2 kernels for the hot PCM loops.
+ *
+ * Each kernel processes only whole vectors and returns the number of
+ * samples it has handled; the caller is responsible for the rest,
+ * using the portable implementation.  For finite input, all kernels
+ * produce exactly the same output as the portable implementation.
+ */
+struct X86PcmKernels {
+	const char *name;
+
+	/**
+	 * dest[i] = src[i] * volume
+	 */
+	size_t (*volume_float)(float *dest, const float *src, size_t n,
+			       float volume);
+
+	/**
+	 * a[i] = a[i] * volume1 + b[i] * volume2
+	 */
+	size_t (*add_vol_float)(float *a, const float *b, size_t n,
+				float volume1, float volume2);
+
+	/**
+	 * a[i] = a[i] + b[i]
+	 */
+	size_t (*add_float)(float *a, const float *b, size_t n);
+
+	/**
+	 * a[i] = clamp(a[i] + b[i])
+	 */
+	size_t (*add_16)(int16_t *a, const int16_t *b, size_t n);
+
+	/**
+	 * a[i] = clamp(a[i] + b[i]) for #SampleFormat::S24_P32
+	 */
+	size_t (*add_24)(int32_t *a, const int32_t *b, size_t n);
+
+	X86ConvertFunction<int16_t, float> float_to_16;
+	X86ConvertFunction<int32_t, float> float_to_24;
+	X86ConvertFunction<int32_t, float> float_to_32;
+
+	X86ConvertFunction<float, int16_t> s16_to_float;
+	X86ConvertFunction<float, int32_t> s24_to_float;
+	X86ConvertFunction<float, int32_t> s32_to_float;
+
+	X86ConvertFunction<int32_t, int16_t> s16_to_24;
+	X86ConvertFunction<int32_t, int16_t> s16_to_32;
+	X86ConvertFunction<int32_t, int32_t> s24_to_32;
+	X86ConvertFunction<int32_t, int32_t> s32_to_24;
+
+	/**
+	 * Run the DSD to PCM filter (see #PcmDsd) over an interleaved
+	 * buffer.  May be nullptr.
+	 *
+	 * @param src the oldest DSD byte of the first output sample's
+	 * filter window
+	 * @param stride the number of channels
+	 * @param tables the 12 lookup tables: 6 for the most recent
+	 * bytes, then 6 for the older, bit-reversed half
+	 */
+	size_t (*dsd_to_float)(float *dest, const uint8_t *src, size_t n,
+			       size_t stride, const float (*tables)[256]);
+};
+
+/**
+ * The best kernels supported by this CPU (determined with CPUID at
+ * startup), or nullptr if it has none.
+ */
+extern const X86PcmKernels *const x86_pcm_kernels;
+
+/**
+ * Returns the kernels for the specified instruction set, or nullptr
+ * if this CPU does not support it.  This is used by the unit tests
+ * and benchmarks to compare all implementations.
+ */
+gcc_pure
+const X86PcmKernels *
+GetX86PcmKernels(X86SimdLevel level);
+
+/**
+ * Wrapper for a "portable" converter class which lets the x86
+ * kernel do the bulk of the work.
+ */
+template<typename Portable,
+	 X86ConvertFunction<typename Portable::DstTraits::value_type,
+			    typename Portable::SrcTraits::value_type> X86PcmKernels::*kernel>
+struct X86OptimizedConvert : Portable {
+	typedef typename Portable::SrcTraits SrcTraits;
+	typedef typename Portable::DstTraits DstTraits;
+
+	void Convert(typename DstTraits::pointer_type out,
+		     typename SrcTraits::const_pointer_type in,
+		     size_t n) const {
+		const X86PcmKernels *k = x86_pcm_kernels;
+		if (k != nullptr) {
+			const size_t done = (k->*kernel)(out, in, n);
+			out += done;
+			in += done;
+			n -= done;
+		}
+
+		Portable::Convert(out, in, n);
+	}
+};
+
+#endif
+
+#endif
@@ -29,6 +29,7 @@
 #include "Chrono.hxx"
 
 #include <stdint.h>
+#include <stddef.h>
 
 class PlayerListener;
 class MultipleOutputs;
@@ -100,6 +101,11 @@ struct PlayerControl {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The size of MusicChunk::data in bytes.
+	 */
+	const size_t chunk_size;
+
 	const unsigned buffered_before_play;
 
 	/**
@@ -180,6 +186,7 @@ struct PlayerControl {
 	PlayerControl(PlayerListener &_listener,
 		      MultipleOutputs &_outputs,
 		      unsigned buffer_chunks,
+		      size_t chunk_size,
 		      unsigned buffered_before_play);
 	~PlayerControl();
 
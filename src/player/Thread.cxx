@@ -530,7 +530,7 @@ Player::SendSilence()
 	const size_t frame_size = play_audio_format.GetFrameSize();
 	/* this formula ensures that we don't send
 	   partial frames */
-	unsigned num_frames = sizeof(chunk->data) / frame_size;
+	unsigned num_frames = chunk->capacity / frame_size;
 
 	chunk->time = SignedSongTime::Negative(); /* undefined time stamp */
 	chunk->length = num_frames * frame_size;
@@ -645,6 +645,14 @@ Player::ProcessCommand()
 		pc.Unlock();
 		if (dc.LockIsIdle())
 			StartDecoder(*new MusicPipe());
+		else {
+			/* the decoder is still busy with the current
+			   song; let it open the next one in
+			   advance */
+			dc.Lock();
+			dc.Prefetch(*pc.next_song);
+			dc.Unlock();
+		}
 		pc.Lock();
 
 		break;
@@ -696,6 +704,8 @@ Player::ProcessCommand()
 			pc.Lock();
 		}
 
+		dc.CancelPrefetch();
+
 		delete pc.next_song;
 		pc.next_song = nullptr;
 		queued = false;
@@ -1036,6 +1046,7 @@ Player::Run()
 							dc.GetMixRampPreviousEnd(),
 							dc.out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							pc.buffered_before_play);
 			if (cross_fade_chunks > 0)
@@ -1139,7 +1150,7 @@ player_task(void *arg)
 	DecoderControl dc(pc.mutex, pc.cond);
 	decoder_thread_start(dc);
 
-	MusicBuffer buffer(pc.buffer_chunks);
+	MusicBuffer buffer(pc.buffer_chunks, pc.chunk_size);
 
 	pc.Lock();
 
@@ -1170,6 +1181,14 @@ player_task(void *arg)
 			break;
 
 		case PlayerCommand::CLOSE_AUDIO:
+			/* playback has been stopped for good; a stream
+			   prefetched for the next song is not needed
+			   anymore (this is not done after "STOP",
+			   because "play" sends "STOP" and "QUEUE", and
+			   it may want that song); pc.mutex is also the
+			   #DecoderControl mutex */
+			dc.CancelPrefetch();
+
 			pc.Unlock();
 
 			pc.outputs.Release();
@@ -1179,6 +1198,10 @@ player_task(void *arg)
 
 			assert(buffer.IsEmptyUnsafe());
 
+			/* nobody uses the buffer now; release its
+			   memory */
+			buffer.DiscardUnsafe();
+
 			break;
 
 		case PlayerCommand::UPDATE_AUDIO:
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ChangeLog.hxx"
+
+#include <algorithm>
+#include <iterator>
+
+
+void
+QueueChangeLog::Append(uint32_t version, unsigned position)
+{
+	if (n_records == CAPACITY) {
+		/* discard the oldest record; from now on, the log
+		   is only complete for newer versions */
+		const Record &oldest = GetRecord(0);
+		if (oldest.version >= complete_since)
+			complete_since = oldest.version + 1;
+
+		head = (head + 1) % CAPACITY;
+		--n_records;
+	}
+
+	Record &record = GetRecord(n_records++);
+	record.version = version;
+	record.start = position;
+	record.end = position + 1;
+}
+
+bool
+QueueChangeLog::Collect(uint32_t version, std::vector<Range> &dest) const
+{
+	dest.clear();
+
+	if (version < complete_since)
+		return false;
+
+	/* records are in ascending version order; walk backwards
+	   until the requested version */
+	for (unsigned i = n_records; i > 0; --i) {
+		const Record &record = GetRecord(i - 1);
+		if (record.version < version)
+			break;
+
+		dest.push_back({record.start, record.end});
+	}
+
+	if (dest.empty())
+		return true;
+
+	std::sort(dest.begin(), dest.end(),
+		  [](const Range &a, const Range &b){
+			  return a.start < b.start;
+		  });
+
+	/* merge overlapping and adjacent ranges */
+	auto o = dest.begin();
+	for (auto i = std::next(dest.begin()); i != dest.end(); ++i) {
+		if (i->start <= o->end)
+			o->end = std::max(o->end, i->end);
+		else
+			*++o = *i;
+	}
+
+	dest.erase(std::next(o), dest.end());
+	return true;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_CHANGE_LOG_HXX
+#define MPD_QUEUE_CHANGE_LOG_HXX
+
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * A bounded log of the queue positions which have been modified,
+ * together with the queue version of each modification.  It allows
+ * answering "plchanges" in O(changes) instead of scanning the whole
+ * queue.  When the log overflows, the oldest records are discarded,
+ * and queries for old versions must fall back to a full scan.
+ */
+class QueueChangeLog {
+public:
+	/**
+	 * A range of queue positions.
+	 */
+	struct Range {
+		unsigned start, end;
+	};
+
+private:
+	struct Record {
+		uint32_t version;
+
+		/**
+		 * The modified positions, [start, end).
+		 */
+		unsigned start, end;
+	};
+
+	static constexpr unsigned CAPACITY = 256;
+
+	Record records[CAPACITY];
+
+	/**
+	 * The index of the oldest record.
+	 */
+	unsigned head;
+
+	/**
+	 * The number of records.
+	 */
+	unsigned n_records;
+
+	/**
+	 * All modifications with this version or newer are in the
+	 * log.
+	 */
+	uint32_t complete_since;
+
+public:
+	explicit QueueChangeLog(uint32_t version)
+		:head(0), n_records(0), complete_since(version) {}
+
+	QueueChangeLog(const QueueChangeLog &) = delete;
+	QueueChangeLog &operator=(const QueueChangeLog &) = delete;
+
+	/**
+	 * Discard all records.  Modifications starting with the
+	 * specified version will be logged.
+	 */
+	void Reset(uint32_t version) {
+		head = 0;
+		n_records = 0;
+		complete_since = version;
+	}
+
+	/**
+	 * Discard all records, and disable the log until the next
+	 * Reset() call.
+	 */
+	void Invalidate() {
+		Reset(UINT32_MAX);
+	}
+
+	/**
+	 * Record a modification of the specified position.
+	 * Consecutive modifications of adjacent positions in the same
+	 * version are merged into one record.
+	 */
+	void Add(uint32_t version, unsigned position) {
+		if (n_records > 0) {
+			Record &last = GetRecord(n_records - 1);
+			if (last.version == version &&
+			    position + 1 >= last.start &&
+			    position <= last.end) {
+				if (position < last.start)
+					last.start = position;
+				else if (position == last.end)
+					++last.end;
+				return;
+			}
+		}
+
+		Append(version, position);
+	}
+
+	/**
+	 * Collect the positions which have been modified in the
+	 * specified version or later.  The ranges are sorted and do
+	 * not overlap; they may exceed the current queue length.
+	 *
+	 * @return false if the log does not reach back to this
+	 * version
+	 */
+	bool Collect(uint32_t version, std::vector<Range> &dest) const;
+
+private:
+	Record &GetRecord(unsigned i) {
+		return records[(head + i) % CAPACITY];
+	}
+
+	const Record &GetRecord(unsigned i) const {
+		return records[(head + i) % CAPACITY];
+	}
+
+	void Append(uint32_t version, unsigned position);
+};
+
+#endif
@@ -52,11 +52,13 @@ struct playlist {
 	bool stop_on_error;
 
 	/**
-	 * If true, then a bulk edit has been initiated by
+	 * If non-zero, then a bulk edit has been initiated by
 	 * BeginBulk(), and UpdateQueuedSong() and OnModified() will
-	 * be postponed until CommitBulk()
+	 * be postponed until CommitBulk().  Bulk edits may be nested
+	 * (e.g. an "add" inside a batched command list); this counts
+	 * the nesting level.
 	 */
-	bool bulk_edit;
+	unsigned bulk_edit;
 
 	/**
 	 * Has the queue been modified during bulk edit mode?
@@ -88,7 +90,7 @@ struct playlist {
 
 	playlist(unsigned max_length)
 		:queue(max_length), playing(false),
-		 bulk_edit(false),
+		 bulk_edit(0),
 		 current(-1), queued(-1) {
 	}
 
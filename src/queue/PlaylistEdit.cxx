@@ -63,19 +63,19 @@ playlist::Clear(PlayerControl &pc)
 void
 playlist::BeginBulk()
 {
-	assert(!bulk_edit);
+	if (bulk_edit++ > 0)
+		/* nested: the outermost CommitBulk() does the work */
+		return;
 
-	bulk_edit = true;
 	bulk_modified = false;
 }
 
 void
 playlist::CommitBulk(PlayerControl &pc)
 {
-	assert(bulk_edit);
+	assert(bulk_edit > 0);
 
-	bulk_edit = false;
-	if (!bulk_modified)
+	if (--bulk_edit > 0 || !bulk_modified)
 		return;
 
 	if (queued < 0)
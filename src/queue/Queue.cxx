@@ -27,6 +27,7 @@ Queue::Queue(unsigned _max_length)
 	 items(new Item[max_length]),
 	 order(new unsigned[max_length]),
 	 id_table(max_length * HASH_MULT),
+	 changes(version),
 	 repeat(false),
 	 single(false),
 	 consume(false),
@@ -42,6 +43,41 @@ Queue::~Queue()
 	delete[] order;
 }
 
+void
+Queue::FindNewer(uint32_t _version, unsigned start, unsigned end,
+		 std::vector<QueueChangeLog::Range> &dest) const
+{
+	assert(start <= end);
+
+	end = std::min(end, length);
+
+	if (_version <= version && changes.Collect(_version, dest)) {
+		/* clip the ranges from the log */
+		auto o = dest.begin();
+		for (const auto &i : dest) {
+			const unsigned a = std::max(i.start, start);
+			const unsigned b = std::min(i.end, end);
+			if (a < b)
+				*o++ = {a, b};
+		}
+
+		dest.erase(o, dest.end());
+		return;
+	}
+
+	dest.clear();
+
+	for (unsigned i = start; i < end; ++i) {
+		if (!IsNewerAtPosition(i, _version))
+			continue;
+
+		if (!dest.empty() && dest.back().end == i)
+			++dest.back().end;
+		else
+			dest.push_back({i, i + 1});
+	}
+}
+
 int
 Queue::GetNextOrder(unsigned _order) const
 {
@@ -71,6 +107,9 @@ Queue::IncrementVersion()
 			items[i].version = 0;
 
 		version = 1;
+
+		/* the log cannot represent "version 0" items */
+		changes.Invalidate();
 	}
 }
 
@@ -94,8 +133,8 @@ Queue::Append(DetachedSong &&song, uint8_t priority)
 	auto &item = items[position];
 	item.song = new DetachedSong(std::move(song));
 	item.id = id;
-	item.version = version;
 	item.priority = priority;
+	ModifyAtPosition(position);
 
 	order[position] = position;
 
@@ -110,8 +149,8 @@ Queue::SwapPositions(unsigned position1, unsigned position2)
 
 	std::swap(items[position1], items[position2]);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	ModifyAtPosition(position1);
+	ModifyAtPosition(position2);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
@@ -136,7 +175,7 @@ Queue::MovePostion(unsigned from, unsigned to)
 
 	id_table.Move(tmp.id, to);
 	items[to] = tmp;
-	items[to].version = version;
+	ModifyAtPosition(to);
 
 	/* now deal with order */
 
@@ -176,7 +215,7 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to)
 	{
 		id_table.Move(tmp[i - start].id, to + i - start);
 		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
+		ModifyAtPosition(to + i - start);
 	}
 
 	if (random) {
@@ -259,6 +298,9 @@ Queue::Clear()
 	}
 
 	length = 0;
+
+	/* all positions are going to be new */
+	changes.Reset(version);
 }
 
 static void
@@ -412,8 +454,8 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
 	item->priority = priority;
+	ModifyAtPosition(position);
 
 	if (!random || !reorder)
 		/* don't reorder if not in random mode */
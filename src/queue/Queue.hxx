@@ -22,9 +22,11 @@
 
 #include "Compiler.h"
 #include "IdTable.hxx"
+#include "ChangeLog.hxx"
 #include "util/LazyRandomEngine.hxx"
 
 #include <algorithm>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -87,6 +89,9 @@ struct Queue {
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/** which positions were modified in which version? */
+	QueueChangeLog changes;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat;
@@ -225,6 +230,17 @@ struct Queue {
 			items[position].version == 0;
 	}
 
+	/**
+	 * Find the positions within [start, end) which are newer
+	 * than the specified version (see IsNewerAtPosition()).  This
+	 * uses the #changes log if possible, and scans the range
+	 * only if the log does not reach back far enough.
+	 *
+	 * @param dest the sorted ranges of matching positions
+	 */
+	void FindNewer(uint32_t _version, unsigned start, unsigned end,
+		       std::vector<QueueChangeLog::Range> &dest) const;
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -249,6 +265,7 @@ struct Queue {
 		assert(position < length);
 
 		items[position].version = version;
+		changes.Add(version, position);
 	}
 
 	/**
@@ -359,7 +376,7 @@ private:
 		unsigned from_id = items[from].id;
 
 		items[to] = items[from];
-		items[to].version = version;
+		ModifyAtPosition(to);
 		id_table.Move(from_id, to);
 	}
 
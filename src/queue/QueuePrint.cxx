@@ -76,14 +76,11 @@ queue_print_changes_info(Response &r, Partition &partition, const Queue &queue,
 {
 	assert(start <= end);
 
-	if (start >= queue.GetLength())
-		return;
+	std::vector<QueueChangeLog::Range> ranges;
+	queue.FindNewer(version, start, end, ranges);
 
-	if (end > queue.GetLength())
-		end = queue.GetLength();
-
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
+	for (const auto &range : ranges)
+		for (unsigned i = range.start; i < range.end; i++)
 			queue_print_song_info(r, partition, queue, i);
 }
 
@@ -94,14 +91,11 @@ queue_print_changes_position(Response &r, const Queue &queue,
 {
 	assert(start <= end);
 
-	if (start >= queue.GetLength())
-		return;
-
-	if (end > queue.GetLength())
-		end = queue.GetLength();
+	std::vector<QueueChangeLog::Range> ranges;
+	queue.FindNewer(version, start, end, ranges);
 
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
+	for (const auto &range : ranges)
+		for (unsigned i = range.start; i < range.end; i++)
 			r.Format("cpos: %i\nId: %i\n",
 				 i, queue.PositionToId(i));
 }
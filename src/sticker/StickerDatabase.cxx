@@ -22,7 +22,9 @@
 #include "lib/sqlite/Domain.hxx"
 #include "lib/sqlite/Util.hxx"
 #include "fs/Path.hxx"
+#include "event/TimeoutMonitor.hxx"
 #include "Idle.hxx"
+#include "Log.hxx"
 #include "util/Error.hxx"
 #include "util/Macros.hxx"
 
@@ -46,6 +48,9 @@ enum sticker_sql {
 	STICKER_SQL_FIND_VALUE,
 	STICKER_SQL_FIND_LT,
 	STICKER_SQL_FIND_GT,
+	STICKER_SQL_BEGIN,
+	STICKER_SQL_COMMIT,
+	STICKER_SQL_ROLLBACK,
 };
 
 static const char *const sticker_sql[] = {
@@ -72,6 +77,13 @@ static const char *const sticker_sql[] = {
 
 	//[STICKER_SQL_FIND_GT] =
 	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value>?",
+
+	//[STICKER_SQL_BEGIN] =
+	"BEGIN",
+	//[STICKER_SQL_COMMIT] =
+	"COMMIT",
+	//[STICKER_SQL_ROLLBACK] =
+	"ROLLBACK",
 };
 
 static const char sticker_sql_create[] =
@@ -85,9 +97,81 @@ static const char sticker_sql_create[] =
 	" sticker_value ON sticker(type, uri, name);"
 	"";
 
+/**
+ * With a write-ahead log, readers do not block the writer, and
+ * committing a transaction does not need to sync the database file
+ * (only checkpoints do).
+ */
+static const char sticker_sql_pragmas[] =
+	"PRAGMA journal_mode=WAL;"
+	"PRAGMA synchronous=NORMAL;";
+
+/**
+ * Modifications are collected in one transaction, which is committed
+ * this many milliseconds after the first one.
+ */
+static constexpr unsigned STICKER_COMMIT_DELAY_MS = 500;
+
+/**
+ * If the database is busy (locked by another process), the commit
+ * is retried this many times, #STICKER_COMMIT_DELAY_MS apart, before
+ * the transaction is rolled back.
+ */
+static constexpr unsigned STICKER_COMMIT_RETRIES = 20;
+
+/**
+ * Values up to this length are kept in #sticker_value_cache; that
+ * is enough for ratings, play counts and time stamps.
+ */
+static constexpr size_t STICKER_CACHE_MAX_VALUE = 64;
+
+/**
+ * The #sticker_value_cache is flushed when it grows beyond this
+ * number of entries.
+ */
+static constexpr size_t STICKER_CACHE_SIZE = 65536;
+
 static sqlite3 *sticker_db;
 static sqlite3_stmt *sticker_stmt[ARRAY_SIZE(sticker_sql)];
 
+/**
+ * Is there an open transaction with uncommitted modifications?
+ */
+static bool sticker_in_transaction;
+
+/**
+ * The number of modifying statements in the open transaction.
+ */
+static unsigned sticker_pending_statements;
+
+/**
+ * The number of failed attempts to commit the open transaction
+ * because the database was busy.
+ */
+static unsigned sticker_commit_retries;
+
+/**
+ * A read-through cache for sticker_load_value().  The key is made of
+ * type, URI and name, separated by null bytes; an empty value means
+ * the sticker does not exist.
+ */
+static std::map<std::string, std::string> sticker_value_cache;
+
+static void
+sticker_commit(bool final);
+
+class StickerCommitTimer final : public TimeoutMonitor {
+public:
+	StickerCommitTimer(EventLoop &_loop):TimeoutMonitor(_loop) {}
+
+protected:
+	void OnTimeout() override {
+		sticker_commit(false);
+	}
+};
+
+static StickerCommitTimer *sticker_commit_timer;
+
 static sqlite3_stmt *
 sticker_prepare(const char *sql, Error &error)
 {
@@ -104,7 +188,7 @@ sticker_prepare(const char *sql, Error &error)
 }
 
 bool
-sticker_global_init(Path path, Error &error)
+sticker_global_init(EventLoop &loop, Path path, Error &error)
 {
 	assert(!path.IsNull());
 
@@ -121,6 +205,15 @@ sticker_global_init(Path path, Error &error)
 		return false;
 	}
 
+	ret = sqlite3_exec(sticker_db, sticker_sql_pragmas,
+			   nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK) {
+		error.Format(sqlite_domain, ret,
+			     "Failed to configure sticker database: %s",
+			     sqlite3_errmsg(sticker_db));
+		return false;
+	}
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(sticker_db, sticker_sql_create,
@@ -142,6 +235,7 @@ sticker_global_init(Path path, Error &error)
 			return false;
 	}
 
+	sticker_commit_timer = new StickerCommitTimer(loop);
 	return true;
 }
 
@@ -152,6 +246,16 @@ sticker_global_finish()
 		/* not configured */
 		return;
 
+	if (sticker_commit_timer != nullptr) {
+		sticker_commit_timer->Cancel();
+		sticker_commit(true);
+
+		delete sticker_commit_timer;
+		sticker_commit_timer = nullptr;
+	}
+
+	sticker_value_cache.clear();
+
 	for (unsigned i = 0; i < ARRAY_SIZE(sticker_stmt); ++i) {
 		assert(sticker_stmt[i] != nullptr);
 
@@ -167,6 +271,131 @@ sticker_enabled()
 	return sticker_db != nullptr;
 }
 
+static bool
+sticker_execute(enum sticker_sql sql, Error &error)
+{
+	sqlite3_stmt *const stmt = sticker_stmt[sql];
+
+	bool success = ExecuteCommand(stmt, error);
+	sqlite3_reset(stmt);
+	return success;
+}
+
+/**
+ * Begin a transaction for the following modification, unless one
+ * is already open, and schedule its commit.
+ */
+static bool
+sticker_begin(Error &error)
+{
+	if (!sticker_in_transaction) {
+		if (!sticker_execute(STICKER_SQL_BEGIN, error))
+			return false;
+
+		sticker_in_transaction = true;
+		sticker_pending_statements = 0;
+		sticker_commit_retries = 0;
+		sticker_commit_timer->Schedule(STICKER_COMMIT_DELAY_MS);
+	}
+
+	++sticker_pending_statements;
+	return true;
+}
+
+/**
+ * Commit the open transaction.  If the database is busy, the commit
+ * is retried later (or, if this is the final commit before
+ * shutdown, sqlite waits for the lock); the transaction stays open
+ * meanwhile.
+ */
+static void
+sticker_commit(bool final)
+{
+	if (!sticker_in_transaction)
+		return;
+
+	if (final)
+		sqlite3_busy_timeout(sticker_db,
+				     STICKER_COMMIT_RETRIES *
+				     STICKER_COMMIT_DELAY_MS);
+
+	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_COMMIT];
+	const int result = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+
+	if (result == SQLITE_DONE) {
+		sticker_in_transaction = false;
+		return;
+	}
+
+	if ((result == SQLITE_BUSY || result == SQLITE_LOCKED) && !final &&
+	    sticker_commit_retries < STICKER_COMMIT_RETRIES) {
+		++sticker_commit_retries;
+		LogDebug(sqlite_domain,
+			 "Sticker database is busy, retrying commit");
+		sticker_commit_timer->Schedule(STICKER_COMMIT_DELAY_MS);
+		return;
+	}
+
+	FormatError(sqlite_domain,
+		    "Failed to commit sticker database, "
+		    "discarding %u statements: %s",
+		    sticker_pending_statements,
+		    sqlite3_errmsg(sticker_db));
+
+	/* the rollback discards the modifications, and the cache
+	   may contain some of them */
+	sticker_value_cache.clear();
+
+	Error error;
+	if (!sticker_execute(STICKER_SQL_ROLLBACK, error))
+		LogError(error);
+
+	sticker_in_transaction = false;
+}
+
+static std::string
+sticker_cache_key(const char *type, const char *uri, const char *name)
+{
+	std::string key(type);
+	key.push_back(0);
+	key.append(uri);
+	key.push_back(0);
+	key.append(name);
+	return key;
+}
+
+/**
+ * Remember a value (or its absence, if empty) in the cache.
+ */
+static void
+sticker_cache_put(std::string &&key, const std::string &value)
+{
+	if (value.length() > STICKER_CACHE_MAX_VALUE) {
+		sticker_value_cache.erase(key);
+		return;
+	}
+
+	if (sticker_value_cache.size() >= STICKER_CACHE_SIZE)
+		sticker_value_cache.clear();
+
+	sticker_value_cache[std::move(key)] = value;
+}
+
+/**
+ * Remove all cached values of one object.
+ */
+static void
+sticker_cache_erase(const char *type, const char *uri)
+{
+	const std::string prefix = sticker_cache_key(type, uri, "");
+
+	auto i = sticker_value_cache.lower_bound(prefix);
+	while (i != sticker_value_cache.end() &&
+	       i->first.compare(0, prefix.length(), prefix) == 0)
+		i = sticker_value_cache.erase(i);
+}
+
 std::string
 sticker_load_value(const char *type, const char *uri, const char *name,
 		   Error &error)
@@ -181,16 +410,27 @@ sticker_load_value(const char *type, const char *uri, const char *name,
 	if (*name == 0)
 		return std::string();
 
+	auto key = sticker_cache_key(type, uri, name);
+	auto i = sticker_value_cache.find(key);
+	if (i != sticker_value_cache.end())
+		return i->second;
+
 	if (!BindAll(error, stmt, type, uri, name))
 		return std::string();
 
 	std::string value;
+	bool success = true;
 	if (ExecuteRow(stmt, error))
 		value = (const char*)sqlite3_column_text(stmt, 0);
+	else
+		success = !error.IsDefined();
 
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	if (success)
+		sticker_cache_put(std::move(key), value);
+
 	return value;
 }
 
@@ -235,7 +475,8 @@ sticker_update_value(const char *type, const char *uri,
 
 	assert(sticker_enabled());
 
-	if (!BindAll(error, stmt, value, type, uri, name))
+	if (!sticker_begin(error) ||
+	    !BindAll(error, stmt, value, type, uri, name))
 		return false;
 
 	bool modified = ExecuteModified(stmt, error);
@@ -263,7 +504,8 @@ sticker_insert_value(const char *type, const char *uri,
 
 	assert(sticker_enabled());
 
-	if (!BindAll(error, stmt, type, uri, name, value))
+	if (!sticker_begin(error) ||
+	    !BindAll(error, stmt, type, uri, name, value))
 		return false;
 
 	bool success = ExecuteCommand(stmt, error);
@@ -290,8 +532,15 @@ sticker_store_value(const char *type, const char *uri,
 	if (*name == 0)
 		return false;
 
-	return sticker_update_value(type, uri, name, value, error) ||
-		sticker_insert_value(type, uri, name, value, error);
+	if (!sticker_update_value(type, uri, name, value, error) &&
+	    (error.IsDefined() ||
+	     !sticker_insert_value(type, uri, name, value, error))) {
+		sticker_value_cache.erase(sticker_cache_key(type, uri, name));
+		return false;
+	}
+
+	sticker_cache_put(sticker_cache_key(type, uri, name), value);
+	return true;
 }
 
 bool
@@ -303,7 +552,7 @@ sticker_delete(const char *type, const char *uri, Error &error)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
-	if (!BindAll(error, stmt, type, uri))
+	if (!sticker_begin(error) || !BindAll(error, stmt, type, uri))
 		return false;
 
 	bool modified = ExecuteModified(stmt, error);
@@ -311,6 +560,8 @@ sticker_delete(const char *type, const char *uri, Error &error)
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	sticker_cache_erase(type, uri);
+
 	if (modified)
 		idle_add(IDLE_STICKER);
 	return modified;
@@ -326,7 +577,7 @@ sticker_delete_value(const char *type, const char *uri, const char *name,
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
-	if (!BindAll(error, stmt, type, uri, name))
+	if (!sticker_begin(error) || !BindAll(error, stmt, type, uri, name))
 		return false;
 
 	bool modified = ExecuteModified(stmt, error);
@@ -334,6 +585,12 @@ sticker_delete_value(const char *type, const char *uri, const char *name,
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	if (error.IsDefined())
+		sticker_value_cache.erase(sticker_cache_key(type, uri, name));
+	else
+		sticker_cache_put(sticker_cache_key(type, uri, name),
+				  std::string());
+
 	if (modified)
 		idle_add(IDLE_STICKER);
 	return modified;
@@ -49,18 +49,21 @@
 
 class Error;
 class Path;
+class EventLoop;
 struct Sticker;
 
 /**
  * Opens the sticker database.
  *
+ * @param loop the #EventLoop which commits pending modifications
+ * after a short delay
  * @return true on success, false on error
  */
 bool
-sticker_global_init(Path path, Error &error);
+sticker_global_init(EventLoop &loop, Path path, Error &error);
 
 /**
- * Close the sticker database.
+ * Commit pending modifications and close the sticker database.
  */
 void
 sticker_global_finish();
@@ -83,6 +86,11 @@ sticker_load_value(const char *type, const char *uri, const char *name,
 /**
  * Sets a sticker value in the specified object.  Overwrites existing
  * values.
+ *
+ * Modifications are not committed immediately; they are collected in
+ * one transaction, which is committed by the #EventLoop shortly
+ * afterwards.  This applies to sticker_delete() and
+ * sticker_delete_value(), too.
  */
 bool
 sticker_store_value(const char *type, const char *uri,
@@ -19,7 +19,7 @@
 
 #include "config.h"
 #include "Tag.hxx"
-#include "TagPool.hxx"
+#include "TagItemArray.hxx"
 #include "TagString.hxx"
 #include "TagBuilder.hxx"
 #include "util/ASCII.hxx"
@@ -63,29 +63,34 @@ Tag::Clear()
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	tag_pool_lock.lock();
-	for (unsigned i = 0; i < num_items; ++i)
-		tag_pool_put_item(items[i]);
-	tag_pool_lock.unlock();
+	if (items != nullptr) {
+		if (shared_items)
+			tag_items_unref(items, num_items);
+		else
+			tag_items_free_unique(items, num_items);
+	}
 
-	delete[] items;
+	shared_items = false;
 	items = nullptr;
 	num_items = 0;
 }
 
 Tag::Tag(const Tag &other)
 	:duration(other.duration), has_playlist(other.has_playlist),
+	 shared_items(true),
 	 num_items(other.num_items),
-	 items(nullptr)
+	 items(other.items)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
-
-		tag_pool_lock.lock();
-		for (unsigned i = 0; i < num_items; i++)
-			items[i] = tag_pool_dup_item(other.items[i]);
-		tag_pool_lock.unlock();
-	}
+	if (items == nullptr)
+		shared_items = false;
+	else if (other.shared_items)
+		tag_items_ref(items);
+	else
+		/* the other object may be read by other threads
+		   meanwhile, so its unique array can't be converted;
+		   make a shared copy which all further copies will
+		   share */
+		items = tag_items_new_shared(items, num_items);
 }
 
 Tag *
@@ -47,22 +47,31 @@ struct Tag {
 	 */
 	bool has_playlist;
 
+	/**
+	 * Is #items a shared array with a reference counter?  If
+	 * not, this object is its only owner (see TagItemArray.hxx).
+	 */
+	bool shared_items;
+
 	/** the total number of tag items in the #items array */
 	unsigned short num_items;
 
-	/** an array of tag items */
+	/**
+	 * An array of tag items, or nullptr if there are none.
+	 */
 	TagItem **items;
 
 	/**
 	 * Create an empty tag.
 	 */
 	Tag():duration(SignedSongTime::Negative()), has_playlist(false),
-	      num_items(0), items(nullptr) {}
+	      shared_items(false), num_items(0), items(nullptr) {}
 
 	Tag(const Tag &other);
 
 	Tag(Tag &&other)
 		:duration(other.duration), has_playlist(other.has_playlist),
+		 shared_items(other.shared_items),
 		 num_items(other.num_items), items(other.items) {
 		other.items = nullptr;
 		other.num_items = 0;
@@ -80,6 +89,7 @@ struct Tag {
 	Tag &operator=(Tag &&other) {
 		duration = other.duration;
 		has_playlist = other.has_playlist;
+		std::swap(shared_items, other.shared_items);
 		std::swap(items, other.items);
 		std::swap(num_items, other.num_items);
 		return *this;
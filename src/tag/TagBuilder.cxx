@@ -21,11 +21,13 @@
 #include "TagBuilder.hxx"
 #include "Settings.hxx"
 #include "TagPool.hxx"
+#include "TagItemArray.hxx"
 #include "TagString.hxx"
 #include "Tag.hxx"
 #include "util/WritableBuffer.hxx"
 #include "util/StringView.hxx"
 
+#include <algorithm>
 #include <array>
 
 #include <assert.h>
@@ -37,27 +39,45 @@ TagBuilder::TagBuilder(const Tag &other)
 {
 	items.reserve(other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
 		items.push_back(tag_pool_dup_item(other.items[i]));
-	tag_pool_lock.unlock();
 }
 
-TagBuilder::TagBuilder(Tag &&other)
-	:duration(other.duration), has_playlist(other.has_playlist)
+inline void
+TagBuilder::MoveItemsFrom(Tag &other)
 {
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
+	assert(items.empty());
+
+	if (other.items == nullptr)
+		return;
+
 	items.reserve(other.num_items);
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
+	/* if the Tag object was the only owner of its item array,
+	   we can move its references without contacting the tag
+	   pool; if not, we need our own references */
+	if (!other.shared_items)
+		delete[] other.items;
+	else if (!tag_items_steal(other.items)) {
+		for (auto i : items)
+			tag_pool_dup_item(i);
+
+		tag_items_unref(other.items, other.num_items);
+	}
+
 	/* discard the pointers from the Tag object */
+	other.shared_items = false;
 	other.num_items = 0;
-	delete[] other.items;
 	other.items = nullptr;
 }
 
+TagBuilder::TagBuilder(Tag &&other)
+	:duration(other.duration), has_playlist(other.has_playlist)
+{
+	MoveItemsFrom(other);
+}
+
 TagBuilder &
 TagBuilder::operator=(const TagBuilder &other)
 {
@@ -67,10 +87,8 @@ TagBuilder::operator=(const TagBuilder &other)
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_dup_item(i);
-	tag_pool_lock.unlock();
 
 	return *this;
 }
@@ -91,17 +109,8 @@ TagBuilder::operator=(Tag &&other)
 	duration = other.duration;
 	has_playlist = other.has_playlist;
 
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
-	items.clear();
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	RemoveAll();
+	MoveItemsFrom(other);
 
 	return *this;
 }
@@ -127,9 +136,11 @@ TagBuilder::Commit(Tag &tag)
 	   vector::clear() call is important to detach them from this
 	   object */
 	const unsigned n_items = items.size();
+	tag.shared_items = false;
 	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
-	std::copy_n(items.begin(), n_items, tag.items);
+	tag.items = n_items > 0
+		? tag_items_new_unique(&items.front(), n_items)
+		: nullptr;
 	items.clear();
 
 	/* now ensure that this object is fresh (will not delete any
@@ -180,13 +191,11 @@ TagBuilder::Complement(const Tag &other)
 
 	items.reserve(items.size() + other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
 		TagItem *item = other.items[i];
 		if (!present[item->type])
 			items.push_back(tag_pool_dup_item(item));
 	}
-	tag_pool_lock.unlock();
 }
 
 inline void
@@ -198,9 +207,7 @@ TagBuilder::AddItemInternal(TagType type, StringView value)
 	if (!f.IsNull())
 		value = { f.data, f.size };
 
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, value);
-	tag_pool_lock.unlock();
 
 	free(f.data);
 
@@ -230,9 +237,7 @@ TagBuilder::AddItem(TagType type, const char *value)
 void
 TagBuilder::AddEmptyItem(TagType type)
 {
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, StringView::Empty());
-	tag_pool_lock.unlock();
 
 	items.push_back(i);
 }
@@ -240,10 +245,8 @@ TagBuilder::AddEmptyItem(TagType type)
 void
 TagBuilder::RemoveAll()
 {
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_put_item(i);
-	tag_pool_lock.unlock();
 
 	items.clear();
 }
@@ -171,6 +171,12 @@ public:
 	void RemoveType(TagType type);
 
 private:
+	/**
+	 * Move the items of the given #Tag object into this (empty)
+	 * object.
+	 */
+	void MoveItemsFrom(Tag &other);
+
 	gcc_nonnull_all
 	void AddItemInternal(TagType type, StringView value);
 };
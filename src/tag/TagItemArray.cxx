@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "TagItemArray.hxx"
+#include "TagPool.hxx"
+#include "util/Cast.hxx"
+#include "util/VarSize.hxx"
+
+#include <atomic>
+#include <algorithm>
+
+#include <assert.h>
+#include <stddef.h>
+
+struct TagItemArray {
+	std::atomic_uint ref;
+
+	TagItem *items[1];
+
+	TagItemArray(TagItem *const*src, unsigned n):ref(1) {
+		std::copy_n(src, n, items);
+	}
+};
+
+static inline TagItemArray &
+ToArray(TagItem **items)
+{
+	return *OffsetCast<TagItemArray, TagItem *>(items,
+						   -ptrdiff_t(offsetof(TagItemArray, items)));
+}
+
+TagItem **
+tag_items_new_unique(TagItem *const*src, unsigned n)
+{
+	assert(n > 0);
+
+	auto *items = new TagItem *[n];
+	std::copy_n(src, n, items);
+	return items;
+}
+
+void
+tag_items_free_unique(TagItem **items, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		tag_pool_put_item(items[i]);
+
+	delete[] items;
+}
+
+TagItem **
+tag_items_new_shared(TagItem *const*src, unsigned n)
+{
+	assert(n > 0);
+
+	auto *array = NewVarSize<TagItemArray>(sizeof(TagItemArray::items),
+					       sizeof(TagItem *) * n,
+					       src, n);
+
+	for (unsigned i = 0; i < n; ++i)
+		tag_pool_dup_item(array->items[i]);
+
+	return array->items;
+}
+
+void
+tag_items_ref(TagItem **items)
+{
+	auto &array = ToArray(items);
+	assert(array.ref > 0);
+
+	array.ref.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+tag_items_unref(TagItem **items, unsigned n)
+{
+	auto &array = ToArray(items);
+	assert(array.ref > 0);
+
+	if (array.ref.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	for (unsigned i = 0; i < n; ++i)
+		tag_pool_put_item(items[i]);
+
+	DeleteVarSize(&array);
+}
+
+bool
+tag_items_steal(TagItem **items)
+{
+	auto &array = ToArray(items);
+	assert(array.ref > 0);
+
+	if (array.ref.load(std::memory_order_acquire) != 1)
+		return false;
+
+	DeleteVarSize(&array);
+	return true;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TAG_ITEM_ARRAY_HXX
+#define MPD_TAG_ITEM_ARRAY_HXX
+
+#include "Compiler.h"
+
+struct TagItem;
+
+/*
+ * The item array of a #Tag object.  The #TagItem pointers are
+ * references into the tag pool, and thus serve as interned string
+ * ids.
+ *
+ * A #Tag built by #TagBuilder owns a plain array (a "unique" array).
+ * The first copy of it gets a "shared" array, which is allocated in
+ * one block with a reference counter, and is immutable; copying a
+ * #Tag with a shared array only increments the counter, without
+ * allocating memory and without touching the tag pool.  This way,
+ * only tags which are actually copied (e.g. songs in the queue) pay
+ * for the counter, and database songs do not.
+ */
+
+/**
+ * Allocate a new unique item array, taking over the tag pool
+ * references from the given pointers.
+ *
+ * @param n the number of items; must be positive
+ */
+gcc_malloc gcc_nonnull_all
+TagItem **
+tag_items_new_unique(TagItem *const*src, unsigned n);
+
+/**
+ * Release the tag pool items of a unique array, and free it.
+ */
+gcc_nonnull_all
+void
+tag_items_free_unique(TagItem **items, unsigned n);
+
+/**
+ * Allocate a new shared item array with new tag pool references to
+ * the given items.
+ *
+ * @param n the number of items; must be positive
+ * @return a pointer to the new array (with one reference)
+ */
+gcc_malloc gcc_nonnull_all
+TagItem **
+tag_items_new_shared(TagItem *const*src, unsigned n);
+
+/**
+ * Add a reference to an array returned by tag_items_new_shared().
+ */
+gcc_nonnull_all
+void
+tag_items_ref(TagItem **items);
+
+/**
+ * Release a reference.  The last one releases the tag pool items
+ * and frees the array.
+ *
+ * @param n the number of items in the array
+ */
+gcc_nonnull_all
+void
+tag_items_unref(TagItem **items, unsigned n);
+
+/**
+ * If the caller holds the only reference, free the array, but keep
+ * the tag pool references; the caller takes them over, after having
+ * copied the pointers.
+ *
+ * @return true if the array has been freed, false if it is shared
+ * (and nothing was done)
+ */
+gcc_nonnull_all
+bool
+tag_items_steal(TagItem **items);
+
+#endif
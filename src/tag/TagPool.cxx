@@ -20,47 +20,118 @@
 #include "config.h"
 #include "TagPool.hxx"
 #include "TagItem.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 #include "util/StringView.hxx"
 
+#include <atomic>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
-Mutex tag_pool_lock;
+/**
+ * The number of shards; must be a power of two.
+ */
+static constexpr unsigned SHARD_BITS = 6;
+static constexpr unsigned NUM_SHARDS = 1u << SHARD_BITS;
 
-static constexpr size_t NUM_SLOTS = 4096;
+/**
+ * The number of hash buckets allocated by a shard for its first
+ * item; must be a power of two.  The table doubles whenever it holds
+ * more items than buckets.
+ */
+static constexpr unsigned INITIAL_BUCKETS = 64;
 
 struct TagPoolSlot {
 	TagPoolSlot *next;
-	unsigned char ref;
+
+	/**
+	 * The full hash of (type, value), for choosing the bucket
+	 * when the table grows and for rejecting most mismatches
+	 * without a string comparison.
+	 */
+	unsigned hash;
+
+	/**
+	 * The number of references.  A slot whose counter has
+	 * dropped to zero is about to be removed by the thread which
+	 * released the last reference, and must not be revived.
+	 */
+	std::atomic_uint ref;
+
 	TagItem item;
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
-		    StringView value)
-		:next(_next), ref(1) {
+	TagPoolSlot(unsigned _hash, TagType type, StringView value)
+		:hash(_hash), ref(1) {
 		item.type = type;
 		memcpy(item.value, value.data, value.size);
 		item.value[value.size] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
+	static TagPoolSlot *Create(unsigned hash, TagType type,
 				   StringView value);
-} gcc_packed;
+
+	/**
+	 * Add a reference, unless the counter has already dropped to
+	 * zero.
+	 */
+	bool TryRef() {
+		unsigned old = ref.load(std::memory_order_relaxed);
+		do {
+			if (old == 0)
+				return false;
+		} while (!ref.compare_exchange_weak(old, old + 1,
+						    std::memory_order_relaxed));
+		return true;
+	}
+};
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
-		    StringView value)
+TagPoolSlot::Create(unsigned hash, TagType type, StringView value)
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       value.size + 1,
-				       _next, type,
-				       value);
+				       hash, type, value);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+/**
+ * One part of the pool: a chained hash table with its own lock.
+ */
+struct TagPoolShard {
+	Mutex mutex;
+
+	/**
+	 * The bucket array; nullptr until the first item is added.
+	 */
+	TagPoolSlot **buckets = nullptr;
+
+	/**
+	 * The number of buckets; a power of two (or zero).
+	 */
+	unsigned n_buckets = 0;
+
+	/**
+	 * The number of slots in all buckets.
+	 */
+	unsigned n_slots = 0;
+
+	TagPoolSlot **GetBucket(unsigned hash) {
+		assert(n_buckets > 0);
+
+		return &buckets[hash & (n_buckets - 1)];
+	}
+
+	TagItem *Get(unsigned hash, TagType type, StringView value);
+	void Remove(TagPoolSlot *slot);
+
+private:
+	void Grow();
+};
+
+static TagPoolShard shards[NUM_SHARDS];
 
 static inline unsigned
 calc_hash(TagType type, StringView p)
@@ -73,17 +144,14 @@ calc_hash(TagType type, StringView p)
 	return hash ^ type;
 }
 
-static inline unsigned
-calc_hash(TagType type, const char *p)
+/**
+ * Choose a shard from the high bits of the (mixed) hash; the
+ * buckets inside the shard are chosen by the low bits.
+ */
+static inline TagPoolShard &
+hash_to_shard(unsigned hash)
 {
-	unsigned hash = 5381;
-
-	assert(p != nullptr);
-
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
-
-	return hash ^ type;
+	return shards[(hash * 0x9e3779b1u) >> (32 - SHARD_BITS)];
 }
 
 #if CLANG_OR_GCC_VERSION(4,7)
@@ -95,35 +163,80 @@ tag_item_to_slot(TagItem *item)
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, StringView value)
+void
+TagPoolShard::Grow()
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	const unsigned new_size = n_buckets > 0
+		? n_buckets * 2
+		: INITIAL_BUCKETS;
+	auto new_buckets = new TagPoolSlot *[new_size]();
+
+	for (unsigned i = 0; i < n_buckets; ++i) {
+		for (auto slot = buckets[i]; slot != nullptr;) {
+			auto next = slot->next;
+			auto &head = new_buckets[slot->hash & (new_size - 1)];
+			slot->next = head;
+			head = slot;
+			slot = next;
+		}
+	}
+
+	delete[] buckets;
+	buckets = new_buckets;
+	n_buckets = new_size;
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value)
+inline TagItem *
+TagPoolShard::Get(unsigned hash, TagType type, StringView value)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	const ScopeLock protect(mutex);
+
+	if (n_buckets > 0) {
+		for (auto slot = *GetBucket(hash); slot != nullptr;
+		     slot = slot->next) {
+			if (slot->hash == hash &&
+			    slot->item.type == type &&
+			    value.Equals(slot->item.value) &&
+			    slot->TryRef())
+				return &slot->item;
+		}
+	}
+
+	if (n_slots >= n_buckets)
+		Grow();
+
+	auto slot = TagPoolSlot::Create(hash, type, value);
+	auto &head = *GetBucket(hash);
+	slot->next = head;
+	head = slot;
+	++n_slots;
+	return &slot->item;
 }
 
-TagItem *
-tag_pool_get_item(TagType type, StringView value)
+inline void
+TagPoolShard::Remove(TagPoolSlot *slot)
 {
-	auto slot_p = tag_value_slot_p(type, value);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
-		    value.Equals(slot->item.value) &&
-		    slot->ref < 0xff) {
-			assert(slot->ref > 0);
-			++slot->ref;
-			return &slot->item;
+	{
+		const ScopeLock protect(mutex);
+
+		TagPoolSlot **slot_p;
+		for (slot_p = GetBucket(slot->hash); *slot_p != slot;
+		     slot_p = &(*slot_p)->next) {
+			assert(*slot_p != nullptr);
 		}
+
+		*slot_p = slot->next;
+		--n_slots;
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value);
-	*slot_p = slot;
-	return &slot->item;
+	DeleteVarSize(slot);
+}
+
+TagItem *
+tag_pool_get_item(TagType type, StringView value)
+{
+	const unsigned hash = calc_hash(type, value);
+	return hash_to_shard(hash).Get(hash, type, value);
 }
 
 TagItem *
@@ -131,40 +244,36 @@ tag_pool_dup_item(TagItem *item)
 {
 	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	assert(slot->ref > 0);
-
-	if (slot->ref < 0xff) {
-		++slot->ref;
-		return item;
-	} else {
-		/* the reference counter overflows above 0xff;
-		   duplicate the item, and start with 1 */
-		auto slot_p = tag_value_slot_p(item->type, item->value);
-		slot = TagPoolSlot::Create(*slot_p, item->type,
-					   item->value);
-		*slot_p = slot;
-		return &slot->item;
-	}
+	/* the caller owns a reference, so the counter cannot drop to
+	   zero meanwhile */
+	assert(slot->ref.load(std::memory_order_relaxed) > 0);
+	slot->ref.fetch_add(1, std::memory_order_relaxed);
+
+	return item;
 }
 
 void
 tag_pool_put_item(TagItem *item)
 {
-	TagPoolSlot **slot_p, *slot;
-
-	slot = tag_item_to_slot(item);
-	assert(slot->ref > 0);
-	--slot->ref;
+	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	if (slot->ref > 0)
+	const unsigned old = slot->ref.fetch_sub(1, std::memory_order_acq_rel);
+	assert(old > 0);
+	if (old > 1)
 		return;
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
+	hash_to_shard(slot->hash).Remove(slot);
+}
+
+unsigned
+tag_pool_size()
+{
+	unsigned n = 0;
+
+	for (auto &shard : shards) {
+		const ScopeLock protect(shard.mutex);
+		n += shard.n_slots;
 	}
 
-	*slot_p = slot->next;
-	DeleteVarSize(slot);
+	return n;
 }
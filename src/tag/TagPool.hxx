@@ -21,20 +21,48 @@
 #define MPD_TAG_POOL_HXX
 
 #include "TagType.h"
-#include "thread/Mutex.hxx"
+#include "Compiler.h"
 
-extern Mutex tag_pool_lock;
+/*
+ * The tag pool interns #TagItem objects: all tags share one instance
+ * per (type, value) pair.  It is split into shards, each with its own
+ * lock and its own growable hash table, and each item has an atomic
+ * reference counter.  All functions are thread-safe; callers do not
+ * need to lock anything.
+ */
 
 struct TagItem;
 struct StringView;
 
+/**
+ * Look up (or create) the item with the given type and value, and
+ * return a new reference to it.  This locks one shard.
+ */
 TagItem *
 tag_pool_get_item(TagType type, StringView value);
 
+/**
+ * Add a reference to an item the caller already holds a reference
+ * to.  This does not lock.
+ */
+gcc_nonnull_all
 TagItem *
 tag_pool_dup_item(TagItem *item);
 
+/**
+ * Release a reference.  Only dropping the last one locks the item's
+ * shard.
+ */
+gcc_nonnull_all
 void
 tag_pool_put_item(TagItem *item);
 
+/**
+ * Determine the number of distinct items in the pool.  This is only
+ * a snapshot, meant for debugging and tests.
+ */
+gcc_pure
+unsigned
+tag_pool_size();
+
 #endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2009-2015 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_SHARED_MUTEX_HXX
+#define THREAD_SHARED_MUTEX_HXX
+
+/**
+ * A reader/writer lock: any number of threads may hold it in
+ * "shared" mode at a time, but only one in "exclusive" mode.  It is
+ * not recursive.
+ */
+#ifdef WIN32
+
+#include "WindowsSharedMutex.hxx"
+class SharedMutex : public WindowsSharedMutex {};
+
+#else
+
+#include "PosixSharedMutex.hxx"
+class SharedMutex : public PosixSharedMutex {};
+
+#endif
+
+class ScopeSharedLock {
+	SharedMutex &mutex;
+
+public:
+	ScopeSharedLock(SharedMutex &_mutex):mutex(_mutex) {
+		mutex.lock_shared();
+	};
+
+	~ScopeSharedLock() {
+		mutex.unlock_shared();
+	};
+
+	ScopeSharedLock(const ScopeSharedLock &other) = delete;
+	ScopeSharedLock &operator=(const ScopeSharedLock &other) = delete;
+};
+
+#endif
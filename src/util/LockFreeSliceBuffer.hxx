@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LOCK_FREE_SLICE_BUFFER_HXX
+#define MPD_LOCK_FREE_SLICE_BUFFER_HXX
+
+#include "HugeAllocator.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+#include <utility>
+#include <new>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A variant of #SliceBuffer which may be used by several threads
+ * concurrently without a lock.  The free list is a stack of slice
+ * indexes; its head is tagged with a modification counter to avoid
+ * the ABA problem.
+ *
+ * Unlike #SliceBuffer, this class does not give memory back to the
+ * kernel automatically when the last slice is freed, because that
+ * cannot be done atomically; call DiscardUnsafe() at a point where
+ * the buffer is known to be idle.
+ */
+template<typename T>
+class LockFreeSliceBuffer {
+	union Slice {
+		/**
+		 * The index of the next free slice plus one, or 0 if
+		 * this is the last one.
+		 */
+		uint32_t next;
+
+		T value;
+	};
+
+	/**
+	 * The maximum number of slices in this container.
+	 */
+	const unsigned n_max;
+
+	/**
+	 * The number of slices that are initialized.  This is used to
+	 * avoid page faulting on the new allocation, so the kernel
+	 * does not need to reserve physical memory pages.
+	 */
+	std::atomic_uint n_initialized;
+
+	/**
+	 * The number of slices currently allocated.
+	 */
+	std::atomic_uint n_allocated;
+
+	Slice *const data;
+
+	/**
+	 * The head of the "available" stack: the lower 32 bits are
+	 * the index of the first free slice plus one (0 means the
+	 * stack is empty), the upper 32 bits are a counter which is
+	 * incremented on every modification.
+	 */
+	std::atomic<uint64_t> available;
+
+	size_t CalcAllocationSize() const {
+		return n_max * sizeof(Slice);
+	}
+
+	static constexpr uint64_t MakeHead(uint64_t old, uint32_t next) {
+		return (((old >> 32) + 1) << 32) | next;
+	}
+
+	Slice *PopAvailable() {
+		uint64_t old = available.load(std::memory_order_acquire);
+		while (true) {
+			const uint32_t i = uint32_t(old);
+			if (i == 0)
+				return nullptr;
+
+			Slice *slice = &data[i - 1];
+
+			/* this may read a stale value if another thread
+			   has popped the slice meanwhile; the counter in
+			   the head makes the following CAS fail in that
+			   case */
+			const uint32_t next = slice->next;
+
+			if (available.compare_exchange_weak(old,
+							    MakeHead(old, next),
+							    std::memory_order_acquire,
+							    std::memory_order_acquire))
+				return slice;
+		}
+	}
+
+	Slice *InitializeNew() {
+		unsigned n = n_initialized.load(std::memory_order_relaxed);
+		do {
+			if (n >= n_max)
+				/* out of (internal) memory, buffer is
+				   full */
+				return nullptr;
+		} while (!n_initialized.compare_exchange_weak(n, n + 1,
+							      std::memory_order_relaxed));
+
+		return &data[n];
+	}
+
+public:
+	LockFreeSliceBuffer(unsigned _count)
+		:n_max(_count), n_initialized(0), n_allocated(0),
+		 data((Slice *)HugeAllocate(CalcAllocationSize())),
+		 available(0) {
+		assert(n_max > 0);
+	}
+
+	~LockFreeSliceBuffer() {
+		/* all slices must be freed explicitly, and this
+		   assertion checks for leaks */
+		assert(n_allocated.load() == 0);
+
+		HugeFree(data, CalcAllocationSize());
+	}
+
+	LockFreeSliceBuffer(const LockFreeSliceBuffer &other) = delete;
+	LockFreeSliceBuffer &operator=(const LockFreeSliceBuffer &other) = delete;
+
+	/**
+	 * @return true if buffer allocation (by the constructor) has failed
+	 */
+	bool IsOOM() {
+		return data == nullptr;
+	}
+
+	unsigned GetCapacity() const {
+		return n_max;
+	}
+
+	/**
+	 * This is only a snapshot if other threads are using this
+	 * object.
+	 */
+	bool IsEmpty() const {
+		return n_allocated.load(std::memory_order_relaxed) == 0;
+	}
+
+	/**
+	 * Returns the position of the given slice within this
+	 * buffer, between 0 and GetCapacity()-1.
+	 */
+	gcc_pure
+	unsigned IndexOf(const T *value) const {
+		const Slice *slice = reinterpret_cast<const Slice *>(value);
+		assert(slice >= data && slice < data + n_max);
+
+		return slice - data;
+	}
+
+	template<typename... Args>
+	T *Allocate(Args&&... args) {
+		Slice *slice = PopAvailable();
+		if (slice == nullptr) {
+			slice = InitializeNew();
+			if (slice == nullptr)
+				return nullptr;
+		}
+
+		n_allocated.fetch_add(1, std::memory_order_relaxed);
+
+		/* construct the object */
+		return ::new((void *)&slice->value) T(std::forward<Args>(args)...);
+	}
+
+	void Free(T *value) {
+		assert(n_allocated.load() > 0);
+
+		Slice *slice = reinterpret_cast<Slice *>(value);
+		assert(slice >= data && slice < data + n_max);
+
+		/* destruct the object */
+		value->~T();
+
+		/* push the slice on the "available" stack */
+		const uint32_t i = uint32_t(slice - data) + 1;
+		uint64_t old = available.load(std::memory_order_relaxed);
+		do {
+			slice->next = uint32_t(old);
+		} while (!available.compare_exchange_weak(old,
+							  MakeHead(old, i),
+							  std::memory_order_release,
+							  std::memory_order_relaxed));
+
+		n_allocated.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Give memory back to the kernel.  The buffer must be empty,
+	 * and no other thread may access it meanwhile.
+	 */
+	void DiscardUnsafe() {
+		assert(IsEmpty());
+
+		HugeDiscard(data, CalcAllocationSize());
+		n_initialized.store(0, std::memory_order_relaxed);
+		available.store(0, std::memory_order_relaxed);
+	}
+};
+
+#endif
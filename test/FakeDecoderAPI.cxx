@@ -29,7 +29,7 @@
 void
 decoder_initialized(Decoder &decoder,
 		    const AudioFormat audio_format,
-		    gcc_unused bool seekable,
+		    bool seekable,
 		    SignedSongTime duration)
 {
 	struct audio_format_string af_string;
@@ -42,34 +42,55 @@ decoder_initialized(Decoder &decoder,
 		duration.ToDoubleS());
 
 	decoder.initialized = true;
+	decoder.sample_rate = audio_format.sample_rate;
+
+	if (decoder.seek && !seekable) {
+		fprintf(stderr, "Not seekable\n");
+		decoder.seek = false;
+		decoder.seek_error = true;
+	}
 }
 
 DecoderCommand
-decoder_get_command(gcc_unused Decoder &decoder)
+decoder_get_command(Decoder &decoder)
 {
-	return DecoderCommand::NONE;
+	return decoder.initialized && decoder.seek
+		? DecoderCommand::SEEK
+		: DecoderCommand::NONE;
 }
 
 void
-decoder_command_finished(gcc_unused Decoder &decoder)
+decoder_command_finished(Decoder &decoder)
 {
+	assert(decoder.seek);
+
+	decoder.seek = false;
 }
 
 SongTime
-decoder_seek_time(gcc_unused Decoder &decoder)
+decoder_seek_time(Decoder &decoder)
 {
-	return SongTime();
+	assert(decoder.seek);
+
+	return decoder.seek_time;
 }
 
 uint64_t
-decoder_seek_where_frame(gcc_unused Decoder &decoder)
+decoder_seek_where_frame(Decoder &decoder)
 {
-	return 1;
+	assert(decoder.seek);
+
+	return decoder.seek_time.ToScale<uint64_t>(decoder.sample_rate);
 }
 
 void
-decoder_seek_error(gcc_unused Decoder &decoder)
+decoder_seek_error(Decoder &decoder)
 {
+	assert(decoder.seek);
+
+	fprintf(stderr, "Seek failed\n");
+	decoder.seek = false;
+	decoder.seek_error = true;
 }
 
 InputStream *
@@ -23,6 +23,7 @@
 #include "check.h"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
+#include "Chrono.hxx"
 
 struct Decoder {
 	Mutex mutex;
@@ -30,8 +31,23 @@ struct Decoder {
 
 	bool initialized;
 
+	/**
+	 * Shall the decoder be asked to seek to #seek_time once it
+	 * is initialized?
+	 */
+	bool seek;
+
+	/**
+	 * Has the decoder reported a seek error?
+	 */
+	bool seek_error;
+
+	SongTime seek_time;
+
+	unsigned sample_rate;
+
 	Decoder()
-		:initialized(false) {}
+		:initialized(false), seek(false), seek_error(false) {}
 };
 
 #endif
@@ -0,0 +1,300 @@
+/*
+ * Unit tests for the binary database format.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/BinaryDatabase.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/DatabaseLock.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "tag/TagType.h"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <random>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * A database in the text format, with nested directories, songs with
+ * tags and ranges, and playlists.  The header is generated by
+ * MakeTextDatabase().
+ */
+static constexpr char text_body[] =
+	"directory: a\n"
+	"mtime: 1400000000\n"
+	"begin: a\n"
+	"directory: b\n"
+	"type: archive\n"
+	"mtime: 1400000001\n"
+	"begin: a/b\n"
+	"song_begin: x.flac\n"
+	"Time: 61.500000\n"
+	"Artist: Foo\n"
+	"Artist: Bar\n"
+	"Title: X\n"
+	"mtime: 1400000002\n"
+	"song_end\n"
+	"end: a/b\n"
+	"directory: c\n"
+	"begin: a/c\n"
+	"end: a/c\n"
+	"song_begin: y.cue\n"
+	"Playlist: yes\n"
+	"mtime: 1400000003\n"
+	"song_end\n"
+	"song_begin: z.wav\n"
+	"Range: 1000-2000\n"
+	"Time: 1.000000\n"
+	"Album: Foo\n"
+	"Title: Z\n"
+	"mtime: 1400000004\n"
+	"song_end\n"
+	"playlist_begin: p.m3u\n"
+	"mtime: 1400000005\n"
+	"playlist_end\n"
+	"end: a\n"
+	"directory: d\n"
+	"begin: d\n"
+	"end: d\n"
+	"song_begin: root.ogg\n"
+	"Time: 0.250000\n"
+	"Title: Root\n"
+	"Genre: Rock\n"
+	"mtime: 1400000006\n"
+	"song_end\n"
+	"playlist_begin: q.pls\n"
+	"mtime: 1400000007\n"
+	"playlist_end\n";
+
+static std::string
+MakeTextDatabase()
+{
+	std::string s = "info_begin\n"
+		"format: 2\n"
+		"mpd_version: " VERSION "\n";
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		s += "tag: ";
+		s += tag_item_names[i];
+		s += '\n';
+	}
+
+	s += "info_end\n";
+	s += text_body;
+	return s;
+}
+
+class StringOutputStream final : public OutputStream {
+public:
+	std::string value;
+
+	bool Write(const void *data, size_t size, Error &) override {
+		value.append((const char *)data, size);
+		return true;
+	}
+};
+
+/**
+ * Dump the tree in the text format, for comparing two trees.
+ */
+static std::string
+Dump(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
+	db_save_internal(bos, root);
+	CPPUNIT_ASSERT(bos.Flush());
+	return sos.value;
+}
+
+static std::string
+SaveBinary(const Directory &root)
+{
+	StringOutputStream sos;
+	Error error;
+	CPPUNIT_ASSERT(db_save_binary(sos, root, error));
+	return sos.value;
+}
+
+/**
+ * Load the given binary database into a new tree and dump it with
+ * Dump().  On error, an empty string is returned and the #Error is
+ * set.
+ */
+static std::string
+LoadBinary(const std::string &data, Error &error)
+{
+	Directory *root = Directory::NewRoot();
+
+	std::string result;
+	db_lock();
+	if (db_load_binary({data.data(), data.size()}, *root, error))
+		result = Dump(*root);
+	else
+		CPPUNIT_ASSERT(error.IsDefined());
+	delete root;
+	db_unlock();
+
+	return result;
+}
+
+class BinaryDatabaseTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(BinaryDatabaseTest);
+	CPPUNIT_TEST(TestRoundTrip);
+	CPPUNIT_TEST(TestTruncated);
+	CPPUNIT_TEST(TestCorrupted);
+	CPPUNIT_TEST(TestRandomCorruption);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * The text dump of the sample database.
+	 */
+	std::string text;
+
+	/**
+	 * The sample database in the binary format.
+	 */
+	std::string binary;
+
+public:
+	void setUp() override {
+		const char *tmpdir = getenv("TMPDIR");
+		const std::string path_s =
+			std::string(tmpdir != nullptr ? tmpdir : "/tmp") +
+			"/TestBinaryDatabase." + std::to_string(getpid());
+		const auto path = AllocatedPath::FromFS(path_s.c_str());
+
+		const std::string input = MakeTextDatabase();
+		FILE *file = fopen(path_s.c_str(), "wb");
+		CPPUNIT_ASSERT(file != nullptr);
+		CPPUNIT_ASSERT_EQUAL(input.size(),
+				     fwrite(input.data(), 1, input.size(),
+					    file));
+		CPPUNIT_ASSERT_EQUAL(0, fclose(file));
+
+		Error error;
+		Directory *root = Directory::NewRoot();
+
+		{
+			TextFile text_file(path, error);
+			CPPUNIT_ASSERT(!text_file.HasFailed());
+			CPPUNIT_ASSERT(db_load_internal(text_file, *root,
+							error));
+		}
+
+		RemoveFile(path);
+
+		db_lock();
+		text = Dump(*root);
+		binary = SaveBinary(*root);
+		delete root;
+		db_unlock();
+	}
+
+	void TestRoundTrip() {
+		/* make sure the sample has actually been loaded */
+		CPPUNIT_ASSERT(text.find("song_begin: x.flac\n") !=
+			       std::string::npos);
+		CPPUNIT_ASSERT(text.find("playlist_begin: q.pls\n") !=
+			       std::string::npos);
+
+		Error error;
+		CPPUNIT_ASSERT_EQUAL(text, LoadBinary(binary, error));
+		CPPUNIT_ASSERT(!error.IsDefined());
+	}
+
+	/**
+	 * Every truncated copy must be rejected: the string table is
+	 * at the end, and it is checked against the file size.
+	 */
+	void TestTruncated() {
+		for (size_t size = 0; size < binary.size(); ++size) {
+			Error error;
+			CPPUNIT_ASSERT(LoadBinary(binary.substr(0, size),
+						  error).empty());
+			CPPUNIT_ASSERT_EQUAL(std::string("Database corrupted"),
+					     std::string(error.GetMessage()));
+		}
+	}
+
+	void TestCorrupted() {
+		/* the magic */
+		std::string data = binary;
+		data[0] ^= 0x20;
+
+		Error error;
+		CPPUNIT_ASSERT(LoadBinary(data, error).empty());
+		CPPUNIT_ASSERT_EQUAL(std::string("Database corrupted"),
+				     std::string(error.GetMessage()));
+
+		/* the null terminator of the last string */
+		data = binary;
+		data.back() = 'x';
+
+		error.Clear();
+		CPPUNIT_ASSERT(LoadBinary(data, error).empty());
+		CPPUNIT_ASSERT_EQUAL(std::string("Database corrupted"),
+				     std::string(error.GetMessage()));
+
+		/* trailing garbage moves the string table relative to
+		   the end of the file */
+		data = binary;
+		data.append(8, 'x');
+
+		error.Clear();
+		CPPUNIT_ASSERT(LoadBinary(data, error).empty());
+		CPPUNIT_ASSERT_EQUAL(std::string("Database corrupted"),
+				     std::string(error.GetMessage()));
+	}
+
+	/**
+	 * Overwrite random bytes.  The loader may or may not notice
+	 * (e.g. if a tag value was modified), but it must not crash
+	 * or read outside of the buffer.
+	 */
+	void TestRandomCorruption() {
+		std::mt19937 random(42);
+		std::uniform_int_distribution<size_t>
+			positions(0, binary.size() - 1);
+		std::uniform_int_distribution<unsigned> bytes(0, 255);
+
+		unsigned n_rejected = 0;
+		for (unsigned i = 0; i < 5000; ++i) {
+			std::string data = binary;
+			for (unsigned j = 1 + i % 3; j > 0; --j)
+				data[positions(random)] = bytes(random);
+
+			Error error;
+			LoadBinary(data, error);
+			if (error.IsDefined())
+				++n_rejected;
+		}
+
+		CPPUNIT_ASSERT(n_rejected > 0);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BinaryDatabaseTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "decoder/DecoderSniff.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include <string>
+
+#include <stdlib.h>
+
+static std::string
+Sniff(const void *data, size_t size)
+{
+	const char *mime_type = decoder_sniff_mime_type(data, size);
+	return mime_type != nullptr ? mime_type : "";
+}
+
+template<size_t n>
+static std::string
+Sniff(const char (&data)[n])
+{
+	/* string literals may contain null bytes */
+	return Sniff(data, n - 1);
+}
+
+/**
+ * Build the first Ogg page with the given codec header.
+ */
+static std::string
+OggPage(const char *header, size_t header_size)
+{
+	std::string page("OggS\0\x02", 6);
+	page.append(20, '\0');
+	page.push_back(1); /* one segment */
+	page.push_back(char(header_size));
+	page.append(header, header_size);
+	return page;
+}
+
+class DecoderSniffTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DecoderSniffTest);
+	CPPUNIT_TEST(TestContainers);
+	CPPUNIT_TEST(TestOgg);
+	CPPUNIT_TEST(TestFrameSync);
+	CPPUNIT_TEST(TestUnknown);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestContainers() {
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/flac"),
+				     Sniff("fLaC\0\0\0\x22"));
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/x-wav"),
+				     Sniff("RIFF\x24\x08\0\0WAVEfmt "));
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/x-aiff"),
+				     Sniff("FORM\0\0\x10\0AIFFCOMM"));
+		CPPUNIT_ASSERT_EQUAL(std::string("application/x-dsf"),
+				     Sniff("DSD \x1c"));
+		CPPUNIT_ASSERT_EQUAL(std::string("application/x-dff"),
+				     Sniff("FRM8\0\0\0\0\0\0\x10\0DSD "));
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/x-wavpack"),
+				     Sniff("wvpk"));
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/mp4"),
+				     Sniff("\0\0\0\x20" "ftypM4A "));
+	}
+
+	void TestOgg() {
+		const auto vorbis = OggPage("\x01vorbis\0\0\0\0", 11);
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/x-vorbis+ogg"),
+				     Sniff(vorbis.data(), vorbis.size()));
+
+		const auto opus = OggPage("OpusHead\x01\x02", 10);
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/opus"),
+				     Sniff(opus.data(), opus.size()));
+
+		const auto flac = OggPage("\x7f" "FLAC\x01\0", 7);
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/x-flac+ogg"),
+				     Sniff(flac.data(), flac.size()));
+
+		const auto speex = OggPage("Speex   ", 8);
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     Sniff(speex.data(), speex.size()));
+
+		/* truncated */
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     Sniff(vorbis.data(), 30));
+	}
+
+	void TestFrameSync() {
+		/* MPEG-1 layer III, 128 kbit/s, 44.1 kHz */
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/mpeg"),
+				     Sniff("\xff\xfb\x90\x64"));
+
+		/* ADTS, MPEG-4 AAC */
+		CPPUNIT_ASSERT_EQUAL(std::string("audio/aac"),
+				     Sniff("\xff\xf1\x50\x80"));
+
+		/* invalid bit rate */
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     Sniff("\xff\xfb\xf0\x64"));
+
+		/* reserved MPEG version */
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     Sniff("\xff\xeb\x90\x64"));
+
+		/* an ID3v2 tag hides the format */
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     Sniff("ID3\x04\0\0\0\0\x10\0"));
+	}
+
+	void TestUnknown() {
+		CPPUNIT_ASSERT_EQUAL(std::string(), Sniff(""));
+		CPPUNIT_ASSERT_EQUAL(std::string(), Sniff("RIFF\0\0\0\0AVI "));
+		CPPUNIT_ASSERT_EQUAL(std::string(), Sniff("#EXTM3U\n"));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DecoderSniffTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
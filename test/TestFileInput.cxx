@@ -0,0 +1,186 @@
+/*
+ * Unit tests for the read-ahead thread of the "file" input plugin.
+ */
+
+#include "config.h"
+#include "input/plugins/FileInputPlugin.hxx"
+#include "input/InputPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Larger than the read-ahead buffer configured below, so seeks
+ * leave the buffered range.
+ */
+static constexpr size_t FILE_SIZE = 3 * 1024 * 1024 + 12345;
+
+static uint8_t
+Expected(offset_type offset)
+{
+	return uint8_t(offset * 131 ^ offset >> 11);
+}
+
+class FileInputTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FileInputTest);
+	CPPUNIT_TEST(TestRandom);
+	CPPUNIT_TEST_SUITE_END();
+
+	std::string path_s;
+
+public:
+	void setUp() override {
+		const char *tmpdir = getenv("TMPDIR");
+		path_s = std::string(tmpdir != nullptr ? tmpdir : "/tmp") +
+			"/TestFileInput." + std::to_string(getpid());
+
+		std::vector<uint8_t> data(FILE_SIZE);
+		for (size_t i = 0; i < data.size(); ++i)
+			data[i] = Expected(i);
+
+		FILE *file = fopen(path_s.c_str(), "wb");
+		CPPUNIT_ASSERT(file != nullptr);
+		CPPUNIT_ASSERT_EQUAL(data.size(),
+				     fwrite(&data.front(), 1, data.size(),
+					    file));
+		CPPUNIT_ASSERT_EQUAL(0, fclose(file));
+
+		/* a small buffer, to make the thread wrap around and
+		   wait for free space often */
+		ConfigBlock block;
+		block.AddBlockParam("read_ahead_size", "262144");
+		Error error;
+		CPPUNIT_ASSERT(input_plugin_file.init(block, error) ==
+			       InputPlugin::InitResult::SUCCESS);
+	}
+
+	void tearDown() override {
+		RemoveFile(AllocatedPath::FromFS(path_s.c_str()));
+	}
+
+	/**
+	 * Read and verify a random number of bytes.
+	 */
+	static void Read(InputStream &is, std::mt19937 &random) {
+		uint8_t buffer[300000];
+		std::uniform_int_distribution<size_t> sizes(1, sizeof(buffer));
+		const size_t size = sizes(random);
+
+		const offset_type offset = is.GetOffset();
+		Error error;
+		const size_t nbytes = is.Read(buffer, size, error);
+		CPPUNIT_ASSERT(!error.IsDefined());
+		CPPUNIT_ASSERT(nbytes <= size);
+		CPPUNIT_ASSERT_EQUAL(offset + nbytes, is.GetOffset());
+
+		if (nbytes == 0) {
+			CPPUNIT_ASSERT_EQUAL(offset_type(FILE_SIZE), offset);
+			CPPUNIT_ASSERT(is.IsEOF());
+			return;
+		}
+
+		/* the number of correct bytes */
+		size_t i = 0;
+		while (i < nbytes && buffer[i] == Expected(offset + i))
+			++i;
+
+		CPPUNIT_ASSERT_EQUAL(nbytes, i);
+	}
+
+	static void Seek(InputStream &is, offset_type offset) {
+		if (offset > FILE_SIZE)
+			offset = FILE_SIZE;
+
+		Error error;
+		CPPUNIT_ASSERT(is.Seek(offset, error));
+		CPPUNIT_ASSERT_EQUAL(offset, is.GetOffset());
+	}
+
+	void Run(unsigned seed) {
+		Mutex mutex;
+		Cond cond;
+		Error error;
+
+		InputStream *is =
+			OpenFileInputStream(Path::FromFS(path_s.c_str()),
+					    mutex, cond, error);
+		CPPUNIT_ASSERT(is != nullptr);
+
+		typedef std::uniform_int_distribution<offset_type> Offsets;
+
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<unsigned> percent(0, 99);
+		Offsets anywhere(0, FILE_SIZE), near(0, 200000);
+
+		mutex.lock();
+
+		CPPUNIT_ASSERT(is->IsReady());
+		CPPUNIT_ASSERT_EQUAL(offset_type(FILE_SIZE), is->GetSize());
+
+		for (unsigned i = 0; i < 3000; ++i) {
+			const unsigned p = percent(random);
+			if (p < 50) {
+				Read(*is, random);
+			} else if (p < 70) {
+				/* usually inside the buffer:
+				   SeekBuffered() skips data */
+				Seek(*is, is->GetOffset() + near(random));
+			} else if (p < 80) {
+				const offset_type back = near(random);
+				Seek(*is, is->GetOffset() > back
+				     ? is->GetOffset() - back
+				     : 0);
+			} else if (p < 90) {
+				Seek(*is, anywhere(random));
+			} else if (p < 95) {
+				/* seek again while the thread is
+				   still reading for the first seek;
+				   its data must be discarded */
+				Seek(*is, anywhere(random));
+				Seek(*is, anywhere(random));
+				Read(*is, random);
+			} else {
+				/* let the thread fill the buffer */
+				mutex.unlock();
+				usleep(1000);
+				mutex.lock();
+			}
+		}
+
+		mutex.unlock();
+		delete is;
+	}
+
+	void TestRandom() {
+		for (unsigned seed = 0; seed < 8; ++seed)
+			Run(seed);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FileInputTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "input/RangeCache.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include <vector>
+
+#include <stdlib.h>
+
+static constexpr size_t BS = RangeCache::BLOCK_SIZE;
+
+/**
+ * The contents of the simulated file: each byte is derived from its
+ * offset.
+ */
+static constexpr uint8_t
+FileByte(offset_type offset)
+{
+	return uint8_t(offset * 7 + (offset >> 11));
+}
+
+static std::vector<uint8_t>
+FileData(offset_type offset, size_t size)
+{
+	std::vector<uint8_t> v(size);
+	for (size_t i = 0; i < size; ++i)
+		v[i] = FileByte(offset + i);
+	return v;
+}
+
+static void
+Write(RangeCache &cache, offset_type offset, size_t size, bool pin=false)
+{
+	const auto v = FileData(offset, size);
+	cache.Write(offset, v.data(), v.size(), pin);
+}
+
+/**
+ * Read from the cache and verify the contents.
+ *
+ * @return the number of bytes which were returned
+ */
+static size_t
+Read(RangeCache &cache, offset_type offset, size_t size)
+{
+	std::vector<uint8_t> v(size);
+	const size_t nbytes = cache.Read(offset, v.data(), size);
+	CPPUNIT_ASSERT(nbytes <= size);
+
+	for (size_t i = 0; i < nbytes; ++i)
+		CPPUNIT_ASSERT_EQUAL(FileByte(offset + i), v[i]);
+
+	return nbytes;
+}
+
+class RangeCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(RangeCacheTest);
+	CPPUNIT_TEST(TestSequential);
+	CPPUNIT_TEST(TestUnaligned);
+	CPPUNIT_TEST(TestOverlap);
+	CPPUNIT_TEST(TestEvict);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSequential() {
+		RangeCache cache(1024 * 1024);
+		CPPUNIT_ASSERT(cache.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(cache, 0, 100));
+
+		/* odd chunk sizes, like from a network connection */
+		offset_type offset = 0;
+		for (size_t size : {1000, 4000, 40000, 3, 70000}) {
+			Write(cache, offset, size);
+			offset += size;
+		}
+
+		CPPUNIT_ASSERT(!cache.IsEmpty());
+
+		CPPUNIT_ASSERT_EQUAL(size_t(offset), Read(cache, 0, 1000000));
+		CPPUNIT_ASSERT_EQUAL(size_t(offset - 12345),
+				     Read(cache, 12345, 1000000));
+		CPPUNIT_ASSERT_EQUAL(size_t(100), Read(cache, BS - 50, 100));
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(cache, offset, 100));
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(cache, offset + BS, 100));
+
+		cache.Clear();
+		CPPUNIT_ASSERT(cache.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(cache, 0, 100));
+	}
+
+	void TestUnaligned() {
+		RangeCache cache(1024 * 1024);
+
+		/* a "Range" request which doesn't start at a block
+		   boundary: the first partial block is not cached */
+		const offset_type start = 10 * BS + 1234;
+		Write(cache, start, 3 * BS);
+
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(cache, start, 100));
+		CPPUNIT_ASSERT_EQUAL(size_t(2 * BS + 1234),
+				     Read(cache, 11 * BS, 10 * BS));
+
+		/* a gap in the middle of a block stops reading */
+		Write(cache, 20 * BS, 100);
+		Write(cache, 20 * BS + 200, 100);
+		CPPUNIT_ASSERT_EQUAL(size_t(100), Read(cache, 20 * BS, BS));
+		CPPUNIT_ASSERT_EQUAL(size_t(0),
+				     Read(cache, 20 * BS + 200, BS));
+
+		/* filling the gap makes the block usable again */
+		Write(cache, 20 * BS + 100, 300);
+		CPPUNIT_ASSERT_EQUAL(size_t(400), Read(cache, 20 * BS, BS));
+	}
+
+	void TestOverlap() {
+		RangeCache cache(1024 * 1024);
+
+		Write(cache, 0, 1000);
+
+		/* the same data received again by another request */
+		Write(cache, 0, 600);
+		Write(cache, 500, 1500);
+		CPPUNIT_ASSERT_EQUAL(size_t(2000), Read(cache, 0, BS));
+	}
+
+	void TestEvict() {
+		RangeCache cache(4 * BS);
+
+		Write(cache, 0, 4 * BS);
+		CPPUNIT_ASSERT_EQUAL(4 * BS, Read(cache, 0, 10 * BS));
+
+		/* touch block 0, so block 1 is the oldest one */
+		CPPUNIT_ASSERT_EQUAL(size_t(10), Read(cache, 0, 10));
+
+		Write(cache, 10 * BS, BS);
+		CPPUNIT_ASSERT_EQUAL(BS, Read(cache, 0, 10 * BS));
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(cache, BS, 10));
+		CPPUNIT_ASSERT_EQUAL(2 * BS, Read(cache, 2 * BS, 10 * BS));
+		CPPUNIT_ASSERT_EQUAL(BS, Read(cache, 10 * BS, 10 * BS));
+
+		/* pinned blocks survive */
+		RangeCache pinned(2 * BS);
+		Write(pinned, 0, BS, true);
+		for (offset_type i = 1; i < 10; ++i)
+			Write(pinned, i * BS, BS);
+		CPPUNIT_ASSERT_EQUAL(BS, Read(pinned, 0, 10 * BS));
+		CPPUNIT_ASSERT_EQUAL(BS, Read(pinned, 9 * BS, 10 * BS));
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(pinned, 8 * BS, 10));
+
+		/* if all blocks are pinned, new data is not cached */
+		Write(pinned, 9 * BS, 10, true);
+		Write(pinned, 20 * BS, BS);
+		CPPUNIT_ASSERT_EQUAL(size_t(0), Read(pinned, 20 * BS, 10));
+
+		/* a cache without blocks doesn't store anything */
+		RangeCache empty(0);
+		Write(empty, 0, BS);
+		CPPUNIT_ASSERT(empty.IsEmpty());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RangeCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
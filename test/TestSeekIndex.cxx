@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "decoder/SeekIndex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include <string>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+class SeekIndexTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SeekIndexTest);
+	CPPUNIT_TEST(TestFind);
+	CPPUNIT_TEST(TestCache);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestFind() {
+		SeekIndex index;
+		CPPUNIT_ASSERT(index.IsEmpty());
+		CPPUNIT_ASSERT(index.Find(0) == nullptr);
+
+		CPPUNIT_ASSERT(index.Add(0, 100, 10));
+		CPPUNIT_ASSERT(!index.Add(5, 150, 10));
+		CPPUNIT_ASSERT(index.Add(10, 200, 10));
+		CPPUNIT_ASSERT(index.Add(25, 400, 10));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(25), index.GetEnd());
+
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), index.Find(0)->offset);
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), index.Find(9)->offset);
+		CPPUNIT_ASSERT_EQUAL(offset_type(200), index.Find(10)->offset);
+		CPPUNIT_ASSERT_EQUAL(offset_type(200), index.Find(24)->offset);
+		CPPUNIT_ASSERT_EQUAL(offset_type(400), index.Find(1000)->offset);
+	}
+
+	void TestCache() {
+		const char *tmpdir = getenv("TMPDIR");
+		const std::string path_s = std::string(tmpdir != nullptr
+						       ? tmpdir : "/tmp") +
+			"/TestSeekIndex." + std::to_string(getpid());
+		const auto path = AllocatedPath::FromFS(path_s.c_str());
+
+		SeekIndex index;
+		index.Add(0, 0, 1);
+		index.Add(1000, 123456, 1);
+
+		seek_index_cache_init(AllocatedPath(path));
+		seek_index_cache_store("mad", "a b.mp3", 1000000, 1400000000,
+				       index);
+
+		/* a shorter index does not replace a longer one */
+		SeekIndex shorter;
+		shorter.Add(0, 0, 1);
+		seek_index_cache_store("mad", "a b.mp3", 1000000, 1400000000,
+				       shorter);
+		seek_index_cache_finish();
+
+		/* reload from the file */
+		seek_index_cache_init(AllocatedPath(path));
+
+		SeekIndex result;
+		CPPUNIT_ASSERT(!seek_index_cache_lookup("mad", "a b.mp3",
+							999999, 1400000000,
+							result));
+		CPPUNIT_ASSERT(!seek_index_cache_lookup("mad", "a b.mp3",
+							1000000, 1400000001,
+							result));
+		CPPUNIT_ASSERT(!seek_index_cache_lookup("opus", "a b.mp3",
+							1000000, 1400000000,
+							result));
+		CPPUNIT_ASSERT(seek_index_cache_lookup("mad", "a b.mp3",
+						       1000000, 1400000000,
+						       result));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1000), result.GetEnd());
+		CPPUNIT_ASSERT_EQUAL(offset_type(123456),
+				     result.Find(2000)->offset);
+
+		/* the file has been modified, but its size is the
+		   same: the shorter index replaces the stale one */
+		seek_index_cache_store("mad", "a b.mp3", 1000000, 1400000001,
+				       shorter);
+		CPPUNIT_ASSERT(!seek_index_cache_lookup("mad", "a b.mp3",
+							1000000, 1400000000,
+							result));
+		CPPUNIT_ASSERT(seek_index_cache_lookup("mad", "a b.mp3",
+						       1000000, 1400000001,
+						       result));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), result.GetEnd());
+
+		seek_index_cache_finish();
+		RemoveFile(path);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SeekIndexTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
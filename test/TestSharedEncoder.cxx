@@ -0,0 +1,467 @@
+/*
+ * Unit tests for src/encoder/SharedEncoder.cxx
+ */
+
+#include "config.h"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/EncoderAPI.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * A trivial encoder which copies its input.  It emits "H" as the
+ * stream header, "T" after each tag and "E" at the end of the
+ * stream.
+ */
+struct CopyEncoder {
+	Encoder base;
+
+	DynamicFifoBuffer<char> buffer;
+
+	CopyEncoder();
+};
+
+static unsigned copy_encoder_writes;
+
+static Encoder *
+copy_encoder_init(gcc_unused const ConfigBlock &block,
+		  gcc_unused Error &error)
+{
+	return &(new CopyEncoder())->base;
+}
+
+static void
+copy_encoder_finish(Encoder *encoder)
+{
+	delete (CopyEncoder *)encoder;
+}
+
+static bool
+copy_encoder_open(Encoder *_encoder, gcc_unused AudioFormat &audio_format,
+		  gcc_unused Error &error)
+{
+	CopyEncoder &encoder = *(CopyEncoder *)_encoder;
+	encoder.buffer.Clear();
+	encoder.buffer.Append("H", 1);
+	return true;
+}
+
+static bool
+copy_encoder_end(Encoder *_encoder, gcc_unused Error &error)
+{
+	CopyEncoder &encoder = *(CopyEncoder *)_encoder;
+	encoder.buffer.Append("E", 1);
+	return true;
+}
+
+static bool
+copy_encoder_tag(Encoder *_encoder, gcc_unused const Tag &tag,
+		 gcc_unused Error &error)
+{
+	CopyEncoder &encoder = *(CopyEncoder *)_encoder;
+	encoder.buffer.Append("T", 1);
+	return true;
+}
+
+static bool
+copy_encoder_write(Encoder *_encoder, const void *data, size_t length,
+		   gcc_unused Error &error)
+{
+	CopyEncoder &encoder = *(CopyEncoder *)_encoder;
+	encoder.buffer.Append((const char *)data, length);
+	++copy_encoder_writes;
+	return true;
+}
+
+static size_t
+copy_encoder_read(Encoder *_encoder, void *dest, size_t length)
+{
+	CopyEncoder &encoder = *(CopyEncoder *)_encoder;
+	auto r = encoder.buffer.Read();
+	if (length > r.size)
+		length = r.size;
+
+	memcpy(dest, r.data, length);
+	encoder.buffer.Consume(length);
+	return length;
+}
+
+static const EncoderPlugin copy_encoder_plugin = {
+	"copy",
+	copy_encoder_init,
+	copy_encoder_finish,
+	copy_encoder_open,
+	nullptr,
+	copy_encoder_end,
+	nullptr,
+	nullptr,
+	copy_encoder_tag,
+	copy_encoder_write,
+	copy_encoder_read,
+	nullptr,
+};
+
+CopyEncoder::CopyEncoder()
+	:base(copy_encoder_plugin), buffer(64) {}
+
+static Encoder *
+TryInitEncoder(const char *group, const char *filters)
+{
+	ConfigBlock block;
+	block.AddBlockParam("encoder_group", group);
+	if (filters != nullptr)
+		block.AddBlockParam("filters", filters);
+
+	Error error;
+	return encoder_init_output(copy_encoder_plugin, block, error);
+}
+
+static Encoder *
+InitEncoder(const char *group)
+{
+	Encoder *encoder = TryInitEncoder(group, nullptr);
+	CPPUNIT_ASSERT(encoder != nullptr);
+	return encoder;
+}
+
+static void
+Open(Encoder *encoder)
+{
+	AudioFormat audio_format(44100, SampleFormat::S16, 2);
+	Error error;
+	CPPUNIT_ASSERT(encoder->Open(audio_format, error));
+}
+
+static void
+Write(Encoder *encoder, const char *data)
+{
+	Error error;
+	CPPUNIT_ASSERT(encoder_write(encoder, data, strlen(data), error));
+}
+
+static void
+WriteSilence(Encoder *encoder, const char *data)
+{
+	Error error;
+	CPPUNIT_ASSERT(encoder_write_silence(encoder, data, strlen(data),
+					     error));
+}
+
+static void
+SendTag(Encoder *encoder)
+{
+	Error error;
+	CPPUNIT_ASSERT(encoder_pre_tag(encoder, error));
+}
+
+static void
+EndTag(Encoder *encoder)
+{
+	Error error;
+	Tag tag;
+	CPPUNIT_ASSERT(encoder_tag(encoder, tag, error));
+}
+
+static void
+End(Encoder *encoder)
+{
+	Error error;
+	CPPUNIT_ASSERT(encoder_end(encoder, error));
+}
+
+static std::string
+Read(Encoder *encoder)
+{
+	std::string result;
+	char buffer[3];
+	size_t nbytes;
+	while ((nbytes = encoder_read(encoder, buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+class SharedEncoderTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SharedEncoderTest);
+	CPPUNIT_TEST(TestFanOut);
+	CPPUNIT_TEST(TestFollowerAhead);
+	CPPUNIT_TEST(TestFormatMismatch);
+	CPPUNIT_TEST(TestFilterMismatch);
+	CPPUNIT_TEST(TestClose);
+	CPPUNIT_TEST(TestEnd);
+	CPPUNIT_TEST(TestTag);
+	CPPUNIT_TEST(TestPause);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestFanOut() {
+		Encoder *a = InitEncoder("fan"), *b = InitEncoder("fan");
+		Open(a);
+		Open(b);
+
+		CPPUNIT_ASSERT(encoder_is_shared(*a));
+		CPPUNIT_ASSERT_EQUAL(std::string("H"), Read(a));
+
+		copy_encoder_writes = 0;
+		Write(a, "hello");
+		Write(b, "hello");
+		Write(a, "world");
+		CPPUNIT_ASSERT_EQUAL(2u, copy_encoder_writes);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("helloworld"), Read(a));
+
+		/* b gets only what was encoded from its own input */
+		CPPUNIT_ASSERT_EQUAL(std::string("Hhello"), Read(b));
+		Write(b, "world");
+		CPPUNIT_ASSERT_EQUAL(std::string("world"), Read(b));
+
+		/* a client which joins later gets the header */
+		Encoder *c = InitEncoder("fan");
+		Open(c);
+		Write(a, "!");
+		CPPUNIT_ASSERT_EQUAL(std::string("H"), Read(c));
+		Write(c, "!");
+		CPPUNIT_ASSERT_EQUAL(std::string("!"), Read(c));
+		CPPUNIT_ASSERT_EQUAL(3u, copy_encoder_writes);
+
+		c->Close();
+		b->Close();
+		a->Close();
+		c->Dispose();
+		b->Dispose();
+		a->Dispose();
+	}
+
+	void TestFollowerAhead() {
+		Encoder *a = InitEncoder("ahead"), *b = InitEncoder("ahead");
+		Open(a);
+		Open(b);
+
+		/* whoever is ahead feeds the encoder */
+		copy_encoder_writes = 0;
+		Write(b, "xy");
+		CPPUNIT_ASSERT_EQUAL(std::string("Hxy"), Read(b));
+		CPPUNIT_ASSERT_EQUAL(std::string("H"), Read(a));
+
+		Write(a, "xyz");
+		CPPUNIT_ASSERT_EQUAL(2u, copy_encoder_writes);
+		CPPUNIT_ASSERT_EQUAL(std::string("xyz"), Read(a));
+		CPPUNIT_ASSERT_EQUAL(std::string(), Read(b));
+
+		Write(b, "z");
+		CPPUNIT_ASSERT_EQUAL(2u, copy_encoder_writes);
+		CPPUNIT_ASSERT_EQUAL(std::string("z"), Read(b));
+
+		a->Close();
+		b->Close();
+		a->Dispose();
+		b->Dispose();
+	}
+
+	void TestFormatMismatch() {
+		Encoder *a = InitEncoder("mismatch"),
+			*b = InitEncoder("mismatch");
+		Open(a);
+
+		AudioFormat audio_format(48000, SampleFormat::S16, 2);
+		Error error;
+		CPPUNIT_ASSERT(!b->Open(audio_format, error));
+		CPPUNIT_ASSERT(error.IsDefined());
+
+		a->Close();
+		a->Dispose();
+		b->Dispose();
+	}
+
+	void TestFilterMismatch() {
+		Encoder *a = TryInitEncoder("filters", "a");
+		CPPUNIT_ASSERT(a != nullptr);
+		CPPUNIT_ASSERT(TryInitEncoder("filters", "b") == nullptr);
+		CPPUNIT_ASSERT(TryInitEncoder("filters", nullptr) == nullptr);
+
+		Encoder *b = TryInitEncoder("filters", "a");
+		CPPUNIT_ASSERT(b != nullptr);
+
+		a->Dispose();
+		b->Dispose();
+
+		ConfigBlock block;
+		block.AddBlockParam("encoder_group", "mixer");
+		block.AddBlockParam("mixer_type", "software");
+		Error error;
+		CPPUNIT_ASSERT(encoder_init_output(copy_encoder_plugin, block,
+						   error) == nullptr);
+		CPPUNIT_ASSERT(error.IsDefined());
+	}
+
+	void TestClose() {
+		Encoder *a = InitEncoder("close"), *b = InitEncoder("close");
+		Open(a);
+		Open(b);
+
+		Write(a, "abc");
+		Write(b, "abc");
+		a->Close();
+
+		Write(b, "def");
+		CPPUNIT_ASSERT_EQUAL(std::string("Habcdef"), Read(b));
+
+		b->Close();
+		a->Dispose();
+		b->Dispose();
+	}
+
+	void TestEnd() {
+		Encoder *a = InitEncoder("end"), *b = InitEncoder("end");
+		Open(a);
+		Open(b);
+
+		Write(a, "ab");
+		Write(b, "ab");
+		Write(b, "cd");
+
+		/* a gets the end of the stream, including the output
+		   of b's input which has already been encoded */
+		End(a);
+		CPPUNIT_ASSERT_EQUAL(std::string("HabcdE"), Read(a));
+		a->Close();
+
+		/* b continues with a new stream as soon as it writes
+		   more input */
+		CPPUNIT_ASSERT_EQUAL(std::string("HabcdE"), Read(b));
+		Write(b, "ef");
+		CPPUNIT_ASSERT_EQUAL(std::string("Hef"), Read(b));
+
+		/* a client which joins now gets the new header */
+		Open(a);
+		CPPUNIT_ASSERT_EQUAL(std::string("H"), Read(a));
+
+		End(b);
+		CPPUNIT_ASSERT_EQUAL(std::string("E"), Read(b));
+		b->Close();
+		Write(a, "gh");
+		CPPUNIT_ASSERT_EQUAL(std::string("EHgh"), Read(a));
+
+		/* the last client really ends the stream */
+		End(a);
+		CPPUNIT_ASSERT_EQUAL(std::string("E"), Read(a));
+		a->Close();
+
+		/* if all clients end, there is no new stream */
+		Open(a);
+		Open(b);
+		Write(a, "ij");
+		Write(b, "ij");
+		End(a);
+		End(b);
+		CPPUNIT_ASSERT_EQUAL(std::string("HijE"), Read(a));
+		CPPUNIT_ASSERT_EQUAL(std::string("HijE"), Read(b));
+
+		a->Close();
+		b->Close();
+		a->Dispose();
+		b->Dispose();
+	}
+
+	void TestTag() {
+		Encoder *a = InitEncoder("tag"), *b = InitEncoder("tag");
+		Open(a);
+		Open(b);
+		CPPUNIT_ASSERT(a->plugin.tag != nullptr);
+
+		/* a runs ahead */
+		Write(a, "one");
+		SendTag(a);
+		CPPUNIT_ASSERT_EQUAL(std::string("Hone"), Read(a));
+		EndTag(a);
+		CPPUNIT_ASSERT_EQUAL(std::string("T"), Read(a));
+		Write(a, "two");
+		CPPUNIT_ASSERT_EQUAL(std::string("two"), Read(a));
+
+		/* b does not see the new header before it has sent
+		   the tag itself */
+		Write(b, "one");
+		CPPUNIT_ASSERT_EQUAL(std::string("Hone"), Read(b));
+		SendTag(b);
+		CPPUNIT_ASSERT_EQUAL(std::string(), Read(b));
+		EndTag(b);
+		CPPUNIT_ASSERT_EQUAL(std::string("T"), Read(b));
+		Write(b, "two");
+		CPPUNIT_ASSERT_EQUAL(std::string("two"), Read(b));
+
+		a->Close();
+		b->Close();
+		a->Dispose();
+		b->Dispose();
+	}
+
+	void TestPause() {
+		Encoder *a = InitEncoder("pause"), *b = InitEncoder("pause");
+		Open(a);
+		Open(b);
+
+		/* a pauses first, after its input "one", while b is
+		   behind */
+		Write(a, "one");
+		Write(b, "o");
+		WriteSilence(a, "..");
+		WriteSilence(a, "..");
+		CPPUNIT_ASSERT_EQUAL(std::string("Hone...."), Read(a));
+
+		/* b does not get the silence before the audio it has
+		   not written yet */
+		WriteSilence(b, "_");
+		CPPUNIT_ASSERT_EQUAL(std::string("H"), Read(b));
+
+		/* b pauses for a shorter time, after catching up; it
+		   reads the silence which has already been encoded */
+		Write(b, "ne");
+		WriteSilence(b, "__");
+		CPPUNIT_ASSERT_EQUAL(std::string("one.."), Read(b));
+
+		/* b continues first; the rest of the silence is
+		   skipped */
+		copy_encoder_writes = 0;
+		Write(b, "two");
+		CPPUNIT_ASSERT_EQUAL(1u, copy_encoder_writes);
+		CPPUNIT_ASSERT_EQUAL(std::string("..two"), Read(b));
+
+		/* a has paused longer; its silence is no longer
+		   encoded, because b has continued */
+		WriteSilence(a, "..");
+		CPPUNIT_ASSERT_EQUAL(std::string(), Read(a));
+		Write(a, "two");
+		Write(a, "three");
+		CPPUNIT_ASSERT_EQUAL(std::string("twothree"), Read(a));
+		CPPUNIT_ASSERT_EQUAL(2u, copy_encoder_writes);
+
+		Write(b, "three");
+		CPPUNIT_ASSERT_EQUAL(std::string("three"), Read(b));
+		CPPUNIT_ASSERT_EQUAL(2u, copy_encoder_writes);
+
+		a->Close();
+		b->Close();
+		a->Dispose();
+		b->Dispose();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedEncoderTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
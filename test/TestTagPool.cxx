@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "tag/TagPool.hxx"
+#include "tag/TagItem.hxx"
+#include "util/StringView.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+static std::string
+MakeValue(unsigned i)
+{
+	return "value" + std::to_string(i);
+}
+
+class TagPoolTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagPoolTest);
+	CPPUNIT_TEST(TestIntern);
+	CPPUNIT_TEST(TestGrow);
+	CPPUNIT_TEST(TestThreads);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestIntern() {
+		CPPUNIT_ASSERT_EQUAL(0u, tag_pool_size());
+
+		auto a = tag_pool_get_item(TAG_ARTIST, "foo");
+		auto b = tag_pool_get_item(TAG_ARTIST, "foo");
+		auto c = tag_pool_get_item(TAG_ALBUM, "foo");
+		auto e = tag_pool_get_item(TAG_ARTIST, StringView::Empty());
+		CPPUNIT_ASSERT(a == b);
+		CPPUNIT_ASSERT(a != c);
+		CPPUNIT_ASSERT(a != e);
+		CPPUNIT_ASSERT_EQUAL(TAG_ALBUM, c->type);
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(c->value, "foo"));
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(e->value, ""));
+		CPPUNIT_ASSERT_EQUAL(3u, tag_pool_size());
+
+		/* more than 255 references must not duplicate the
+		   item */
+		for (unsigned i = 0; i < 1000; ++i)
+			CPPUNIT_ASSERT(tag_pool_dup_item(a) == a);
+		CPPUNIT_ASSERT(tag_pool_get_item(TAG_ARTIST, "foo") == a);
+		CPPUNIT_ASSERT_EQUAL(3u, tag_pool_size());
+
+		for (unsigned i = 0; i < 1002; ++i)
+			tag_pool_put_item(a);
+		CPPUNIT_ASSERT_EQUAL(3u, tag_pool_size());
+
+		tag_pool_put_item(b);
+		tag_pool_put_item(c);
+		tag_pool_put_item(e);
+		CPPUNIT_ASSERT_EQUAL(0u, tag_pool_size());
+	}
+
+	void TestGrow() {
+		constexpr unsigned N = 200000;
+
+		std::vector<TagItem *> items;
+		items.reserve(N);
+		for (unsigned i = 0; i < N; ++i) {
+			const auto value = MakeValue(i);
+			items.push_back(tag_pool_get_item(TAG_TITLE,
+							  value.c_str()));
+		}
+
+		CPPUNIT_ASSERT_EQUAL(N, tag_pool_size());
+
+		for (unsigned i = 0; i < N; ++i) {
+			const auto value = MakeValue(i);
+			auto item = tag_pool_get_item(TAG_TITLE,
+						      value.c_str());
+			CPPUNIT_ASSERT(item == items[i]);
+			CPPUNIT_ASSERT_EQUAL(value, std::string(item->value));
+			tag_pool_put_item(item);
+		}
+
+		for (auto i : items)
+			tag_pool_put_item(i);
+
+		CPPUNIT_ASSERT_EQUAL(0u, tag_pool_size());
+	}
+
+	/**
+	 * Several threads intern, duplicate and release items from
+	 * an overlapping set of values, so the last reference to an
+	 * item is often dropped while another thread looks it up.
+	 */
+	void TestThreads() {
+		constexpr unsigned N_THREADS = 8;
+		constexpr unsigned N_VALUES = 5000;
+		constexpr unsigned N_ITERATIONS = 200000;
+
+		std::atomic_uint errors(0);
+
+		auto worker = [&errors](unsigned seed){
+			std::mt19937 rng(seed);
+			std::uniform_int_distribution<unsigned>
+				random_value(0, N_VALUES - 1),
+				random_op(0, 3);
+
+			std::vector<TagItem *> held;
+
+			for (unsigned i = 0; i < N_ITERATIONS; ++i) {
+				switch (random_op(rng)) {
+				case 0:
+				case 1: {
+					const unsigned v = random_value(rng);
+					const auto value = MakeValue(v);
+					const TagType type = TagType(v % 4);
+					auto item = tag_pool_get_item(type,
+								      value.c_str());
+					if (item->type != type ||
+					    value != item->value)
+						++errors;
+					held.push_back(item);
+					break;
+				}
+
+				case 2:
+					if (!held.empty())
+						held.push_back(tag_pool_dup_item(held[rng() % held.size()]));
+					break;
+
+				case 3:
+					while (!held.empty() && rng() % 4 != 0) {
+						tag_pool_put_item(held.back());
+						held.pop_back();
+					}
+					break;
+				}
+			}
+
+			for (auto item : held)
+				tag_pool_put_item(item);
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < N_THREADS; ++i)
+			threads.emplace_back(worker, i);
+
+		for (auto &t : threads)
+			t.join();
+
+		CPPUNIT_ASSERT_EQUAL(0u, errors.load());
+		CPPUNIT_ASSERT_EQUAL(0u, tag_pool_size());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagPoolTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "event/TimerWheel.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include <random>
+#include <vector>
+
+#include <stdlib.h>
+
+struct TestItem : TimerWheel::Item {
+	bool scheduled = false;
+};
+
+class TimerWheelTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TimerWheelTest);
+	CPPUNIT_TEST(TestEmpty);
+	CPPUNIT_TEST(TestPast);
+	CPPUNIT_TEST(TestRemove);
+	CPPUNIT_TEST(TestRandom);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * Pop all items due at the given time, and check that none of
+	 * them is early or late.
+	 */
+	static unsigned PopAll(TimerWheel &wheel, uint64_t now,
+			       uint64_t previous) {
+		unsigned n = 0;
+		TimerWheel::Item *i;
+		while ((i = wheel.Pop(now)) != nullptr) {
+			auto &item = static_cast<TestItem &>(*i);
+			CPPUNIT_ASSERT(item.scheduled);
+			CPPUNIT_ASSERT(item.GetDue() <= now);
+			CPPUNIT_ASSERT(item.GetDue() > previous);
+			item.scheduled = false;
+			++n;
+		}
+
+		return n;
+	}
+
+public:
+	void TestEmpty() {
+		TimerWheel wheel(1000);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(UINT64_MAX, wheel.GetNextEvent());
+		CPPUNIT_ASSERT(wheel.Pop(123456789) == nullptr);
+	}
+
+	void TestPast() {
+		TimerWheel wheel(1000);
+		CPPUNIT_ASSERT(wheel.Pop(2000) == nullptr);
+
+		/* a due time in the past is treated as "now" */
+		TestItem item;
+		wheel.Insert(item, 1500);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(2000), wheel.GetNextEvent());
+		CPPUNIT_ASSERT(wheel.Pop(2000) == &item);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+	}
+
+	void TestRemove() {
+		TimerWheel wheel(0);
+
+		TestItem a, b, c;
+		wheel.Insert(a, 10);
+		wheel.Insert(b, 100000);
+		wheel.Insert(c, 10000000000);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(10), wheel.GetNextEvent());
+
+		wheel.Remove(a);
+		CPPUNIT_ASSERT(wheel.GetNextEvent() <= 100000);
+		CPPUNIT_ASSERT(wheel.Pop(99999) == nullptr);
+
+		wheel.Remove(b);
+		CPPUNIT_ASSERT(wheel.GetNextEvent() <= 10000000000);
+		wheel.Remove(c);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(UINT64_MAX, wheel.GetNextEvent());
+	}
+
+	/**
+	 * Schedule, reschedule and cancel many items with due times
+	 * on all levels of the wheel, and advance the clock like the
+	 * #EventLoop does.
+	 */
+	void TestRandom() {
+		std::mt19937_64 random(42);
+		std::uniform_int_distribution<unsigned> pick(0, 999);
+		std::uniform_int_distribution<unsigned> shift(0, 38);
+
+		std::vector<TestItem> items(1000);
+
+		uint64_t now = 1ull << 40, previous = now - 1;
+		TimerWheel wheel(now);
+
+		unsigned n_popped = 0;
+		for (unsigned round = 0; round < 20000; ++round) {
+			/* (re)schedule or cancel a few items */
+			for (unsigned j = 0; j < 4; ++j) {
+				TestItem &item = items[pick(random)];
+				if (item.scheduled)
+					wheel.Remove(item);
+
+				item.scheduled = pick(random) < 900;
+				if (item.scheduled) {
+					const uint64_t delta = random() &
+						((uint64_t(1) << shift(random)) - 1);
+					wheel.Insert(item, now + delta);
+				}
+			}
+
+			n_popped += PopAll(wheel, now, previous);
+
+			/* nothing must be due anymore */
+			const uint64_t next = wheel.GetNextEvent();
+			CPPUNIT_ASSERT(next > now);
+			for (const auto &item : items)
+				if (item.scheduled)
+					CPPUNIT_ASSERT(item.GetDue() >= next);
+
+			/* sleep until the next event, or wake up
+			   earlier */
+			previous = now;
+			if (next != UINT64_MAX && pick(random) < 800)
+				now = next;
+			else
+				now += 1 + pick(random);
+		}
+
+		CPPUNIT_ASSERT(n_popped > 1000);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the cost of populating and looking up a
+ * #Directory with many entries, like the database update does with a
+ * huge flat directory.
+ *
+ */
+
+#include "config.h"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+
+#include <chrono>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static std::vector<std::string>
+MakeNames(const char *format, unsigned n)
+{
+	std::vector<std::string> names;
+	names.reserve(n);
+
+	char buffer[64];
+	for (unsigned i = 0; i < n; ++i) {
+		snprintf(buffer, sizeof(buffer), format, i);
+		names.emplace_back(buffer);
+	}
+
+	return names;
+}
+
+template<typename F>
+static void
+Measure(const char *name, unsigned n, F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	printf("%-10s %8.1f ms %8.0f ns/entry\n", name,
+	       duration.count() * 1e3, duration.count() * 1e9 / n);
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_directory [N]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+	if (n == 0) {
+		fprintf(stderr, "Invalid number of entries\n");
+		return EXIT_FAILURE;
+	}
+
+	const auto song_names = MakeNames("track%07u.flac", n);
+	const auto child_names = MakeNames("dir%07u", n);
+
+	printf("%u songs, %u directories\n", n, n);
+
+	const ScopeDatabaseLock protect;
+	Directory *root = Directory::NewRoot();
+
+	/* the update walk: look up each file, add it if it's new */
+	Measure("add", n, [root, &song_names](){
+			for (const auto &name : song_names)
+				if (root->FindSong(name.c_str()) == nullptr)
+					root->AddSong(Song::NewFile(name.c_str(),
+								    *root));
+		});
+
+	/* the next update: all files are known */
+	unsigned found = 0;
+	Measure("rescan", n, [root, &song_names, &found](){
+			for (const auto &name : song_names)
+				if (root->FindSong(name.c_str()) != nullptr)
+					++found;
+		});
+
+	Measure("mkdir", n, [root, &child_names](){
+			for (const auto &name : child_names)
+				root->MakeChild(name.c_str());
+		});
+
+	Measure("lookup", n, [root, &child_names, &found](){
+			for (const auto &name : child_names) {
+				const auto r = root->LookupDirectory(name.c_str());
+				if (r.uri == nullptr)
+					++found;
+			}
+		});
+
+	Measure("remove", n, [root, &song_names](){
+			for (const auto &name : song_names) {
+				Song *song = root->FindSong(name.c_str());
+				root->RemoveSong(song);
+				song->Free();
+			}
+		});
+
+	delete root;
+
+	if (found != 2 * n) {
+		fprintf(stderr, "Lookup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
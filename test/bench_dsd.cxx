@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of the DSD to PCM conversion
+ * in #PcmDsd, compared with the dsd2pcm library which converts one
+ * channel at a time.
+ *
+ */
+
+#include "config.h"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+
+#include <chrono>
+#include <memory>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * The size of one input buffer per channel, like a decoder would
+ * submit it.
+ */
+static constexpr size_t FRAMES = 4096;
+
+static double
+MeasureLibrary(const uint8_t *src, unsigned channels, unsigned long n_rounds)
+{
+	std::unique_ptr<float[]> dest(new float[FRAMES * channels]);
+	std::unique_ptr<dsd2pcm_ctx *[]> ctx(new dsd2pcm_ctx *[channels]);
+	for (unsigned c = 0; c < channels; ++c)
+		ctx[c] = dsd2pcm_init();
+
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < n_rounds; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			dsd2pcm_translate(ctx[c], FRAMES, src + c, channels,
+					  false, dest.get() + c, channels);
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	for (unsigned c = 0; c < channels; ++c)
+		dsd2pcm_destroy(ctx[c]);
+
+	return n_rounds * FRAMES * channels / duration.count();
+}
+
+template<typename F>
+static double
+Measure(F f, unsigned long n_rounds)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < n_rounds; ++i)
+		f();
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	return n_rounds * FRAMES / duration.count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 3) {
+		fprintf(stderr, "Usage: bench_dsd [CHANNELS [SECONDS]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned channels = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 2;
+	if (channels < 1 || channels > MAX_CHANNELS) {
+		fprintf(stderr, "Invalid channel count\n");
+		return EXIT_FAILURE;
+	}
+
+	/* the amount of DSD64 audio to convert */
+	const double seconds = argc > 2
+		? strtod(argv[2], nullptr)
+		: 60;
+
+	/* DSD64: one PCM frame per DSD byte at 352.8 kHz */
+	const unsigned long n_rounds = seconds * 352800 / FRAMES;
+
+	std::unique_ptr<uint8_t[]> src(new uint8_t[FRAMES * channels]);
+	for (size_t i = 0; i < FRAMES * channels; ++i)
+		src[i] = uint8_t(i * 7919 >> 3);
+
+	const ConstBuffer<uint8_t> s(src.get(), FRAMES * channels);
+
+	PcmDsd dsd;
+
+	const double library = MeasureLibrary(src.get(), channels,
+					      n_rounds) / channels;
+	const double to_float = Measure([&](){
+			dsd.ToFloat(channels, s);
+		}, n_rounds);
+	const double to_s24 = Measure([&](){
+			dsd.ToS24(channels, s);
+		}, n_rounds);
+
+	/* a DSD64 stream generates 352800 PCM frames per second;
+	   DSD1024 is 16 times that */
+	printf("%-10s %14s %10s %10s\n", "", "frames/s", "xDSD64", "xDSD1024");
+	printf("%-10s %14.0f %10.1f %10.2f\n", "dsd2pcm",
+	       library, library / 352800, library / 352800 / 16);
+	printf("%-10s %14.0f %10.1f %10.2f\n", "float",
+	       to_float, to_float / 352800, to_float / 352800 / 16);
+	printf("%-10s %14.0f %10.1f %10.2f\n", "s24",
+	       to_s24, to_s24 / 352800, to_s24 / 352800 / 16);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * A synthetic load test for the #EventLoop's timer and idle
+ * scheduling: many simulated clients re-arm their expiry timeout,
+ * an #IdleMonitor and a #DeferredMonitor on every (simulated)
+ * command, like the MPD client code does.  A small share of the
+ * timeouts is short enough to expire during the test.  The program
+ * reports the CPU time per command.
+ *
+ */
+
+#include "config.h"
+#include "event/Loop.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "event/IdleMonitor.hxx"
+#include "event/DeferredMonitor.hxx"
+
+#include <list>
+#include <random>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+class BenchClient final
+	: TimeoutMonitor, IdleMonitor, DeferredMonitor {
+public:
+	unsigned long n_timeout = 0, n_idle = 0, n_deferred = 0;
+
+	explicit BenchClient(EventLoop &loop)
+		:TimeoutMonitor(loop), IdleMonitor(loop),
+		 DeferredMonitor(loop) {}
+
+	/**
+	 * Simulate the execution of one command.
+	 */
+	void Touch(unsigned timeout_ms) {
+		TimeoutMonitor::Schedule(timeout_ms);
+		IdleMonitor::Schedule();
+		DeferredMonitor::Schedule();
+	}
+
+private:
+	virtual void OnTimeout() override {
+		++n_timeout;
+	}
+
+	virtual void OnIdle() override {
+		++n_idle;
+	}
+
+	virtual void RunDeferred() override {
+		++n_deferred;
+	}
+};
+
+/**
+ * Touches all clients once per round, with a random timeout.
+ */
+class BenchDriver final : TimeoutMonitor {
+	std::list<BenchClient> &clients;
+
+	unsigned remaining_rounds;
+
+	std::minstd_rand random;
+	std::uniform_int_distribution<unsigned> long_timeout, short_timeout;
+
+public:
+	BenchDriver(EventLoop &loop, std::list<BenchClient> &_clients,
+		    unsigned n_rounds)
+		:TimeoutMonitor(loop), clients(_clients),
+		 remaining_rounds(n_rounds),
+		 long_timeout(30000, 90000), short_timeout(0, 20) {
+		TimeoutMonitor::Schedule(0);
+	}
+
+private:
+	virtual void OnTimeout() override {
+		if (remaining_rounds-- == 0) {
+			GetEventLoop().Break();
+			return;
+		}
+
+		for (auto &client : clients) {
+			/* one in 16 commands uses a timeout which
+			   expires during the test */
+			const unsigned timeout_ms = random() % 16 == 0
+				? short_timeout(random)
+				: long_timeout(random);
+			client.Touch(timeout_ms);
+		}
+
+		/* give the loop a chance to run the idle and deferred
+		   monitors and the expired timers */
+		TimeoutMonitor::Schedule(1);
+	}
+};
+
+static double
+GetCpuSeconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 3) {
+		fprintf(stderr, "Usage: bench_event_loop [N_CLIENTS [ROUNDS]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n_clients = argc > 1 ? strtoul(argv[1], nullptr, 10)
+		: 10000;
+	const unsigned n_rounds = argc > 2 ? strtoul(argv[2], nullptr, 10)
+		: 100;
+
+	EventLoop loop;
+
+	/* allocate the clients before the measurement starts */
+	std::list<BenchClient> clients;
+	for (unsigned i = 0; i < n_clients; ++i)
+		clients.emplace_back(loop);
+
+	double cpu;
+
+	{
+		BenchDriver driver(loop, clients, n_rounds);
+
+		const double start = GetCpuSeconds();
+		loop.Run();
+		cpu = GetCpuSeconds() - start;
+	}
+
+	unsigned long n_timeout = 0, n_idle = 0, n_deferred = 0;
+	for (const auto &client : clients) {
+		n_timeout += client.n_timeout;
+		n_idle += client.n_idle;
+		n_deferred += client.n_deferred;
+	}
+
+	clients.clear();
+
+	const unsigned long n_commands = (unsigned long)n_clients * n_rounds;
+	printf("%u clients, %u rounds: %.3f s CPU, %.0f ns/command\n",
+	       n_clients, n_rounds, cpu, cpu * 1e9 / n_commands);
+	printf("timeouts=%lu idle=%lu deferred=%lu\n",
+	       n_timeout, n_idle, n_deferred);
+
+	return EXIT_SUCCESS;
+}
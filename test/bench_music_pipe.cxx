@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of the #MusicPipe and
+ * #MusicBuffer classes, compared with the mutex based implementation
+ * they replaced.  One thread allocates and pushes chunks, another
+ * one shifts and returns them.
+ *
+ */
+
+#include "config.h"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Thread.hxx"
+#include "util/SliceBuffer.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+/**
+ * The #MusicPipe implementation which guards all operations with a
+ * mutex, for comparison.
+ */
+class MutexMusicPipe {
+	MusicChunk *head = nullptr, *tail = nullptr;
+
+	Mutex mutex;
+
+public:
+	MusicChunk *Shift() {
+		const ScopeLock protect(mutex);
+
+		MusicChunk *chunk = head;
+		if (chunk != nullptr) {
+			head = chunk->next.load(std::memory_order_relaxed);
+			if (head == nullptr)
+				tail = nullptr;
+		}
+
+		return chunk;
+	}
+
+	void Push(MusicChunk *chunk) {
+		chunk->next.store(nullptr, std::memory_order_relaxed);
+
+		const ScopeLock protect(mutex);
+
+		if (tail != nullptr)
+			tail->next.store(chunk, std::memory_order_relaxed);
+		else
+			head = chunk;
+		tail = chunk;
+	}
+};
+
+/**
+ * The #MusicBuffer implementation which guards all operations with
+ * a mutex, for comparison.
+ */
+class MutexMusicBuffer {
+	Mutex mutex;
+
+	SliceBuffer<MusicChunk> buffer;
+
+	std::unique_ptr<uint8_t[]> payload;
+
+	const size_t chunk_size;
+
+	unsigned next_payload = 0;
+
+public:
+	MutexMusicBuffer(unsigned num_chunks, size_t _chunk_size)
+		:buffer(num_chunks),
+		 payload(new uint8_t[num_chunks * _chunk_size]),
+		 chunk_size(_chunk_size) {}
+
+	MusicChunk *Allocate() {
+		const ScopeLock protect(mutex);
+		MusicChunk *chunk = buffer.Allocate();
+		if (chunk != nullptr) {
+			/* chunks are returned in FIFO order, so
+			   round-robin never hands out a data buffer
+			   which is still in use */
+			chunk->data = payload.get() +
+				(next_payload++ % buffer.GetCapacity()) * chunk_size;
+			chunk->capacity = chunk_size;
+		}
+
+		return chunk;
+	}
+
+	void Return(MusicChunk *chunk) {
+		const ScopeLock protect(mutex);
+		buffer.Free(chunk);
+	}
+};
+
+template<typename P, typename B>
+struct Context {
+	P pipe;
+	B buffer;
+
+	const unsigned long n_chunks;
+
+	Context(unsigned num_chunks, unsigned long _n_chunks)
+		:buffer(num_chunks, DEFAULT_CHUNK_SIZE), n_chunks(_n_chunks) {}
+
+	static void Produce(void *ctx) {
+		auto &c = *(Context *)ctx;
+
+		for (unsigned long i = 0; i < c.n_chunks;) {
+			MusicChunk *chunk = c.buffer.Allocate();
+			if (chunk == nullptr) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+			assert(w.size >= 4);
+			*(uint32_t *)w.data = i;
+			chunk->Expand(audio_format, 4);
+
+			c.pipe.Push(chunk);
+			++i;
+		}
+	}
+
+	void Consume() {
+		for (unsigned long i = 0; i < n_chunks;) {
+			MusicChunk *chunk = pipe.Shift();
+			if (chunk == nullptr) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			if (*(const uint32_t *)chunk->data != uint32_t(i)) {
+				fprintf(stderr, "Chunk %lu out of order\n", i);
+				exit(EXIT_FAILURE);
+			}
+
+			buffer.Return(chunk);
+			++i;
+		}
+	}
+};
+
+template<typename P, typename B>
+static double
+Run(const char *name, unsigned num_chunks, unsigned long n_chunks)
+{
+	Context<P, B> c(num_chunks, n_chunks);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	Thread producer;
+	Error error;
+	if (!producer.Start(Context<P, B>::Produce, &c, error)) {
+		LogError(error);
+		exit(EXIT_FAILURE);
+	}
+
+	c.Consume();
+	producer.Join();
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	const double rate = n_chunks / duration.count();
+	printf("%-10s %10.3f s %12.0f chunks/s\n",
+	       name, duration.count(), rate);
+	return rate;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 3) {
+		fprintf(stderr, "Usage: bench_music_pipe [N_CHUNKS [BUFFER_CHUNKS]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned long n_chunks = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 10000000;
+	const unsigned num_chunks = argc > 2
+		? strtoul(argv[2], nullptr, 10)
+		: 1024;
+
+	const double old_rate =
+		Run<MutexMusicPipe, MutexMusicBuffer>("mutex", num_chunks,
+						      n_chunks);
+	const double new_rate =
+		Run<MusicPipe, MusicBuffer>("lock-free", num_chunks,
+					    n_chunks);
+
+	printf("speedup: %.2f\n", new_rate / old_rate);
+	return EXIT_SUCCESS;
+}
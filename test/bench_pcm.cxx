@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of the x86 PCM kernels in
+ * samples per second, compared with the portable implementation.
+ *
+ */
+
+#include "config.h"
+#include "pcm/X86Simd.hxx"
+#include "pcm/PcmUtils.hxx"
+#include "pcm/FloatConvert.hxx"
+#include "pcm/ShiftConvert.hxx"
+
+#include <chrono>
+#include <memory>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_X86_SIMD
+
+/**
+ * The buffer size; small enough to stay in the L2 cache, like the
+ * audio chunks MPD processes.
+ */
+static constexpr size_t N = 4096;
+
+static float f1[N], f2[N];
+static int16_t s16a[N], s16b[N];
+static int32_t s32a[N], s32b[N];
+
+template<typename C, typename D, typename S>
+static void
+PortableConvert(D *dest, const S *src, size_t n)
+{
+	for (size_t i = 0; i != n; ++i)
+		dest[i] = C::Convert(src[i]);
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+PortableAdd(typename Traits::pointer_type a,
+	    typename Traits::const_pointer_type b, size_t n)
+{
+	typedef typename Traits::sum_type sum_type;
+
+	for (size_t i = 0; i != n; ++i)
+		a[i] = PcmClamp<F, Traits>(sum_type(a[i]) + sum_type(b[i]));
+}
+
+/**
+ * Run one operation.  If #k is nullptr, the portable implementation
+ * is used.
+ */
+typedef void (*Operation)(const X86PcmKernels *k);
+
+static const struct {
+	const char *name;
+	Operation run;
+} operations[] = {
+	{ "volume_float", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->volume_float(f2, f1, N, 0.5);
+			else
+				for (size_t i = 0; i != N; ++i)
+					f2[i] = f1[i] * 0.5f;
+		} },
+	{ "add_vol_float", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->add_vol_float(f2, f1, N, 0.5, 0.5);
+			else
+				for (size_t i = 0; i != N; ++i)
+					f2[i] = f2[i] * 0.5f + f1[i] * 0.5f;
+		} },
+	{ "add_16", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->add_16(s16b, s16a, N);
+			else
+				PortableAdd<SampleFormat::S16>(s16b, s16a, N);
+		} },
+	{ "add_24", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->add_24(s32b, s32a, N);
+			else
+				PortableAdd<SampleFormat::S24_P32>(s32b, s32a, N);
+		} },
+	{ "float_to_16", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->float_to_16(s16a, f1, N);
+			else
+				PortableConvert<FloatToIntegerSampleConvert<SampleFormat::S16>>(s16a, f1, N);
+		} },
+	{ "float_to_24", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->float_to_24(s32a, f1, N);
+			else
+				PortableConvert<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>(s32a, f1, N);
+		} },
+	{ "float_to_32", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->float_to_32(s32a, f1, N);
+			else
+				PortableConvert<FloatToIntegerSampleConvert<SampleFormat::S32>>(s32a, f1, N);
+		} },
+	{ "s16_to_float", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->s16_to_float(f2, s16a, N);
+			else
+				PortableConvert<IntegerToFloatSampleConvert<SampleFormat::S16>>(f2, s16a, N);
+		} },
+	{ "s24_to_float", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->s24_to_float(f2, s32a, N);
+			else
+				PortableConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>(f2, s32a, N);
+		} },
+	{ "s32_to_float", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->s32_to_float(f2, s32a, N);
+			else
+				PortableConvert<IntegerToFloatSampleConvert<SampleFormat::S32>>(f2, s32a, N);
+		} },
+	{ "s16_to_24", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->s16_to_24(s32b, s16a, N);
+			else
+				PortableConvert<LeftShiftSampleConvert<SampleFormat::S16, SampleFormat::S24_P32>>(s32b, s16a, N);
+		} },
+	{ "s16_to_32", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->s16_to_32(s32b, s16a, N);
+			else
+				PortableConvert<LeftShiftSampleConvert<SampleFormat::S16, SampleFormat::S32>>(s32b, s16a, N);
+		} },
+	{ "s24_to_32", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->s24_to_32(s32b, s32a, N);
+			else
+				PortableConvert<LeftShiftSampleConvert<SampleFormat::S24_P32, SampleFormat::S32>>(s32b, s32a, N);
+		} },
+	{ "s32_to_24", [](const X86PcmKernels *k){
+			if (k != nullptr)
+				k->s32_to_24(s32b, s32a, N);
+			else
+				PortableConvert<RightShiftSampleConvert<SampleFormat::S32, SampleFormat::S24_P32>>(s32b, s32a, N);
+		} },
+};
+
+static double
+Measure(Operation run, const X86PcmKernels *k, unsigned long n_samples)
+{
+	const unsigned long n_rounds = (n_samples + N - 1) / N;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < n_rounds; ++i)
+		run(k);
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	return n_rounds * N / duration.count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_pcm [N_SAMPLES]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned long n_samples = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 100000000;
+
+	for (size_t i = 0; i < N; ++i) {
+		f1[i] = f2[i] = float(int(i % 2001) - 1000) / 1000;
+		s16a[i] = s16b[i] = int16_t(i * 7919);
+		s32a[i] = s32b[i] = int32_t(i * 7919) >> 8;
+	}
+
+	const X86PcmKernels *const kernels[] = {
+		GetX86PcmKernels(X86SimdLevel::SSE2),
+		GetX86PcmKernels(X86SimdLevel::AVX2),
+	};
+
+	printf("%-14s %14s", "", "portable");
+	for (auto k : kernels)
+		if (k != nullptr)
+			printf(" %14s", k->name);
+	printf("   (samples/s)\n");
+
+	for (const auto &o : operations) {
+		printf("%-14s %14.0f", o.name,
+		       Measure(o.run, nullptr, n_samples));
+
+		for (auto k : kernels)
+			if (k != nullptr)
+				printf(" %14.0f", Measure(o.run, k, n_samples));
+
+		printf("\n");
+	}
+
+	return EXIT_SUCCESS;
+}
+
+#else
+
+int main(int, char **)
+{
+	fprintf(stderr, "No x86 SIMD support\n");
+	return EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the cost of setting, reading and finding
+ * song stickers in bulk, the way rating synchronization tools use
+ * them.  The given sticker database file is created (or extended).
+ *
+ */
+
+#include "config.h"
+#include "sticker/StickerDatabase.hxx"
+#include "event/Loop.hxx"
+#include "fs/Path.hxx"
+#include "Idle.hxx"
+#include "Log.hxx"
+#include "util/Error.hxx"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void
+idle_add(gcc_unused unsigned flags)
+{
+}
+
+template<typename F>
+static void
+Measure(const char *name, unsigned n, F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	printf("%-10s %10.1f ms %8.0f ns/sticker\n", name,
+	       duration.count() * 1e3, duration.count() * 1e9 / n);
+}
+
+static void
+MakeUri(char *buffer, size_t size, unsigned i)
+{
+	snprintf(buffer, size, "artist%u/album%u/track%02u.flac",
+		 i / 120, i / 12, i % 12);
+}
+
+static void
+FindCallback(gcc_unused const char *uri, gcc_unused const char *value,
+	     void *user_data)
+{
+	++*(unsigned *)user_data;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: bench_sticker PATH [N]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path path = Path::FromFS(argv[1]);
+	const unsigned n = argc > 2 ? strtoul(argv[2], nullptr, 10) : 50000;
+
+	EventLoop loop;
+
+	Error error;
+	if (!sticker_global_init(loop, path, error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	char uri[64], value[16];
+
+	Measure("set", n, [n, &uri, &value](){
+			for (unsigned i = 0; i < n; ++i) {
+				MakeUri(uri, sizeof(uri), i);
+				snprintf(value, sizeof(value), "%u", i % 10);
+				Error error2;
+				if (!sticker_store_value("song", uri, "rating",
+							 value, error2)) {
+					LogError(error2);
+					exit(EXIT_FAILURE);
+				}
+			}
+		});
+
+	Measure("get", n, [n, &uri](){
+			for (unsigned i = 0; i < n; ++i) {
+				MakeUri(uri, sizeof(uri), i);
+				if (sticker_load_value("song", uri, "rating",
+						       IgnoreError()).empty())
+					exit(EXIT_FAILURE);
+			}
+		});
+
+	unsigned found = 0;
+	Measure("find", n, [&found](){
+			Error error2;
+			if (!sticker_find("song", nullptr, "rating",
+					  StickerOperator::GREATER_THAN, "4",
+					  FindCallback, &found, error2)) {
+				LogError(error2);
+				exit(EXIT_FAILURE);
+			}
+		});
+
+	/* this commits all pending modifications */
+	Measure("close", n, [](){
+			sticker_global_finish();
+		});
+
+	printf("found %u\n", found);
+	return EXIT_SUCCESS;
+}
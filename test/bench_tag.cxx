@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the cost of loading a large synthetic
+ * database into memory and of copying all of its songs into the
+ * queue (and from there into another list), in time and heap usage.
+ *
+ */
+
+#include "config.h"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "DetachedSong.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Tag.hxx"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+static constexpr unsigned SONGS_PER_ALBUM = 12;
+static constexpr unsigned ALBUMS_PER_ARTIST = 10;
+
+static size_t
+HeapUsage()
+{
+#ifdef __GLIBC__
+	return mallinfo().uordblks;
+#else
+	return 0;
+#endif
+}
+
+template<typename F>
+static void
+Measure(const char *name, unsigned n, F &&f)
+{
+	const size_t heap_before = HeapUsage();
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+	const long heap_delta = long(HeapUsage()) - long(heap_before);
+
+	printf("%-10s %8.1f ms %8.0f ns/song %8ld bytes/song\n", name,
+	       duration.count() * 1e3, duration.count() * 1e9 / n,
+	       heap_delta / long(n));
+}
+
+static void
+AddTag(TagBuilder &tag, TagType type, const char *format, unsigned i)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), format, i);
+	tag.AddItem(type, buffer);
+}
+
+/**
+ * Populate the database like the database loader does: one
+ * directory per album, with songs carrying the usual tags.
+ */
+static void
+Load(Directory &root, unsigned n)
+{
+	TagBuilder tag;
+	Directory *album = nullptr;
+	char buffer[64];
+
+	for (unsigned i = 0; i < n; ++i) {
+		const unsigned album_no = i / SONGS_PER_ALBUM;
+		const unsigned artist_no = album_no / ALBUMS_PER_ARTIST;
+
+		if (i % SONGS_PER_ALBUM == 0) {
+			snprintf(buffer, sizeof(buffer), "album%06u", album_no);
+			album = root.MakeChild(buffer);
+		}
+
+		snprintf(buffer, sizeof(buffer), "%02u.flac",
+			 i % SONGS_PER_ALBUM + 1);
+		Song *song = Song::NewFile(buffer, *album);
+
+		AddTag(tag, TAG_ARTIST, "Artist %u", artist_no);
+		AddTag(tag, TAG_ALBUM_ARTIST, "Artist %u", artist_no);
+		AddTag(tag, TAG_ALBUM, "Album %u", album_no);
+		AddTag(tag, TAG_TITLE, "Title %u", i);
+		AddTag(tag, TAG_TRACK, "%u", i % SONGS_PER_ALBUM + 1);
+		AddTag(tag, TAG_DATE, "%u", 1960 + album_no % 50);
+		AddTag(tag, TAG_GENRE, "Genre %u", artist_no % 20);
+		tag.SetDuration(SignedSongTime::FromS(180 + i % 120));
+		tag.Commit(song->tag);
+
+		album->AddSong(song);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_tag [N]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+	if (n == 0) {
+		fprintf(stderr, "Invalid number of songs\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%u songs\n", n);
+
+	const ScopeDatabaseLock protect;
+	Directory *root = Directory::NewRoot();
+
+	Measure("load", n, [root, n](){
+			Load(*root, n);
+		});
+
+	std::vector<DetachedSong> queue;
+	queue.reserve(n);
+
+	/* what "add /" does: copy each song into the queue */
+	Measure("enqueue", n, [root, &queue](){
+			for (const auto &album : root->children)
+				for (const auto &song : album.songs)
+					queue.emplace_back(std::string(album.GetPath()) + "/" + song.uri,
+							   Tag(song.tag));
+		});
+
+	/* what copying the queue (e.g. to a playlist) does: the
+	   second copy of a tag shares the item array of the first */
+	std::vector<DetachedSong> copy;
+	copy.reserve(n);
+	Measure("copy", n, [&queue, &copy](){
+			for (const auto &song : queue)
+				copy.emplace_back(song);
+		});
+
+	Measure("uncopy", n, [&copy](){
+			copy.clear();
+			copy.shrink_to_fit();
+		});
+
+	/* what "playlistinfo" does */
+	unsigned found = 0;
+	Measure("lookup", n, [&queue, &found](){
+			for (const auto &song : queue)
+				if (song.GetTag().GetValue(TAG_ARTIST) != nullptr)
+					++found;
+		});
+
+	Measure("clear", n, [&queue](){
+			queue.clear();
+		});
+
+	Measure("free", n, [root](){
+			delete root;
+		});
+
+	if (found != n) {
+		fprintf(stderr, "Lookup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -24,6 +24,8 @@
 #include "FakeDecoderAPI.hxx"
 #include "input/Init.hxx"
 #include "input/InputStream.hxx"
+#include "decoder/SeekIndex.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "fs/Path.hxx"
 #include "AudioFormat.hxx"
 #include "util/Error.hxx"
@@ -36,8 +38,8 @@
 
 int main(int argc, char **argv)
 {
-	if (argc != 3) {
-		fprintf(stderr, "Usage: run_decoder DECODER URI >OUT\n");
+	if (argc < 3 || argc > 5) {
+		fprintf(stderr, "Usage: run_decoder DECODER URI [SEEK [SEEK_INDEX_FILE]] >OUT\n");
 		return EXIT_FAILURE;
 	}
 
@@ -45,6 +47,22 @@ int main(int argc, char **argv)
 	const char *const decoder_name = argv[1];
 	const char *const uri = argv[2];
 
+	if (argc > 3) {
+		char *endptr;
+		const double seek_s = strtod(argv[3], &endptr);
+		if (endptr == argv[3] || *endptr != 0 || seek_s < 0) {
+			fprintf(stderr, "Invalid seek position: %s\n",
+				argv[3]);
+			return EXIT_FAILURE;
+		}
+
+		decoder.seek = true;
+		decoder.seek_time = SongTime::FromS(seek_s);
+	}
+
+	if (argc > 4)
+		seek_index_cache_init(AllocatedPath::FromFS(argv[4]));
+
 	const ScopeIOThread io_thread;
 
 	Error error;
@@ -86,11 +104,17 @@ int main(int argc, char **argv)
 
 	decoder_plugin_deinit_all();
 	input_stream_global_finish();
+	seek_index_cache_finish();
 
 	if (!decoder.initialized) {
 		fprintf(stderr, "Decoding failed\n");
 		return EXIT_FAILURE;
 	}
 
+	if (decoder.seek || decoder.seek_error) {
+		fprintf(stderr, "Seeking failed\n");
+		return EXIT_FAILURE;
+	}
+
 	return 0;
 }
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A load test for the "httpd" output plugin: this program connects
+ * many clients to a configured httpd output, feeds silence into it
+ * at the given multiple of the real time speed and reports the CPU
+ * usage and how much of the stream has been delivered to the
+ * clients.
+ *
+ */
+
+#include "config.h"
+#include "output/Internal.hxx"
+#include "output/OutputPlugin.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "event/Loop.hxx"
+#include "ScopeIOThread.hxx"
+#include "fs/Path.hxx"
+#include "filter/FilterRegistry.hxx"
+#include "player/Control.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+const struct filter_plugin *
+filter_plugin_by_name(gcc_unused const char *name)
+{
+	assert(false);
+	return NULL;
+}
+
+PlayerControl::PlayerControl(PlayerListener &_listener,
+			     MultipleOutputs &_outputs,
+			     unsigned _buffer_chunks,
+			     size_t _chunk_size,
+			     unsigned _buffered_before_play)
+	:listener(_listener), outputs(_outputs),
+	 buffer_chunks(_buffer_chunks),
+	 chunk_size(_chunk_size),
+	 buffered_before_play(_buffered_before_play) {}
+PlayerControl::~PlayerControl() {}
+
+/**
+ * The listeners: one thread polls all sockets and counts the
+ * received bytes.
+ */
+struct Listeners {
+	const unsigned n;
+	std::unique_ptr<struct pollfd[]> fds;
+
+	std::atomic_uint n_connected;
+	std::atomic<uint64_t> n_bytes;
+	std::atomic_bool quit;
+
+	Thread thread;
+
+	explicit Listeners(unsigned _n)
+		:n(_n), fds(new struct pollfd[_n]),
+		 n_connected(0), n_bytes(0), quit(false) {}
+
+	~Listeners() {
+		for (unsigned i = 0; i < n; ++i)
+			if (fds[i].fd >= 0)
+				close(fds[i].fd);
+	}
+
+	bool Connect(unsigned port);
+
+	void Run();
+
+	static void Run(void *ctx) {
+		((Listeners *)ctx)->Run();
+	}
+};
+
+bool
+Listeners::Connect(unsigned port)
+{
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	static constexpr char request[] = "GET / HTTP/1.0\r\n\r\n";
+
+	for (unsigned i = 0; i < n; ++i) {
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		fds[i].fd = fd;
+		fds[i].events = POLLIN;
+
+		if (fd < 0 ||
+		    connect(fd, (const struct sockaddr *)&sin,
+			    sizeof(sin)) < 0 ||
+		    write(fd, request, sizeof(request) - 1) < 0) {
+			perror("Failed to connect");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+Listeners::Run()
+{
+	std::unique_ptr<bool[]> connected(new bool[n]());
+	static char buffer[65536];
+
+	while (!quit) {
+		if (poll(fds.get(), n, 100) <= 0)
+			continue;
+
+		for (unsigned i = 0; i < n; ++i) {
+			if (fds[i].revents == 0)
+				continue;
+
+			ssize_t nbytes = read(fds[i].fd, buffer, sizeof(buffer));
+			if (nbytes <= 0) {
+				fprintf(stderr, "Client %u disconnected\n", i);
+				close(fds[i].fd);
+				fds[i].fd = -1;
+				continue;
+			}
+
+			if (!connected[i]) {
+				connected[i] = true;
+				++n_connected;
+			}
+
+			n_bytes += nbytes;
+		}
+	}
+}
+
+static double
+CpuSeconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static bool
+RunLoad(AudioOutput *ao, unsigned port, Listeners &listeners,
+	double seconds, double speed)
+{
+	Error error;
+	if (!ao_plugin_enable(ao, error)) {
+		LogError(error, "Failed to enable audio output");
+		return false;
+	}
+
+	AudioFormat audio_format(44100, SampleFormat::S16, 2);
+	if (!ao_plugin_open(ao, audio_format, error)) {
+		ao_plugin_disable(ao);
+		LogError(error, "Failed to open audio output");
+		return false;
+	}
+
+	if (!listeners.Connect(port) ||
+	    !listeners.thread.Start(Listeners::Run, &listeners, error)) {
+		ao_plugin_close(ao);
+		ao_plugin_disable(ao);
+		return false;
+	}
+
+	/* wait until all clients have received the response
+	   header */
+	for (unsigned i = 0; i < 100 && listeners.n_connected < listeners.n;
+	     ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	if (listeners.n_connected < listeners.n) {
+		fprintf(stderr, "Only %u of %u clients are connected\n",
+			listeners.n_connected.load(), listeners.n);
+		ao_plugin_close(ao);
+		ao_plugin_disable(ao);
+		return false;
+	}
+
+	const uint64_t n_input = uint64_t(seconds *
+					  audio_format.GetTimeToSize());
+
+	listeners.n_bytes = 0;
+	const double cpu_start = CpuSeconds();
+	const auto start = std::chrono::steady_clock::now();
+
+	static char silence[4096];
+	for (uint64_t position = 0; position < n_input;) {
+		size_t consumed = ao_plugin_play(ao, silence, sizeof(silence),
+						 error);
+		if (consumed == 0) {
+			LogError(error, "Failed to play");
+			break;
+		}
+
+		position += consumed;
+
+		/* throttle to the given speed */
+		const std::chrono::duration<double>
+			should_elapsed(position / speed /
+				       audio_format.GetTimeToSize());
+		const auto now = std::chrono::steady_clock::now();
+		if (now - start < should_elapsed)
+			std::this_thread::sleep_for(should_elapsed - (now - start));
+	}
+
+	/* wait until the clients have received everything (the
+	   encoder may add a little) */
+	const uint64_t expected = n_input * listeners.n;
+	for (unsigned i = 0; i < 500 && listeners.n_bytes < expected; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+	const double cpu = CpuSeconds() - cpu_start;
+
+	listeners.quit = true;
+	listeners.thread.Join();
+
+	ao_plugin_close(ao);
+	ao_plugin_disable(ao);
+
+	const double n_bytes = listeners.n_bytes;
+	printf("clients:    %u\n", listeners.n);
+	printf("audio:      %.1f s\n", seconds);
+	printf("wall time:  %.3f s (%.1fx real time)\n",
+	       duration.count(), seconds / duration.count());
+	printf("CPU time:   %.3f s (including the listeners), "
+	       "%.2f ms per audio second\n",
+	       cpu, cpu * 1000 / seconds);
+	printf("delivered:  %.1f MB (%.1f%%), %.1f MB/s\n",
+	       n_bytes / 1e6, n_bytes * 100. / expected,
+	       n_bytes / 1e6 / duration.count());
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	Error error;
+
+	if (argc < 4 || argc > 6) {
+		fprintf(stderr, "Usage: run_httpd_load CONFIG NAME N_CLIENTS [SECONDS [SPEED]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path config_path = Path::FromFS(argv[1]);
+	const unsigned n_clients = strtoul(argv[3], nullptr, 10);
+	const double seconds = argc > 4 ? strtod(argv[4], nullptr) : 60;
+	const double speed = argc > 5 ? strtod(argv[5], nullptr) : 10;
+
+	if (n_clients == 0 || seconds <= 0 || speed <= 0) {
+		fprintf(stderr, "Invalid arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	config_global_init();
+	if (!ReadConfigFile(config_path, error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	EventLoop event_loop;
+
+	const ScopeIOThread io_thread;
+
+	const auto *param = config_find_block(ConfigBlockOption::AUDIO_OUTPUT,
+					      "name", argv[2]);
+	if (param == nullptr) {
+		fprintf(stderr, "No such configured audio output: %s\n",
+			argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	static PlayerControl dummy_player_control(*(PlayerListener *)nullptr,
+						  *(MultipleOutputs *)nullptr,
+						  32, 4096, 4);
+
+	AudioOutput *ao = audio_output_new(event_loop, *param,
+					   *(MixerListener *)nullptr,
+					   dummy_player_control,
+					   error);
+	if (ao == nullptr) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	bool success;
+	{
+		Listeners listeners(n_clients);
+		success = RunLoad(ao, param->GetBlockValue("port", 8000u),
+				  listeners, seconds, speed);
+	}
+
+	audio_output_free(ao);
+
+	config_global_finish();
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,6 +20,8 @@
 #ifndef MPD_TEST_PCM_ALL_HXX
 #define MPD_TEST_PCM_ALL_HXX
 
+#include "pcm/X86Simd.hxx"
+
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/HelperMacros.h>
 
@@ -137,4 +139,42 @@ public:
 	void TestAlsaChannelOrder();
 };
 
+#ifdef ENABLE_DSD
+
+class PcmDsdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmDsdTest);
+	CPPUNIT_TEST(TestFloat);
+	CPPUNIT_TEST(TestInteger);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestFloat();
+	void TestInteger();
+};
+
+#endif
+
+#ifdef HAVE_X86_SIMD
+
+class PcmSimdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmSimdTest);
+	CPPUNIT_TEST(TestVolumeFloat);
+	CPPUNIT_TEST(TestMixFloat);
+	CPPUNIT_TEST(TestAddInteger);
+	CPPUNIT_TEST(TestFloatToInteger);
+	CPPUNIT_TEST(TestIntegerToFloat);
+	CPPUNIT_TEST(TestShift);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestVolumeFloat();
+	void TestMixFloat();
+	void TestAddInteger();
+	void TestFloatToInteger();
+	void TestIntegerToFloat();
+	void TestShift();
+};
+
+#endif
+
 #endif
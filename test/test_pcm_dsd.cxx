@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+
+#ifdef ENABLE_DSD
+
+#include "pcm/PcmDsd.hxx"
+#include "pcm/PcmUtils.hxx"
+#include "pcm/FloatConvert.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/Macros.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+
+static constexpr unsigned CHANNELS = 3;
+static constexpr size_t N_FRAMES = 2003;
+
+/**
+ * Feed the buffer to #PcmDsd in chunks of different sizes.
+ */
+static void
+ConvertInChunks(PcmDsd &dsd, const uint8_t *src, float *dest)
+{
+	static constexpr size_t chunk_frames[] = { 1, 7, 100, 3, 1000 };
+
+	size_t position = 0, i = 0;
+	while (position < N_FRAMES) {
+		size_t n = std::min(chunk_frames[i++ % ARRAY_SIZE(chunk_frames)],
+				    N_FRAMES - position);
+
+		auto d = dsd.ToFloat(CHANNELS,
+				     { src + position * CHANNELS, n * CHANNELS });
+		CPPUNIT_ASSERT_EQUAL(n * CHANNELS, d.size);
+		memcpy(dest + position * CHANNELS, d.data,
+		       d.size * sizeof(*d.data));
+
+		position += n;
+	}
+}
+
+void
+PcmDsdTest::TestFloat()
+{
+	const TestDataBuffer<uint8_t, N_FRAMES * CHANNELS> src;
+
+	/* the reference: the dsd2pcm library, one channel at a
+	   time */
+	static float expected[N_FRAMES * CHANNELS];
+	for (unsigned c = 0; c < CHANNELS; ++c) {
+		dsd2pcm_ctx *ctx = dsd2pcm_init();
+		dsd2pcm_translate(ctx, N_FRAMES, src.begin() + c, CHANNELS,
+				  false, expected + c, CHANNELS);
+		dsd2pcm_destroy(ctx);
+	}
+
+	PcmDsd dsd;
+	static float result[N_FRAMES * CHANNELS];
+	ConvertInChunks(dsd, src.begin(), result);
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(result, expected, sizeof(result)));
+
+	/* after Reset(), the filter must start from scratch */
+	dsd.Reset();
+	memset(result, 0, sizeof(result));
+	ConvertInChunks(dsd, src.begin(), result);
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(result, expected, sizeof(result)));
+}
+
+template<SampleFormat F, typename T>
+static void
+CheckInteger(ConstBuffer<float> f, ConstBuffer<T> d)
+{
+	CPPUNIT_ASSERT_EQUAL(f.size, d.size);
+
+	for (size_t i = 0; i < f.size; ++i)
+		CPPUNIT_ASSERT_EQUAL(FloatToIntegerSampleConvert<F>::Convert(f[i]),
+				     d[i]);
+}
+
+void
+PcmDsdTest::TestInteger()
+{
+	const TestDataBuffer<uint8_t, N_FRAMES * CHANNELS> src;
+
+	PcmDsd dsd1, dsd2;
+
+	const auto f = dsd1.ToFloat(CHANNELS, src);
+	CheckInteger<SampleFormat::S16>(f, dsd2.ToS16(CHANNELS, src));
+
+	const auto f2 = dsd1.ToFloat(CHANNELS, src);
+	CheckInteger<SampleFormat::S24_P32>(f2, dsd2.ToS24(CHANNELS, src));
+
+	const auto f3 = dsd1.ToFloat(CHANNELS, src);
+	CheckInteger<SampleFormat::S32>(f3, dsd2.ToS32(CHANNELS, src));
+}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/X86Simd.hxx"
+#include "pcm/PcmUtils.hxx"
+#include "pcm/FloatConvert.hxx"
+#include "pcm/ShiftConvert.hxx"
+
+#ifdef HAVE_X86_SIMD
+
+#include <algorithm>
+#include <array>
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * These tests compare each x86 kernel with the portable
+ * implementation it replaces; the results must be bit-exact.
+ *
+ */
+
+static constexpr size_t N = 509;
+
+template<typename F>
+static void
+ForEachKernelSet(F f)
+{
+	static constexpr X86SimdLevel levels[] = {
+		X86SimdLevel::SSE2,
+		X86SimdLevel::AVX2,
+	};
+
+	for (auto level : levels) {
+		const X86PcmKernels *k = GetX86PcmKernels(level);
+		if (k != nullptr)
+			f(*k);
+	}
+}
+
+/**
+ * Check the number of samples returned by a kernel: it must process
+ * whole vectors only, and leave no more than one block to the
+ * caller.
+ */
+static void
+CheckDone(size_t done, size_t n)
+{
+	CPPUNIT_ASSERT(done <= n);
+	CPPUNIT_ASSERT(n - done < 32);
+}
+
+template<typename T, size_t M>
+static void
+AssertBitExact(const T *a, const std::array<T, M> &b, size_t n)
+{
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(a, &b.front(), n * sizeof(T)));
+}
+
+template<typename Portable, typename D, typename S, size_t M>
+static void
+CheckConvert(X86ConvertFunction<D, S> kernel, const std::array<S, M> &src)
+{
+	/* start at an odd offset to catch alignment bugs */
+	const size_t n = M - 1;
+
+	std::array<D, M> expected;
+	for (size_t i = 0; i < n; ++i)
+		expected[i] = Portable::Convert(src[i + 1]);
+
+	std::array<D, M> result;
+	const size_t done = kernel(&result.front(), &src.front() + 1, n);
+	CheckDone(done, n);
+	AssertBitExact(&result.front(), expected, done);
+}
+
+/**
+ * Random floats in the nominal range, plus some which need clamping.
+ */
+template<size_t M>
+static std::array<float, M>
+MakeFloatData(float extra)
+{
+	std::array<float, M> data;
+	RandomFloat r;
+	for (auto &i : data)
+		i = r();
+
+	data[10] = 1.0;
+	data[11] = -1.0;
+	data[12] = 1.5;
+	data[13] = -1.5;
+	data[14] = extra;
+	data[15] = -extra;
+	data[16] = 0.99999994;
+	data[17] = -0.99999994;
+	data[18] = 0;
+	return data;
+}
+
+void
+PcmSimdTest::TestVolumeFloat()
+{
+	const auto src = MakeFloatData<N>(2);
+	constexpr float volume = 0.3;
+
+	ForEachKernelSet([&src](const X86PcmKernels &k){
+			std::array<float, N> expected, result;
+			for (size_t i = 0; i < N; ++i)
+				expected[i] = src[i] * volume;
+
+			size_t done = k.volume_float(&result.front(),
+						     &src.front(), N, volume);
+			CheckDone(done, N);
+			AssertBitExact(&result.front(), expected, done);
+		});
+}
+
+void
+PcmSimdTest::TestMixFloat()
+{
+	const auto src1 = MakeFloatData<N>(2);
+	const auto src2 = MakeFloatData<N>(2);
+	constexpr float volume1 = 0.7, volume2 = 0.3;
+
+	ForEachKernelSet([&src1, &src2](const X86PcmKernels &k){
+			std::array<float, N> expected, result;
+
+			for (size_t i = 0; i < N; ++i)
+				expected[i] = src1[i] * volume1
+					+ src2[i] * volume2;
+
+			result = src1;
+			size_t done = k.add_vol_float(&result.front(),
+						      &src2.front(), N,
+						      volume1, volume2);
+			CheckDone(done, N);
+			AssertBitExact(&result.front(), expected, done);
+
+			for (size_t i = 0; i < N; ++i)
+				expected[i] = src1[i] + src2[i];
+
+			result = src1;
+			done = k.add_float(&result.front(), &src2.front(), N);
+			CheckDone(done, N);
+			AssertBitExact(&result.front(), expected, done);
+		});
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+CheckAdd(size_t (*kernel)(typename Traits::pointer_type,
+			  typename Traits::const_pointer_type, size_t),
+	 const std::array<typename Traits::value_type, N> &src1,
+	 const std::array<typename Traits::value_type, N> &src2)
+{
+	typedef typename Traits::sum_type sum_type;
+
+	std::array<typename Traits::value_type, N> expected;
+	for (size_t i = 0; i < N; ++i)
+		expected[i] = PcmClamp<F, Traits>(sum_type(src1[i]) +
+						  sum_type(src2[i]));
+
+	auto result = src1;
+	size_t done = kernel(&result.front(), &src2.front(), N);
+	CheckDone(done, N);
+	AssertBitExact(&result.front(), expected, done);
+}
+
+void
+PcmSimdTest::TestAddInteger()
+{
+	std::array<int16_t, N> a16, b16;
+	std::array<int32_t, N> a24, b24;
+
+	RandomInt<int16_t> r16;
+	RandomInt24 r24;
+	for (size_t i = 0; i < N; ++i) {
+		a16[i] = r16();
+		b16[i] = r16();
+		a24[i] = r24();
+		b24[i] = r24();
+	}
+
+	ForEachKernelSet([&](const X86PcmKernels &k){
+			CheckAdd<SampleFormat::S16>(k.add_16, a16, b16);
+			CheckAdd<SampleFormat::S24_P32>(k.add_24, a24, b24);
+		});
+}
+
+void
+PcmSimdTest::TestFloatToInteger()
+{
+	const auto src = MakeFloatData<N>(1000);
+
+	ForEachKernelSet([&src](const X86PcmKernels &k){
+			CheckConvert<FloatToIntegerSampleConvert<SampleFormat::S16>>(k.float_to_16, src);
+			CheckConvert<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>(k.float_to_24, src);
+			CheckConvert<FloatToIntegerSampleConvert<SampleFormat::S32>>(k.float_to_32, src);
+		});
+}
+
+void
+PcmSimdTest::TestIntegerToFloat()
+{
+	const TestDataBuffer<int16_t, N> s16;
+	const TestDataBuffer<int32_t, N> s24{RandomInt24()};
+	const TestDataBuffer<int32_t, N> s32;
+
+	std::array<int16_t, N> a16;
+	std::array<int32_t, N> a24, a32;
+	std::copy(s16.begin(), s16.end(), a16.begin());
+	std::copy(s24.begin(), s24.end(), a24.begin());
+	std::copy(s32.begin(), s32.end(), a32.begin());
+
+	/* extreme values */
+	a16[3] = -32768;
+	a16[4] = 32767;
+	a24[3] = -(1 << 23);
+	a24[4] = (1 << 23) - 1;
+	a32[3] = INT32_MIN;
+	a32[4] = INT32_MAX;
+
+	ForEachKernelSet([&](const X86PcmKernels &k){
+			CheckConvert<IntegerToFloatSampleConvert<SampleFormat::S16>>(k.s16_to_float, a16);
+			CheckConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>(k.s24_to_float, a24);
+			CheckConvert<IntegerToFloatSampleConvert<SampleFormat::S32>>(k.s32_to_float, a32);
+		});
+}
+
+void
+PcmSimdTest::TestShift()
+{
+	const TestDataBuffer<int16_t, N> s16;
+	const TestDataBuffer<int32_t, N> s24{RandomInt24()};
+	const TestDataBuffer<int32_t, N> s32;
+
+	std::array<int16_t, N> a16;
+	std::array<int32_t, N> a24, a32;
+	std::copy(s16.begin(), s16.end(), a16.begin());
+	std::copy(s24.begin(), s24.end(), a24.begin());
+	std::copy(s32.begin(), s32.end(), a32.begin());
+
+	ForEachKernelSet([&](const X86PcmKernels &k){
+			CheckConvert<LeftShiftSampleConvert<SampleFormat::S16,
+							    SampleFormat::S24_P32>>(k.s16_to_24, a16);
+			CheckConvert<LeftShiftSampleConvert<SampleFormat::S16,
+							    SampleFormat::S32>>(k.s16_to_32, a16);
+			CheckConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
+							    SampleFormat::S32>>(k.s24_to_32, a24);
+			CheckConvert<RightShiftSampleConvert<SampleFormat::S32,
+							     SampleFormat::S24_P32>>(k.s32_to_24, a32);
+		});
+}
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "queue/Queue.hxx"
+#include "DetachedSong.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <random>
+#include <vector>
+
+Tag::Tag(const Tag &) {}
+void Tag::Clear() {}
+
+class QueueChangesTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(QueueChangesTest);
+	CPPUNIT_TEST(TestChangeLog);
+	CPPUNIT_TEST(TestRandom);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * Compare Queue::FindNewer() with a scan using
+	 * Queue::IsNewerAtPosition().
+	 */
+	static void Check(const Queue &queue, uint32_t version,
+			  unsigned start, unsigned end) {
+		std::vector<QueueChangeLog::Range> ranges;
+		queue.FindNewer(version, start, end, ranges);
+
+		std::vector<unsigned> found;
+		for (const auto &range : ranges) {
+			CPPUNIT_ASSERT(range.start < range.end);
+			CPPUNIT_ASSERT(found.empty() ||
+				       found.back() < range.start);
+
+			for (unsigned i = range.start; i < range.end; ++i)
+				found.push_back(i);
+		}
+
+		std::vector<unsigned> expected;
+		for (unsigned i = start; i < end && i < queue.GetLength(); ++i)
+			if (queue.IsNewerAtPosition(i, version))
+				expected.push_back(i);
+
+		CPPUNIT_ASSERT(found == expected);
+	}
+
+public:
+	void TestChangeLog();
+	void TestRandom();
+};
+
+void
+QueueChangesTest::TestChangeLog()
+{
+	QueueChangeLog log(1);
+	std::vector<QueueChangeLog::Range> ranges;
+
+	CPPUNIT_ASSERT(!log.Collect(0, ranges));
+	CPPUNIT_ASSERT(log.Collect(1, ranges));
+	CPPUNIT_ASSERT(ranges.empty());
+
+	/* adjacent positions are merged */
+	for (unsigned i = 10; i < 20; ++i)
+		log.Add(1, i);
+	for (unsigned i = 9; i > 4; --i)
+		log.Add(1, i);
+
+	log.Add(2, 30);
+	log.Add(3, 18);
+	log.Add(3, 25);
+
+	CPPUNIT_ASSERT(log.Collect(1, ranges));
+	CPPUNIT_ASSERT_EQUAL(size_t(3), ranges.size());
+	CPPUNIT_ASSERT_EQUAL(5u, ranges[0].start);
+	CPPUNIT_ASSERT_EQUAL(20u, ranges[0].end);
+	CPPUNIT_ASSERT_EQUAL(25u, ranges[1].start);
+	CPPUNIT_ASSERT_EQUAL(26u, ranges[1].end);
+	CPPUNIT_ASSERT_EQUAL(30u, ranges[2].start);
+	CPPUNIT_ASSERT_EQUAL(31u, ranges[2].end);
+
+	CPPUNIT_ASSERT(log.Collect(3, ranges));
+	CPPUNIT_ASSERT_EQUAL(size_t(2), ranges.size());
+	CPPUNIT_ASSERT_EQUAL(18u, ranges[0].start);
+	CPPUNIT_ASSERT_EQUAL(19u, ranges[0].end);
+
+	CPPUNIT_ASSERT(log.Collect(4, ranges));
+	CPPUNIT_ASSERT(ranges.empty());
+
+	/* overflow discards old versions */
+	for (unsigned i = 0; i < 1000; ++i)
+		log.Add(4 + i, i * 2);
+
+	CPPUNIT_ASSERT(!log.Collect(3, ranges));
+	CPPUNIT_ASSERT(log.Collect(1000, ranges));
+	CPPUNIT_ASSERT_EQUAL(size_t(4), ranges.size());
+}
+
+void
+QueueChangesTest::TestRandom()
+{
+	Queue queue(64);
+	std::mt19937 rng(42);
+
+	const auto random = [&rng](unsigned n){
+		return std::uniform_int_distribution<unsigned>(0, n - 1)(rng);
+	};
+
+	for (unsigned step = 0; step < 2000; ++step) {
+		const unsigned length = queue.GetLength();
+
+		switch (random(9)) {
+		case 0:
+		case 1:
+			if (!queue.IsFull())
+				queue.Append(DetachedSong("foo.ogg"), 0);
+			break;
+
+		case 2:
+			if (length > 0)
+				queue.DeletePosition(random(length));
+			break;
+
+		case 3:
+			if (length > 1)
+				queue.MovePostion(random(length),
+						  random(length));
+			break;
+
+		case 4:
+			if (length > 2) {
+				const unsigned start = random(length - 1);
+				const unsigned end = start + 1 +
+					random(length - start - 1);
+				const unsigned to =
+					random(length - (end - start) + 1);
+				queue.MoveRange(start, end, to);
+			}
+			break;
+
+		case 5:
+			if (length > 1)
+				queue.SwapPositions(random(length),
+						    random(length));
+			break;
+
+		case 6:
+			if (length > 0)
+				queue.SetPriority(random(length),
+						  random(256), -1);
+			break;
+
+		case 7:
+			/* many scattered modifications, which may
+			   overflow the change log */
+			if (length > 1 && random(10) == 0)
+				queue.ShuffleRange(0, length);
+			break;
+
+		case 8:
+			if (random(50) == 0)
+				queue.Clear();
+			else if (length > 0)
+				queue.ModifyAtPosition(random(length));
+			break;
+		}
+
+		queue.IncrementVersion();
+
+		Check(queue, 0, 0, queue.max_length);
+
+		for (uint32_t v = queue.version > 300 ? queue.version - 300 : 1;
+		     v <= queue.version + 1; ++v) {
+			Check(queue, v, 0, queue.max_length);
+
+			const unsigned start = random(queue.max_length);
+			Check(queue, v, start,
+			      start + random(queue.max_length - start + 1));
+		}
+	}
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QueueChangesTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}